@@ -0,0 +1,50 @@
+#include "alloc_counter.hpp"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local alloc_stats t_stats;
+
+void* counted_malloc(size_t size)
+{
+  t_stats.count++;
+  t_stats.bytes += size;
+  return std::malloc(size ? size : 1);
+}
+
+} // namespace
+
+alloc_stats thread_alloc_stats()
+{
+  return t_stats;
+}
+
+void* operator new(size_t size)
+{
+  if (void* p = counted_malloc(size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return counted_malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return counted_malloc(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+// Counts the allocations made through the global operator new, which
+// alloc_counter.cpp replaces for the whole CPSEBench executable.
+// Counters are per thread so that background jobs (name filters, hash
+// scans..) don't blur the numbers of the measured thread.
+
+struct alloc_stats
+{
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+
+  alloc_stats operator-(const alloc_stats& rhs) const
+  {
+    return {count - rhs.count, bytes - rhs.bytes};
+  }
+};
+
+// allocations made by the calling thread since it started
+alloc_stats thread_alloc_stats();
@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+#include "benches.hpp"
+
+namespace {
+
+struct bench_entry
+{
+  const char* name;
+  const char* description;
+  int (*main_fn)(int argc, char** argv);
+};
+
+constexpr bench_entry s_benches[] = {
+  { "cproperty", "per-field serialization cost of primitive CProperty classes", &cproperty_bench_main },
+  { "pipeline",  "per-stage time, throughput and allocations of loading and saving", &pipeline_bench_main },
+  { "synth",     "generates synthetic saves of growing size and checks they read back", &synth_bench_main },
+  { "widgets",   "headless frame time and allocations of the editor widgets", &widgets_bench_main },
+};
+
+void print_usage()
+{
+  printf("usage: CPSEBench <bench> [args...]\n\nbenches:\n");
+  for (auto& b : s_benches)
+    printf("  %-12s %s\n", b.name, b.description);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    print_usage();
+    return 1;
+  }
+
+  const std::string_view name = argv[1];
+  for (auto& b : s_benches)
+  {
+    if (name == b.name)
+      return b.main_fn(argc - 1, argv + 1);
+  }
+
+  fprintf(stderr, "unknown bench: %s\n\n", argv[1]);
+  print_usage();
+  return 1;
+}
+
@@ -0,0 +1,9 @@
+#pragma once
+
+// each bench is a sub-command of CPSEBench: CPSEBench <name> [args...]
+
+int cproperty_bench_main(int argc, char** argv);
+int pipeline_bench_main(int argc, char** argv);
+int synth_bench_main(int argc, char** argv);
+int widgets_bench_main(int argc, char** argv);
+
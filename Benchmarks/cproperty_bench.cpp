@@ -0,0 +1,209 @@
+// Microbenchmark of the primitive CProperty classes.
+//
+// Measures the per-field cost of serialize_in/serialize_out for every
+// integer/float width, comparing the templated properties with a replica of
+// the previous runtime-kind CIntProperty (EIntKind + union + cached size).
+
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <memory>
+#include <vector>
+
+#include <utils.hpp>
+#include <csav/csystem/CProperty.hpp>
+#include <csav/csystem/CSystemSerCtx.hpp>
+#include "benches.hpp"
+
+namespace {
+
+//------------------------------------------------------------------------------
+// replica of the former CIntProperty, kept here as the baseline
+//------------------------------------------------------------------------------
+
+class CLegacyIntProperty
+  : public CProperty
+{
+protected:
+  union
+  {
+    uint8_t  u8;
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64 = 0;
+  }
+  m_value;
+
+  const EIntKind m_int_kind;
+  const size_t m_int_size;
+  CSysName m_ctypename;
+
+public:
+  CLegacyIntProperty(CPropertyOwner* owner, EIntKind int_kind)
+    : CProperty(owner, EPropertyKind::Integer)
+    , m_int_kind(int_kind)
+    , m_int_size(int_size(int_kind))
+    , m_ctypename(int_ctypename(int_kind))
+  {
+  }
+
+  static size_t int_size(EIntKind int_kind)
+  {
+    switch (int_kind)
+    {
+      case EIntKind::U8:
+      case EIntKind::I8: return 1;
+      case EIntKind::U16:
+      case EIntKind::I16: return 2;
+      case EIntKind::U32:
+      case EIntKind::I32: return 4;
+      default: break;
+    }
+    return 8;
+  }
+
+  static std::string int_ctypename(EIntKind int_kind)
+  {
+    switch (int_kind)
+    {
+      case EIntKind::U8: return "Uint8";
+      case EIntKind::I8: return "Int8";
+      case EIntKind::U16: return "Uint16";
+      case EIntKind::I16: return "Int16";
+      case EIntKind::U32: return "Uint32";
+      case EIntKind::I32: return "Int32";
+      case EIntKind::U64: return "Uint64";
+      default: break;
+    }
+    return "Int64";
+  }
+
+  CSysName ctypename() const override { return m_ctypename; }
+
+  bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
+  {
+    is.read((char*)&m_value.u64, m_int_size);
+    return is.good();
+  }
+
+  bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const override
+  {
+    os.write((char*)&m_value.u64, m_int_size);
+    return true;
+  }
+};
+
+//------------------------------------------------------------------------------
+// harness
+//------------------------------------------------------------------------------
+
+using clock_type = std::chrono::steady_clock;
+
+constexpr size_t field_count = 200000;
+constexpr size_t iterations = 10;
+
+struct bench_result
+{
+  double in_ns_per_field = 0;
+  double out_ns_per_field = 0;
+  size_t instance_size = 0;
+};
+
+// props must all have the same serialized size (elt_size)
+bench_result run_bench(std::vector<CPropertyUPtr>& props, size_t elt_size, size_t instance_size)
+{
+  CSystemSerCtx serctx;
+  bench_result res;
+  res.instance_size = instance_size;
+
+  std::vector<char> buf(props.size() * elt_size);
+  for (size_t i = 0; i < buf.size(); ++i)
+    buf[i] = (char)(i * 31);
+
+  double in_ns = 0, out_ns = 0;
+  for (size_t it = 0; it < iterations; ++it)
+  {
+    span_istreambuf sbuf(buf.data(), buf.data() + buf.size());
+    std::istream is(&sbuf);
+
+    auto t0 = clock_type::now();
+    for (auto& prop : props)
+      std::ignore = prop->serialize_in(is, serctx);
+    auto t1 = clock_type::now();
+
+    std::ostringstream os;
+    auto t2 = clock_type::now();
+    for (auto& prop : props)
+      prop->serialize_out(os, serctx);
+    auto t3 = clock_type::now();
+
+    in_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+    out_ns += std::chrono::duration<double, std::nano>(t3 - t2).count();
+  }
+
+  const double n = (double)(props.size() * iterations);
+  res.in_ns_per_field = in_ns / n;
+  res.out_ns_per_field = out_ns / n;
+  return res;
+}
+
+template <EIntKind IntKind>
+void bench_int_kind()
+{
+  using prop_type = CIntPropertyT<IntKind>;
+
+  std::vector<CPropertyUPtr> legacy_props, props;
+  legacy_props.reserve(field_count);
+  props.reserve(field_count);
+  for (size_t i = 0; i < field_count; ++i)
+  {
+    legacy_props.emplace_back(std::make_unique<CLegacyIntProperty>(nullptr, IntKind));
+    props.emplace_back(std::make_unique<prop_type>(nullptr));
+  }
+
+  auto before = run_bench(legacy_props, prop_type::size, sizeof(CLegacyIntProperty));
+  auto after = run_bench(props, prop_type::size, sizeof(prop_type));
+
+  printf("%-8s | %4zu B  in %6.2f ns  out %6.2f ns | %4zu B  in %6.2f ns  out %6.2f ns\n",
+    prop_type::traits::ctypename,
+    before.instance_size, before.in_ns_per_field, before.out_ns_per_field,
+    after.instance_size, after.in_ns_per_field, after.out_ns_per_field);
+}
+
+template <typename FloatType>
+void bench_float_type()
+{
+  using prop_type = CFloatPropertyT<FloatType>;
+
+  std::vector<CPropertyUPtr> props;
+  props.reserve(field_count);
+  for (size_t i = 0; i < field_count; ++i)
+    props.emplace_back(std::make_unique<prop_type>(nullptr));
+
+  auto after = run_bench(props, prop_type::size, sizeof(prop_type));
+
+  printf("%-8s |                                 | %4zu B  in %6.2f ns  out %6.2f ns\n",
+    prop_type::traits::ctypename,
+    after.instance_size, after.in_ns_per_field, after.out_ns_per_field);
+}
+
+} // namespace
+
+int cproperty_bench_main(int argc, char** argv)
+{
+  printf("%zu fields x %zu iterations\n\n", field_count, iterations);
+  printf("type     | before (runtime EIntKind)       | after (templated)\n");
+
+  bench_int_kind<EIntKind::U8>();
+  bench_int_kind<EIntKind::I8>();
+  bench_int_kind<EIntKind::U16>();
+  bench_int_kind<EIntKind::I16>();
+  bench_int_kind<EIntKind::U32>();
+  bench_int_kind<EIntKind::I32>();
+  bench_int_kind<EIntKind::U64>();
+  bench_int_kind<EIntKind::I64>();
+  bench_float_type<float>();
+  bench_float_type<double>();
+
+  return 0;
+}
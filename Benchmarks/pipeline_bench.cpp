@@ -0,0 +1,392 @@
+// Stage-level benchmark of the save pipeline.
+//
+// Times each stage of opening and saving a savefile separately, on saves
+// read once into memory (disk I/O isn't measured):
+//   load: header and descriptors parse, chunks decompression, unflattening
+//         of the node tree, from_node of each structure, and
+//         CSystem::serialize_in of the system-backed ones
+//   save: CSystem::serialize_out and to_node of each structure (original
+//         data dropped first, everything is re-encoded), flattening of the
+//         node tree and compression
+// Each stage runs N times, its inputs being prepared outside of the timed
+// region. Reports the median time, throughput (MB/s of the stage's data),
+// allocations of the stage (see alloc_counter) and the peak RSS of the
+// process once the stage ran, as a table and optionally as JSON so that runs
+// can be compared.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <csav/csav.hpp>
+#include "alloc_counter.hpp"
+#include "benches.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+uint64_t peak_rss_bytes()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc = {};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return (uint64_t)pmc.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage ru = {};
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    return (uint64_t)ru.ru_maxrss * 1024; // KB on linux
+  return 0;
+#endif
+}
+
+struct stage_result
+{
+  std::string name;
+  uint64_t bytes = 0; // data processed by one run
+  bool ok = true;
+  double min_ms = 0;
+  double median_ms = 0;
+  double mb_per_s = 0;
+  double allocs = 0; // per run
+  double alloc_kb = 0; // per run
+  uint64_t peak_rss_kb = 0;
+};
+
+struct bench_options
+{
+  size_t iterations = 5;
+  std::string json_path;
+};
+
+// setup() prepares the inputs of a run, untimed; fn() is the timed stage
+template <typename SetupFn, typename Fn>
+stage_result run_stage(std::string name, uint64_t bytes, const bench_options& opts, SetupFn&& setup, Fn&& fn)
+{
+  stage_result res;
+  res.name = std::move(name);
+  res.bytes = bytes;
+
+  std::vector<double> ms;
+  alloc_stats allocs;
+  for (size_t i = 0; i < opts.iterations; ++i)
+  {
+    setup();
+
+    bool ok = false;
+    const auto a0 = thread_alloc_stats();
+    const auto t0 = clock_type::now();
+    try
+    {
+      ok = fn();
+    }
+    catch (std::exception& e)
+    {
+      fprintf(stderr, "%s: %s\n", res.name.c_str(), e.what());
+    }
+    const auto t1 = clock_type::now();
+    const auto a = thread_alloc_stats() - a0;
+
+    res.ok &= ok;
+    ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    allocs.count += a.count;
+    allocs.bytes += a.bytes;
+  }
+
+  std::sort(ms.begin(), ms.end());
+  res.min_ms = ms.front();
+  res.median_ms = ms[ms.size() / 2];
+  if (res.median_ms > 0)
+    res.mb_per_s = (bytes / (1024.0 * 1024.0)) / (res.median_ms / 1000.0);
+  res.allocs = (double)allocs.count / opts.iterations;
+  res.alloc_kb = allocs.bytes / 1024.0 / opts.iterations;
+  res.peak_rss_kb = peak_rss_bytes() / 1024;
+  return res;
+}
+
+struct save_bench
+{
+  std::string path;
+  std::vector<char> file;
+  uint64_t nodedata_bytes = 0;
+  std::vector<stage_result> stages;
+};
+
+// from_node and to_node of a structure, on fresh instances
+template <typename T>
+void bench_structure(save_bench& sb, csav& sav, std::string_view nodename, const bench_options& opts)
+{
+  auto node = sav.search_node(nodename);
+  if (!node)
+    return;
+
+  const uint64_t bytes = node->calcsize();
+
+  std::unique_ptr<T> var;
+  sb.stages.push_back(run_stage(fmt::format("from_node {}", nodename), bytes, opts,
+    [&]() { var = std::make_unique<T>(); },
+    [&]() { return var->from_node(node, sav.ver); }));
+
+  if (!var || !var->has_valid_data)
+    return;
+
+  std::shared_ptr<const node_t> new_node;
+  sb.stages.push_back(run_stage(fmt::format("to_node {}", nodename), bytes, opts,
+    [&]() { var->drop_original_data(); new_node.reset(); },
+    [&]() { new_node = var->to_node(sav.ver); return !!new_node; }));
+}
+
+// CSystem part of the system-backed structures
+void bench_csystem(save_bench& sb, csav& sav, std::string_view nodename, const bench_options& opts)
+{
+  auto node = sav.search_node(nodename);
+  if (!node)
+    return;
+
+  const uint64_t bytes = node->calcsize();
+
+  std::unique_ptr<CSystem> sys;
+  sb.stages.push_back(run_stage(fmt::format("CSystem::serialize_in {}", nodename), bytes, opts,
+    [&]() { sys = std::make_unique<CSystem>(); },
+    [&]() {
+      node_reader reader(node, sav.ver);
+      return sys->serialize_in(reader);
+    }));
+
+  if (!sys)
+    return;
+
+  std::unique_ptr<node_writer> writer;
+  sb.stages.push_back(run_stage(fmt::format("CSystem::serialize_out {}", nodename), bytes, opts,
+    [&]() { sys->drop_original_data(); writer = std::make_unique<node_writer>(sav.ver); },
+    [&]() { return sys->serialize_out(*writer); }));
+}
+
+bool bench_save(save_bench& sb, const bench_options& opts)
+{
+  {
+    std::ifstream ifs(sb.path, std::ios::binary);
+    if (!ifs)
+      return false;
+    sb.file.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+
+  const uint64_t file_bytes = sb.file.size();
+
+  auto sav = std::make_unique<csav>();
+  std::vector<compressed_chunk_desc> chunk_descs;
+  vector_istreambuf sbuf;
+  std::unique_ptr<std::istream> is;
+
+  auto reset_stream = [&]() {
+    sbuf = vector_istreambuf(sb.file);
+    is = std::make_unique<std::istream>(&sbuf);
+  };
+
+  // load
+
+  sb.stages.push_back(run_stage("parse", file_bytes, opts,
+    [&]() { reset_stream(); chunk_descs.clear(); },
+    [&]() { return sav->read_stree_descs(*is, chunk_descs); }));
+  if (!sb.stages.back().ok)
+    return false;
+
+  // throughput of the decompressed data
+  if (chunk_descs.size())
+    sb.nodedata_bytes = (uint64_t)chunk_descs.back().data_offset + chunk_descs.back().data_size;
+
+  sb.stages.push_back(run_stage("decompress", sb.nodedata_bytes, opts,
+    [&]() { reset_stream(); },
+    [&]() { return sav->decompress_stree(*is, chunk_descs); }));
+  if (!sb.stages.back().ok)
+    return false;
+
+  sb.stages.push_back(run_stage("unflatten", sb.nodedata_bytes, opts,
+    [&]() { sav->root_node.reset(); },
+    [&]() { return sav->unflatten_stree(chunk_descs); }));
+  if (!sb.stages.back().ok)
+    return false;
+
+  bench_structure<CInventory>(sb, *sav, "inventory", opts);
+  bench_structure<CCharacterCustomization>(sb, *sav, "CharacetrCustomization_Appearances", opts);
+  bench_structure<CGenericSystem>(sb, *sav, "godModeSystem", opts);
+  bench_structure<CSAV::Nodes::FactsDB>(sb, *sav, "FactsDB", opts);
+  bench_structure<CGenericSystem>(sb, *sav, "ScriptableSystemsContainer", opts);
+  bench_structure<CPSData>(sb, *sav, "PSData", opts);
+  bench_structure<CStats>(sb, *sav, "StatsSystem", opts);
+  bench_structure<CStatsPool>(sb, *sav, "StatPoolsSystem", opts);
+
+  bench_csystem(sb, *sav, "godModeSystem", opts);
+  bench_csystem(sb, *sav, "ScriptableSystemsContainer", opts);
+  bench_csystem(sb, *sav, "PSData", opts);
+  bench_csystem(sb, *sav, "StatsSystem", opts);
+  bench_csystem(sb, *sav, "StatPoolsSystem", opts);
+
+  // save
+
+  std::unique_ptr<std::ostringstream> os;
+  uint32_t chunkdescs_start = 0, chunks_start = 0;
+
+  sb.stages.push_back(run_stage("flatten", sb.nodedata_bytes, opts,
+    [&]() { os = std::make_unique<std::ostringstream>(); },
+    [&]() {
+      return sav->write_stree_header(*os, chunkdescs_start, chunks_start)
+        && sav->stree.from_node(sav->root_node, chunks_start);
+    }));
+  if (!sb.stages.back().ok)
+    return false;
+
+  sb.stages.push_back(run_stage("compress", sb.nodedata_bytes, opts,
+    [&]() {
+      os = std::make_unique<std::ostringstream>();
+      std::ignore = sav->write_stree_header(*os, chunkdescs_start, chunks_start)
+        && sav->stree.from_node(sav->root_node, chunks_start);
+    },
+    [&]() { return sav->compress_stree(*os, chunkdescs_start); }));
+
+  return sb.stages.back().ok;
+}
+
+nlohmann::json to_json(const std::vector<save_bench>& saves, const bench_options& opts)
+{
+  nlohmann::json jroot;
+  jroot["bench"] = "pipeline";
+  jroot["iterations"] = opts.iterations;
+
+  auto& jsaves = jroot["saves"] = nlohmann::json::array();
+  for (auto& sb : saves)
+  {
+    nlohmann::json jsave;
+    jsave["path"] = sb.path;
+    jsave["file_bytes"] = sb.file.size();
+    jsave["nodedata_bytes"] = sb.nodedata_bytes;
+
+    auto& jstages = jsave["stages"] = nlohmann::json::array();
+    for (auto& st : sb.stages)
+    {
+      jstages.push_back({
+        {"name", st.name},
+        {"ok", st.ok},
+        {"bytes", st.bytes},
+        {"min_ms", st.min_ms},
+        {"median_ms", st.median_ms},
+        {"mb_per_s", st.mb_per_s},
+        {"allocs", st.allocs},
+        {"alloc_kb", st.alloc_kb},
+        {"peak_rss_kb", st.peak_rss_kb},
+      });
+    }
+    jsaves.push_back(std::move(jsave));
+  }
+
+  return jroot;
+}
+
+bool parse_size_arg(const char* arg, const char* prefix, size_t& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+  out = (size_t)std::strtoull(arg + len, nullptr, 10);
+  return true;
+}
+
+bool parse_str_arg(const char* arg, const char* prefix, std::string& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+  out = arg + len;
+  return true;
+}
+
+void print_usage()
+{
+  printf("usage: CPSEBench pipeline <save>... [--iterations=N] [--json=out.json]\n"
+    "the db folder must be in the working directory.\n");
+}
+
+} // namespace
+
+int pipeline_bench_main(int argc, char** argv)
+{
+  bench_options opts;
+  std::vector<save_bench> saves;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::strncmp(argv[i], "--", 2) != 0)
+      saves.emplace_back().path = argv[i];
+    else if (!parse_size_arg(argv[i], "--iterations=", opts.iterations) && !parse_str_arg(argv[i], "--json=", opts.json_path))
+    {
+      print_usage();
+      return 1;
+    }
+  }
+
+  if (saves.empty() || opts.iterations == 0)
+  {
+    print_usage();
+    return 1;
+  }
+
+  // the blueprints db is loaded once per process, not part of any stage
+  CObjectBPList::get();
+
+  int ret = 0;
+  for (auto& sb : saves)
+  {
+    if (!bench_save(sb, opts))
+    {
+      fprintf(stderr, "%s: a stage failed, the next ones were skipped\n", sb.path.c_str());
+      ret = 1;
+    }
+
+    printf("\n%s (%zu bytes, %llu bytes decompressed), %zu runs per stage\n\n",
+      sb.path.c_str(), sb.file.size(), (unsigned long long)sb.nodedata_bytes, opts.iterations);
+    printf("%-46s | %10s | %9s | %9s | %9s | %10s | %10s | %12s\n",
+      "stage", "KB", "min ms", "median ms", "MB/s", "allocs", "alloc KB", "peak RSS KB");
+    for (auto& st : sb.stages)
+    {
+      printf("%-46s | %10.1f | %9.3f | %9.3f | %9.1f | %10.0f | %10.1f | %12llu%s\n",
+        st.name.c_str(), st.bytes / 1024.0, st.min_ms, st.median_ms, st.mb_per_s,
+        st.allocs, st.alloc_kb, (unsigned long long)st.peak_rss_kb, st.ok ? "" : " (failed)");
+    }
+  }
+
+  if (opts.json_path.size())
+  {
+    std::ofstream ofs(opts.json_path, std::ios::trunc);
+    ofs << to_json(saves, opts).dump(2);
+    if (!ofs)
+    {
+      fprintf(stderr, "couldn't write %s\n", opts.json_path.c_str());
+      return 1;
+    }
+    printf("\nresults written to %s\n", opts.json_path.c_str());
+  }
+
+  return ret;
+}
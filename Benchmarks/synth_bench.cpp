@@ -0,0 +1,396 @@
+// Synthetic saves, for stress and scaling tests.
+//
+// Generates a save (see synthetic_save.hpp) for each requested scale, then
+// times writing it with save_with_progress and opening it back with
+// open_with_progress, and checks that the reloaded structures hold what was
+// generated. A step that throws or doesn't read back identically stops the
+// sweep: that's a scaling cliff, like the 24-bit CRangeDesc offsets of the
+// string pools or their 16-bit indices.
+// For each stage, the growth exponent against the first scale tells how the
+// time scales: ~1 is linear, 2 is quadratic.
+// The written files can be fed to the pipeline bench for per-stage numbers,
+// and are identical for a given seed and set of counts.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+#include <csav/csav.hpp>
+#include "benches.hpp"
+#include "synthetic_save.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+uint64_t peak_rss_bytes()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS pmc = {};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    return (uint64_t)pmc.PeakWorkingSetSize;
+  return 0;
+#else
+  struct rusage ru = {};
+  if (getrusage(RUSAGE_SELF, &ru) == 0)
+    return (uint64_t)ru.ru_maxrss * 1024; // KB on linux
+  return 0;
+#endif
+}
+
+double elapsed_ms(clock_type::time_point t0)
+{
+  return std::chrono::duration<double, std::milli>(clock_type::now() - t0).count();
+}
+
+struct synth_step
+{
+  double scale = 0;
+  std::string path;
+  synthetic_save_summary summary;
+  uint64_t file_bytes = 0;
+  uint64_t nodedata_bytes = 0;
+  uint64_t file_hash = 0;
+  double generate_ms = 0;
+  double save_ms = 0;
+  double open_ms = 0;
+  uint64_t peak_rss_kb = 0;
+  std::string error; // empty if the save was generated and read back identically
+};
+
+struct bench_options
+{
+  synthetic_save_options gen;
+  std::vector<double> scales;
+  std::string out_path;
+  std::string json_path;
+};
+
+uint64_t file_hash(const std::filesystem::path& path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  std::vector<char> buf((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+  // FNV-1a
+  uint64_t hash = 0xCBF29CE484222325;
+  for (char c : buf)
+    hash = (hash ^ (uint8_t)c) * 0x100000001B3;
+  return hash;
+}
+
+std::string compare_summaries(const synthetic_save_summary& expected, const synthetic_save_summary& loaded)
+{
+  if (loaded.nodes != expected.nodes)
+    return fmt::format("{} nodes read back, {} generated", loaded.nodes, expected.nodes);
+  if (loaded.inventory_items != expected.inventory_items)
+    return fmt::format("{} inventory items read back, {} generated", loaded.inventory_items, expected.inventory_items);
+  if (loaded.facts != expected.facts)
+    return fmt::format("{} facts read back, {} generated", loaded.facts, expected.facts);
+  if (loaded.psdata_objects != expected.psdata_objects)
+    return fmt::format("{} PSData objects read back, {} generated", loaded.psdata_objects, expected.psdata_objects);
+  if (loaded.psdata_digest != expected.psdata_digest)
+    return "PSData objects read back with different values";
+  return {};
+}
+
+void run_step(synth_step& step, const bench_options& opts)
+{
+  synthetic_save_options gen = opts.gen;
+  gen.scale = step.scale;
+
+  // generate
+  auto cs = std::make_unique<csav>();
+  auto t0 = clock_type::now();
+  try
+  {
+    step.summary = build_synthetic_save(*cs, gen);
+  }
+  catch (std::exception& e)
+  {
+    step.error = fmt::format("generate: {}", e.what());
+    return;
+  }
+  step.generate_ms = elapsed_ms(t0);
+
+  // save
+  progress_t progress;
+  t0 = clock_type::now();
+  try
+  {
+    if (!cs->save_with_progress(step.path, progress))
+      step.error = "save: failed";
+  }
+  catch (std::exception& e)
+  {
+    step.error = fmt::format("save: {}", e.what());
+  }
+  step.save_ms = elapsed_ms(t0);
+  step.nodedata_bytes = cs->stree.nodedata.size();
+  cs.reset();
+  if (step.error.size())
+    return;
+
+  step.file_bytes = std::filesystem::file_size(step.path);
+  step.file_hash = file_hash(step.path);
+
+  // open, without the background reserialization check
+  auto loaded = std::make_unique<csav>();
+  t0 = clock_type::now();
+  try
+  {
+    if (!loaded->open_with_progress(step.path, progress, false, false, false))
+      step.error = "open: failed";
+    else if (loaded->structure_failures.size())
+      step.error = fmt::format("open: {}", format_structure_failures(loaded->structure_failures));
+  }
+  catch (std::exception& e)
+  {
+    step.error = fmt::format("open: {}", e.what());
+  }
+  step.open_ms = elapsed_ms(t0);
+  step.peak_rss_kb = peak_rss_bytes() / 1024;
+  if (step.error.size())
+    return;
+
+  const auto diff = compare_summaries(step.summary, summarize_save(*loaded));
+  if (diff.size())
+    step.error = fmt::format("check: {}", diff);
+}
+
+// how a stage's time grew from the first step: 1 is linear, 2 quadratic
+double growth_exponent(double first_scale, double first_ms, double scale, double ms)
+{
+  if (first_ms <= 0 || ms <= 0 || scale == first_scale)
+    return 0;
+  return std::log(ms / first_ms) / std::log(scale / first_scale);
+}
+
+nlohmann::json to_json(const std::vector<synth_step>& steps, const bench_options& opts)
+{
+  nlohmann::json jroot;
+  jroot["bench"] = "synth";
+  jroot["seed"] = opts.gen.seed;
+  jroot["options"] = {
+    {"filler_nodes", opts.gen.filler_nodes},
+    {"filler_node_size", opts.gen.filler_node_size},
+    {"subinventories", opts.gen.subinventories},
+    {"inventory_items", opts.gen.inventory_items},
+    {"facts_tables", opts.gen.facts_tables},
+    {"facts", opts.gen.facts},
+    {"psdata_objects", opts.gen.psdata_objects},
+    {"psdata_names", opts.gen.psdata_names},
+    {"psdata_name_len", opts.gen.psdata_name_len},
+  };
+
+  auto& jsteps = jroot["steps"] = nlohmann::json::array();
+  for (auto& st : steps)
+  {
+    jsteps.push_back({
+      {"scale", st.scale},
+      {"path", st.path},
+      {"ok", st.error.empty()},
+      {"error", st.error},
+      {"nodes", st.summary.nodes},
+      {"inventory_items", st.summary.inventory_items},
+      {"facts", st.summary.facts},
+      {"psdata_objects", st.summary.psdata_objects},
+      {"file_bytes", st.file_bytes},
+      {"nodedata_bytes", st.nodedata_bytes},
+      {"file_hash", fmt::format("{:016X}", st.file_hash)},
+      {"generate_ms", st.generate_ms},
+      {"save_ms", st.save_ms},
+      {"open_ms", st.open_ms},
+      {"peak_rss_kb", st.peak_rss_kb},
+    });
+  }
+
+  return jroot;
+}
+
+bool parse_size_arg(const char* arg, const char* prefix, size_t& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+  out = (size_t)std::strtoull(arg + len, nullptr, 10);
+  return true;
+}
+
+bool parse_u64_arg(const char* arg, const char* prefix, uint64_t& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+  out = std::strtoull(arg + len, nullptr, 10);
+  return true;
+}
+
+bool parse_str_arg(const char* arg, const char* prefix, std::string& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+  out = arg + len;
+  return true;
+}
+
+// comma separated list
+bool parse_scales_arg(const char* arg, const char* prefix, std::vector<double>& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+
+  out.clear();
+  const char* p = arg + len;
+  while (*p)
+  {
+    char* end = nullptr;
+    out.push_back(std::strtod(p, &end));
+    if (end == p)
+      break;
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return true;
+}
+
+void print_usage()
+{
+  const synthetic_save_options defaults;
+  printf("usage: CPSEBench synth <out.dat> [--scale=F[,F...]] [--seed=N] [--json=out.json]\n"
+    "                       [--nodes=N] [--node-size=N] [--subinvs=N] [--items=N] [--tables=N]\n"
+    "                       [--facts=N] [--psdata=N] [--names=N] [--name-len=N]\n"
+    "counts are at scale 1 (defaults: %zu nodes of ~%zu bytes, %zu items in %zu inventories,\n"
+    "%zu facts in %zu tables, %zu PSData objects using %zu names of ~%zu characters).\n"
+    "with several scales, each save is written next to out.dat with the scale in its name.\n"
+    "the db folder must be in the working directory.\n",
+    defaults.filler_nodes, defaults.filler_node_size, defaults.inventory_items, defaults.subinventories,
+    defaults.facts, defaults.facts_tables, defaults.psdata_objects, defaults.psdata_names, defaults.psdata_name_len);
+}
+
+} // namespace
+
+int synth_bench_main(int argc, char** argv)
+{
+  bench_options opts;
+  opts.scales = { 1.0 };
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const char* arg = argv[i];
+    auto& gen = opts.gen;
+    if (std::strncmp(arg, "--", 2) != 0)
+      opts.out_path = arg;
+    else if (!parse_scales_arg(arg, "--scale=", opts.scales)
+      && !parse_u64_arg(arg, "--seed=", gen.seed)
+      && !parse_str_arg(arg, "--json=", opts.json_path)
+      && !parse_size_arg(arg, "--nodes=", gen.filler_nodes)
+      && !parse_size_arg(arg, "--node-size=", gen.filler_node_size)
+      && !parse_size_arg(arg, "--subinvs=", gen.subinventories)
+      && !parse_size_arg(arg, "--items=", gen.inventory_items)
+      && !parse_size_arg(arg, "--tables=", gen.facts_tables)
+      && !parse_size_arg(arg, "--facts=", gen.facts)
+      && !parse_size_arg(arg, "--psdata=", gen.psdata_objects)
+      && !parse_size_arg(arg, "--names=", gen.psdata_names)
+      && !parse_size_arg(arg, "--name-len=", gen.psdata_name_len))
+    {
+      print_usage();
+      return 1;
+    }
+  }
+
+  if (opts.out_path.empty() || opts.scales.empty())
+  {
+    print_usage();
+    return 1;
+  }
+
+  // the blueprints db is loaded once per process, not part of any step
+  CObjectBPList::get();
+
+  std::vector<synth_step> steps;
+  for (double scale : opts.scales)
+  {
+    auto& step = steps.emplace_back();
+    step.scale = scale;
+
+    std::filesystem::path path = opts.out_path;
+    if (opts.scales.size() > 1)
+      path.replace_filename(fmt::format("{}_x{}{}", path.stem().string(), scale, path.extension().string()));
+    step.path = path.string();
+
+    run_step(step, opts);
+    if (step.error.size())
+      break;
+  }
+
+  printf("\nseed %llu\n\n", (unsigned long long)opts.gen.seed);
+  printf("%-6s | %8s | %8s | %8s | %9s | %10s | %10s | %16s | %10s | %10s | %10s | %12s\n",
+    "scale", "nodes", "items", "facts", "PSData", "file KB", "data KB", "file hash",
+    "gen ms", "save ms", "open ms", "peak RSS KB");
+  for (auto& st : steps)
+  {
+    printf("%-6g | %8zu | %8zu | %8zu | %9zu | %10.1f | %10.1f | %016llX | %10.1f | %10.1f | %10.1f | %12llu\n",
+      st.scale, st.summary.nodes, st.summary.inventory_items, st.summary.facts, st.summary.psdata_objects,
+      st.file_bytes / 1024.0, st.nodedata_bytes / 1024.0, (unsigned long long)st.file_hash,
+      st.generate_ms, st.save_ms, st.open_ms, (unsigned long long)st.peak_rss_kb);
+  }
+
+  int ret = 0;
+  if (steps.back().error.size())
+  {
+    printf("\nscaling cliff at scale %g: %s\n", steps.back().scale, steps.back().error.c_str());
+    ret = 1;
+  }
+
+  if (steps.size() > 1)
+  {
+    const auto& first = steps.front();
+    printf("\ngrowth exponents against scale %g (1: linear, 2: quadratic)\n\n", first.scale);
+    printf("%-6s | %8s | %8s | %8s\n", "scale", "gen", "save", "open");
+    for (size_t i = 1; i < steps.size(); ++i)
+    {
+      const auto& st = steps[i];
+      if (st.error.size())
+        break;
+      printf("%-6g | %8.2f | %8.2f | %8.2f\n", st.scale,
+        growth_exponent(first.scale, first.generate_ms, st.scale, st.generate_ms),
+        growth_exponent(first.scale, first.save_ms, st.scale, st.save_ms),
+        growth_exponent(first.scale, first.open_ms, st.scale, st.open_ms));
+    }
+  }
+
+  if (opts.json_path.size())
+  {
+    std::ofstream ofs(opts.json_path, std::ios::trunc);
+    ofs << to_json(steps, opts).dump(2);
+    if (!ofs)
+    {
+      fprintf(stderr, "couldn't write %s\n", opts.json_path.c_str());
+      return 1;
+    }
+    printf("\nresults written to %s\n", opts.json_path.c_str());
+  }
+
+  return ret;
+}
+
@@ -0,0 +1,397 @@
+#include "synthetic_save.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace {
+
+// mt19937_64 is specified bit for bit, the std distributions aren't
+class synthetic_rng
+{
+  std::mt19937_64 m_engine;
+
+public:
+  explicit synthetic_rng(uint64_t seed)
+    : m_engine(seed) {}
+
+  uint64_t next() { return m_engine(); }
+
+  // [0, n), the modulo bias is irrelevant here
+  size_t below(size_t n) { return n ? (size_t)(next() % n) : 0; }
+
+  // [0, 1)
+  double unit() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  bool one_in(size_t n) { return below(n) == 0; }
+
+  // [avg / 2, avg * 3 / 2]
+  size_t around(size_t avg) { return avg / 2 + below(avg + 1); }
+};
+
+// low entropy bytes, to compress about like the game's data does
+void fill_data(synthetic_rng& rng, std::vector<char>& data, size_t size)
+{
+  data.resize(size);
+  size_t i = 0;
+  while (i < size)
+  {
+    const size_t run = std::min(size - i, 1 + rng.below(16));
+    const char c = rng.one_in(2) ? 0 : (char)rng.below(32);
+    std::fill_n(data.begin() + i, run, c);
+    i += run;
+  }
+}
+
+struct filler_builder
+{
+  synthetic_rng& rng;
+  size_t avg_size;
+  size_t remaining;
+  size_t next_name = 0;
+
+  std::shared_ptr<const node_t> make_node(size_t depth)
+  {
+    --remaining;
+    auto node = node_t::create_shared(0, fmt::format("synthetic_{}", next_name++));
+
+    std::vector<char> data;
+    fill_data(rng, data, rng.around(avg_size));
+    node->nonconst().assign_data(data);
+
+    // a quarter of the nodes have children, up to 4 levels deep
+    if (depth < 3 && remaining && rng.one_in(4))
+    {
+      std::vector<std::shared_ptr<const node_t>> children;
+      const size_t cnt = std::min(remaining, 1 + rng.below(8));
+      for (size_t i = 0; i < cnt && remaining; ++i)
+        children.push_back(make_node(depth + 1));
+      node->nonconst().assign_children(children);
+    }
+
+    return node;
+  }
+};
+
+TweakDBID synthetic_tdbid(std::string_view prefix, size_t n)
+{
+  return TweakDBID(fmt::format("{}{}", prefix, n));
+}
+
+void fill_item_mod(synthetic_rng& rng, CItemMod& mod, size_t depth)
+{
+  mod.iid.nameid = synthetic_tdbid("Items.SyntheticMod_", rng.below(256));
+  mod.iid.uk.uk4 = (uint32_t)rng.next();
+  mod.iid.uk.uk1 = 1;
+
+  static const std::array<const char*, 4> slots = {
+    "", "AttachmentSlots.Scope", "AttachmentSlots.PowerModule", "AttachmentSlots.GenericWeaponMod1" };
+  strncpy(mod.cn0, slots[rng.below(slots.size())], sizeof(mod.cn0) - 1);
+  mod.tdbid1 = synthetic_tdbid("Items.SyntheticPart_", rng.below(256));
+  mod.uk2 = (uint32_t)rng.below(4);
+  mod.uk3.nameid = synthetic_tdbid("Items.SyntheticRecipe_", rng.below(64));
+  mod.uk3.uk0 = (uint32_t)rng.below(100);
+
+  if (depth < 2)
+  {
+    mod.subs.resize(rng.below(depth ? 3 : 5));
+    for (auto& sub : mod.subs)
+      fill_item_mod(rng, sub, depth + 1);
+  }
+}
+
+std::shared_ptr<const node_t> build_inventory(synthetic_rng& rng, const synthetic_save_options& opts, const csav_version& ver, size_t& items_cnt)
+{
+  CInventory inventory;
+  inventory.has_valid_data = true;
+
+  const size_t subinv_cnt = std::max<size_t>(opts.subinventories, 1);
+  inventory.m_subinvs.resize(subinv_cnt);
+  for (auto& subinv : inventory.m_subinvs)
+    subinv.uid = rng.next();
+
+  // most items end up in the player's inventory, the first one
+  items_cnt = opts.scaled(opts.inventory_items);
+  for (size_t i = 0; i < items_cnt; ++i)
+  {
+    auto& subinv = rng.one_in(2) ? inventory.m_subinvs.front() : *std::next(inventory.m_subinvs.begin(), rng.below(subinv_cnt));
+    auto& item = subinv.items.emplace_back();
+    item.has_valid_data = true;
+
+    item.iid.nameid = synthetic_tdbid("Items.Synthetic_", rng.below(1024));
+    item.iid.uk.uk4 = (uint32_t)rng.next();
+
+    // mostly stackables (kind 1), then moddable items (0) and mods (2)
+    const size_t kind_roll = rng.below(8);
+    item.iid.uk.uk1 = kind_roll < 5 ? 2 : (kind_roll < 7 ? 3 : 1);
+
+    item.flags = (uint8_t)rng.below(4);
+    item.uk1_012 = (uint32_t)rng.below(1000);
+    item.quantity = 1 + (uint32_t)rng.below(rng.one_in(8) ? 100000 : 10);
+    item.uk3.nameid = synthetic_tdbid("Items.SyntheticRecipe_", rng.below(64));
+    item.uk3.uk0 = (uint32_t)rng.below(100);
+    if (item.iid.uk.kind() != 1)
+      fill_item_mod(rng, item.root2, 0);
+  }
+
+  auto node = inventory.to_node(ver);
+  if (!node)
+    throw std::runtime_error("inventory: to_node failed");
+  return node;
+}
+
+std::shared_ptr<const node_t> build_factsdb(synthetic_rng& rng, const synthetic_save_options& opts, const csav_version& ver, size_t& facts_cnt)
+{
+  CSAV::Nodes::FactsDB factsdb;
+  factsdb.has_valid_data = true;
+
+  const size_t tables_cnt = std::max<size_t>(opts.facts_tables, 1);
+  const size_t total = opts.scaled(opts.facts);
+  factsdb.tables().resize(tables_cnt);
+
+  facts_cnt = 0;
+  for (size_t t = 0; t < tables_cnt; ++t)
+  {
+    auto& table = factsdb.tables()[t];
+    table.has_valid_data = true;
+
+    // sorted unique hashes, the game looks them up by bisection
+    std::vector<uint32_t> hashes(total / tables_cnt + (t < total % tables_cnt ? 1 : 0));
+    for (auto& h : hashes)
+      h = (uint32_t)rng.next();
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+    auto& facts = table.facts();
+    facts.reserve(hashes.size());
+    for (auto h : hashes)
+      facts.emplace_back(h, (uint32_t)rng.below(rng.one_in(4) ? 1000 : 2));
+    facts_cnt += facts.size();
+  }
+
+  auto node = factsdb.to_node(ver);
+  if (!node)
+    throw std::runtime_error("FactsDB: to_node failed");
+  return node;
+}
+
+// the kinds randomize_scalar knows how to fill
+bool is_scalar_ctypename(const std::string& ctypename)
+{
+  static const std::array<std::string_view, 13> scalars = {
+    "Bool", "Uint8", "Int8", "Uint16", "Int16", "Uint32", "Int32", "Uint64", "Int64",
+    "Float", "Double", "TweakDBID", "CName" };
+  return std::find(scalars.begin(), scalars.end(), ctypename) != scalars.end();
+}
+
+// classes of the blueprint db with scalar fields, persistent states (*PS)
+// only if the db has some
+std::vector<CSysName> psdata_classes()
+{
+  std::vector<CSysName> all, ps;
+  for (auto& bp : CObjectBPList::get().sorted_bps())
+  {
+    const bool has_scalar = std::any_of(bp->field_bps().begin(), bp->field_bps().end(),
+      [](const CFieldBP& f) { return is_scalar_ctypename(f.ctypename().str()); });
+    if (!has_scalar)
+      continue;
+
+    const std::string name = bp->ctypename().str();
+    all.push_back(bp->ctypename());
+    if (name.size() > 2 && name.compare(name.size() - 2, 2, "PS") == 0)
+      ps.push_back(bp->ctypename());
+  }
+  return ps.size() ? ps : all;
+}
+
+void randomize_scalar(synthetic_rng& rng, CProperty* prop, const std::vector<CName>& names)
+{
+  if (auto p = dynamic_cast<CBoolProperty*>(prop))
+    return p->value(rng.one_in(2));
+  if (auto p = dynamic_cast<CIntProperty*>(prop))
+    return p->u64(rng.one_in(4) ? rng.next() : rng.below(1000));
+  if (auto p = dynamic_cast<CFloatProperty*>(prop))
+    return p->set_value((float)(rng.unit() * 1000.0));
+  if (auto p = dynamic_cast<CDoubleProperty*>(prop))
+    return p->set_value(rng.unit() * 1000.0);
+  if (auto p = dynamic_cast<CTweakDBIDProperty*>(prop))
+    return p->id(synthetic_tdbid("Synthetic.Record_", rng.below(1024)));
+  if (auto p = dynamic_cast<CNameProperty*>(prop))
+  {
+    if (names.size())
+      p->id(names[rng.below(names.size())]);
+  }
+}
+
+std::shared_ptr<const node_t> build_psdata(synthetic_rng& rng, const synthetic_save_options& opts, const csav_version& ver, synthetic_save_summary& summary)
+{
+  const auto classes = psdata_classes();
+  if (classes.empty())
+    throw std::runtime_error("PSData: the blueprint db has no class with scalar fields (is db/CObjectBPs.json there?)");
+
+  std::vector<CName> names(opts.scaled(opts.psdata_names));
+  for (size_t i = 0; i < names.size(); ++i)
+  {
+    auto s = fmt::format("synthetic.name_{}_", i);
+    // CStringPool entries are at most 254 characters long
+    s.resize(std::clamp(rng.around(opts.psdata_name_len), s.size(), (size_t)254), 'x');
+    names[i] = CName(s);
+  }
+
+  CPSData psdata;
+  psdata.has_valid_data = true;
+  auto& sys = psdata.system();
+
+  // a single root object would be read back as a system without names
+  const size_t objects_cnt = std::max<size_t>(opts.scaled(opts.psdata_objects), 2);
+  sys.objects().reserve(objects_cnt);
+  sys.subsys_names().reserve(objects_cnt);
+  for (size_t i = 0; i < objects_cnt; ++i)
+  {
+    auto obj = std::make_shared<CObject>(classes[rng.below(classes.size())]);
+    // some fields stay at their construction value and aren't serialized
+    obj->for_each_field([&](CSysName, CProperty* prop) {
+      if (prop && !rng.one_in(4))
+        randomize_scalar(rng, prop, names);
+    });
+    sys.objects().push_back(obj);
+    sys.subsys_names().emplace_back(rng.next());
+  }
+
+  psdata.trailing_names.resize(objects_cnt / 16);
+  for (auto& name : psdata.trailing_names)
+    name = CName(rng.next());
+
+  summary.psdata_objects = objects_cnt;
+  summary.psdata_digest = psdata_digest(sys);
+
+  // not CPSData::to_node, which swallows the serializer's exceptions
+  node_writer writer(ver);
+  if (!sys.serialize_out(writer))
+    throw std::runtime_error("PSData: CSystem::serialize_out failed");
+
+  uint32_t cnt = (uint32_t)psdata.trailing_names.size();
+  writer << cbytes_ref(cnt);
+  writer.write((char*)psdata.trailing_names.data(), cnt * sizeof(CName));
+  return writer.finalize(psdata.node_name());
+}
+
+// raw value of the properties randomize_scalar fills
+bool scalar_bits(const CProperty* prop, uint64_t& bits)
+{
+  bits = 0;
+  if (auto p = dynamic_cast<const CBoolProperty*>(prop))
+    bits = p->value();
+  else if (auto p = dynamic_cast<const CIntProperty*>(prop))
+    bits = p->u64();
+  else if (auto p = dynamic_cast<const CFloatProperty*>(prop))
+  {
+    const float value = p->value();
+    std::memcpy(&bits, &value, sizeof(value));
+  }
+  else if (auto p = dynamic_cast<const CDoubleProperty*>(prop))
+  {
+    const double value = p->value();
+    std::memcpy(&bits, &value, sizeof(value));
+  }
+  else if (auto p = dynamic_cast<const CTweakDBIDProperty*>(prop))
+    bits = p->id().as_u64;
+  else if (auto p = dynamic_cast<const CNameProperty*>(prop))
+    bits = p->id().as_u64;
+  else
+    return false;
+  return true;
+}
+
+} // namespace
+
+size_t synthetic_save_options::scaled(size_t cnt) const
+{
+  return (size_t)std::llround((double)cnt * std::max(scale, 0.0));
+}
+
+synthetic_save_summary build_synthetic_save(csav& cs, const synthetic_save_options& opts)
+{
+  synthetic_rng rng(opts.seed);
+  synthetic_save_summary summary;
+
+  cs.ver.v1 = 193;
+  cs.ver.v2 = 9;
+  cs.ver.v3 = 192;
+  cs.suk = "synthetic";
+  cs.uk0 = 0;
+  cs.uk1 = 0;
+
+  filler_builder fillers{rng, std::max<size_t>(opts.filler_node_size, 1), opts.scaled(opts.filler_nodes)};
+  std::vector<std::shared_ptr<const node_t>> children;
+  while (fillers.remaining)
+    children.push_back(fillers.make_node(0));
+
+  std::shared_ptr<const node_t> structures[] = {
+    build_inventory(rng, opts, cs.ver, summary.inventory_items),
+    build_factsdb(rng, opts, cs.ver, summary.facts),
+    build_psdata(rng, opts, cs.ver, summary),
+  };
+  for (auto& node : structures)
+    children.insert(children.begin() + rng.below(children.size() + 1), node);
+
+  auto root = node_t::create_shared(node_t::root_node_idx, "root");
+  root->nonconst().assign_children(children);
+  cs.root_node = root;
+  summary.nodes = root->treecount();
+
+  return summary;
+}
+
+uint64_t psdata_digest(const CSystem& sys)
+{
+  // FNV-1a
+  uint64_t hash = 0xCBF29CE484222325;
+  auto add = [&](const void* p, size_t size) {
+    auto bytes = (const uint8_t*)p;
+    for (size_t i = 0; i < size; ++i)
+      hash = (hash ^ bytes[i]) * 0x100000001B3;
+  };
+
+  for (auto& obj : sys.objects())
+  {
+    const auto ctypename = obj->ctypename().str();
+    add(ctypename.data(), ctypename.size());
+    obj->for_each_field([&](CSysName name, const CProperty* prop) {
+      uint64_t bits = 0;
+      if (!prop || prop->is_skippable_in_serialization() || !scalar_bits(prop, bits))
+        return;
+      const auto field_name = name.str();
+      add(field_name.data(), field_name.size());
+      add(&bits, sizeof(bits));
+    });
+  }
+
+  return hash;
+}
+
+synthetic_save_summary summarize_save(const csav& cs)
+{
+  synthetic_save_summary summary;
+  if (cs.root_node)
+    summary.nodes = cs.root_node->treecount();
+
+  for (auto& subinv : cs.inventory.m_subinvs)
+    summary.inventory_items += subinv.items.size();
+
+  for (auto& table : cs.factsdb.tables())
+    summary.facts += table.facts().size();
+
+  summary.psdata_objects = cs.psdata.system().objects().size();
+  summary.psdata_digest = psdata_digest(cs.psdata.system());
+  return summary;
+}
+
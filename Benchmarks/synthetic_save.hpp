@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include <csav/csav.hpp>
+
+// Generator of valid savefiles of arbitrary size, for stress and scaling
+// tests (real saves are limited in size and can't be shared).
+//
+// The node tree is made of filler nodes (opaque data, nested) around the
+// structures the editor knows of: inventory, FactsDB and PSData, encoded by
+// their own serializers. PSData objects are instances of the classes of the
+// blueprint db (db/CObjectBPs.json) with random values in their scalar
+// fields, CName ones taking their values from a pool of random names that
+// ends up in the string pool of the system.
+//
+// The output only depends on the options: everything is drawn from a
+// mt19937_64 seeded with options.seed, without the std distributions whose
+// results differ between standard libraries.
+
+struct synthetic_save_options
+{
+  uint64_t seed = 1;
+
+  // multiplies the counts below, 1 is about the size of a late-game save
+  double scale = 1.0;
+
+  size_t filler_nodes     = 4000;
+  size_t filler_node_size = 1024; // average, in bytes
+  size_t subinventories   = 8;    // not scaled
+  size_t inventory_items  = 1500;
+  size_t facts_tables     = 2;    // not scaled
+  size_t facts            = 15000;
+  size_t psdata_objects   = 30000;
+  size_t psdata_names     = 2000; // distinct CName values
+  size_t psdata_name_len  = 32;   // average length of these names
+
+  size_t scaled(size_t cnt) const;
+};
+
+// what ended up in the save, to be compared with a reload of it
+struct synthetic_save_summary
+{
+  size_t nodes = 0;
+  size_t inventory_items = 0;
+  size_t facts = 0;
+  size_t psdata_objects = 0;
+  uint64_t psdata_digest = 0;
+};
+
+// replaces the node tree and header of cs, which can then be written with
+// save_with_progress. errors of the serializers are thrown as is, e.g. the
+// std::range_error of CRangeDesc when the PSData string pool outgrows its
+// 24-bit offsets.
+synthetic_save_summary build_synthetic_save(csav& cs, const synthetic_save_options& opts);
+
+// hash of the class names and scalar field values of the root objects
+uint64_t psdata_digest(const CSystem& sys);
+
+// summary of a loaded save, psdata_digest included
+synthetic_save_summary summarize_save(const csav& cs);
+
@@ -0,0 +1,419 @@
+// Headless frame-time benchmark of the save editor widgets.
+//
+// Loads a save and draws each widget alone for N frames, without window nor
+// renderer: Render() builds the draw data, which is dropped. The input is
+// scripted: the mouse hovers a few rows of the widget's window and scrolls
+// (down, then up again), the tree nodes/collapsing headers that become
+// visible are expanded one at a time and the tabs are visited in turn.
+// Reports the CPU time and the allocations of the widget's draw calls, on
+// the UI thread.
+//
+// Expanding and tab switching rely on the item hooks of ImGui's test engine,
+// the bench is built with IMGUI_ENABLE_TEST_ENGINE.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <vector>
+
+#include <imgui.h>
+#include <imgui_internal.h>
+#include <widgets/csav_widget.hpp>
+#include "alloc_counter.hpp"
+#include "benches.hpp"
+
+#ifndef IMGUI_ENABLE_TEST_ENGINE
+#error the widgets bench needs the test engine hooks of ImGui (IMGUI_ENABLE_TEST_ENGINE)
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+//------------------------------------------------------------------------------
+// scripted navigation
+//------------------------------------------------------------------------------
+
+// collects the closed tree nodes drawn in the frame, opens one between frames,
+// and the tabs, selects the next unvisited one between frames
+struct ui_explorer
+{
+  struct item_t
+  {
+    ImGuiStorage* storage;
+    ImGuiID id;
+  };
+
+  struct tab_t
+  {
+    ImGuiID tab_bar_id; // tab bars are pooled, pointers don't last
+    ImGuiID id;
+  };
+
+  std::vector<item_t> closed_items;
+  std::unordered_set<ImGuiID> expanded;
+
+  std::vector<tab_t> tabs;
+  std::unordered_set<ImGuiID> visited_tabs;
+
+  void on_item(ImGuiContext* ctx, ImGuiID id, ImGuiItemStatusFlags flags)
+  {
+    ImGuiWindow* window = ctx->CurrentWindow;
+    if (!window)
+      return;
+
+    ImGuiTabBar* tab_bar = ctx->CurrentTabBar;
+    ImGuiTabItem* tab = tab_bar ? ImGui::TabBarFindTabByID(tab_bar, id) : nullptr;
+    if (tab)
+    {
+      if (tab->Flags & ImGuiTabItemFlags_Button)
+        return;
+      if (tab_bar->SelectedTabId == id)
+        visited_tabs.insert(id);
+      else if (!visited_tabs.count(id))
+        tabs.push_back({tab_bar->ID, id});
+      return;
+    }
+
+    if (!(flags & ImGuiItemStatusFlags_Openable) || (flags & ImGuiItemStatusFlags_Opened))
+      return;
+    // menus are openable too
+    if ((window->Flags & (ImGuiWindowFlags_Popup | ImGuiWindowFlags_ChildMenu)) || window->DC.NavLayerCurrent == ImGuiNavLayer_Menu)
+      return;
+    if (!window->ClipRect.Overlaps(window->DC.LastItemRect) || expanded.count(id))
+      return;
+    closed_items.push_back({window->DC.StateStorage, id});
+  }
+
+  // a menu's id may end up here, it stays closed but isn't picked again
+  bool expand_one()
+  {
+    for (auto& item : closed_items)
+    {
+      if (expanded.insert(item.id).second)
+      {
+        item.storage->SetInt(item.id, 1);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool select_next_tab()
+  {
+    for (auto& tab : tabs)
+    {
+      ImGuiTabBar* tab_bar = GImGui->TabBars.GetByKey(tab.tab_bar_id);
+      if (tab_bar && visited_tabs.insert(tab.id).second)
+      {
+        tab_bar->NextSelectedTabId = tab.id;
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+ui_explorer* s_explorer = nullptr;
+
+//------------------------------------------------------------------------------
+// harness
+//------------------------------------------------------------------------------
+
+struct bench_options
+{
+  size_t frames = 300;
+  size_t expand_limit = 50;
+  size_t expand_period = 5; // frames
+  size_t tab_period = 30; // frames
+  size_t scroll_period = 120; // frames, then scrolls back
+};
+
+struct bench_result
+{
+  std::string name;
+  double first_ms = 0;
+  double avg_ms = 0;
+  double p95_ms = 0;
+  double max_ms = 0;
+  double frame_avg_ms = 0; // whole frame, ImGui's own work included
+  double allocs_per_frame = 0;
+  double kb_per_frame = 0;
+  size_t expanded = 0;
+  size_t visited_tabs = 0;
+};
+
+bench_result run_widget(const char* name, const std::function<void()>& draw_fn, const bench_options& opts)
+{
+  bench_result res;
+  res.name = name;
+
+  ImGuiIO& io = ImGui::GetIO();
+  ui_explorer explorer;
+  s_explorer = &explorer;
+
+  std::vector<double> widget_ms;
+  widget_ms.reserve(opts.frames);
+  double frame_ms_sum = 0;
+  alloc_stats allocs;
+
+  for (size_t i = 0; i < opts.frames; ++i)
+  {
+    // the mouse hovers the widget without clicking, on one of three rows
+    const float row = 0.25f + 0.25f * (float)((i / 20) % 3);
+    io.MousePos = ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * row);
+    io.MouseWheel = ((i / opts.scroll_period) % 2) ? 2.f : -2.f;
+    io.DeltaTime = 1.f / 60.f;
+
+    explorer.closed_items.clear();
+    explorer.tabs.clear();
+
+    const auto f0 = clock_type::now();
+    ImGui::NewFrame();
+
+    ImGui::SetNextWindowPos(ImVec2(0, 0));
+    ImGui::SetNextWindowSize(io.DisplaySize);
+    ImGui::Begin(name, nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoSavedSettings);
+
+    const auto a0 = thread_alloc_stats();
+    const auto t0 = clock_type::now();
+    draw_fn();
+    const auto t1 = clock_type::now();
+    const auto a1 = thread_alloc_stats();
+
+    ImGui::End();
+    ImGui::Render();
+    const auto f1 = clock_type::now();
+
+    widget_ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    frame_ms_sum += std::chrono::duration<double, std::milli>(f1 - f0).count();
+    allocs.count += (a1 - a0).count;
+    allocs.bytes += (a1 - a0).bytes;
+
+    if (res.expanded < opts.expand_limit && (i % opts.expand_period) == 0 && explorer.expand_one())
+      res.expanded++;
+    if ((i % opts.tab_period) == opts.tab_period - 1)
+      explorer.select_next_tab();
+  }
+
+  s_explorer = nullptr;
+  res.visited_tabs = explorer.visited_tabs.size();
+
+  if (widget_ms.empty())
+    return res;
+
+  const double n = (double)widget_ms.size();
+  res.first_ms = widget_ms.front();
+  double sum = 0;
+  for (double ms : widget_ms)
+    sum += ms;
+  res.avg_ms = sum / n;
+  res.frame_avg_ms = frame_ms_sum / n;
+  res.allocs_per_frame = (double)allocs.count / n;
+  res.kb_per_frame = (double)allocs.bytes / n / 1024.0;
+
+  std::sort(widget_ms.begin(), widget_ms.end());
+  res.p95_ms = widget_ms[std::min(widget_ms.size() - 1, (size_t)(n * 0.95))];
+  res.max_ms = widget_ms.back();
+  return res;
+}
+
+std::shared_ptr<const node_t> largest_data_node(const std::shared_ptr<const node_t>& node)
+{
+  auto best = node;
+  for (auto& c : node->children())
+  {
+    auto n = largest_data_node(c);
+    if (n->data().size() > best->data().size())
+      best = n;
+  }
+  return best;
+}
+
+struct system_choice
+{
+  const node_serializable* var;
+  CSystem* sys;
+  const char* name;
+};
+
+// the loaded system with the most objects (PSData in late-game saves)
+system_choice largest_system(csav& sav)
+{
+  const system_choice systems[] = {
+    {&sav.psdata,      &sav.psdata.system(),      "PSData"},
+    {&sav.scriptables, &sav.scriptables.system(), "ScriptableSystemsContainer"},
+    {&sav.stats,       &sav.stats.system(),       "StatsSystem"},
+    {&sav.statspool,   &sav.statspool.system(),   "StatPoolsSystem"},
+    {&sav.godmode,     &sav.godmode.system(),     "godModeSystem"},
+  };
+
+  system_choice best = {nullptr, nullptr, ""};
+  for (auto& s : systems)
+  {
+    if (s.var->has_valid_data && (!best.sys || s.sys->objects().size() > best.sys->objects().size()))
+      best = s;
+  }
+  return best;
+}
+
+// selected in the system widget, so that its property pane has the most to draw
+int object_with_most_fields(const CSystem& sys)
+{
+  int best = -1;
+  size_t best_cnt = 0;
+  auto& objects = sys.objects();
+  for (size_t i = 0; i < objects.size(); ++i)
+  {
+    size_t cnt = 0;
+    objects[i]->for_each_field([&cnt](auto&&...) { ++cnt; });
+    if (best < 0 || cnt > best_cnt)
+    {
+      best = (int)i;
+      best_cnt = cnt;
+    }
+  }
+  return best;
+}
+
+bool parse_size_arg(const char* arg, const char* prefix, size_t& out)
+{
+  const size_t len = std::strlen(prefix);
+  if (std::strncmp(arg, prefix, len) != 0)
+    return false;
+  out = (size_t)std::strtoull(arg + len, nullptr, 10);
+  return true;
+}
+
+void print_usage()
+{
+  printf("usage: CPSEBench widgets <save> [--frames=N] [--expand=N]\n"
+    "the db folder must be in the working directory.\n");
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// test engine hooks (see IMGUI_ENABLE_TEST_ENGINE)
+//------------------------------------------------------------------------------
+
+void ImGuiTestEngineHook_ItemAdd(ImGuiContext*, const ImRect&, ImGuiID) {}
+
+void ImGuiTestEngineHook_ItemInfo(ImGuiContext* ctx, ImGuiID id, const char*, ImGuiItemStatusFlags flags)
+{
+  if (s_explorer)
+    s_explorer->on_item(ctx, id, flags);
+}
+
+void ImGuiTestEngineHook_IdInfo(ImGuiContext*, ImGuiDataType, ImGuiID, const void*) {}
+void ImGuiTestEngineHook_IdInfo(ImGuiContext*, ImGuiDataType, ImGuiID, const void*, const void*) {}
+void ImGuiTestEngineHook_Log(ImGuiContext*, const char*, ...) {}
+
+//------------------------------------------------------------------------------
+
+int widgets_bench_main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    print_usage();
+    return 1;
+  }
+
+  bench_options opts;
+  for (int i = 2; i < argc; ++i)
+  {
+    if (!parse_size_arg(argv[i], "--frames=", opts.frames) && !parse_size_arg(argv[i], "--expand=", opts.expand_limit))
+    {
+      print_usage();
+      return 1;
+    }
+  }
+
+  auto sav = std::make_shared<csav>();
+  {
+    progress_t progress;
+    const auto t0 = clock_type::now();
+    if (!sav->open_with_progress(argv[1], progress, false, false, false))
+    {
+      fprintf(stderr, "couldn't open %s\n", argv[1]);
+      return 1;
+    }
+    const auto t1 = clock_type::now();
+    printf("loaded %s in %.1f ms\n", argv[1], std::chrono::duration<double, std::milli>(t1 - t0).count());
+  }
+
+  // ImGui's own allocations are counted too
+  ImGui::SetAllocatorFunctions(
+    [](size_t size, void*) { return ::operator new(size); },
+    [](void* p, void*) { ::operator delete(p); });
+
+  ImGui::CreateContext();
+  GImGui->TestEngineHookItems = true;
+
+  const ImVec2 display_size(1600, 900);
+  ImGuiIO& io = ImGui::GetIO();
+  io.IniFilename = nullptr;
+  io.DisplaySize = display_size;
+  unsigned char* pixels = nullptr;
+  int tex_w = 0, tex_h = 0;
+  io.Fonts->GetTexDataAsRGBA32(&pixels, &tex_w, &tex_h);
+
+  std::vector<bench_result> results;
+
+  if (auto choice = largest_system(*sav); choice.sys)
+  {
+    int selected = object_with_most_fields(*choice.sys);
+    CObjectListLabels labels;
+    printf("system widget on %s (%zu objects, object #%d selected)\n",
+      choice.name, choice.sys->objects().size(), selected);
+    results.push_back(run_widget("CSystem_widget", [&]() {
+      std::ignore = CSystem_widget::draw(*choice.sys, &selected, labels);
+    }, opts));
+  }
+
+  results.push_back(run_widget("CInventory_widget", [&]() {
+    std::ignore = CInventory_widget::draw(sav->inventory, &sav->stats);
+  }, opts));
+
+  results.push_back(run_widget("WidFactsDB", [&]() {
+    std::ignore = UI::WidFactsDB::draw(sav->factsdb, "Facts");
+  }, opts));
+
+  {
+    auto node = largest_data_node(sav->root_node);
+    auto editor = std::make_shared<node_hexeditor>(node);
+    printf("hex editor on node %s (%zu bytes)\n", node->name().c_str(), node->data().size());
+    results.push_back(run_widget("node_hexeditor", [&]() {
+      editor->draw_widget();
+    }, opts));
+  }
+
+  // last: its update() starts background jobs (known identifiers scan)
+  {
+    csav_collapsable_header header(sav, nullptr, "bench");
+    results.push_back(run_widget("csav_collapsable_header", [&]() {
+      header.update();
+      header.draw();
+    }, opts));
+  }
+
+  ImGui::DestroyContext();
+
+  printf("\n%zu frames, %.0fx%.0f\n\n", opts.frames, display_size.x, display_size.y);
+  printf("%-24s | first ms |   avg ms |   p95 ms |   max ms | frame ms | allocs/frame | KB/frame | expanded | tabs\n", "widget");
+  for (auto& r : results)
+  {
+    printf("%-24s | %8.3f | %8.3f | %8.3f | %8.3f | %8.3f | %12.1f | %8.1f | %8zu | %4zu\n",
+      r.name.c_str(), r.first_ms, r.avg_ms, r.p95_ms, r.max_ms, r.frame_avg_ms,
+      r.allocs_per_frame, r.kb_per_frame, r.expanded, r.visited_tabs);
+  }
+
+  return 0;
+}
@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include <utils.hpp>
+#include "commands.hpp"
+
+namespace {
+
+struct command_entry
+{
+  const char* name;
+  const char* usage;
+  const char* description;
+  int (*main_fn)(int argc, char** argv);
+};
+
+constexpr command_entry s_commands[] = {
+  { "info",             "<save> [--structures]",                  "header, node count and sizes, loaded structures", &info_main },
+  { "list-nodes",       "<save> [--max-depth=N]",                 "node tree with indices and sizes", &list_nodes_main },
+  { "extract-node",     "<save> <node path> <out> [--flat]",      "writes the data of a node, or its whole flattened subtree", &extract_node_main },
+  { "replace-node",     "<save> <node path> <in> <out save>",     "replaces the data of a node (children are kept)", &replace_node_main },
+  { "decompress",       "<save> <out> [--raw]",                   "rewrites the save with uncompressed chunks, or dumps the raw node data", &decompress_main },
+  { "recompress",       "<save> <out save>",                      "rewrites the save with compressed chunks", &recompress_main },
+  { "round-trip-check", "<save> [--structures]",                  "checks that the save is rewritten identically", &round_trip_check_main },
+  { "batch",            "<dir|glob> <script> [--out=DIR] [--threads=N] [--dry-run]", "applies an edit script to many saves, in place unless --out is given", &batch_main },
+};
+
+void print_usage()
+{
+  printf("usage: CPSECli <command> [args...]\n\n"
+    "node paths are names from the root separated by '/', \"name[i]\" for the\n"
+    "i-th sibling of a name, or a single name searched in the whole tree.\n"
+    "the db folder must be in the working directory for --structures and batch.\n\ncommands:\n");
+  for (auto& c : s_commands)
+    printf("  %-16s %s\n  %-16s   %s\n", c.name, c.usage, "", c.description);
+
+  printf("\nbatch scripts have one operation per line ('#' starts a comment):\n"
+    "  unflag-quest-items\n"
+    "  set-fact <name|0xhash> <value>\n"
+    "  replace-spawned-vehicles <tweakdbid name|0xid>\n"
+    "a directory given to batch is searched for sav.dat files.\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    print_usage();
+    return 1;
+  }
+
+  set_error_report_fn([](const std::string& title, const std::string& msg) {
+    fprintf(stderr, "error: %s: %s\n", title.c_str(), msg.c_str());
+  });
+
+  const std::string_view name = argv[1];
+  for (auto& c : s_commands)
+  {
+    if (name == c.name)
+      return c.main_fn(argc - 1, argv + 1);
+  }
+
+  fprintf(stderr, "unknown command: %s\n\n", argv[1]);
+  print_usage();
+  return 1;
+}
+
@@ -0,0 +1,475 @@
+// Sub-commands of CPSECli, they work on csav and its serial_tree directly,
+// without any of the app's widgets.
+
+#include <cstdio>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+#include <utils.hpp>
+#include <csav/csav.hpp>
+#include <csav/batch_edit.hpp>
+#include "commands.hpp"
+
+namespace {
+
+struct args_t
+{
+  std::vector<std::string> positionals;
+  std::map<std::string, std::string> options; // --name or --name=value
+
+  bool has(const std::string& name) const
+  {
+    return options.find(name) != options.end();
+  }
+
+  std::string get(const std::string& name, const std::string& default_value = "") const
+  {
+    auto it = options.find(name);
+    return it != options.end() ? it->second : default_value;
+  }
+};
+
+// argv[0] is the command name
+args_t parse_args(int argc, char** argv)
+{
+  args_t args;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg.rfind("--", 0) == 0)
+    {
+      const size_t eq = arg.find('=');
+      if (eq == std::string::npos)
+        args.options[arg.substr(2)] = "";
+      else
+        args.options[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+    }
+    else
+    {
+      args.positionals.push_back(std::move(arg));
+    }
+  }
+  return args;
+}
+
+bool check_positionals(const args_t& args, size_t cnt, const char* command)
+{
+  if (args.positionals.size() == cnt)
+    return true;
+  fprintf(stderr, "%s: expected %zu arguments, got %zu (run CPSECli without arguments for usage)\n",
+    command, cnt, args.positionals.size());
+  return false;
+}
+
+bool open_save(csav& sav, const std::filesystem::path& path, bool structures, bool reserialization_test = false)
+{
+  progress_t progress;
+  if (!sav.open_with_progress(path, progress, false, !structures, reserialization_test))
+  {
+    fprintf(stderr, "couldn't open %s\n", path.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool save_to(csav& sav, const std::filesystem::path& path, bool uncompressed)
+{
+  progress_t progress;
+  if (!sav.save_with_progress(path, progress, false, uncompressed))
+  {
+    fprintf(stderr, "couldn't write %s\n", path.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool write_file(const std::filesystem::path& path, const char* data, size_t size)
+{
+  std::ofstream ofs;
+  ofs.open(path, ofs.out | ofs.binary | ofs.trunc);
+  ofs.write(data, size);
+  if (ofs.fail())
+  {
+    fprintf(stderr, "couldn't write %s\n", path.string().c_str());
+    return false;
+  }
+  return true;
+}
+
+bool read_file(const std::filesystem::path& path, std::vector<char>& buf)
+{
+  std::ifstream ifs;
+  ifs.open(path, ifs.in | ifs.binary);
+  if (ifs.fail())
+  {
+    fprintf(stderr, "couldn't open %s\n", path.string().c_str());
+    return false;
+  }
+  buf.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  return true;
+}
+
+// "a/b[1]/c" from the root, or a single name searched in the whole tree
+std::shared_ptr<const node_t> find_node(const csav& sav, const std::string& path)
+{
+  auto node = sav.root_node;
+  if (!node)
+    return nullptr;
+
+  size_t pos = 0;
+  while (node && pos <= path.size())
+  {
+    size_t end = path.find('/', pos);
+    if (end == std::string::npos)
+      end = path.size();
+
+    std::string name = path.substr(pos, end - pos);
+    size_t occurrence = 0;
+    const size_t bracket = name.find('[');
+    if (bracket != std::string::npos && name.back() == ']')
+    {
+      occurrence = std::strtoull(name.c_str() + bracket + 1, nullptr, 10);
+      name.resize(bracket);
+    }
+
+    std::shared_ptr<const node_t> next;
+    for (auto& child : node->children())
+    {
+      if (child->name() == name && occurrence-- == 0)
+      {
+        next = child;
+        break;
+      }
+    }
+    node = next;
+    pos = end + 1;
+  }
+
+  if (!node && path.find_first_of("/[") == std::string::npos)
+    node = sav.search_node(path);
+  return node;
+}
+
+std::shared_ptr<const node_t> find_node_or_complain(const csav& sav, const std::string& path)
+{
+  auto node = find_node(sav, path);
+  if (!node)
+    fprintf(stderr, "node not found: %s\n", path.c_str());
+  return node;
+}
+
+void list_children(const node_t& node, const std::string& path, size_t depth, size_t max_depth)
+{
+  auto& children = node.children();
+  std::unordered_map<std::string, uint32_t> counts, occurrences;
+  for (auto& child : children)
+    counts[child->name()]++;
+
+  for (auto& child : children)
+  {
+    const std::string name = child->name();
+    std::string child_path = path.size() ? path + "/" + name : name;
+    const uint32_t occurrence = occurrences[name]++;
+    if (counts[name] > 1)
+      child_path += fmt::format("[{}]", occurrence);
+
+    const std::string idx = child->is_blob() ? "blob" : std::to_string(child->idx());
+    printf("%s\t%s\t%zu\t%zu\n", child_path.c_str(), idx.c_str(), child->data().size(), child->calcsize());
+
+    if (depth + 1 < max_depth)
+      list_children(*child, child_path, depth + 1, max_depth);
+  }
+}
+
+} // namespace
+
+int info_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 1, "info"))
+    return 1;
+
+  const bool structures = args.has("structures");
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, args.positionals[0], structures))
+    return 2;
+
+  printf("file: %s\n", args.positionals[0].c_str());
+  printf("version: %s\n", sav->ver.string().c_str());
+  printf("nodes: %zu\n", sav->stree.descs.size());
+  printf("top-level nodes: %zu\n", sav->root_node->children().size());
+  printf("node data size: %zu bytes\n", sav->root_node->calcsize());
+
+  if (!structures)
+    return 0;
+
+  struct structure_t
+  {
+    const char* name;
+    const node_serializable* var;
+    const CSystem* sys;
+  };
+
+  const structure_t list[] = {
+    { "inventory",                          &sav->inventory,    nullptr },
+    { "CharacetrCustomization_Appearances", &sav->chtrcustom,   nullptr },
+    { "godModeSystem",                      &sav->godmode,      &sav->godmode.system() },
+    { "FactsDB",                            &sav->factsdb,      nullptr },
+    { "ScriptableSystemsContainer",         &sav->scriptables,  &sav->scriptables.system() },
+    { "PSData",                             &sav->psdata,       &sav->psdata.system() },
+    { "StatsSystem",                        &sav->stats,        &sav->stats.system() },
+    { "StatPoolsSystem",                    &sav->statspool,    &sav->statspool.system() },
+  };
+
+  int ret = 0;
+  printf("structures:\n");
+  for (auto& s : list)
+  {
+    if (!sav->search_node(s.name))
+      printf("  %-36s absent\n", s.name);
+    else if (!s.var->has_valid_data)
+    {
+      printf("  %-36s not loaded\n", s.name);
+      ret = 2;
+    }
+    else if (s.sys)
+      printf("  %-36s loaded, %zu objects\n", s.name, s.sys->objects().size());
+    else
+      printf("  %-36s loaded\n", s.name);
+  }
+  return ret;
+}
+
+int list_nodes_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 1, "list-nodes"))
+    return 1;
+
+  const size_t max_depth = std::strtoull(args.get("max-depth", "-1").c_str(), nullptr, 10);
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, args.positionals[0], false))
+    return 2;
+
+  printf("path\tidx\tdata size\tsubtree size\n");
+  list_children(*sav->root_node, "", 0, max_depth ? max_depth : 1);
+  return 0;
+}
+
+int extract_node_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 3, "extract-node"))
+    return 1;
+
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, args.positionals[0], false))
+    return 2;
+
+  auto node = find_node_or_complain(*sav, args.positionals[1]);
+  if (!node)
+    return 2;
+
+  const std::filesystem::path out_path = args.positionals[2];
+  if (!args.has("flat"))
+  {
+    auto& data = node->data();
+    return write_file(out_path, data.data(), data.size()) ? 0 : 2;
+  }
+
+  // streamed from the tree, nothing is copied
+  std::ofstream ofs;
+  ofs.open(out_path, ofs.out | ofs.binary | ofs.trunc);
+  node_flat_stream stream(*node);
+  const char* data = nullptr;
+  size_t size = 0;
+  while (stream.next(data, size))
+    ofs.write(data, size);
+
+  if (ofs.fail())
+  {
+    fprintf(stderr, "couldn't write %s\n", out_path.string().c_str());
+    return 2;
+  }
+  return 0;
+}
+
+int replace_node_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 4, "replace-node"))
+    return 1;
+
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, args.positionals[0], false))
+    return 2;
+
+  auto node = find_node_or_complain(*sav, args.positionals[1]);
+  if (!node)
+    return 2;
+
+  std::vector<char> buf;
+  if (!read_file(args.positionals[2], buf))
+    return 2;
+
+  node->nonconst().assign_data(buf);
+  return save_to(*sav, args.positionals[3], false) ? 0 : 2;
+}
+
+int decompress_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 2, "decompress"))
+    return 1;
+
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, args.positionals[0], false))
+    return 2;
+
+  if (args.has("raw"))
+  {
+    auto& nodedata = sav->stree.nodedata;
+    return write_file(args.positionals[1], nodedata.data(), nodedata.size()) ? 0 : 2;
+  }
+
+  // the layout of PS4 saves, that the editor reads back
+  return save_to(*sav, args.positionals[1], true) ? 0 : 2;
+}
+
+int recompress_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 2, "recompress"))
+    return 1;
+
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, args.positionals[0], false))
+    return 2;
+
+  return save_to(*sav, args.positionals[1], false) ? 0 : 2;
+}
+
+int round_trip_check_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 1, "round-trip-check"))
+    return 1;
+
+  const std::filesystem::path path = args.positionals[0];
+  int ret = 0;
+
+  // tree: written to a temporary file and read back
+  {
+    auto sav = std::make_unique<csav>();
+    if (!open_save(*sav, path, false))
+      return 2;
+
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const auto tmp_path = std::filesystem::temp_directory_path() / fmt::format("cpse_round_trip_{:x}.dat", stamp);
+    if (!save_to(*sav, tmp_path, false))
+      return 2;
+
+    auto reloaded = std::make_unique<csav>();
+    const bool reopened = open_save(*reloaded, tmp_path, false);
+    std::error_code ec;
+    std::filesystem::remove(tmp_path, ec);
+    if (!reopened)
+      return 2;
+
+    reserialization_mismatch mismatch;
+    if (sav->ver != reloaded->ver || sav->suk != reloaded->suk || sav->uk0 != reloaded->uk0 || sav->uk1 != reloaded->uk1)
+    {
+      printf("tree: header differs\n");
+      ret = 2;
+    }
+    else if (!compare_flattened_nodes(*sav->root_node, *reloaded->root_node, mismatch))
+    {
+      printf("tree: differs at offset %#zx (in %s)\n", mismatch.offset, mismatch.node_path.c_str());
+      ret = 2;
+    }
+    else
+    {
+      printf("tree: ok (%zu nodes)\n", sav->stree.descs.size());
+    }
+  }
+
+  if (!args.has("structures"))
+    return ret;
+
+  // structures: reloaded and reserialized by the reserialization check
+  auto sav = std::make_unique<csav>();
+  if (!open_save(*sav, path, true, true))
+    return 2;
+
+  sav->reserialization_check.wait();
+  for (auto& res : sav->reserialization_check.results())
+  {
+    if (res.ok)
+      printf("%s: ok\n", res.node_name.c_str());
+    else
+    {
+      printf("%s: %s\n", res.node_name.c_str(), res.error.c_str());
+      ret = 2;
+    }
+  }
+  return ret;
+}
+
+int batch_main(int argc, char** argv)
+{
+  const args_t args = parse_args(argc, argv);
+  if (!check_positionals(args, 2, "batch"))
+    return 1;
+
+  std::string err;
+  batch_edit_script script;
+  if (!script.load(args.positionals[1], err))
+  {
+    fprintf(stderr, "%s: %s\n", args.positionals[1].c_str(), err.c_str());
+    return 1;
+  }
+
+  std::vector<std::filesystem::path> files;
+  std::filesystem::path root;
+  if (!collect_batch_inputs(args.positionals[0], files, root, err))
+  {
+    fprintf(stderr, "%s\n", err.c_str());
+    return 2;
+  }
+
+  batch_edit_runner::options_t opts;
+  opts.thread_cnt = std::strtoull(args.get("threads", "0").c_str(), nullptr, 10);
+  opts.out_dir = args.get("out");
+  opts.dry_run = args.has("dry-run");
+
+  batch_edit_runner runner(opts);
+  std::thread thread([&]() { runner.run(files, root, script); });
+  for (size_t done = 0; done < files.size(); done = runner.done_cnt())
+  {
+    fprintf(stderr, "\r%zu/%zu", done, files.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  thread.join();
+  fprintf(stderr, "\r%zu/%zu\n", files.size(), files.size());
+
+  for (auto& res : runner.results())
+  {
+    if (!res.ok)
+      printf("failed: %s: %s\n", res.path.string().c_str(), res.error.c_str());
+  }
+
+  auto& stats = runner.stats();
+  printf("%zu files, %zu failed, %.1f MB in %.2f s: %.1f files/s, %.1f MB/s (%zu steals)\n",
+    stats.files, stats.failures, stats.bytes / (1024.0 * 1024.0), stats.ms / 1000.0,
+    stats.files_per_s(), stats.mb_per_s(), stats.steals);
+  return stats.failures ? 2 : 0;
+}
+
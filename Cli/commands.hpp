@@ -0,0 +1,14 @@
+#pragma once
+
+// each command is a sub-command of CPSECli: CPSECli <name> [args...]
+// they return 0 on success, 1 on usage errors and 2 on failures
+
+int info_main(int argc, char** argv);
+int list_nodes_main(int argc, char** argv);
+int extract_node_main(int argc, char** argv);
+int replace_node_main(int argc, char** argv);
+int decompress_main(int argc, char** argv);
+int recompress_main(int argc, char** argv);
+int round_trip_check_main(int argc, char** argv);
+int batch_main(int argc, char** argv);
+
@@ -305,6 +305,13 @@ std::shared_ptr<AppImage> IApp::load_texture_from_file(const std::string& filena
 
 	stbi_image_free(image_data);
 
-	return std::make_shared<AppImage>(tex, w, h);
+	if (!tex)
+		return {};
+
+	// the image holds a reference on the view
+	std::shared_ptr<void> holder(tex.Detach(), [](void* p) {
+		static_cast<ID3D11ShaderResourceView*>(p)->Release();
+	});
+	return std::make_shared<AppImage>(std::move(holder), w, h);
 }
 
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <numeric>
 #include <csav/csystem/CSystem.hpp>
+#include <csav/csystem/CObjectListLabels.hpp>
 
 
 class archive_test
@@ -35,12 +36,7 @@ public:
 
   int selected = -1;
 
-  static std::string object_name_getter(const CObjectSPtr& item)
-  {
-    static std::string tmp;
-    tmp = item->ctypename().str();
-    return tmp;
-  };
+  CObjectListLabels labels;
 
   bool imgui_draw()
   {
@@ -87,7 +83,19 @@ public:
 
         //ImGui::PushItemWidth(150.f);
         ImGui::BeginChild("Objects", ImVec2(-FLT_MIN, 0));
-        modified |= ImGui::ErasableListBox("##CSystem::objects", &selected, &object_name_getter, objects, true, true);
+        ImGuiListClipper clipper;
+        clipper.Begin((int)objects.size(), ImGui::GetTextLineHeightWithSpacing());
+        labels.sync(objects);
+        while (clipper.Step())
+        {
+          for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+          {
+            ImGui::PushID(i);
+            if (ImGui::Selectable(labels.label(i).c_str(), i == selected))
+              selected = i;
+            ImGui::PopID();
+          }
+        }
         ImGui::EndChild();
         //ImGui::PopItemWidth();
 
@@ -1,7 +1,7 @@
 #pragma once
 #include <cpinternals/CFact.hpp>
 
-#include <Windows.h>
+#include <utils.hpp>
 #include <fstream>
 #include <sstream>
 #include <nlohmann/json.hpp>
@@ -53,15 +53,12 @@ CFactResolver::CFactResolver()
     }
     catch (std::exception& e)
     {
-      std::wostringstream oss;
-      oss << L"db/CFactsDB.json has unexpected content" << std::endl;
-      oss << e.what();
-      MessageBox(0, oss.str().c_str(), L"corrupt resource file", 0);
+      report_error("corrupt resource file", fmt::format("db/CFactsDB.json has unexpected content\n{}", e.what()));
     }
   }
   else
   {
-    MessageBox(0, L"db/CFactsDB.json is missing", L"missing resource file", 0);
+    report_error("missing resource file", "db/CFactsDB.json is missing");
   }
 
   for (auto& n : m_list)
@@ -4,6 +4,8 @@
 #include <map>
 #include <unordered_map>
 #include <algorithm>
+#include <mutex>
+#include <shared_mutex>
 
 #include <fmt/format.h>
 #include <utils.hpp>
@@ -82,6 +84,7 @@ struct CFactResolver
   {
     uint32_t id = FNV1a32(name.str());
 
+    std::unique_lock<std::shared_mutex> lk(m_invmap_mtx);
     auto it = m_invmap.emplace(id, name);
     if (it.second)
     {
@@ -102,6 +105,7 @@ struct CFactResolver
 
   bool is_registered(uint32_t hash) const
   {
+    std::shared_lock<std::shared_mutex> lk(m_invmap_mtx);
     return m_invmap.find(hash) != m_invmap.end();
   }
 
@@ -112,12 +116,25 @@ struct CFactResolver
 
   CSysName resolve(uint32_t hash) const
   {
-    auto it = m_invmap.find(hash);
-    if (it != m_invmap.end())
-      return it->second;
+    {
+      std::shared_lock<std::shared_mutex> lk(m_invmap_mtx);
+      auto it = m_invmap.find(hash);
+      if (it != m_invmap.end())
+        return it->second;
+    }
     return CSysName(fmt::format("<unknown_fact:{:08X}>", hash));
   }
 
+  std::vector<uint32_t> registered_hashes() const
+  {
+    std::shared_lock<std::shared_mutex> lk(m_invmap_mtx);
+    std::vector<uint32_t> hashes;
+    hashes.reserve(m_invmap.size());
+    for (auto& kv : m_invmap)
+      hashes.push_back(kv.first);
+    return hashes;
+  }
+
   const std::vector<CSysName>& sorted_names() const { return m_list; }
 
 protected:
@@ -126,6 +143,8 @@ protected:
 
   std::vector<CSysName> m_list;
   std::unordered_map<uint32_t, CSysName> m_invmap;
+  // facts are resolved on worker threads too (hash scans)
+  mutable std::shared_mutex m_invmap_mtx;
 };
 
 } // namespace CP
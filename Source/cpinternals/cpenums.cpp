@@ -1,7 +1,7 @@
 #pragma once
 #include "cpenums.hpp"
 
-#include <Windows.h>
+#include <utils.hpp>
 #include <fstream>
 #include <sstream>
 #include <nlohmann/json.hpp>
@@ -27,15 +27,12 @@ CEnumList::CEnumList()
     }
     catch (std::exception& e)
     {
-      std::wostringstream oss;
-      oss << L"db/CEnums.json has unexpected content" << std::endl;
-      oss << e.what();
-      MessageBox(0, oss.str().c_str(), L"corrupt resource file", 0);
+      report_error("corrupt resource file", fmt::format("db/CEnums.json has unexpected content\n{}", e.what()));
     }
   }
   else
   {
-    MessageBox(0, L"db/CEnums.json is missing", L"CObjectBPs", 0);
+    report_error("missing resource file", "db/CEnums.json is missing");
   }
 }
 
@@ -1,7 +1,7 @@
 #pragma once
 #include "cpnames.hpp"
 
-#include <Windows.h>
+#include <utils.hpp>
 #include <fstream>
 #include <sstream>
 #include <nlohmann/json.hpp>
@@ -68,15 +68,12 @@ TweakDBIDResolver::TweakDBIDResolver()
     }
     catch (std::exception& e)
     {
-      std::wostringstream oss;
-      oss << L"db/TweakDBIDs.json has an unexpected content" << std::endl;
-      oss << e.what();
-      MessageBox(0, oss.str().c_str(), L"corrupt resource file", 0);
+      report_error("corrupt resource file", fmt::format("db/TweakDBIDs.json has an unexpected content\n{}", e.what()));
     }
   }
   else
   {
-    MessageBox(0, L"db/TweakDBIDs.json is missing", L"missing resource file", 0);
+    report_error("missing resource file", "db/TweakDBIDs.json is missing");
   }
 
   for (auto& n : s_full_list)
@@ -109,12 +106,12 @@ CNameResolver::CNameResolver()
     }
     catch (std::exception&)
     {
-      MessageBox(0, L"db/CNames.json has unexpected content", L"corrupt resource file", 0);
+      report_error("corrupt resource file", "db/CNames.json has unexpected content");
     }
   }
   else
   {
-    MessageBox(0, L"db/CNames.json is missing", L"CObjectBPs", 0);
+    report_error("missing resource file", "db/CNames.json is missing");
   }
   for (auto& n : s_full_list)
   {
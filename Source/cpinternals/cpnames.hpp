@@ -7,6 +7,9 @@
 #include <map>
 #include <unordered_map>
 #include <algorithm>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <csav/serializers.hpp>
 #include <fmt/format.h>
 #include <utils.hpp>
@@ -118,6 +121,15 @@ public:
     return fmt::format("<tdbid:{:08X}:{:02X}>", id.crc, id.slen);
   }
 
+  std::vector<uint64_t> registered_hashes() const
+  {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(s_tdbid_invmap.size());
+    for (auto& kv : s_tdbid_invmap)
+      hashes.push_back(kv.first);
+    return hashes;
+  }
+
   const std::vector<std::string>& sorted_names(TweakDBIDCategory cat = TweakDBIDCategory::All) const
   {
     switch (cat)
@@ -185,6 +197,10 @@ class CNameResolver
 {
   std::vector<std::string> s_full_list;
   std::unordered_map<uint64_t, std::string> s_cname_invmap;
+  // resolution can happen on worker threads while the ui registers names
+  mutable std::shared_mutex s_cname_invmap_mtx;
+  // copy of s_full_list for the ui, dropped when a name is registered
+  mutable std::shared_ptr<const std::vector<std::string>> s_full_list_snapshot;
 
   CNameResolver();
   ~CNameResolver() = default;
@@ -203,10 +219,12 @@ public:
   void register_name(std::string_view name)
   {
     uint64_t id = FNV1a(name);
+    std::unique_lock<std::shared_mutex> lk(s_cname_invmap_mtx);
     if (s_cname_invmap.find(id) == s_cname_invmap.end())
     {
       s_cname_invmap[id] = name;
       insert_sorted(s_full_list, std::string(name));
+      s_full_list_snapshot.reset();
     }
   }
 
@@ -223,6 +241,7 @@ public:
 
   bool is_registered(uint64_t hash) const
   {
+    std::shared_lock<std::shared_mutex> lk(s_cname_invmap_mtx);
     return s_cname_invmap.find(hash) != s_cname_invmap.end();
   }
 
@@ -233,13 +252,37 @@ public:
 
   std::string resolve(uint64_t hash) const
   {
+    std::shared_lock<std::shared_mutex> lk(s_cname_invmap_mtx);
     auto it = s_cname_invmap.find(hash);
     if (it != s_cname_invmap.end())
       return it->second;
     return fmt::format("<cname:{:016X}>", hash);
   }
 
-  const std::vector<std::string>& sorted_names() const { return s_full_list; }
+  std::vector<uint64_t> registered_hashes() const
+  {
+    std::shared_lock<std::shared_mutex> lk(s_cname_invmap_mtx);
+    std::vector<uint64_t> hashes;
+    hashes.reserve(s_cname_invmap.size());
+    for (auto& kv : s_cname_invmap)
+      hashes.push_back(kv.first);
+    return hashes;
+  }
+
+  // names can be registered concurrently (loads on worker threads),
+  // the snapshot stays the same until then
+  std::shared_ptr<const std::vector<std::string>> sorted_names() const
+  {
+    {
+      std::shared_lock<std::shared_mutex> lk(s_cname_invmap_mtx);
+      if (s_full_list_snapshot)
+        return s_full_list_snapshot;
+    }
+    std::unique_lock<std::shared_mutex> lk(s_cname_invmap_mtx);
+    if (!s_full_list_snapshot)
+      s_full_list_snapshot = std::make_shared<const std::vector<std::string>>(s_full_list);
+    return s_full_list_snapshot;
+  }
 };
 
 inline std::string CName::str() const
@@ -0,0 +1,371 @@
+#include "name_filter.hpp"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+inline char lower_char(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+}
+
+inline uint32_t trigram_key(char a, char b, char c)
+{
+  return ((uint32_t)(uint8_t)a << 16) | ((uint32_t)(uint8_t)b << 8) | (uint8_t)c;
+}
+
+void distinct_trigrams(std::string_view lowered, std::vector<uint32_t>& out)
+{
+  out.clear();
+  for (size_t i = 0; i + 2 < lowered.size(); ++i)
+    out.push_back(trigram_key(lowered[i], lowered[i + 1], lowered[i + 2]));
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+size_t find_ignore_case(std::string_view name, std::string_view lowered_query)
+{
+  if (lowered_query.size() > name.size())
+    return std::string_view::npos;
+  const size_t last = name.size() - lowered_query.size();
+  for (size_t pos = 0; pos <= last; ++pos)
+  {
+    size_t i = 0;
+    while (i < lowered_query.size() && lower_char(name[pos + i]) == lowered_query[i])
+      ++i;
+    if (i == lowered_query.size())
+      return pos;
+  }
+  return std::string_view::npos;
+}
+
+// edit distance between the query and its closest substring of name
+// (Sellers, with transpositions of adjacent characters counted as one edit),
+// max_dist + 1 if every alignment needs more edits than that
+size_t substring_distance(std::string_view name, std::string_view lowered_query, size_t max_dist)
+{
+  const size_t m = lowered_query.size();
+  thread_local std::vector<uint16_t> buf;
+  buf.assign(3 * (m + 1), 0);
+  uint16_t* col = buf.data();
+  uint16_t* prev = col + (m + 1);
+  uint16_t* prev2 = prev + (m + 1);
+  for (size_t i = 0; i <= m; ++i)
+    col[i] = (uint16_t)i;
+
+  size_t best = m;
+  char prev_c = 0;
+  for (char nc : name)
+  {
+    const char c = lower_char(nc);
+    std::swap(prev2, prev);
+    std::swap(prev, col); // col gets the oldest column, overwritten below
+
+    col[0] = 0; // a match can start anywhere
+    for (size_t i = 1; i <= m; ++i)
+    {
+      const char qc = lowered_query[i - 1];
+      int d = std::min({prev[i] + 1, col[i - 1] + 1, prev[i - 1] + (qc != c ? 1 : 0)});
+      if (i > 1 && prev_c && qc == prev_c && lowered_query[i - 2] == c)
+        d = std::min(d, prev2[i - 2] + 1);
+      col[i] = (uint16_t)d;
+    }
+    best = std::min<size_t>(best, col[m]);
+    if (best == 0)
+      break;
+    prev_c = c;
+  }
+  return best <= max_dist ? best : max_dist + 1;
+}
+
+} // namespace
+
+name_filter_index::name_filter_index(std::shared_ptr<const std::vector<std::string>> names)
+  : m_names(std::move(names))
+{
+  std::string lowered;
+  std::vector<uint32_t> trigrams;
+  const auto& list = *m_names;
+  for (uint32_t i = 0; i < (uint32_t)list.size(); ++i)
+  {
+    lowered = lower(list[i]);
+    distinct_trigrams(lowered, trigrams);
+    for (uint32_t t : trigrams)
+      m_postings[t].push_back(i); // sorted since i grows
+  }
+}
+
+bool name_filter_index::candidates(std::string_view lowered_query, std::vector<uint32_t>& out) const
+{
+  out.clear();
+
+  std::vector<uint32_t> trigrams;
+  distinct_trigrams(lowered_query, trigrams);
+
+  const size_t broken = 4 * max_typos(lowered_query);
+  if (trigrams.size() <= broken)
+    return false;
+  const size_t needed = trigrams.size() - broken;
+
+  if (needed == trigrams.size())
+  {
+    // no typo allowed: intersection, smallest posting list first
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (uint32_t t : trigrams)
+    {
+      auto it = m_postings.find(t);
+      if (it == m_postings.end())
+        return true;
+      lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+
+    out = *lists[0];
+    std::vector<uint32_t> tmp;
+    for (size_t i = 1; i < lists.size() && out.size(); ++i)
+    {
+      tmp.clear();
+      std::set_intersection(out.begin(), out.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(tmp));
+      out.swap(tmp);
+    }
+    return true;
+  }
+
+  std::vector<uint8_t> counts(m_names->size(), 0);
+  for (uint32_t t : trigrams)
+  {
+    auto it = m_postings.find(t);
+    if (it == m_postings.end())
+      continue;
+    for (uint32_t idx : it->second)
+    {
+      if (counts[idx] < 0xFF)
+        ++counts[idx];
+    }
+  }
+
+  for (uint32_t i = 0; i < (uint32_t)counts.size(); ++i)
+  {
+    if (counts[i] >= needed)
+      out.push_back(i);
+  }
+  return true;
+}
+
+std::string name_filter_index::lower(std::string_view s)
+{
+  std::string ret(s);
+  for (auto& c : ret)
+    c = lower_char(c);
+  return ret;
+}
+
+size_t name_filter_index::max_typos(std::string_view query)
+{
+  if (query.size() >= 10)
+    return 2;
+  if (query.size() >= 5)
+    return 1;
+  return 0;
+}
+
+int32_t name_filter_index::score(std::string_view name, std::string_view lowered_query)
+{
+  if (lowered_query.empty())
+    return 0;
+
+  const int32_t len_penalty = (int32_t)std::min<size_t>(name.size(), 500);
+
+  const size_t pos = find_ignore_case(name, lowered_query);
+  if (pos != std::string_view::npos)
+  {
+    int32_t s = 3000 - len_penalty;
+    if (name.size() == lowered_query.size())
+      s += 1000;
+    if (pos == 0)
+      s += 600;
+    else if (name[pos - 1] == '.' || name[pos - 1] == '_')
+      s += 400;
+    return s;
+  }
+
+  const size_t k = max_typos(lowered_query);
+  if (k == 0 || lowered_query.size() > name.size() + k)
+    return -1;
+
+  const size_t d = substring_distance(name, lowered_query, k);
+  if (d > k)
+    return -1;
+  return 2000 - 500 * (int32_t)d - len_penalty;
+}
+
+//------------------------------------------------------------------------------
+
+name_filter::~name_filter()
+{
+  m_cancel = true;
+  if (m_query_thread.joinable())
+    m_query_thread.join();
+  if (m_build_thread.joinable())
+    m_build_thread.join();
+}
+
+void name_filter::sync(const std::vector<std::string>& names)
+{
+  if (m_names && m_names->size() == names.size())
+    return;
+
+  sync(std::make_shared<const std::vector<std::string>>(names));
+}
+
+void name_filter::sync(std::shared_ptr<const std::vector<std::string>> names)
+{
+  if (!names || m_names == names)
+    return;
+
+  m_names = std::move(names);
+
+  // the previous snapshot's index is dropped when it's published
+  if (m_build_thread.joinable())
+    m_build_thread.join();
+
+  m_build_thread = std::thread([this, names = m_names]() {
+    auto index = std::make_shared<const name_filter_index>(names);
+    std::lock_guard<std::mutex> lk(m_mtx);
+    m_index = std::move(index);
+  });
+
+  // results of the previous snapshot must not be reused
+  m_started = false;
+}
+
+void name_filter::submit(std::string_view query)
+{
+  m_wanted_query = name_filter_index::lower(query);
+  step();
+}
+
+std::shared_ptr<const name_filter_results> name_filter::results()
+{
+  step();
+  std::lock_guard<std::mutex> lk(m_mtx);
+  return m_results;
+}
+
+bool name_filter::is_indexed() const
+{
+  std::lock_guard<std::mutex> lk(m_mtx);
+  return m_index && m_index->names() == m_names;
+}
+
+void name_filter::step()
+{
+  if (m_query_thread.joinable())
+  {
+    if (!m_query_finished)
+    {
+      if (m_started_query != m_wanted_query)
+        m_cancel = true;
+      return;
+    }
+    m_query_thread.join();
+  }
+
+  if (!m_names || m_wanted_query.empty() || (m_started && m_started_query == m_wanted_query))
+    return;
+
+  std::shared_ptr<const name_filter_index> index;
+  std::shared_ptr<const name_filter_results> base;
+  {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if (m_index && m_index->names() == m_names)
+      index = m_index;
+    // a query extending a completed one matches a subset of its matches
+    // (the prefix of an alignment has at most as many edits)
+    if (m_results && m_results->complete && m_results->names == m_names
+      && m_results->query.size() && m_wanted_query.rfind(m_results->query, 0) == 0
+      && name_filter_index::max_typos(m_wanted_query) == name_filter_index::max_typos(m_results->query))
+      base = m_results;
+  }
+
+  m_started = true;
+  m_started_query = m_wanted_query;
+  m_cancel = false;
+  m_query_finished = false;
+  m_query_thread = std::thread([this, query = m_wanted_query, names = m_names, index, base]() {
+    run_query(query, names, index, base);
+    m_query_finished = true;
+  });
+}
+
+void name_filter::run_query(std::string lowered_query, std::shared_ptr<const std::vector<std::string>> names,
+  std::shared_ptr<const name_filter_index> index, std::shared_ptr<const name_filter_results> base)
+{
+  using clock = std::chrono::steady_clock;
+  const auto t0 = clock::now();
+
+  std::vector<uint32_t> candidates;
+  bool use_candidates = false;
+  if (base)
+  {
+    candidates = base->matches;
+    use_candidates = true;
+  }
+  else if (index)
+    use_candidates = index->candidates(lowered_query, candidates);
+
+  struct scored_t
+  {
+    int32_t score;
+    uint32_t idx;
+  };
+  std::vector<scored_t> scored;
+
+  auto publish = [&](bool complete) {
+    std::vector<scored_t> ranked = scored;
+    std::sort(ranked.begin(), ranked.end(), [](const scored_t& a, const scored_t& b) {
+      return a.score != b.score ? a.score > b.score : a.idx < b.idx;
+    });
+
+    auto res = std::make_shared<name_filter_results>();
+    res->query = lowered_query;
+    res->names = names;
+    res->matches.reserve(ranked.size());
+    for (auto& s : ranked)
+      res->matches.push_back(s.idx);
+    res->complete = complete;
+    res->ms = std::chrono::duration<double, std::milli>(clock::now() - t0).count();
+
+    std::lock_guard<std::mutex> lk(m_mtx);
+    m_results = std::move(res);
+  };
+
+  // partial results are published often enough to be shown on next frame
+  constexpr auto publish_period = std::chrono::milliseconds(5);
+  auto last_publish = t0;
+
+  const size_t cnt = use_candidates ? candidates.size() : names->size();
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    if ((i & 0x3FF) == 0 && i)
+    {
+      if (m_cancel)
+        return;
+      const auto now = clock::now();
+      if (now - last_publish > publish_period)
+      {
+        publish(false);
+        last_publish = now;
+      }
+    }
+
+    const uint32_t idx = use_candidates ? candidates[i] : (uint32_t)i;
+    const int32_t s = name_filter_index::score((*names)[idx], lowered_query);
+    if (s >= 0)
+      scored.push_back({s, idx});
+  }
+
+  if (!m_cancel)
+    publish(true);
+}
+
@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Fuzzy filter over the name lists of the resolvers (TweakDBIDs, CNames).
+//
+// A name matches a query when it contains it, case insensitive, with up to
+// max_typos(query) edits (insertions, deletions, substitutions, swaps of
+// adjacent characters).
+// Candidates are preselected with a trigram index: an edit breaks at most 4
+// of the query's trigrams, so a match shares at least trigrams - 4 * typos
+// of them with the query. Matches are ranked by: exact substring first
+// (better at the start of the name or of one of its dotted parts), then by
+// edit count and name length.
+
+class name_filter_index
+{
+  std::shared_ptr<const std::vector<std::string>> m_names;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> m_postings; // trigram -> sorted name indices
+
+public:
+  explicit name_filter_index(std::shared_ptr<const std::vector<std::string>> names);
+
+  name_filter_index(const name_filter_index&) = delete;
+  name_filter_index& operator=(const name_filter_index&) = delete;
+
+  const std::shared_ptr<const std::vector<std::string>>& names() const { return m_names; }
+
+  // indices of the names that may match, false if the query is too short
+  // for its trigrams to discriminate (every name is a candidate)
+  bool candidates(std::string_view lowered_query, std::vector<uint32_t>& out) const;
+
+  static std::string lower(std::string_view s);
+  static size_t max_typos(std::string_view query);
+
+  // < 0: no match, name's case is ignored
+  static int32_t score(std::string_view name, std::string_view lowered_query);
+};
+
+struct name_filter_results
+{
+  std::string query;
+  // names the matches refer to
+  std::shared_ptr<const std::vector<std::string>> names;
+  std::vector<uint32_t> matches; // ranked
+  bool complete = false;
+  double ms = 0;
+};
+
+// Runs the queries of a picker in background. The first one builds the
+// index in its own thread, queries scan the whole list until it's ready.
+// Results are published while the scan progresses (partial, ranked among
+// what's been scanned so far), the UI shows the last ones.
+// A query that extends the last completed one only rescans its matches.
+// The methods are to be called from the UI thread.
+class name_filter
+{
+  std::shared_ptr<const std::vector<std::string>> m_names; // snapshot
+
+  std::thread m_build_thread;
+  std::thread m_query_thread;
+  std::atomic<bool> m_query_finished = false;
+  std::atomic<bool> m_cancel = false;
+
+  std::string m_wanted_query;
+  std::string m_started_query;
+  bool m_started = false;
+
+  mutable std::mutex m_mtx;
+  std::shared_ptr<const name_filter_index> m_index; // guarded by m_mtx
+  std::shared_ptr<const name_filter_results> m_results; // guarded by m_mtx
+
+public:
+  name_filter() = default;
+  name_filter(const name_filter&) = delete;
+  name_filter& operator=(const name_filter&) = delete;
+
+  ~name_filter();
+
+  // takes a new snapshot of names if their count changed,
+  // and indexes it in background
+  void sync(const std::vector<std::string>& names);
+
+  // same with a snapshot made by the owner of the names, compared by address
+  void sync(std::shared_ptr<const std::vector<std::string>> names);
+
+  // cancels the running query if it's another one,
+  // the new one starts when it stopped (see results())
+  void submit(std::string_view query);
+
+  // last published results, of a previous query or partial while the
+  // submitted one runs, null before the first ones
+  std::shared_ptr<const name_filter_results> results();
+
+  // the snapshot, the results of an empty query
+  const std::shared_ptr<const std::vector<std::string>>& names() const { return m_names; }
+
+  bool is_indexed() const;
+
+protected:
+  void step();
+  void run_query(std::string lowered_query, std::shared_ptr<const std::vector<std::string>> names,
+    std::shared_ptr<const name_filter_index> index, std::shared_ptr<const name_filter_results> base);
+};
+
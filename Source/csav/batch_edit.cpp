@@ -0,0 +1,472 @@
+#include "batch_edit.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <fmt/format.h>
+#include <csav/csav.hpp>
+
+namespace {
+
+bool parse_u64(const std::string& s, uint64_t& out)
+{
+  if (s.empty())
+    return false;
+  char* end = nullptr;
+  out = std::strtoull(s.c_str(), &end, 0);
+  return end && *end == '\0';
+}
+
+// '*' any sequence, '?' any character
+bool glob_match(const char* pattern, const char* str)
+{
+  const char* star = nullptr;
+  const char* star_str = nullptr;
+  while (*str)
+  {
+    if (*pattern == '*')
+    {
+      star = pattern++;
+      star_str = str;
+    }
+    else if (*pattern == '?' || *pattern == *str)
+    {
+      ++pattern;
+      ++str;
+    }
+    else if (star)
+    {
+      pattern = star + 1;
+      str = ++star_str;
+    }
+    else
+      return false;
+  }
+  while (*pattern == '*')
+    ++pattern;
+  return *pattern == '\0';
+}
+
+bool has_wildcard(const std::string& s)
+{
+  return s.find_first_of("*?") != std::string::npos;
+}
+
+void collect_matches(const std::filesystem::path& dir, const std::vector<std::string>& comps, size_t i, std::vector<std::filesystem::path>& files)
+{
+  std::error_code ec;
+  const bool last = i + 1 == comps.size();
+
+  auto visit = [&](const std::filesystem::path& p) {
+    if (last)
+    {
+      if (std::filesystem::is_regular_file(p, ec))
+        files.push_back(p);
+    }
+    else if (std::filesystem::is_directory(p, ec))
+      collect_matches(p, comps, i + 1, files);
+  };
+
+  if (!has_wildcard(comps[i]))
+  {
+    visit(dir / comps[i]);
+    return;
+  }
+
+  for (auto& entry : std::filesystem::directory_iterator(dir, ec))
+  {
+    if (glob_match(comps[i].c_str(), entry.path().filename().string().c_str()))
+      visit(entry.path());
+  }
+}
+
+struct work_queue
+{
+  std::mutex mtx;
+  std::deque<size_t> items;
+};
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// batch_edit_script
+//------------------------------------------------------------------------------
+
+bool batch_edit_script::parse(const std::string& text, std::string& err)
+{
+  m_ops.clear();
+
+  std::istringstream iss(text);
+  std::string line;
+  size_t line_num = 0;
+  while (std::getline(iss, line))
+  {
+    ++line_num;
+    const size_t comment = line.find('#');
+    if (comment != std::string::npos)
+      line.resize(comment);
+
+    std::istringstream lss(line);
+    std::vector<std::string> words;
+    for (std::string w; lss >> w;)
+      words.push_back(std::move(w));
+    if (words.empty())
+      continue;
+
+    auto fail = [&](const char* msg) {
+      err = fmt::format("line {}: {}", line_num, msg);
+      return false;
+    };
+
+    batch_edit_op op;
+    op.line = line_num;
+    const std::string& cmd = words[0];
+    if (cmd == "unflag-quest-items")
+    {
+      if (words.size() != 1)
+        return fail("unflag-quest-items takes no argument");
+      op.kind = batch_edit_op_kind::unflag_quest_items;
+    }
+    else if (cmd == "set-fact")
+    {
+      uint64_t value = 0;
+      if (words.size() != 3 || !parse_u64(words[2], value) || value > UINT32_MAX)
+        return fail("usage: set-fact <name|0xhash> <value>");
+      op.kind = batch_edit_op_kind::set_fact;
+      op.arg = words[1];
+      op.value = (uint32_t)value;
+      if (op.arg.rfind("0x", 0) == 0)
+      {
+        if (!parse_u64(op.arg, op.u64) || op.u64 > UINT32_MAX)
+          return fail("invalid fact hash");
+      }
+      else
+        op.u64 = CP::CFact(CSysName(op.arg), 0).hash();
+    }
+    else if (cmd == "replace-spawned-vehicles")
+    {
+      if (words.size() != 2)
+        return fail("usage: replace-spawned-vehicles <tdbid>");
+      op.kind = batch_edit_op_kind::replace_spawned_vehicles;
+      op.arg = words[1];
+      if (op.arg.rfind("0x", 0) == 0)
+      {
+        if (!parse_u64(op.arg, op.u64))
+          return fail("invalid TweakDBID");
+      }
+      else
+        op.u64 = TweakDBID(op.arg).as_u64;
+    }
+    else
+    {
+      return fail("unknown operation");
+    }
+
+    m_ops.push_back(std::move(op));
+  }
+
+  if (m_ops.empty())
+  {
+    err = "the script is empty";
+    return false;
+  }
+  return true;
+}
+
+bool batch_edit_script::load(const std::filesystem::path& path, std::string& err)
+{
+  std::ifstream ifs;
+  ifs.open(path, ifs.in | ifs.binary);
+  if (ifs.fail())
+  {
+    err = fmt::format("couldn't open {}", path.string());
+    return false;
+  }
+
+  std::stringstream ss;
+  ss << ifs.rdbuf();
+  return parse(ss.str(), err);
+}
+
+bool batch_edit_script::apply(csav& sav, std::string& err) const
+{
+  for (auto& op : m_ops)
+  {
+    auto fail = [&](const char* msg) {
+      err = fmt::format("line {}: {}", op.line, msg);
+      return false;
+    };
+
+    switch (op.kind)
+    {
+      case batch_edit_op_kind::unflag_quest_items:
+      {
+        if (!sav.inventory.has_valid_data)
+          return fail("inventory isn't loaded");
+        for (auto& subinv : sav.inventory.m_subinvs)
+        {
+          for (auto& item : subinv.items)
+            item.flags &= 0xF8; // 3 bits
+        }
+        sav.inventory.mark_dirty();
+        break;
+      }
+      case batch_edit_op_kind::set_fact:
+      {
+        if (!sav.factsdb.has_valid_data)
+          return fail("FactsDB isn't loaded");
+        auto& tables = sav.factsdb.tables();
+        if (tables.empty())
+          return fail("FactsDB has no table");
+
+        bool found = false;
+        for (auto& tbl : tables)
+        {
+          for (auto& fact : tbl.facts())
+          {
+            if (fact.hash() == (uint32_t)op.u64)
+            {
+              fact.value(op.value);
+              found = true;
+            }
+          }
+        }
+        if (!found)
+          tables.front().facts().emplace_back((uint32_t)op.u64, op.value);
+        sav.factsdb.mark_dirty();
+        break;
+      }
+      case batch_edit_op_kind::replace_spawned_vehicles:
+      {
+        if (!sav.psdata.has_valid_data)
+          return fail("PSData isn't loaded");
+        if (!sav.psdata.replace_spawned_vehicles(TweakDBID(op.u64)))
+          return fail("no spawned vehicles data");
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// batch_edit_runner
+//------------------------------------------------------------------------------
+
+void batch_edit_runner::run(const std::vector<std::filesystem::path>& files, const std::filesystem::path& root, const batch_edit_script& script)
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  m_results.clear();
+  m_results.resize(files.size());
+  m_stats = {};
+  m_done_cnt = 0;
+
+  size_t thread_cnt = m_opts.thread_cnt;
+  if (!thread_cnt)
+    thread_cnt = std::max(1u, std::thread::hardware_concurrency());
+  thread_cnt = std::max<size_t>(1, std::min(thread_cnt, files.size()));
+
+  // largest first, dealt round-robin, steals then pick the smallest leftovers
+  std::vector<std::pair<uint64_t, size_t>> by_size;
+  by_size.reserve(files.size());
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    std::error_code ec;
+    const uint64_t size = std::filesystem::file_size(files[i], ec);
+    by_size.emplace_back(ec ? 0 : size, i);
+  }
+  std::stable_sort(by_size.begin(), by_size.end(),
+    [](const auto& a, const auto& b) { return a.first > b.first; });
+
+  std::vector<work_queue> queues(thread_cnt);
+  for (size_t i = 0; i < by_size.size(); ++i)
+    queues[i % thread_cnt].items.push_back(by_size[i].second);
+
+  std::atomic<size_t> steals = 0;
+
+  auto next_item = [&](size_t self, size_t& item) {
+    {
+      auto& q = queues[self];
+      std::lock_guard<std::mutex> lk(q.mtx);
+      if (q.items.size())
+      {
+        item = q.items.front();
+        q.items.pop_front();
+        return true;
+      }
+    }
+    for (size_t k = 1; k < thread_cnt; ++k)
+    {
+      auto& q = queues[(self + k) % thread_cnt];
+      std::lock_guard<std::mutex> lk(q.mtx);
+      if (q.items.size())
+      {
+        item = q.items.back();
+        q.items.pop_back();
+        ++steals;
+        return true;
+      }
+    }
+    return false;
+  };
+
+  auto worker = [&](size_t self) {
+    size_t item = 0;
+    while (next_item(self, item))
+    {
+      m_results[item] = process_file(files[item], root, script);
+      ++m_done_cnt;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < thread_cnt; ++i)
+    threads.emplace_back(worker, i);
+  worker(0);
+  for (auto& t : threads)
+    t.join();
+
+  m_stats.files = files.size();
+  m_stats.steals = steals.load();
+  for (auto& res : m_results)
+  {
+    m_stats.bytes += res.bytes;
+    if (!res.ok)
+      ++m_stats.failures;
+  }
+  m_stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+batch_edit_file_result batch_edit_runner::process_file(const std::filesystem::path& path, const std::filesystem::path& root, const batch_edit_script& script) const
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  batch_edit_file_result res;
+  res.path = path;
+
+  std::error_code ec;
+  res.bytes = std::filesystem::file_size(path, ec);
+
+  std::filesystem::path tmp_path;
+  try
+  {
+    auto sav = std::make_unique<csav>();
+    // files are already processed in parallel
+    sav->structure_threads = 1;
+    progress_t progress;
+    if (!sav->open_with_progress(path, progress, false, false, false))
+      res.error = "couldn't open the save";
+    else if (!script.apply(*sav, res.error))
+      ; // error set by apply
+    else if (m_opts.dry_run)
+      res.ok = true;
+    else
+    {
+      const std::filesystem::path target = m_opts.out_dir.empty()
+        ? path : m_opts.out_dir / path.lexically_relative(root);
+
+      if (!m_opts.out_dir.empty())
+        std::filesystem::create_directories(target.parent_path());
+
+      // a stale temporary would be backed up by save_stree
+      tmp_path = target;
+      tmp_path += ".tmp~";
+      std::filesystem::remove(tmp_path, ec);
+
+      if (!sav->save_with_progress(tmp_path, progress))
+        res.error = "couldn't write the save";
+      else
+      {
+        if (m_opts.out_dir.empty())
+        {
+          // same backup as the editor's (oldest wins)
+          std::filesystem::path old_path = path;
+          old_path.replace_extension(".old");
+          if (!std::filesystem::exists(old_path))
+            std::filesystem::copy(path, old_path);
+        }
+
+        std::filesystem::rename(tmp_path, target);
+        tmp_path.clear();
+        res.ok = true;
+      }
+    }
+  }
+  catch (std::exception& e)
+  {
+    res.ok = false;
+    res.error = e.what();
+  }
+
+  if (!tmp_path.empty())
+    std::filesystem::remove(tmp_path, ec);
+
+  res.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  return res;
+}
+
+//------------------------------------------------------------------------------
+// inputs
+//------------------------------------------------------------------------------
+
+bool collect_batch_inputs(const std::string& spec, std::vector<std::filesystem::path>& files, std::filesystem::path& root, std::string& err)
+{
+  files.clear();
+  std::error_code ec;
+
+  const std::filesystem::path spec_path = spec;
+  if (!has_wildcard(spec))
+  {
+    if (std::filesystem::is_regular_file(spec_path, ec))
+    {
+      root = spec_path.parent_path();
+      files.push_back(spec_path);
+      return true;
+    }
+
+    if (!std::filesystem::is_directory(spec_path, ec))
+    {
+      err = fmt::format("{} doesn't exist", spec);
+      return false;
+    }
+
+    root = spec_path;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(spec_path, ec))
+    {
+      if (entry.is_regular_file(ec) && entry.path().filename() == "sav.dat")
+        files.push_back(entry.path());
+    }
+  }
+  else
+  {
+    std::vector<std::string> comps;
+    root.clear();
+    for (auto& comp : spec_path)
+    {
+      if (comps.empty() && !has_wildcard(comp.string()))
+        root /= comp;
+      else
+        comps.push_back(comp.string());
+    }
+    if (root.empty())
+      root = ".";
+
+    // at least the file name has a wildcard
+    collect_matches(root, comps, 0, files);
+  }
+
+  if (files.empty())
+  {
+    err = fmt::format("no save found in {}", spec);
+    return false;
+  }
+
+  std::sort(files.begin(), files.end());
+  return true;
+}
+
@@ -0,0 +1,123 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+class csav;
+
+// Edit applied to every save of a batch, parsed from a text script with one
+// operation per line ('#' starts a comment):
+//
+//   unflag-quest-items                   quest items become normal items
+//   set-fact <name|0xhash> <value>       appended to the first table if missing
+//   replace-spawned-vehicles <tdbid>     see CPSData::replace_spawned_vehicles
+//
+// TweakDBIDs are given by name or as 0x-prefixed hex.
+
+enum class batch_edit_op_kind : uint8_t
+{
+  unflag_quest_items,
+  set_fact,
+  replace_spawned_vehicles,
+};
+
+struct batch_edit_op
+{
+  batch_edit_op_kind kind = batch_edit_op_kind::unflag_quest_items;
+  size_t line = 0;
+  std::string arg;
+  uint64_t u64 = 0; // hash, id or value depending on kind
+  uint32_t value = 0;
+};
+
+class batch_edit_script
+{
+protected:
+  std::vector<batch_edit_op> m_ops;
+
+public:
+  batch_edit_script() = default;
+
+  [[nodiscard]] bool parse(const std::string& text, std::string& err);
+  [[nodiscard]] bool load(const std::filesystem::path& path, std::string& err);
+
+  // only modifies the loaded structures, the caller saves
+  [[nodiscard]] bool apply(csav& sav, std::string& err) const;
+
+  const std::vector<batch_edit_op>& ops() const { return m_ops; }
+};
+
+// Runs a script over many saves on a bounded pool: each worker owns a deque of
+// files and steals from the back of the others' when its own is empty, so
+// that a few large saves don't serialize the end of the batch.
+// A worker has a single save open at a time, files are isolated from each
+// other (a failure or exception only fails its file) and results replace the
+// targets atomically (written next to them, then renamed).
+
+struct batch_edit_file_result
+{
+  std::filesystem::path path;
+  bool ok = false;
+  std::string error;
+  uint64_t bytes = 0; // size of the input file
+  double ms = 0;
+};
+
+class batch_edit_runner
+{
+public:
+  struct options_t
+  {
+    size_t thread_cnt = 0; // 0: hardware concurrency
+    // empty: saves are edited in place (the originals are backed up to .old
+    // like the editor does), otherwise results are written under out_dir
+    // with their path relative to the input root
+    std::filesystem::path out_dir;
+    bool dry_run = false; // apply the edits but don't write anything
+  };
+
+  struct stats_t
+  {
+    size_t files = 0;
+    size_t failures = 0;
+    size_t steals = 0;
+    uint64_t bytes = 0;
+    double ms = 0;
+
+    double files_per_s() const { return ms > 0 ? files * 1000.0 / ms : 0; }
+    double mb_per_s() const { return ms > 0 ? bytes / (1024.0 * 1024.0) * 1000.0 / ms : 0; }
+  };
+
+protected:
+  options_t m_opts;
+  std::vector<batch_edit_file_result> m_results;
+  stats_t m_stats;
+  std::atomic<size_t> m_done_cnt = 0;
+
+public:
+  batch_edit_runner() = default;
+
+  explicit batch_edit_runner(const options_t& opts)
+    : m_opts(opts) {}
+
+  // see collect_batch_inputs for root
+  void run(const std::vector<std::filesystem::path>& files, const std::filesystem::path& root, const batch_edit_script& script);
+
+  // can be polled from another thread during run()
+  size_t done_cnt() const { return m_done_cnt.load(); }
+
+  const std::vector<batch_edit_file_result>& results() const { return m_results; }
+  const stats_t& stats() const { return m_stats; }
+
+protected:
+  batch_edit_file_result process_file(const std::filesystem::path& path, const std::filesystem::path& root, const batch_edit_script& script) const;
+};
+
+// spec is either a directory, searched recursively for sav.dat files (the
+// layout of the game's save folders), or a path whose file names may contain
+// '*' and '?' wildcards (e.g. "saves/ManualSave-*/sav.dat").
+// root receives the wildcard-free part of spec.
+[[nodiscard]] bool collect_batch_inputs(const std::string& spec, std::vector<std::filesystem::path>& files, std::filesystem::path& root, std::string& err);
+
@@ -1,5 +1,6 @@
 #pragma once
 #include <inttypes.h>
+#include <cfloat>
 #include <iostream>
 
 #include <cpinternals/cpnames.hpp>
@@ -137,7 +138,8 @@ struct CItemMod // for CItemData kind 0, 2
 
     std::string s;
     reader >> cp_plstring_ref(s);
-    strcpy_s(cn0, s.c_str());
+    strncpy(cn0, s.c_str(), sizeof(cn0) - 1);
+    cn0[sizeof(cn0) - 1] = 0;
     reader >> tdbid1;
 
     size_t cnt = 0;
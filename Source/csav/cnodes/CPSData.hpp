@@ -47,7 +47,7 @@ public:
         auto record = obj->get_prop_cast<CTweakDBIDProperty>("spawnRecordID");
         if (!record)
           return false;
-        record->m_id = tdbid;
+        record->id(tdbid);
       }
 
       return true;
@@ -108,6 +108,10 @@ public:
 
     return writer.finalize(node_name());
   }
+
+  bool is_dirty_impl() const override { return m_sys.is_dirty(); }
+  void clear_dirty_impl() override { m_sys.clear_dirty(); }
+  void drop_original_data_impl() override { m_sys.drop_original_data(); }
 };
 
 
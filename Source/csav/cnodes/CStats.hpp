@@ -161,6 +161,10 @@ public:
 
     return writer.finalize(node_name());
   }
+
+  bool is_dirty_impl() const override { return m_sys.is_dirty(); }
+  void clear_dirty_impl() override { m_sys.clear_dirty(); }
+  void drop_original_data_impl() override { m_sys.drop_original_data(); }
 };
 
 
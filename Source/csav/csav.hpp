@@ -11,6 +11,8 @@
 
 #include <csav/cnodes.hpp>
 #include <csav/serial_tree.hpp>
+#include <csav/reserialization_check.hpp>
+#include <csav/structure_tasks.hpp>
 
 #define XLZ4_CHUNK_SIZE 0x40000
 
@@ -66,21 +68,53 @@ public:
 
   //CGenericSystem            scriptables;
 
+  // started by open_with_progress once the structures are loaded
+  reserialization_checker   reserialization_check;
+
+  // structures are loaded and serialized concurrently on the job_scheduler,
+  // 0 for the whole pool (1 when saves are already processed in parallel by
+  // other threads, see batch_edit)
+  size_t structure_threads = 0;
+
+  // structures that failed to load during the last (re)load, reported once
+  std::vector<structure_task_failure> structure_failures;
+
 protected:
   bool load_stree(std::filesystem::path path, bool dump_decompressed_data=false);
   bool save_stree(std::filesystem::path path, bool dump_decompressed_data=false, bool ps4_weird_format=false);
 
+public:
+  // stages of load_stree and save_stree, also timed separately by the pipeline bench
+
+  // header, node descriptors and chunk descriptors (sorted, with their data offsets)
+  bool read_stree_descs(std::istream& is, std::vector<compressed_chunk_desc>& chunk_descs);
+  // chunks to stree.nodedata
+  bool decompress_stree(std::istream& is, const std::vector<compressed_chunk_desc>& chunk_descs);
+  // stree to root_node
+  bool unflatten_stree(const std::vector<compressed_chunk_desc>& chunk_descs);
+
+  // header and room for the chunk descriptors, the tree is then flattened with
+  // stree.from_node(root_node, chunks_start)
+  bool write_stree_header(std::ostream& os, uint32_t& chunkdescs_start, uint32_t& chunks_start);
+  // stree.nodedata to chunks, then the descriptors and footer
+  bool compress_stree(std::ostream& os, uint32_t chunkdescs_start, bool ps4_weird_format=false);
+
 public:
   // reserialization test can only be done with file saved by the game
   // this is because although the order of the CProperties isn't important for the game
   // we don't want to keep the initial order for each object but rely on a standardized one (blueprint db)
   // the one the game uses
+  // the test runs in background once the save is usable, see reserialization_check
+  // a cancelled opening (progress.cancel()) returns false between stages
   bool open_with_progress(std::filesystem::path path, progress_t& progress, bool dump_decompressed_data=false, bool tree_only=false, bool test=true)
   {
     progress.value = 0.00f;
     if (!load_stree(path, dump_decompressed_data))
       return false;
 
+    if (progress.is_cancelled())
+      return false;
+
     if (tree_only)
     {
       return true;
@@ -88,42 +122,88 @@ public:
     }
 
     progress.value = 0.20f;
+    load_structures(progress);
 
-    progress.comment = "loading game classes definitions";
-    CObjectBPList::get();
-    progress.value = 0.25f;
+    if (progress.is_cancelled())
+      return false;
 
-    try_load_node_data_struct(inventory,    "inventory"                           , progress, 0.30f, test);
-    try_load_node_data_struct(chtrcustom,   "CharacetrCustomization_Appearances"  , progress, 0.35f, test);
+    if (test)
+      start_reserialization_check();
+    
+    return true;
+  }
+
+  // replaces the tree's content with the one of new_root (e.g. a merge result)
+  // and reloads the structures from it, the save is then saved as usual
+  bool assign_root_and_reload(const std::shared_ptr<const node_t>& new_root, progress_t& progress)
+  {
+    if (!root_node || !new_root)
+      return false;
 
-    try_load_node_data_struct(godmode,      "godModeSystem"                       , progress, 0.40f, test);
-    try_load_node_data_struct(factsdb,      "FactsDB"                             , progress, 0.45f, test);
+    // the check reads the structure nodes that are about to be replaced
+    reserialization_check.wait();
 
-    try_load_node_data_struct(scriptables,  "ScriptableSystemsContainer"          , progress, 0.50f, test);
-    try_load_node_data_struct(psdata,       "PSData"                              , progress, 0.80f, test);
+    auto ncroot = std::const_pointer_cast<node_t>(root_node);
+    ncroot->assign_children(new_root->children());
+    ncroot->assign_data(new_root->data());
 
-    try_load_node_data_struct(stats,        "StatsSystem"                         , progress, 0.90f, test);
-    try_load_node_data_struct(statspool,    "StatPoolsSystem"                     , progress, 1.00f, test);
-    
+    load_structures(progress);
     return true;
   }
 
+  // reloads the structures from the tree after it was modified in place
+  // (e.g. restored from its history), their unsaved edits are dropped
+  void reload_structures(progress_t& progress)
+  {
+    reserialization_check.wait();
+    load_structures(progress);
+  }
+
+  // names of the structures edited since they were loaded or saved
+  std::vector<std::string> dirty_structures() const
+  {
+    std::vector<std::string> names;
+    auto add_if_dirty = [&names](const node_serializable& var, std::string_view nodename) {
+      if (var.has_valid_data && var.is_dirty())
+        names.emplace_back(nodename);
+    };
+
+    add_if_dirty(inventory,    "inventory"                           );
+    add_if_dirty(chtrcustom,   "CharacetrCustomization_Appearances"  );
+
+    add_if_dirty(godmode,      "godModeSystem"                       );
+    add_if_dirty(factsdb,      "FactsDB"                             );
+
+    add_if_dirty(scriptables,  "ScriptableSystemsContainer"          );
+    add_if_dirty(psdata,       "PSData"                              );
+
+    add_if_dirty(stats,        "StatsSystem"                         );
+    add_if_dirty(statspool,    "StatPoolsSystem"                     );
+
+    return names;
+  }
+
+  // a cancelled save (progress.cancel()) returns false before the file is written,
+  // the structures serialized so far are kept in the tree
   bool save_with_progress(std::filesystem::path path, progress_t& progress, bool dump_decompressed_data=false, bool ps4_weird_format=false)
   {
     progress.value = 0.00f;
 
-    try_save_node_data_struct(inventory,    "inventory"                             );  progress.value = 0.10f;
-    try_save_node_data_struct(chtrcustom,   "CharacetrCustomization_Appearances"    );  progress.value = 0.15f;
+    // the check reads the structure nodes that are about to be replaced
+    if (reserialization_check.is_running())
+      progress.set_comment("waiting for reserialization check");
+    reserialization_check.wait();
+
+    if (progress.is_cancelled())
+      return false;
 
-    try_save_node_data_struct(godmode,      "godModeSystem"                         );  progress.value = 0.20f;
-    try_save_node_data_struct(factsdb,      "FactsDB"                               );  progress.value = 0.25f;
+    save_structures(progress);
+    progress.value = 0.80f;
 
-    try_save_node_data_struct(scriptables,  "ScriptableSystemsContainer"            );  progress.value = 0.30f;
-    try_save_node_data_struct(psdata,       "PSData"                                );  progress.value = 0.60f;
+    if (progress.is_cancelled())
+      return false;
 
-    try_save_node_data_struct(stats,        "StatsSystem"                           );  progress.value = 0.70f;
-    try_save_node_data_struct(statspool,    "StatPoolsSystem"                       );  progress.value = 0.80f;
-    
+    progress.set_comment("writing file");
 
     if (!save_stree(path, dump_decompressed_data, ps4_weird_format))
       return false;
@@ -132,115 +212,193 @@ public:
   }
 
 protected:
-  bool try_load_node_data_struct(node_serializable& var, std::string_view nodename, progress_t& progress, float end_progress, bool test=false)
+  void load_structures(progress_t& progress)
+  {
+    progress.set_comment("loading game classes definitions");
+    CObjectBPList::get();
+    progress.value = 0.25f;
+
+    std::vector<structure_task> tasks;
+
+    add_load_task(tasks, inventory,    "inventory"                           );
+    add_load_task(tasks, chtrcustom,   "CharacetrCustomization_Appearances"  );
+
+    add_load_task(tasks, godmode,      "godModeSystem"                       );
+    add_load_task(tasks, factsdb,      "FactsDB"                             );
+
+    add_load_task(tasks, scriptables,  "ScriptableSystemsContainer"          );
+    add_load_task(tasks, psdata,       "PSData"                              );
+
+    add_load_task(tasks, stats,        "StatsSystem"                         );
+    add_load_task(tasks, statspool,    "StatPoolsSystem"                     );
+
+    structure_failures = run_structure_tasks(std::move(tasks), structure_threads, progress, 0.25f, 1.f, "Loading");
+    if (structure_failures.size() && !progress.is_cancelled())
+      report_error("error", fmt::format("couldn't load some nodes\n{}", format_structure_failures(structure_failures)));
+  }
+
+  // each structure only reads its own node subtree
+  void add_load_task(std::vector<structure_task>& tasks, node_serializable& var, std::string_view nodename)
   {
     auto node = search_node(nodename);
     if (!node)
+      return;
+
+    tasks.push_back({node->name(), node->calcsize(), [this, node, &var](std::string& error) {
+      if (var.from_node(node, ver))
+        return true;
+      error = "couldn't be loaded";
       return false;
+    }});
+  }
+
+  void start_reserialization_check()
+  {
+    std::vector<reserialization_checker::check_fn_t> checks;
 
-    bool ok = false;
+    add_reserialization_check(checks, inventory,    "inventory"                           );
+    add_reserialization_check(checks, chtrcustom,   "CharacetrCustomization_Appearances"  );
 
-    progress.comment.assign(fmt::format("Loading node {}", node->name()));
-    if (load_node_data_struct(node, var))
+    add_reserialization_check(checks, godmode,      "godModeSystem"                       );
+    add_reserialization_check(checks, factsdb,      "FactsDB"                             );
+
+    add_reserialization_check(checks, scriptables,  "ScriptableSystemsContainer"          );
+    add_reserialization_check(checks, psdata,       "PSData"                              );
+
+    add_reserialization_check(checks, stats,        "StatsSystem"                         );
+    add_reserialization_check(checks, statspool,    "StatPoolsSystem"                     );
+
+    reserialization_check.start(std::move(checks));
+  }
+
+  template <typename T>
+  void add_reserialization_check(std::vector<reserialization_checker::check_fn_t>& checks, const T& var, std::string_view nodename)
+  {
+    if (!var.has_valid_data)
+      return;
+
+    auto node = search_node(nodename);
+    if (!node)
+      return;
+
+    checks.emplace_back([node, ver = ver]() {
+      return test_reserialize<T>(node, ver);
+    });
+  }
+
+  // works on its own instance of the structure so that the loaded one
+  // stays editable while the test runs
+  template <typename T>
+  static reserialization_checker::result_t test_reserialize(const std::shared_ptr<const node_t>& node, const csav_version& ver)
+  {
+    reserialization_checker::result_t res;
+    res.node_name = node->name();
+
+    try
     {
-      if (test)
+      T var;
+      if (!var.from_node(node, ver))
+      {
+        res.error = "couldn't be reloaded";
+        return res;
+      }
+
+      var.drop_original_data();
+      auto new_node = var.to_node(ver);
+      if (!new_node)
       {
-        progress.value = 0.5f * (end_progress + progress.value);
-        progress.comment.assign(fmt::format("Testing reserialization of node {}", node->name()));
-        if (test_reserialize(node, var))
-          ok = true;
+        res.error = "couldn't be reserialized";
+        return res;
       }
-      else
+
+      if (!compare_flattened_nodes(*node, *new_node, res.mismatch))
       {
-        ok = true;
+        dump_flattened_node(*node, fmt::format("dump_{}_orig.bin", res.node_name));
+        dump_flattened_node(*new_node, fmt::format("dump_{}_reserialized.bin", res.node_name));
+        res.error = fmt::format("differs from original at offset {:#x} (in {})",
+          res.mismatch.offset, res.mismatch.node_path);
+        return res;
       }
     }
+    catch (std::exception& e)
+    {
+      res.error = e.what();
+      return res;
+    }
 
-    progress.value = end_progress;
-    return ok;
+    res.ok = true;
+    return res;
   }
 
-  bool test_reserialize(const std::shared_ptr<const node_t>& node, node_serializable& var)
+  struct pending_save
   {
-    auto new_node = var.to_node(ver);
-    if (!new_node)
-      return false;
-
-    serial_tree stree1, stree2;
+    node_serializable* var;
+    std::shared_ptr<const node_t> node;
+    std::shared_ptr<const node_t> new_node;
+  };
+
+  // the dirty structures are serialized concurrently into detached nodes,
+  // which are then swapped into the tree by the calling thread only
+  void save_structures(progress_t& progress)
+  {
+    std::vector<pending_save> pending;
 
-    {
-      auto root = node_t::create_shared(node_t::root_node_idx, "root");
-      root->nonconst().children_push_back(node);
-      stree1.from_node(root, 4);
-    }
-    {
-      auto root = node_t::create_shared(node_t::root_node_idx, "root");
-      root->nonconst().children_push_back(new_node);
-      stree2.from_node(root, 4);
-    }
+    add_pending_save(pending, inventory,    "inventory"                             );
+    add_pending_save(pending, chtrcustom,   "CharacetrCustomization_Appearances"    );
 
-    if (stree1.nodedata.size() != stree2.nodedata.size()
-      || std::memcmp(stree1.nodedata.data(), stree2.nodedata.data(), stree1.nodedata.size()))
-    {
-      std::ofstream ofs;
-      ofs.open(fmt::format("dump_{}_orig.bin", node->name()));
-      ofs.write(stree1.nodedata.data(), stree1.nodedata.size());
-      ofs.close();
-      ofs.open(fmt::format("dump_{}_reserialized.bin", node->name()));
-      ofs.write(stree2.nodedata.data(), stree2.nodedata.size());
-      ofs.close();
-
-      // it's easier to call this atm than the GUI's error box
-      MessageBoxA(
-        0,
-        fmt::format(
-          "Reserialized \"{}\" node differs from original\n"
-          "\n"
-          "If your save has been edited with an older version of CPSE,\n"
-          "please make the game save it again.\n"
-          "\n"
-          "Otherwise, please open an issue.",
-          node->name()
-        ).c_str(), 
-        "Reserialization test failed.",
-        0);
+    add_pending_save(pending, godmode,      "godModeSystem"                         );
+    add_pending_save(pending, factsdb,      "FactsDB"                               );
 
-      return false;
-    }
+    add_pending_save(pending, scriptables,  "ScriptableSystemsContainer"            );
+    add_pending_save(pending, psdata,       "PSData"                                );
 
-    return true;
-  }
+    add_pending_save(pending, stats,        "StatsSystem"                           );
+    add_pending_save(pending, statspool,    "StatPoolsSystem"                       );
 
-  bool load_node_data_struct(const std::shared_ptr<const node_t>& node, node_serializable& var)
-  {
-    try
+    std::vector<structure_task> tasks;
+    tasks.reserve(pending.size());
+    for (auto& ps : pending)
     {
-      if (!var.from_node(node, ver))
+      tasks.push_back({ps.node->name(), ps.node->calcsize(), [this, &ps](std::string& error) {
+        ps.new_node = ps.var->to_node(ver);
+        if (ps.new_node)
+          return true;
+        error = "couldn't be serialized";
         return false;
+      }});
     }
-    catch (std::exception& e)
+
+    auto failures = run_structure_tasks(std::move(tasks), structure_threads, progress, 0.f, 0.80f, "Serializing");
+
+    // commit, failed structures keep their original node subtree
+    for (auto& ps : pending)
     {
-      MessageBoxA(0, fmt::format("couldn't load node {}\nreason: {}", node->name(), e.what()).c_str(), "error", 0);
-      return false;
+      if (!ps.new_node)
+        continue;
+
+      auto ncnode = std::const_pointer_cast<node_t>(ps.node);
+      ncnode->assign_children(ps.new_node->children());
+      ncnode->assign_data(ps.new_node->data());
+
+      ps.var->clear_dirty();
     }
 
-    return true;
+    if (failures.size() && !progress.is_cancelled())
+      report_error("error", fmt::format("couldn't save some nodes, their original content is kept\n{}", format_structure_failures(failures)));
   }
 
-  bool try_save_node_data_struct(node_serializable& var, std::string_view nodename)
+  void add_pending_save(std::vector<pending_save>& pending, node_serializable& var, std::string_view nodename)
   {
     auto node = search_node(nodename);
     if (!node)
-      return false;
-    auto new_node = var.to_node(ver);
-    if (!new_node)
-      return false;
+      return;
 
-    auto ncnode = std::const_pointer_cast<node_t>(node);
-    ncnode->assign_children(new_node->children());
-    ncnode->assign_data(new_node->data());
+    // unmodified structures keep their original node subtree,
+    // as do the ones that couldn't be loaded
+    if (!var.is_dirty() || !var.has_valid_data)
+      return;
 
-    return true;
+    pending.push_back({&var, node, nullptr});
   }
 
 
@@ -3,6 +3,7 @@
 #include <list>
 #include <array>
 #include <set>
+#include <mutex>
 #include <exception>
 #include <stdexcept>
 
@@ -58,6 +59,8 @@ class CObject
 protected:
   std::vector<field_t> m_fields;
   CObjectBPSPtr m_blueprint;
+  // edited since last serialize_in or clear_dirty()
+  bool m_is_dirty = true;
 
 public:
   CObject(CSysName ctypename, bool delay_fields_init=false)
@@ -99,6 +102,14 @@ public:
     return nullptr;
   }
 
+  // fn(field_name, prop) for each field, in blueprint order
+  template <typename Fn>
+  void for_each_field(Fn&& fn) const
+  {
+    for (auto& field : m_fields)
+      fn(field.name, field.prop.get());
+  }
+
 protected:
   void clear_fields()
   {
@@ -127,6 +138,7 @@ protected:
   };
 
   static inline std::set<std::string> to_implement_ctypenames;
+  static inline std::mutex to_implement_ctypenames_mtx;
 
   // todo move inside field struct
   [[nodiscard]] bool serialize_field(field_t& field, std::istream& is, CSystemSerCtx& serctx, bool eof_is_end_of_prop = false)
@@ -156,7 +168,10 @@ protected:
       is.setstate(std::ios_base::badbit);
     }
 
-    to_implement_ctypenames.emplace(std::string(prop->ctypename().str()));
+    {
+      std::lock_guard<std::mutex> lk(to_implement_ctypenames_mtx);
+      to_implement_ctypenames.emplace(std::string(prop->ctypename().str()));
+    }
 
     // try fall-back
     if (!is_unknown_prop && eof_is_end_of_prop)
@@ -202,7 +217,10 @@ public:
     uint16_t serial_fields_cnt = 0;
     is >> cbytes_ref(serial_fields_cnt);
     if (serial_fields_cnt < 1)
+    {
+      m_is_dirty = false;
       return true;
+    }
 
     // field descriptors
     std::vector<serial_field_desc_t> serial_descs(serial_fields_cnt);
@@ -344,6 +362,8 @@ public:
 
     serctx.log(fmt::format("serialized_in CObject {} in {} bytes", this->ctypename().str(), (size_t)(end_pos - start_pos)));
 
+    // nested objects' events during serialization don't count as edits
+    m_is_dirty = false;
     post_cobject_event(EObjectEvent::data_modified);
     return true;
   }
@@ -532,10 +552,17 @@ protected:
 
   void on_cproperty_event(const CProperty& prop, EPropertyEvent evt) override
   {
+    if (evt == EPropertyEvent::data_edited)
+      m_is_dirty = true;
     post_cobject_event(EObjectEvent::data_modified);
   }
 
 public:
+  // dirty tracking (edits of nested objects propagate here through their property)
+
+  bool is_dirty() const { return m_is_dirty; }
+  void clear_dirty() { m_is_dirty = false; }
+
   // provided as const for ease of use
 
   void add_listener(CObjectListener* listener) const
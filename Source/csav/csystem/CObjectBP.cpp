@@ -1,7 +1,7 @@
 #pragma once
 #include "CObjectBP.hpp"
 
-#include <Windows.h>
+#include <utils.hpp>
 #include <fstream>
 #include <sstream>
 #include <nlohmann/json.hpp>
@@ -60,7 +60,7 @@ CObjectBPSPtr read_class_bp(std::unordered_map<CSysName, CObjectBPSPtr>& classma
     if (parent_it == j.end())
     {
       auto err = fmt::format("Incomplete DB, {} is missing parent def {}", ctypename.str(), parent_name);
-      MessageBoxA(0, err.c_str(), "CObjectBPList Error", 0);
+      report_error("CObjectBPList Error", err);
       throw std::runtime_error(err);
     }
     parent = read_class_bp(classmap, j, parent_it);
@@ -96,15 +96,12 @@ CObjectBPList::CObjectBPList()
     }
     catch (std::exception& e)
     {
-      std::wostringstream oss;
-      oss << L"db/CObjectBPs.json has unexpected content" << std::endl;
-      oss << e.what();
-      MessageBox(0, oss.str().c_str(), L"corrupt resource file", 0);
+      report_error("corrupt resource file", fmt::format("db/CObjectBPs.json has unexpected content\n{}", e.what()));
     }
   }
   else
   {
-    MessageBox(0, L"db/CEnums.json is missing", L"couldn't open resource file", 0);
+    report_error("missing resource file", "db/CObjectBPs.json is missing");
   }
 }
 
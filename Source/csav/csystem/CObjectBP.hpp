@@ -8,6 +8,8 @@
 #include <set>
 #include <unordered_map>
 #include <algorithm>
+#include <mutex>
+#include <shared_mutex>
 #include <fmt/format.h>
 #include <utils.hpp>
 #include <nlohmann/json.hpp>
@@ -35,13 +37,13 @@ class CFieldBP
 {
   CFieldDesc m_desc;
 
-  std::function<CPropertyUPtr(CPropertyOwner*)> m_prop_creator;
+  CPropertyCreator m_prop_creator;
 
 public:
   CFieldBP(CFieldDesc desc)
     : m_desc(desc)
+    , m_prop_creator(CPropertyFactory::get().get_creator(desc.ctypename))
   {
-    m_prop_creator = CPropertyFactory::get().get_creator(desc.ctypename);
   }
 
   CFieldDesc desc() const { return m_desc; }
@@ -49,7 +51,7 @@ public:
   CSysName name() const { return m_desc.name; }
   CSysName ctypename() const { return m_desc.ctypename; }
 
-  CPropertyUPtr create_prop(CPropertyOwner* owner) const { return std::move(m_prop_creator(owner)); }
+  CPropertyUPtr create_prop(CPropertyOwner* owner) const { return m_prop_creator(owner); }
 };
 
 
@@ -96,6 +98,7 @@ class CObjectBPList
 {
 private:
   std::unordered_map<CSysName, CObjectBPSPtr> m_classmap;
+  mutable std::shared_mutex m_classmap_mtx;
 
   // filtered lists
 
@@ -116,11 +119,37 @@ public:
   // always returns a class, so that unknown ones can be configured
   CObjectBPSPtr get_or_make_bp(CSysName objtype)
   {
-    auto it = m_classmap.find(objtype);
-    if (it != m_classmap.end())
-      return it->second;
-    it = m_classmap.emplace(objtype, std::make_shared<CObjectBP>(objtype)).first;
+    {
+      std::shared_lock<std::shared_mutex> lk(m_classmap_mtx);
+      auto it = m_classmap.find(objtype);
+      if (it != m_classmap.end())
+        return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lk(m_classmap_mtx);
+    // emplace doesn't replace a bp made by another thread in between
+    auto it = m_classmap.emplace(objtype, std::make_shared<CObjectBP>(objtype)).first;
     return it->second;
   }
+
+  // all known classes, sorted by name so that the order doesn't depend on the
+  // order in which names entered the global pool
+  std::vector<CObjectBPSPtr> sorted_bps() const
+  {
+    std::vector<std::pair<std::string, CObjectBPSPtr>> named;
+    {
+      std::shared_lock<std::shared_mutex> lk(m_classmap_mtx);
+      named.reserve(m_classmap.size());
+      for (auto& [name, bp] : m_classmap)
+        named.emplace_back(name.str(), bp);
+    }
+    std::sort(named.begin(), named.end(),
+      [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    std::vector<CObjectBPSPtr> bps;
+    bps.reserve(named.size());
+    for (auto& [name, bp] : named)
+      bps.push_back(bp);
+    return bps;
+  }
 };
 
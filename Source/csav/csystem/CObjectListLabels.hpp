@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <fmt/format.h>
+#include <csav/csystem/CObject.hpp>
+
+// Labels of an object list, kept between frames: a label is formatted the
+// first time its row is visible and again only after its object posted an
+// event. The list is compared with its snapshot every frame, a different
+// list (addition, removal, another system) drops every label.
+// Copies start empty, the listener registrations aren't shared.
+class CObjectListLabels
+  : public CObjectListener
+{
+  std::vector<CObjectSPtr> m_objects; // snapshot the labels refer to
+  std::vector<std::string> m_labels; // empty: to be formatted
+  std::unordered_map<const CObject*, size_t> m_indices;
+
+public:
+  CObjectListLabels() = default;
+  CObjectListLabels(const CObjectListLabels&) {}
+  CObjectListLabels& operator=(const CObjectListLabels&) { clear(); return *this; }
+  ~CObjectListLabels() override { clear(); }
+
+  void sync(const std::vector<CObjectSPtr>& objects)
+  {
+    if (m_objects == objects)
+      return;
+
+    clear();
+    m_objects = objects;
+    m_labels.resize(m_objects.size());
+    m_indices.reserve(m_objects.size());
+    for (size_t i = 0; i < m_objects.size(); ++i)
+    {
+      m_objects[i]->add_listener(this);
+      m_indices.emplace(m_objects[i].get(), i);
+    }
+  }
+
+  // idx must be valid in the last synced list
+  const std::string& label(size_t idx)
+  {
+    auto& lbl = m_labels[idx];
+    if (lbl.empty())
+    {
+      auto name = m_objects[idx]->ctypename().str();
+      if (name.empty())
+        name = "*Unknown item*";
+      lbl = fmt::format("{:>3d} {}", idx, name);
+    }
+    return lbl;
+  }
+
+  void clear()
+  {
+    for (auto& obj : m_objects)
+      obj->remove_listener(this);
+    m_objects.clear();
+    m_labels.clear();
+    m_indices.clear();
+  }
+
+  void on_cobject_event(const CObject& obj, EObjectEvent evt) override
+  {
+    auto it = m_indices.find(&obj);
+    if (it != m_indices.end())
+      m_labels[it->second].clear();
+  }
+};
+
@@ -17,6 +17,7 @@
 #include <csav/csystem/CPropertyFactory.hpp>
 #include <csav/csystem/CObject.hpp>
 #include <widgets/cpinternals.hpp>
+#include <imgui_extras/cpp_imgui.hpp>
 
 //------------------------------------------------------------------------------
 // BOOL
@@ -104,193 +105,213 @@ enum class EIntKind
   U64, I64,
 };
 
+template <EIntKind IntKind>
+struct CIntKindTraits;
+
+#define CINTKIND_TRAITS(kind, type, name, hexfmt)                   \
+  template <> struct CIntKindTraits<EIntKind::kind>                 \
+  {                                                                 \
+    using value_type = type;                                        \
+    static constexpr const char* ctypename = name;                  \
+    static constexpr const char* hex_format = hexfmt;               \
+  };
+
+CINTKIND_TRAITS(U8,  uint8_t,  "Uint8",  "%02X")
+CINTKIND_TRAITS(I8,  int8_t,   "Int8",   "%02X")
+CINTKIND_TRAITS(U16, uint16_t, "Uint16", "%04X")
+CINTKIND_TRAITS(I16, int16_t,  "Int16",  "%04X")
+CINTKIND_TRAITS(U32, uint32_t, "Uint32", "%08X")
+CINTKIND_TRAITS(I32, int32_t,  "Int32",  "%08X")
+CINTKIND_TRAITS(U64, uint64_t, "Uint64", "%016llX")
+CINTKIND_TRAITS(I64, int64_t,  "Int64",  "%016llX")
+
+#undef CINTKIND_TRAITS
+
+// common interface of all integer properties, the value itself lives in
+// CIntPropertyT<> so that each instance only stores its own width.
 class CIntProperty
   : public CProperty
 {
 protected:
-  union 
-  {
-    uint8_t  u8;
-    int8_t   i8;
-    uint16_t u16;
-    int16_t  i16;
-    uint32_t u32;
-    int32_t  i32;
-    uint64_t u64;
-    int64_t  i64 = 0;
-  }
-  m_value;
-
-protected:
-  const EIntKind m_int_kind;
-  const size_t m_int_size;
-  CSysName m_ctypename;
-
-public:
-  CIntProperty(CPropertyOwner* owner, EIntKind int_kind)
+  CIntProperty(CPropertyOwner* owner)
     : CProperty(owner, EPropertyKind::Integer)
-    , m_int_kind(int_kind)
-    , m_int_size(int_size(int_kind))
-    , m_ctypename(int_ctypename(int_kind))
   {
   }
 
-  ~CIntProperty() override = default;
-
 public:
-  EIntKind int_kind() const { return m_int_kind; }
+  ~CIntProperty() override = default;
 
 public:
-  
-  static inline size_t int_size(EIntKind int_kind)
-  {
-    switch (int_kind)
-    {
-      case EIntKind::U8:
-      case EIntKind::I8: return 1;
-      case EIntKind::U16:
-      case EIntKind::I16: return 2;
-      case EIntKind::U32:
-      case EIntKind::I32: return 4;
-      case EIntKind::U64:
-      case EIntKind::I64: return 8;
-      default: break;
-    }
-    throw std::domain_error("unknown EIntKind");
-  }
+  virtual EIntKind int_kind() const = 0;
+  virtual size_t int_size() const = 0;
 
-  static inline std::string int_ctypename(EIntKind int_kind)
-  {
-    switch (int_kind)
-    {
-      case EIntKind::U8: return "Uint8";
-      case EIntKind::I8: return "Int8";
-      case EIntKind::U16: return "Uint16";
-      case EIntKind::I16: return "Int16";
-      case EIntKind::U32: return "Uint32";
-      case EIntKind::I32: return "Int32";
-      case EIntKind::U64: return "Uint64";
-      case EIntKind::I64: return "Int64";
-      default: break;
-    }
-    throw std::domain_error("unknown EIntKind");
-  };
+  // zero-extended value, whatever the width
+  uint64_t u64() const { return get_u64(); }
+  uint32_t u32() const { return static_cast<uint32_t>(get_u64()); }
+  uint16_t u16() const { return static_cast<uint16_t>(get_u64()); }
+  uint8_t u8() const { return static_cast<uint8_t>(get_u64()); }
 
-  uint64_t u64() const { return m_value.u64; }
-  uint32_t u32() const { return m_value.u32; }
-  uint16_t u16() const { return m_value.u16; }
-  uint8_t u8() const { return m_value.u8; }
-
-  // todo: template this class..
+  // truncated to the property's width
 
   void u64(uint64_t value)
   {
     // whatever happens.. because we don't really know the default values
     post_cproperty_event(EPropertyEvent::data_edited);
-    m_value.u64 = value;
-
+    set_u64(value);
   }
 
-  void u32(uint32_t value)
-  {
-    // whatever happens.. because we don't really know the default values
-    post_cproperty_event(EPropertyEvent::data_edited);
-    m_value.u32 = value;
-  }
+  void u32(uint32_t value) { u64(value); }
+  void u16(uint16_t value) { u64(value); }
+  void u8(uint8_t value) { u64(value); }
 
-  void u16(uint16_t value)
+protected:
+  virtual uint64_t get_u64() const = 0;
+  virtual void set_u64(uint64_t value) = 0;
+};
+
+template <EIntKind IntKind>
+class CIntPropertyT
+  : public CIntProperty
+{
+public:
+  using traits = CIntKindTraits<IntKind>;
+  using value_type = typename traits::value_type;
+  using uvalue_type = std::make_unsigned_t<value_type>;
+
+  static constexpr EIntKind kind = IntKind;
+  static constexpr size_t size = sizeof(value_type);
+
+protected:
+  value_type m_value = 0;
+
+public:
+  CIntPropertyT(CPropertyOwner* owner)
+    : CIntProperty(owner)
   {
-    // whatever happens.. because we don't really know the default values
-    post_cproperty_event(EPropertyEvent::data_edited);
-    m_value.u16 = value;
   }
 
-  void u8(uint8_t value)
+  ~CIntPropertyT() override = default;
+
+public:
+  value_type value() const { return m_value; }
+
+  void value(value_type value)
   {
     // whatever happens.. because we don't really know the default values
     post_cproperty_event(EPropertyEvent::data_edited);
-    m_value.u8 = value;
+    m_value = value;
   }
 
   // overrides
 
+  EIntKind int_kind() const override { return IntKind; }
+  size_t int_size() const override { return size; }
+
   CSysName ctypename() const override
   {
-    return m_ctypename;
+    static CSysName sname(traits::ctypename);
+    return sname;
   }
 
   bool serialize_in_impl(std::istream& is, CSystemSerCtx& serctx) override
   {
-    is.read((char*)&m_value.u64, m_int_size);
+    is >> cbytes_ref(m_value);
     return is.good();
   }
 
   virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
-    os.write((char*)&m_value.u64, m_int_size);
+    os << cbytes_ref(m_value);
     return true;
   }
 
+protected:
+  uint64_t get_u64() const override
+  {
+    return static_cast<uvalue_type>(m_value);
+  }
+
+  void set_u64(uint64_t value) override
+  {
+    m_value = static_cast<value_type>(value);
+  }
+
 #ifndef DISABLE_CP_IMGUI_WIDGETS
 
+public:
   [[nodiscard]] bool imgui_widget_impl(const char* label, bool editable) override
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
       return false;
 
-    //auto label = ctypename() + "##CIntProperty";
-    ImGuiDataType dtype = ImGuiDataType_U64;
-    auto dfmt = "%016X";
-
-    switch (m_int_kind)
-    {
-      case EIntKind::U8:  dtype = ImGuiDataType_U8;  dfmt = "%02X";  break;
-      case EIntKind::I8:  dtype = ImGuiDataType_U8;  dfmt = "%02X";  break;
-      case EIntKind::U16: dtype = ImGuiDataType_U16; dfmt = "%04X";  break;
-      case EIntKind::I16: dtype = ImGuiDataType_U16; dfmt = "%04X";  break;
-      case EIntKind::U32: dtype = ImGuiDataType_U32; dfmt = "%08X";  break;
-      case EIntKind::I32: dtype = ImGuiDataType_U32; dfmt = "%08X";  break;
-      case EIntKind::U64: dtype = ImGuiDataType_U64; dfmt = "%016X"; break;
-      case EIntKind::I64: dtype = ImGuiDataType_U64; dfmt = "%016X"; break;
-      default: break;
-    }
-
-    return ImGui::InputScalar(label, dtype, &m_value.u64, 0, 0, dfmt,
+    // displayed as unsigned hex, like the raw bytes
+    return ImGui::InputScalar(label, imgui_datatype_of<uvalue_type>::value, &m_value, 0, 0, traits::hex_format,
       ImGuiInputTextFlags_CharsHexadecimal | (editable ? 0 : ImGuiInputTextFlags_ReadOnly));
   }
 
 #endif
 };
 
+using CUint8Property  = CIntPropertyT<EIntKind::U8>;
+using CInt8Property   = CIntPropertyT<EIntKind::I8>;
+using CUint16Property = CIntPropertyT<EIntKind::U16>;
+using CInt16Property  = CIntPropertyT<EIntKind::I16>;
+using CUint32Property = CIntPropertyT<EIntKind::U32>;
+using CInt32Property  = CIntPropertyT<EIntKind::I32>;
+using CUint64Property = CIntPropertyT<EIntKind::U64>;
+using CInt64Property  = CIntPropertyT<EIntKind::I64>;
+
 //------------------------------------------------------------------------------
 // FLOATING POINT
 //------------------------------------------------------------------------------
 
-class CFloatProperty
+template <typename FloatType>
+struct CFloatTypeTraits;
+
+template <> struct CFloatTypeTraits<float>
+{
+  static constexpr EPropertyKind kind = EPropertyKind::Float;
+  static constexpr const char* ctypename = "Float";
+};
+
+template <> struct CFloatTypeTraits<double>
+{
+  static constexpr EPropertyKind kind = EPropertyKind::Double;
+  static constexpr const char* ctypename = "Double";
+};
+
+template <typename FloatType>
+class CFloatPropertyT
   : public CProperty
 {
+public:
+  using traits = CFloatTypeTraits<FloatType>;
+  using value_type = FloatType;
+
+  static constexpr size_t size = sizeof(value_type);
+
 protected:
-  float m_value = 0.f;
+  value_type m_value = 0;
 
 public:
-  CFloatProperty(CPropertyOwner* owner)
-    : CProperty(owner, EPropertyKind::Float) {}
+  CFloatPropertyT(CPropertyOwner* owner)
+    : CProperty(owner, traits::kind) {}
 
-  ~CFloatProperty() override = default;
+  ~CFloatPropertyT() override = default;
 
 public:
   // overrides
 
   CSysName ctypename() const override
   {
-    static CSysName sname("Float");
+    static CSysName sname(traits::ctypename);
     return sname;
   };
 
-  float value() const { return m_value; }
+  value_type value() const { return m_value; }
 
-  void set_value(float value)
+  void set_value(value_type value)
   {
     // whatever happens.. because we don't really know the default values
     post_cproperty_event(EPropertyEvent::data_edited);
@@ -317,12 +338,15 @@ public:
     if (window->SkipItems)
       return false;
 
-    return ImGui::InputFloat(label, &m_value, 0, 0, "%.3f", editable ? 0 : ImGuiInputTextFlags_ReadOnly);
+    return ImGui::InputScalar(label, imgui_datatype_of<value_type>::value, &m_value, 0, 0, "%.3f",
+      editable ? 0 : ImGuiInputTextFlags_ReadOnly);
   }
 
 #endif
 };
 
+using CFloatProperty  = CFloatPropertyT<float>;
+using CDoubleProperty = CFloatPropertyT<double>;
 
 //------------------------------------------------------------------------------
 // ARRAY (fixed len)
@@ -345,17 +369,21 @@ protected:
   // CName ids too.. but that's for later
   CSysName m_elt_ctypename;
   CSysName m_typename;
-  std::function<CPropertyUPtr(CPropertyOwner*)> m_elt_create_fn;
+  CPropertyCreator m_elt_create_fn;
+
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  // measured by the widget, only the visible elements are drawn
+  std::vector<float> m_row_heights;
+#endif
 
 public:
   CArrayProperty(CPropertyOwner* owner, CSysName elt_ctypename, size_t size)
     : CProperty(owner, EPropertyKind::DynArray)
     , m_elt_ctypename(elt_ctypename)
     , m_typename(fmt::format("[{}]{}", size, elt_ctypename.str()))
+    , m_elt_create_fn(CPropertyFactory::get().get_creator(elt_ctypename))
   {
     m_elts.resize(size);
-    auto& factory = CPropertyFactory::get();
-    m_elt_create_fn = factory.get_creator(elt_ctypename);
     for (auto& elt : m_elts)
     {
       // todo: use clone on first instance..
@@ -402,7 +430,7 @@ public:
     return is.good();
   }
 
-  virtual [[nodiscard]] bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
+  [[nodiscard]] virtual bool serialize_out(std::ostream& os, CSystemSerCtx& serctx) const
   {
     size_t start_pos = os.tellp();
 
@@ -431,7 +459,8 @@ public:
 
     bool modified = false;
 
-    static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV;
+    static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV
+      | ImGuiTableFlags_ScrollY;
 
     ImVec2 size = ImVec2(-FLT_MIN, std::min(400.f, ImGui::GetContentRegionAvail().y));
     if (ImGui::BeginTable(label, 2, tbl_flags, size))
@@ -441,28 +470,31 @@ public:
       ImGui::TableSetupColumn("value", ImGuiTableColumnFlags_WidthStretch);
       ImGui::TableHeadersRow();
 
-      size_t idx = 0;
       int to_rem = -1;
-      for (auto& elt : m_elts)
+      ImGui::TableRowsClipper clipper(m_row_heights, (int)m_elts.size());
+      for (int idx = clipper.DisplayStart; idx < clipper.DisplayEnd; ++idx)
       {
+        scoped_imgui_id _sii(idx);
+
+        auto& elt = m_elts[idx];
+
         auto lbl = fmt::format("{:03d}", idx);
 
-        ImGui::TableNextRow();
+        clipper.NextRow();
         ImGui::TableNextColumn();
         ImGui::Text(lbl.c_str());
         if (editable && ImGui::BeginPopupContextItem("item context menu"))
         {
           if (ImGui::Selectable("^ delete"))
-            to_rem = (int)idx;
+            to_rem = idx;
           ImGui::EndPopup();
         }
 
         ImGui::TableNextColumn();
 
         modified |= elt->imgui_widget(lbl.c_str(), editable);
-
-        ++idx;
       }
+      clipper.End();
 
       if (to_rem >= 0)
       {
@@ -509,16 +541,20 @@ protected:
   // CName ids too.. but that's for later
   CSysName m_elt_ctypename;
   CSysName m_ctypename;
-  std::function<CPropertyUPtr(CPropertyOwner*)> m_elt_create_fn;
+  CPropertyCreator m_elt_create_fn;
+
+#ifndef DISABLE_CP_IMGUI_WIDGETS
+  // measured by the widget, only the visible elements are drawn
+  std::vector<float> m_row_heights;
+#endif
 
 public:
   CDynArrayProperty(CPropertyOwner* owner, CSysName elt_ctypename)
     : CProperty(owner, EPropertyKind::DynArray)
     , m_elt_ctypename(elt_ctypename)
     , m_ctypename(std::string("array:") + elt_ctypename.str())
+    , m_elt_create_fn(CPropertyFactory::get().get_creator(elt_ctypename))
   {
-    auto& factory = CPropertyFactory::get();
-    m_elt_create_fn = factory.get_creator(elt_ctypename);
   }
 
 public:
@@ -590,7 +626,8 @@ public:
 
     bool modified = false;
 
-    static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV;
+    static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV
+      | ImGuiTableFlags_ScrollY;
 
     ImVec2 size = ImVec2(-FLT_MIN, std::min(400.f, ImGui::GetContentRegionAvail().y));
     if (ImGui::BeginTable(label, 2, tbl_flags, size))
@@ -602,15 +639,16 @@ public:
 
       int to_rem = -1;
       int to_ins = -1;
-      for (size_t idx = 0; idx < m_elts.size(); ++idx)
+      ImGui::TableRowsClipper clipper(m_row_heights, (int)m_elts.size());
+      for (int idx = clipper.DisplayStart; idx < clipper.DisplayEnd; ++idx)
       {
-        scoped_imgui_id _sii((int)idx);
+        scoped_imgui_id _sii(idx);
 
         auto& elt = m_elts[idx];
 
         auto lbl = fmt::format("{:03d}", idx);
 
-        ImGui::TableNextRow();
+        clipper.NextRow();
         ImGui::TableNextColumn();
 
         ImGui::Text(lbl.c_str());
@@ -630,7 +668,7 @@ public:
           ImGui::SameLine();
           if (ImGui::ArrowButton("down", ImGuiDir_Down))
           {
-            if (idx + 1 < m_elts.size())
+            if ((size_t)idx + 1 < m_elts.size())
             {
               size_t next = idx + 1;
               std::swap(m_elts[idx], m_elts[next]);
@@ -639,15 +677,16 @@ public:
           }
           ImGui::PopStyleVar();
           if (editable && ImGui::SmallButton("delete"))
-            to_rem = (int)idx;
+            to_rem = idx;
 
           if (editable && ImGui::SmallButton("insert"))
-            to_ins = (int)idx;
+            to_ins = idx;
         }
 
         ImGui::TableNextColumn();
         modified |= elt->imgui_widget(lbl.c_str(), editable);
       }
+      clipper.End();
 
       if (m_elts.empty())
       {
@@ -906,6 +945,15 @@ public:
   ~CTweakDBIDProperty() override = default;
 
 public:
+  TweakDBID id() const { return m_id; }
+
+  void id(TweakDBID id)
+  {
+    // whatever happens.. because we don't really know the default values
+    post_cproperty_event(EPropertyEvent::data_edited);
+    m_id = id;
+  }
+
   // overrides
 
   CSysName ctypename() const override
@@ -954,6 +1002,16 @@ public:
 
   ~CNameProperty() override = default;
 
+public:
+  CName id() const { return m_id; }
+
+  void id(CName id)
+  {
+    // whatever happens.. because we don't really know the default values
+    post_cproperty_event(EPropertyEvent::data_edited);
+    m_id = id;
+  }
+
 public:
   // overrides
 
@@ -1009,6 +1067,9 @@ public:
 
   ~CCRUIDProperty() override = default;
 
+public:
+  uint64_t id() const { return m_id; }
+
 public:
   // overrides
 
@@ -1158,6 +1219,9 @@ public:
 
   ~CNodeRefProperty() override = default;
 
+public:
+  const std::string& str() const { return m_str; }
+
 public:
   // overrides
 
@@ -1,19 +1,55 @@
 #include "CPropertyFactory.hpp"
 #include <string>
-#include <functional>
+#include <mutex>
 #include <cpinternals/cpenums.hpp>
 #include <csav/csystem/CProperty.hpp>
 
 
-template <typename CPropType, typename ...Args>
-std::function<CPropertyUPtr(CPropertyOwner*)> build_prop_creator(Args&& ...args)
+template <typename CPropType>
+CPropertyUPtr create_prop(CPropertyOwner* owner, CSysName, uint32_t)
 {
-  return [args...](CPropertyOwner* owner) -> CPropertyUPtr {
-    return std::move(std::unique_ptr<CProperty>(new CPropType(owner, args...)));
-  };
+  return std::make_unique<CPropType>(owner);
 }
 
-std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::get_creator(CSysName ctypename)
+template <typename CPropType>
+CPropertyUPtr create_named_prop(CPropertyOwner* owner, CSysName ctypename, uint32_t)
+{
+  return std::make_unique<CPropType>(owner, ctypename);
+}
+
+static CPropertyUPtr create_array_prop(CPropertyOwner* owner, CSysName elt_ctypename, uint32_t array_size)
+{
+  return std::make_unique<CArrayProperty>(owner, elt_ctypename, array_size);
+}
+
+template <typename CPropType>
+CPropertyCreator build_prop_creator()
+{
+  return CPropertyCreator(&create_prop<CPropType>, CSysName());
+}
+
+template <typename CPropType>
+CPropertyCreator build_prop_creator(CSysName ctypename)
+{
+  return CPropertyCreator(&create_named_prop<CPropType>, ctypename);
+}
+
+CPropertyCreator CPropertyFactory::get_creator(CSysName ctypename)
+{
+  {
+    std::shared_lock<std::shared_mutex> lk(m_creators_mtx);
+    auto it = m_creators.find(ctypename);
+    if (it != m_creators.end())
+      return it->second;
+  }
+
+  CPropertyCreator creator = build_creator(ctypename);
+
+  std::unique_lock<std::shared_mutex> lk(m_creators_mtx);
+  return m_creators.emplace(ctypename, creator).first->second;
+}
+
+CPropertyCreator CPropertyFactory::build_creator(CSysName ctypename)
 {
   std::string str_ctypename = ctypename.str();
 
@@ -27,7 +63,7 @@ std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::get_creator(CSys
         size_t array_size = std::stoul(std::string(str_ctypename.substr(1, pos - 1)));
         CSysName elt_type(str_ctypename.substr(pos + 1));
 
-        return build_prop_creator<CArrayProperty>(elt_type, array_size);
+        return CPropertyCreator(&create_array_prop, elt_type, (uint32_t)array_size);
       }
       catch (std::exception&)
       {
@@ -50,15 +86,16 @@ std::function<CPropertyUPtr(CPropertyOwner*)> CPropertyFactory::get_creator(CSys
   {
     return build_prop_creator<CBoolProperty>();
   }
-  else if (str_ctypename == "Uint8")      { return build_prop_creator<CIntProperty>(EIntKind::U8);  }
-  else if (str_ctypename == "Int8")       { return build_prop_creator<CIntProperty>(EIntKind::I8);  }
-  else if (str_ctypename == "Uint16")     { return build_prop_creator<CIntProperty>(EIntKind::U16); }
-  else if (str_ctypename == "Int16")      { return build_prop_creator<CIntProperty>(EIntKind::I16); }
-  else if (str_ctypename == "Uint32")     { return build_prop_creator<CIntProperty>(EIntKind::U32); }
-  else if (str_ctypename == "Int32")      { return build_prop_creator<CIntProperty>(EIntKind::I32); }
-  else if (str_ctypename == "Uint64")     { return build_prop_creator<CIntProperty>(EIntKind::U64); }
-  else if (str_ctypename == "Int64")      { return build_prop_creator<CIntProperty>(EIntKind::I64); }
+  else if (str_ctypename == "Uint8")      { return build_prop_creator<CUint8Property>();            }
+  else if (str_ctypename == "Int8")       { return build_prop_creator<CInt8Property>();             }
+  else if (str_ctypename == "Uint16")     { return build_prop_creator<CUint16Property>();           }
+  else if (str_ctypename == "Int16")      { return build_prop_creator<CInt16Property>();            }
+  else if (str_ctypename == "Uint32")     { return build_prop_creator<CUint32Property>();           }
+  else if (str_ctypename == "Int32")      { return build_prop_creator<CInt32Property>();            }
+  else if (str_ctypename == "Uint64")     { return build_prop_creator<CUint64Property>();           }
+  else if (str_ctypename == "Int64")      { return build_prop_creator<CInt64Property>();            }
   else if (str_ctypename == "Float")      { return build_prop_creator<CFloatProperty>();            }
+  else if (str_ctypename == "Double")     { return build_prop_creator<CDoubleProperty>();           }
   else if (str_ctypename == "TweakDBID")  { return build_prop_creator<CTweakDBIDProperty>();        }
   else if (str_ctypename == "CName")      { return build_prop_creator<CNameProperty>();             }
   else if (str_ctypename == "CRUID")      { return build_prop_creator<CCRUIDProperty>();             }
@@ -1,9 +1,39 @@
 #pragma once
 #include <string>
+#include <unordered_map>
+#include <shared_mutex>
 #include <csav/csystem/fwd.hpp>
 #include <csav/csystem/CPropertyBase.hpp>
 #include <csav/csystem/CStringPool.hpp>
 
+// Lightweight creator descriptor: a plain function pointer plus the few
+// construction arguments some property classes need (element/sub type,
+// fixed array size). Cheap to copy, no heap allocation.
+class CPropertyCreator
+{
+public:
+  using create_fn_t = CPropertyUPtr(*)(CPropertyOwner* owner, CSysName ctypename, uint32_t array_size);
+
+private:
+  create_fn_t m_create_fn = nullptr;
+  CSysName m_ctypename;
+  uint32_t m_array_size = 0;
+
+public:
+  CPropertyCreator() = default;
+
+  CPropertyCreator(create_fn_t create_fn, CSysName ctypename, uint32_t array_size = 0)
+    : m_create_fn(create_fn), m_ctypename(ctypename), m_array_size(array_size) {}
+
+  explicit operator bool() const { return m_create_fn != nullptr; }
+
+  CPropertyUPtr operator()(CPropertyOwner* owner) const
+  {
+    return m_create_fn(owner, m_ctypename, m_array_size);
+  }
+};
+
+
 class CPropertyFactory
 {
 private:
@@ -24,7 +54,14 @@ public:
     return s;
   }
 
+protected:
+  // memoized creators, ctypename parsing happens once per ctypename
+  mutable std::shared_mutex m_creators_mtx;
+  std::unordered_map<CSysName, CPropertyCreator> m_creators;
+
+  static CPropertyCreator build_creator(CSysName ctypename);
+
 public:
-  static std::function<CPropertyUPtr(CPropertyOwner*)> get_creator(CSysName ctypename);
+  CPropertyCreator get_creator(CSysName ctypename);
 };
 
@@ -5,6 +5,8 @@
 #include <stdexcept>
 #include <algorithm>
 #include <numeric>
+#include <mutex>
+#include <shared_mutex>
 
 #include <utils.hpp>
 #include <csav/serializers.hpp>
@@ -215,22 +217,36 @@ public:
 };
 
 // let's use a global pool
+// it is shared by the worker threads (loading, checks), hence the lock
 class CSysName
 {
   uint32_t m_idx;
 
-public:
-  CSysName()
+  static std::shared_mutex& global_pool_mtx()
   {
-    m_idx = CStringPool::get_global().to_idx("uninitialized");
+    static std::shared_mutex mtx;
+    return mtx;
   }
 
+public:
+  CSysName()
+    : CSysName("uninitialized") {}
+
   CSysName(const char* s)
     : CSysName(std::string_view(s)) {}
 
   CSysName(std::string_view s)
   {
-    m_idx = CStringPool::get_global().to_idx(s);
+    auto& pool = CStringPool::get_global();
+    {
+      std::shared_lock<std::shared_mutex> lk(global_pool_mtx());
+      m_idx = pool.to_idx(s, false);
+    }
+    if (m_idx == (uint32_t)-1)
+    {
+      std::unique_lock<std::shared_mutex> lk(global_pool_mtx());
+      m_idx = pool.to_idx(s);
+    }
   }
 
   CSysName(const CSysName&) = default;
@@ -239,6 +255,7 @@ public:
   // todo: switch to string_view when CStringPool doesnot reallocate mem
   std::string str() const
   {
+    std::shared_lock<std::shared_mutex> lk(global_pool_mtx());
     return CStringPool::get_global().from_idx(m_idx);
   }
 
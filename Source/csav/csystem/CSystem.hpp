@@ -32,6 +32,7 @@ enum class ESystemKind : uint8_t
 };
 
 
+class CSystemQueryIndex;
 
 class CSystem
 {
@@ -59,6 +60,15 @@ private:
     uint32_t data_offset  = 0;// relative to the end of the header in stream
   };
 
+  // serialized range of an object in m_last_objdata
+  struct obj_span_t
+  {
+    uint32_t offset       = 0;
+    uint32_t size         = 0;
+    uint32_t name_idx     = 0;
+    int64_t  max_handle   = -1; // highest handle index contained in the object's data
+  };
+
 private:
   header_t m_header;
   std::vector<CName> m_subsys_names;
@@ -72,6 +82,19 @@ private:
   // since we don't handle all types..
   CSystemSerCtx m_serctx;
 
+  // state at last serialize_in or clear_dirty(), for dirty tracking
+  std::vector<CObjectSPtr> m_clean_objects;
+  std::vector<CName> m_clean_subsys_names;
+
+  // last serialized (in or out) object data, unmodified objects are
+  // copied back from it verbatim by serialize_out
+  mutable std::vector<char> m_last_objdata;
+  mutable std::vector<obj_span_t> m_last_spans;
+  mutable std::vector<CObjectSPtr> m_last_serobjs;
+
+  // see CSystemQuery.hpp, created on first use
+  mutable std::shared_ptr<CSystemQueryIndex> m_query_index;
+
 public:
   CSystem() = default;
   ~CSystem() = default;
@@ -83,6 +106,53 @@ public:
   const std::vector<CObjectSPtr>& objects() const { return m_objects; }
         std::vector<CObjectSPtr>& objects()       { return m_objects; }
 
+  // lazily built indexes for structural queries, defined in CSystemQuery.cpp
+  CSystemQueryIndex& query_index() const;
+
+public:
+  // true if an object has been edited, added or removed since serialize_in
+  bool is_dirty() const
+  {
+    if (m_objects != m_clean_objects)
+      return true;
+    if (m_subsys_names.size() != m_clean_subsys_names.size()
+      || !std::equal(m_subsys_names.begin(), m_subsys_names.end(), m_clean_subsys_names.begin(),
+          [](const CName& a, const CName& b) { return a.as_u64 == b.as_u64; }))
+      return true;
+
+    for (auto& obj : m_objects)
+    {
+      if (obj->is_dirty())
+        return true;
+    }
+    for (auto& obj : m_handle_objects)
+    {
+      if (obj->is_dirty())
+        return true;
+    }
+
+    return false;
+  }
+
+  // to be called once the serialized system has been committed
+  void clear_dirty()
+  {
+    m_clean_objects = m_objects;
+    m_clean_subsys_names = m_subsys_names;
+    for (auto& obj : m_objects)
+      obj->clear_dirty();
+    for (auto& obj : m_handle_objects)
+      obj->clear_dirty();
+  }
+
+  // next serialize_out will re-encode every object
+  void drop_original_data()
+  {
+    m_last_objdata.clear();
+    m_last_spans.clear();
+    m_last_serobjs.clear();
+  }
+
 public:
 
   bool serialize_in(std::istream& reader)
@@ -98,6 +168,7 @@ public:
     m_subsys_names.clear();
     m_objects.clear();
     m_handle_objects.clear();
+    drop_original_data();
 
     // let's get our header start position
     auto blob_spos = reader.tellg();
@@ -152,7 +223,10 @@ public:
 
     const size_t obj_descs_cnt = obj_descs_size / sizeof(obj_desc_t);
     if (obj_descs_cnt == 0)
+    {
+      clear_dirty();
       return m_header.objdata_offset + base_offset == blob_size; // could be empty
+    }
 
     std::vector<obj_desc_t> obj_descs(obj_descs_cnt);
     reader.read((char*)obj_descs.data(), obj_descs_size);
@@ -163,7 +237,9 @@ public:
     if (base_offset + m_header.objdata_offset != (reader.tellg() - blob_spos))
       return false;
 
-    std::vector<char> objdata(objdata_size);
+    // kept for serialize_out
+    auto& objdata = m_last_objdata;
+    objdata.resize(objdata_size);
     reader.read((char*)objdata.data(), objdata_size);
 
     if (blob_size != (reader.tellg() - blob_spos))
@@ -186,23 +262,29 @@ public:
     }
 
     // here the offsets relative to base_offset are converted to offsets relative to objdata
+    std::vector<obj_span_t> spans(obj_descs.size());
     size_t next_obj_offset = objdata_size;
-    auto obj_it = m_serctx.m_objects.rbegin();
-    for (auto it = obj_descs.rbegin(); it != obj_descs.rend(); ++it, ++obj_it)
+    for (size_t i = obj_descs.size(); i-- > 0;)
     {
-      const auto& desc = *it;
+      const auto& desc = obj_descs[i];
 
       const size_t offset = desc.data_offset - m_header.objdata_offset;
       if (offset > next_obj_offset)
         throw std::logic_error("CSystem: false assumption #2. please open an issue.");
 
-      std::span<char> objblob((char*)objdata.data() + offset, next_obj_offset - offset);
-      if (!(*obj_it)->serialize_in(objblob, m_serctx))
+      const size_t size = next_obj_offset - offset;
+      std::span<char> objblob((char*)objdata.data() + offset, size);
+      m_serctx.m_max_handle = -1;
+      if (!m_serctx.m_objects[i]->serialize_in(objblob, m_serctx))
         return false;
 
+      spans[i] = { (uint32_t)offset, (uint32_t)size, desc.name_idx, m_serctx.m_max_handle };
       next_obj_offset = offset;
     }
 
+    m_last_spans = std::move(spans);
+    m_last_serobjs = m_serctx.m_objects;
+
     const auto& serobjs = m_serctx.m_objects;
     size_t root_obj_cnt = m_subsys_names.size();
     if (root_obj_cnt == 0)
@@ -210,6 +292,7 @@ public:
     m_objects.assign(serobjs.begin(), serobjs.begin() + root_obj_cnt);
     m_handle_objects.assign(serobjs.begin() + root_obj_cnt, serobjs.end()); // backup handle-objects
 
+    clear_dirty();
     return true;
   }
 
@@ -250,16 +333,44 @@ public:
     std::ostringstream ss;
     std::vector<obj_desc_t> obj_descs;
     obj_descs.reserve(serctx.m_objects.size()); // ends up higher in the presence of handles
+    std::vector<obj_span_t> spans;
+    spans.reserve(serctx.m_objects.size());
+
+    // objects that kept their position since last serialization can be
+    // copied verbatim if they (and the handles they contain) didn't change.
+    // the strpool only grows so their name indices are still valid.
+    size_t unmoved_cnt = 0;
+    {
+      const size_t cnt = std::min(m_last_serobjs.size(), serctx.m_objects.size());
+      while (unmoved_cnt < cnt && serctx.m_objects[unmoved_cnt] == m_last_serobjs[unmoved_cnt])
+        ++unmoved_cnt;
+    }
 
     // serctx.m_objects is extended during object serialization (handles)
     for (size_t i = 0; i < serctx.m_objects.size(); ++i)
     {
       auto& obj = serctx.m_objects[i];
       const uint32_t tmp_offset = (uint32_t)ss.tellp();
+
+      if (i < unmoved_cnt && !obj->is_dirty())
+      {
+        const auto& last_span = m_last_spans[i];
+        if (last_span.max_handle < (int64_t)unmoved_cnt)
+        {
+          obj_descs.emplace_back(last_span.name_idx, tmp_offset);
+          ss.write(m_last_objdata.data() + last_span.offset, last_span.size);
+          spans.push_back({ tmp_offset, last_span.size, last_span.name_idx, last_span.max_handle });
+          continue;
+        }
+      }
+
       const uint16_t name_idx = serctx.strpool.to_idx(obj->ctypename().str());
       obj_descs.emplace_back(name_idx, tmp_offset);
+      serctx.m_max_handle = -1;
       if (!obj->serialize_out(ss, serctx))
         return false;
+      const uint32_t size = (uint32_t)ss.tellp() - tmp_offset;
+      spans.push_back({ tmp_offset, size, name_idx, serctx.m_max_handle });
     }
 
     // time to write strpool
@@ -285,6 +396,11 @@ public:
     writer.write(objdata.data(), objdata.size());
     auto end_spos = writer.tellp();
 
+    // this serialization becomes the reference for the next one
+    m_last_objdata.assign(objdata.begin(), objdata.end());
+    m_last_spans = std::move(spans);
+    m_last_serobjs = serctx.m_objects;
+
     // at this point data should be correct except blob_size and header
     // so let's rewrite them
 
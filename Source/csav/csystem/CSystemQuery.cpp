@@ -0,0 +1,1073 @@
+#include "CSystemQuery.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <fmt/format.h>
+#include <job_scheduler.hpp>
+#include <cpinternals/cpnames.hpp>
+#include <csav/csystem/CProperty.hpp>
+
+//------------------------------------------------------------------------------
+// parsing
+//------------------------------------------------------------------------------
+
+namespace {
+
+using segment_t = CSystemQuery::segment_t;
+using path_t = CSystemQuery::path_t;
+using literal_t = CSystemQuery::literal_t;
+
+bool is_ident_char(char c)
+{
+  return std::isalnum((unsigned char)c) || c == '_' || c == ':';
+}
+
+std::string to_lower(std::string_view s)
+{
+  std::string ret(s);
+  for (auto& c : ret)
+    c = (char)std::tolower((unsigned char)c);
+  return ret;
+}
+
+class query_parser
+{
+  std::string_view m_text;
+  size_t m_pos = 0;
+
+public:
+  std::string err;
+
+  explicit query_parser(std::string_view text)
+    : m_text(text) {}
+
+  void skip_ws()
+  {
+    while (m_pos < m_text.size() && std::isspace((unsigned char)m_text[m_pos]))
+      ++m_pos;
+  }
+
+  bool at_end()
+  {
+    skip_ws();
+    return m_pos >= m_text.size();
+  }
+
+  bool accept(std::string_view tok)
+  {
+    skip_ws();
+    if (m_text.substr(m_pos, tok.size()) != tok)
+      return false;
+    m_pos += tok.size();
+    return true;
+  }
+
+  bool fail(std::string_view what)
+  {
+    if (err.empty())
+      err = fmt::format("{} at column {}", what, m_pos + 1);
+    return false;
+  }
+
+  std::string_view ident()
+  {
+    skip_ws();
+    const size_t start = m_pos;
+    while (m_pos < m_text.size() && is_ident_char(m_text[m_pos]))
+      ++m_pos;
+    return m_text.substr(start, m_pos - start);
+  }
+
+  bool parse_path(path_t& path, std::string& path_text)
+  {
+    bool expect_name = true;
+    for (;;)
+    {
+      if (expect_name)
+      {
+        segment_t seg;
+        if (accept("@"))
+        {
+          auto name = ident();
+          if (name == "type")
+            seg.kind = segment_t::kind_t::type;
+          else if (name == "count")
+            seg.kind = segment_t::kind_t::count;
+          else
+            return fail("unknown attribute");
+          path_text += '@';
+          path_text += name;
+        }
+        else
+        {
+          auto name = ident();
+          if (name.empty())
+            return fail("expected a field name");
+          seg.kind = segment_t::kind_t::field;
+          seg.name = CSysName(name);
+          path_text += name;
+        }
+        path.push_back(std::move(seg));
+        expect_name = false;
+      }
+
+      // attributes end the path
+      const auto last_kind = path.back().kind;
+      if (last_kind == segment_t::kind_t::type || last_kind == segment_t::kind_t::count)
+        return true;
+
+      if (m_pos < m_text.size() && m_text[m_pos] == '.')
+      {
+        ++m_pos;
+        path_text += '.';
+        expect_name = true;
+      }
+      else if (m_pos < m_text.size() && m_text[m_pos] == '[')
+      {
+        ++m_pos;
+        segment_t seg;
+        if (accept("*"))
+        {
+          seg.kind = segment_t::kind_t::any;
+          path_text += "[*]";
+        }
+        else
+        {
+          skip_ws();
+          const char* first = m_text.data() + m_pos;
+          char* last = nullptr;
+          const unsigned long long idx = std::strtoull(first, &last, 0);
+          if (last == first || idx > UINT32_MAX)
+            return fail("expected an index");
+          m_pos += last - first;
+          seg.kind = segment_t::kind_t::index;
+          seg.index = (uint32_t)idx;
+          path_text += fmt::format("[{}]", idx);
+        }
+        if (!accept("]"))
+          return fail("expected ']'");
+        path.push_back(std::move(seg));
+      }
+      else
+        return true;
+    }
+  }
+
+  bool parse_op(EQueryOp& op)
+  {
+    // longest first
+    if (accept("==")) op = EQueryOp::eq;
+    else if (accept("!=")) op = EQueryOp::ne;
+    else if (accept("<=")) op = EQueryOp::le;
+    else if (accept(">=")) op = EQueryOp::ge;
+    else if (accept("~=")) op = EQueryOp::contains;
+    else if (accept("<")) op = EQueryOp::lt;
+    else if (accept(">")) op = EQueryOp::gt;
+    else
+      return false;
+    return true;
+  }
+
+  bool parse_literal(literal_t& lit)
+  {
+    skip_ws();
+    if (m_pos >= m_text.size())
+      return fail("expected a value");
+
+    bool quoted = false;
+    const char c = m_text[m_pos];
+    if (c == '"')
+    {
+      const size_t end = m_text.find('"', m_pos + 1);
+      if (end == std::string_view::npos)
+        return fail("unterminated string");
+      lit.str = m_text.substr(m_pos + 1, end - m_pos - 1);
+      m_pos = end + 1;
+      quoted = true;
+    }
+    else
+    {
+      // bare words can be dotted names (Items.Preset_..) or numbers
+      const size_t start = m_pos;
+      while (m_pos < m_text.size() && (is_ident_char(m_text[m_pos])
+        || m_text[m_pos] == '.' || m_text[m_pos] == '-' || m_text[m_pos] == '+'))
+        ++m_pos;
+      if (m_pos == start)
+        return fail("expected a value");
+      lit.str = m_text.substr(start, m_pos - start);
+    }
+
+    if (!quoted)
+    {
+      if (lit.str == "true" || lit.str == "false")
+      {
+        lit.is_bool = true;
+        lit.b = lit.str == "true";
+      }
+      else
+        parse_number(lit);
+    }
+
+    lit.lower = to_lower(lit.str);
+    lit.sysname = CSysName(lit.str);
+    lit.tdbid = TweakDBID(lit.str).as_u64;
+    lit.cname = FNV1a(lit.str);
+    return true;
+  }
+
+  static void parse_number(literal_t& lit)
+  {
+    const char* first = lit.str.c_str();
+    const char* str_end = first + lit.str.size();
+    char* last = nullptr;
+
+    const bool neg = lit.str.size() && lit.str[0] == '-';
+    errno = 0;
+    if (neg)
+    {
+      const long long v = std::strtoll(first, &last, 0);
+      if (last == str_end && errno == 0)
+      {
+        lit.is_number = lit.is_int = lit.is_negative = true;
+        lit.u64 = (uint64_t)v;
+        lit.num = (double)v;
+        return;
+      }
+    }
+    else
+    {
+      const unsigned long long v = std::strtoull(first, &last, 0);
+      if (last == str_end && errno == 0)
+      {
+        lit.is_number = lit.is_int = true;
+        lit.u64 = v;
+        lit.num = (double)v;
+        return;
+      }
+    }
+
+    const double d = std::strtod(first, &last);
+    if (last == str_end && lit.str.size())
+    {
+      lit.is_number = true;
+      lit.num = d;
+    }
+  }
+};
+
+} // namespace
+
+bool CSystemQuery::parse(std::string_view text, std::string& err)
+{
+  m_text = std::string(text);
+  m_exprs.clear();
+  m_root = 0;
+
+  query_parser p(text);
+
+  auto add = [this](expr_t&& e) {
+    m_exprs.push_back(std::move(e));
+    return (uint32_t)(m_exprs.size() - 1);
+  };
+
+  // returns false on error, expressions are appended before their parents
+  std::function<bool(uint32_t&)> parse_or;
+
+  std::function<bool(uint32_t&)> parse_unary = [&](uint32_t& out) -> bool {
+    if (p.accept("!"))
+    {
+      expr_t e;
+      e.kind = expr_t::kind_t::not_;
+      if (!parse_unary(e.lhs))
+        return false;
+      out = add(std::move(e));
+      return true;
+    }
+    if (p.accept("("))
+    {
+      if (!parse_or(out))
+        return false;
+      if (!p.accept(")"))
+        return p.fail("expected ')'");
+      return true;
+    }
+
+    expr_t e;
+    e.kind = expr_t::kind_t::cmp;
+    if (!p.parse_path(e.path, e.path_text))
+      return false;
+    if (p.parse_op(e.op))
+    {
+      if (!p.parse_literal(e.lit))
+        return false;
+    }
+    out = add(std::move(e));
+    return true;
+  };
+
+  auto parse_and = [&](uint32_t& out) -> bool {
+    if (!parse_unary(out))
+      return false;
+    while (p.accept("&&"))
+    {
+      expr_t e;
+      e.kind = expr_t::kind_t::and_;
+      e.lhs = out;
+      if (!parse_unary(e.rhs))
+        return false;
+      out = add(std::move(e));
+    }
+    return true;
+  };
+
+  parse_or = [&](uint32_t& out) -> bool {
+    if (!parse_and(out))
+      return false;
+    while (p.accept("||"))
+    {
+      expr_t e;
+      e.kind = expr_t::kind_t::or_;
+      e.lhs = out;
+      if (!parse_and(e.rhs))
+        return false;
+      out = add(std::move(e));
+    }
+    return true;
+  };
+
+  bool ok = false;
+  if (p.at_end())
+    p.fail("empty query");
+  else if (parse_or(m_root))
+  {
+    ok = p.at_end();
+    if (!ok)
+      p.fail("unexpected characters");
+  }
+
+  if (!ok)
+  {
+    err = p.err;
+    m_exprs.clear();
+    return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// evaluation
+//------------------------------------------------------------------------------
+
+namespace {
+
+// what a path leads to
+struct leaf_t
+{
+  enum class kind_t : uint8_t { prop, object, type, count };
+
+  kind_t kind = kind_t::prop;
+  const CProperty* prop = nullptr;
+  const CObject* obj = nullptr;
+  uint64_t count = 0;
+};
+
+const std::vector<CPropertyUPtr>* array_elts(const CProperty* prop)
+{
+  // both array kinds report EPropertyKind::DynArray
+  if (prop->kind() != EPropertyKind::DynArray)
+    return nullptr;
+  if (auto arr = dynamic_cast<const CDynArrayProperty*>(prop))
+    return &arr->elts();
+  if (auto arr = dynamic_cast<const CArrayProperty*>(prop))
+    return &arr->elts();
+  return nullptr;
+}
+
+const CObject* prop_object(const CProperty* prop)
+{
+  if (prop->kind() == EPropertyKind::Object)
+    return static_cast<const CObjectProperty*>(prop)->obj().get();
+  if (prop->kind() == EPropertyKind::Handle)
+    return static_cast<const CHandleProperty*>(prop)->obj().get();
+  return nullptr;
+}
+
+template <typename Fn>
+bool visit_prop(const CProperty* prop, const path_t& path, size_t i, Fn&& fn);
+
+// fn(leaf) returns true to stop the visit, which then returns true
+template <typename Fn>
+bool visit_obj(const CObject* obj, const path_t& path, size_t i, Fn&& fn)
+{
+  if (i == path.size())
+    return fn(leaf_t{leaf_t::kind_t::object, nullptr, obj});
+
+  auto& seg = path[i];
+  switch (seg.kind)
+  {
+    case segment_t::kind_t::field:
+    {
+      auto prop = obj->get_prop(seg.name);
+      return prop && visit_prop(prop, path, i + 1, fn);
+    }
+    case segment_t::kind_t::type:
+      return fn(leaf_t{leaf_t::kind_t::type, nullptr, obj});
+    default:
+      break;
+  }
+  return false;
+}
+
+template <typename Fn>
+bool visit_prop(const CProperty* prop, const path_t& path, size_t i, Fn&& fn)
+{
+  if (i == path.size())
+    return fn(leaf_t{leaf_t::kind_t::prop, prop});
+
+  auto& seg = path[i];
+
+  if (auto elts = array_elts(prop))
+  {
+    switch (seg.kind)
+    {
+      case segment_t::kind_t::index:
+        return seg.index < elts->size() && visit_prop((*elts)[seg.index].get(), path, i + 1, fn);
+      case segment_t::kind_t::any:
+        for (auto& elt : *elts)
+        {
+          if (visit_prop(elt.get(), path, i + 1, fn))
+            return true;
+        }
+        return false;
+      case segment_t::kind_t::count:
+        return fn(leaf_t{leaf_t::kind_t::count, prop, nullptr, elts->size()});
+      case segment_t::kind_t::field:
+        // implicit expansion
+        for (auto& elt : *elts)
+        {
+          if (visit_prop(elt.get(), path, i, fn))
+            return true;
+        }
+        return false;
+      default:
+        break;
+    }
+    return false;
+  }
+
+  auto obj = prop_object(prop);
+  return obj && visit_obj(obj, path, i, fn);
+}
+
+// sign extended for signed kinds
+uint64_t int_raw(const CIntProperty* iprop, bool& is_signed)
+{
+  const EIntKind ik = iprop->int_kind();
+  is_signed = ik == EIntKind::I8 || ik == EIntKind::I16 || ik == EIntKind::I32 || ik == EIntKind::I64;
+  uint64_t raw = iprop->u64();
+  const size_t bits = iprop->int_size() * 8;
+  if (is_signed && bits < 64 && ((raw >> (bits - 1)) & 1))
+    raw |= ~uint64_t(0) << bits;
+  return raw;
+}
+
+bool apply_op(EQueryOp op, int c)
+{
+  switch (op)
+  {
+    case EQueryOp::eq: return c == 0;
+    case EQueryOp::ne: return c != 0;
+    case EQueryOp::lt: return c < 0;
+    case EQueryOp::le: return c <= 0;
+    case EQueryOp::gt: return c > 0;
+    case EQueryOp::ge: return c >= 0;
+    default: break;
+  }
+  return false;
+}
+
+template <typename T>
+int three_way(const T& a, const T& b)
+{
+  return (a < b) ? -1 : ((b < a) ? 1 : 0);
+}
+
+bool cmp_string(const std::string& value, EQueryOp op, const literal_t& lit)
+{
+  if (op == EQueryOp::contains)
+    return to_lower(value).find(lit.lower) != std::string::npos;
+  return apply_op(op, value.compare(lit.str) < 0 ? -1 : (value == lit.str ? 0 : 1));
+}
+
+bool cmp_int(uint64_t raw, bool is_signed, EQueryOp op, const literal_t& lit)
+{
+  if (op == EQueryOp::contains)
+    return cmp_string(is_signed ? std::to_string((int64_t)raw) : std::to_string(raw), op, lit);
+  if (lit.is_bool)
+    return apply_op(op, three_way<uint64_t>(raw, lit.b ? 1 : 0));
+  if (!lit.is_number)
+    return false;
+
+  if (!lit.is_int)
+  {
+    const double v = is_signed ? (double)(int64_t)raw : (double)raw;
+    return apply_op(op, three_way(v, lit.num));
+  }
+
+  int c;
+  if (is_signed)
+  {
+    const int64_t v = (int64_t)raw;
+    if (!lit.is_negative && lit.u64 > (uint64_t)INT64_MAX)
+      c = -1;
+    else
+      c = three_way(v, (int64_t)lit.u64);
+  }
+  else
+  {
+    if (lit.is_negative)
+      c = 1;
+    else
+      c = three_way(raw, lit.u64);
+  }
+  return apply_op(op, c);
+}
+
+bool cmp_real(double v, EQueryOp op, const literal_t& lit)
+{
+  if (op == EQueryOp::contains)
+    return cmp_string(fmt::format("{}", v), op, lit);
+  if (!lit.is_number)
+    return false;
+  if (std::isnan(v))
+    return op == EQueryOp::ne;
+  return apply_op(op, three_way(v, lit.num));
+}
+
+// names compare by hash for equality, by string otherwise
+template <typename ResolveFn>
+bool cmp_name(bool hash_equal, EQueryOp op, const literal_t& lit, ResolveFn&& resolve)
+{
+  if (op == EQueryOp::eq)
+    return hash_equal;
+  if (op == EQueryOp::ne)
+    return !hash_equal;
+  return cmp_string(resolve(), op, lit);
+}
+
+bool cmp_leaf(const leaf_t& leaf, EQueryOp op, const literal_t& lit)
+{
+  if (op == EQueryOp::exists)
+  {
+    if (leaf.kind == leaf_t::kind_t::prop && leaf.prop->kind() == EPropertyKind::Handle)
+      return static_cast<const CHandleProperty*>(leaf.prop)->obj() != nullptr;
+    return true;
+  }
+
+  switch (leaf.kind)
+  {
+    case leaf_t::kind_t::object:
+      return false;
+    case leaf_t::kind_t::type:
+    {
+      const CSysName ctypename = leaf.obj->ctypename();
+      return cmp_name(ctypename == lit.sysname, op, lit, [&]() { return ctypename.str(); });
+    }
+    case leaf_t::kind_t::count:
+      return cmp_int(leaf.count, false, op, lit);
+    default:
+      break;
+  }
+
+  auto prop = leaf.prop;
+  switch (prop->kind())
+  {
+    case EPropertyKind::Bool:
+      return cmp_int(static_cast<const CBoolProperty*>(prop)->value() ? 1 : 0, false, op, lit);
+    case EPropertyKind::Integer:
+    {
+      bool is_signed = false;
+      const uint64_t raw = int_raw(static_cast<const CIntProperty*>(prop), is_signed);
+      return cmp_int(raw, is_signed, op, lit);
+    }
+    case EPropertyKind::Float:
+      return cmp_real(static_cast<const CFloatPropertyT<float>*>(prop)->value(), op, lit);
+    case EPropertyKind::Double:
+      return cmp_real(static_cast<const CFloatPropertyT<double>*>(prop)->value(), op, lit);
+    case EPropertyKind::Combo:
+    {
+      const CSysName value_name = static_cast<const CEnumProperty*>(prop)->value_name();
+      return cmp_name(value_name == lit.sysname, op, lit, [&]() { return value_name.str(); });
+    }
+    case EPropertyKind::TweakDBID:
+    {
+      const TweakDBID id = static_cast<const CTweakDBIDProperty*>(prop)->id();
+      const uint64_t expected = lit.is_int && !lit.is_negative ? lit.u64 : lit.tdbid;
+      return cmp_name(id.as_u64 == expected, op, lit, [&]() { return id.name(); });
+    }
+    case EPropertyKind::CName:
+    {
+      const CName id = static_cast<const CNameProperty*>(prop)->id();
+      const uint64_t expected = lit.is_int && !lit.is_negative ? lit.u64 : lit.cname;
+      return cmp_name(id.as_u64 == expected, op, lit, [&]() { return id.str(); });
+    }
+    case EPropertyKind::CRUID:
+      return cmp_int(static_cast<const CCRUIDProperty*>(prop)->id(), false, op, lit);
+    case EPropertyKind::NodeRef:
+      return cmp_string(static_cast<const CNodeRefProperty*>(prop)->str(), op, lit);
+    case EPropertyKind::DynArray:
+    {
+      // a path ending on an array compares its elements
+      auto elts = array_elts(prop);
+      if (!elts)
+        return false;
+      for (auto& elt : *elts)
+      {
+        if (cmp_leaf(leaf_t{leaf_t::kind_t::prop, elt.get()}, op, lit))
+          return true;
+      }
+      return false;
+    }
+    default:
+      break;
+  }
+  return false;
+}
+
+} // namespace
+
+bool CSystemQuery::match(const CObject& obj) const
+{
+  if (m_exprs.empty())
+    return false;
+  return eval(m_root, obj);
+}
+
+bool CSystemQuery::eval(uint32_t expr_idx, const CObject& obj) const
+{
+  auto& e = m_exprs[expr_idx];
+  switch (e.kind)
+  {
+    case expr_t::kind_t::and_: return eval(e.lhs, obj) && eval(e.rhs, obj);
+    case expr_t::kind_t::or_: return eval(e.lhs, obj) || eval(e.rhs, obj);
+    case expr_t::kind_t::not_: return !eval(e.lhs, obj);
+    default: break;
+  }
+
+  return visit_obj(&obj, e.path, 0, [&](const leaf_t& leaf) {
+    return cmp_leaf(leaf, e.op, e.lit);
+  });
+}
+
+void CSystemQuery::collect_eq_terms(uint32_t expr_idx, std::vector<const expr_t*>& out) const
+{
+  auto& e = m_exprs[expr_idx];
+  if (e.kind == expr_t::kind_t::and_)
+  {
+    collect_eq_terms(e.lhs, out);
+    collect_eq_terms(e.rhs, out);
+  }
+  else if (e.kind == expr_t::kind_t::cmp && e.op == EQueryOp::eq)
+    out.push_back(&e);
+}
+
+//------------------------------------------------------------------------------
+// CSystemQueryIndex
+//------------------------------------------------------------------------------
+
+namespace {
+
+// Runs fn(begin, end, chunk_idx) over [0, count) in chunks, subtasks of the
+// job_scheduler pulled in order by a few threads, so that large objects don't
+// stall a whole partition.
+template <typename Fn>
+void parallel_chunks(size_t count, size_t thread_cnt, Fn&& fn)
+{
+  static constexpr size_t chunk_size = 256;
+  const size_t chunk_cnt = (count + chunk_size - 1) / chunk_size;
+
+  auto& scheduler = job_scheduler::get();
+  if (!thread_cnt)
+    thread_cnt = scheduler.thread_count();
+  thread_cnt = std::max<size_t>(1, std::min(thread_cnt, chunk_cnt / 4));
+
+  scheduler.parallel_for(chunk_cnt, [&](size_t i) {
+    fn(i * chunk_size, std::min(count, (i + 1) * chunk_size), i);
+  }, thread_cnt);
+}
+
+size_t chunk_count(size_t count)
+{
+  return (count + 255) / 256;
+}
+
+// value keys, the tag tells how a literal must be converted to be compared
+enum class value_tag : uint8_t
+{
+  boolean,
+  sint,
+  uint,
+  real,
+  sysname,
+  tweakdbid,
+  cname,
+  cruid,
+  string,
+  count
+};
+
+uint64_t make_key(value_tag tag, uint64_t v)
+{
+  return (v ^ ((uint64_t)tag << 56)) * 0x9E3779B97F4A7C15;
+}
+
+uint64_t real_bits(double d)
+{
+  if (d == 0)
+    d = 0; // -0
+  uint64_t bits;
+  std::memcpy(&bits, &d, 8);
+  return bits;
+}
+
+// calls fn(tag, key) for the values equality can match at leaf
+template <typename Fn>
+void leaf_keys(const leaf_t& leaf, Fn&& fn)
+{
+  switch (leaf.kind)
+  {
+    case leaf_t::kind_t::type:
+      fn(value_tag::sysname, make_key(value_tag::sysname, leaf.obj->ctypename().idx()));
+      return;
+    case leaf_t::kind_t::count:
+      fn(value_tag::uint, make_key(value_tag::uint, leaf.count));
+      return;
+    case leaf_t::kind_t::object:
+      return;
+    default:
+      break;
+  }
+
+  auto prop = leaf.prop;
+  switch (prop->kind())
+  {
+    case EPropertyKind::Bool:
+      fn(value_tag::boolean, make_key(value_tag::boolean, static_cast<const CBoolProperty*>(prop)->value() ? 1 : 0));
+      break;
+    case EPropertyKind::Integer:
+    {
+      bool is_signed = false;
+      const uint64_t raw = int_raw(static_cast<const CIntProperty*>(prop), is_signed);
+      const value_tag tag = is_signed ? value_tag::sint : value_tag::uint;
+      fn(tag, make_key(tag, raw));
+      break;
+    }
+    case EPropertyKind::Float:
+      fn(value_tag::real, make_key(value_tag::real, real_bits(static_cast<const CFloatPropertyT<float>*>(prop)->value())));
+      break;
+    case EPropertyKind::Double:
+      fn(value_tag::real, make_key(value_tag::real, real_bits(static_cast<const CFloatPropertyT<double>*>(prop)->value())));
+      break;
+    case EPropertyKind::Combo:
+      fn(value_tag::sysname, make_key(value_tag::sysname, static_cast<const CEnumProperty*>(prop)->value_name().idx()));
+      break;
+    case EPropertyKind::TweakDBID:
+      fn(value_tag::tweakdbid, make_key(value_tag::tweakdbid, static_cast<const CTweakDBIDProperty*>(prop)->id().as_u64));
+      break;
+    case EPropertyKind::CName:
+      fn(value_tag::cname, make_key(value_tag::cname, static_cast<const CNameProperty*>(prop)->id().as_u64));
+      break;
+    case EPropertyKind::CRUID:
+      fn(value_tag::cruid, make_key(value_tag::cruid, static_cast<const CCRUIDProperty*>(prop)->id()));
+      break;
+    case EPropertyKind::NodeRef:
+      fn(value_tag::string, make_key(value_tag::string, std::hash<std::string>()(static_cast<const CNodeRefProperty*>(prop)->str())));
+      break;
+    case EPropertyKind::DynArray:
+      if (auto elts = array_elts(prop))
+      {
+        for (auto& elt : *elts)
+          leaf_keys(leaf_t{leaf_t::kind_t::prop, elt.get()}, fn);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+// key of the values of kind tag that compare equal to lit,
+// false if there may be several of them
+bool literal_key(value_tag tag, const literal_t& lit, uint64_t& key)
+{
+  uint64_t v = 0;
+  switch (tag)
+  {
+    case value_tag::boolean:
+      if (lit.is_bool)
+        v = lit.b ? 1 : 0;
+      else if (lit.is_int && !lit.is_negative && lit.u64 <= 1)
+        v = lit.u64;
+      else
+        return false;
+      break;
+    case value_tag::sint:
+      if (!lit.is_int || (!lit.is_negative && lit.u64 > (uint64_t)INT64_MAX))
+        return false;
+      v = lit.u64;
+      break;
+    case value_tag::uint:
+    case value_tag::cruid:
+      if (!lit.is_int || lit.is_negative)
+        return false;
+      v = lit.u64;
+      break;
+    case value_tag::real:
+      if (!lit.is_number)
+        return false;
+      v = real_bits(lit.num);
+      break;
+    case value_tag::sysname:
+      v = lit.sysname.idx();
+      break;
+    case value_tag::tweakdbid:
+      v = lit.is_int && !lit.is_negative ? lit.u64 : lit.tdbid;
+      break;
+    case value_tag::cname:
+      v = lit.is_int && !lit.is_negative ? lit.u64 : lit.cname;
+      break;
+    case value_tag::string:
+      v = std::hash<std::string>()(lit.str);
+      break;
+    default:
+      return false;
+  }
+  key = make_key(tag, v);
+  return true;
+}
+
+} // namespace
+
+CSystemQueryIndex& CSystem::query_index() const
+{
+  if (!m_query_index)
+    m_query_index = std::make_shared<CSystemQueryIndex>();
+  return *m_query_index;
+}
+
+CSystemQueryIndex::~CSystemQueryIndex()
+{
+  clear();
+}
+
+void CSystemQueryIndex::clear()
+{
+  for (auto& obj : m_objects)
+    obj->remove_listener(this);
+  m_objects.clear();
+  m_has_type_index = false;
+  m_by_type.clear();
+  m_by_value.clear();
+  m_values_stale = false;
+  ++m_version;
+}
+
+void CSystemQueryIndex::on_cobject_event(const CObject& obj, EObjectEvent evt)
+{
+  m_values_stale = true;
+  ++m_version;
+}
+
+void CSystemQueryIndex::sync_snapshot(const CSystem& sys)
+{
+  if (m_objects == sys.objects())
+    return;
+
+  clear();
+  m_objects = sys.objects();
+  for (auto& obj : m_objects)
+    obj->add_listener(this);
+}
+
+void CSystemQueryIndex::build_type_index()
+{
+  m_by_type.clear();
+  for (uint32_t i = 0; i < (uint32_t)m_objects.size(); ++i)
+    m_by_type[m_objects[i]->ctypename()].push_back(i);
+  m_has_type_index = true;
+}
+
+void CSystemQueryIndex::build_value_index(value_index_t& vi, const CSystemQuery::path_t& path, size_t thread_cnt)
+{
+  struct entry_t
+  {
+    uint64_t key;
+    uint32_t obj_idx;
+  };
+
+  std::vector<std::vector<entry_t>> chunk_entries(chunk_count(m_objects.size()));
+  std::vector<uint32_t> chunk_tags(chunk_entries.size());
+
+  parallel_chunks(m_objects.size(), thread_cnt, [&](size_t begin, size_t end, size_t chunk_idx) {
+    auto& entries = chunk_entries[chunk_idx];
+    auto& tags = chunk_tags[chunk_idx];
+    for (size_t i = begin; i < end; ++i)
+    {
+      visit_obj(m_objects[i].get(), path, 0, [&](const leaf_t& leaf) {
+        leaf_keys(leaf, [&](value_tag tag, uint64_t key) {
+          tags |= 1u << (uint32_t)tag;
+          entries.push_back(entry_t{key, (uint32_t)i});
+        });
+        return false;
+      });
+    }
+  });
+
+  vi.map.clear();
+  vi.tags = 0;
+  for (size_t c = 0; c < chunk_entries.size(); ++c)
+  {
+    vi.tags |= chunk_tags[c];
+    for (auto& entry : chunk_entries[c])
+    {
+      auto& objs = vi.map[entry.key];
+      // objects are visited in order, arrays can give the same key twice
+      if (objs.empty() || objs.back() != entry.obj_idx)
+        objs.push_back(entry.obj_idx);
+    }
+  }
+  vi.built = true;
+}
+
+bool CSystemQueryIndex::lookup_value_index(const value_index_t& vi, const CSystemQuery::literal_t& lit, std::vector<uint32_t>& out) const
+{
+  out.clear();
+  for (uint32_t t = 0; t < (uint32_t)value_tag::count; ++t)
+  {
+    if (!(vi.tags & (1u << t)))
+      continue;
+
+    uint64_t key = 0;
+    if (!literal_key((value_tag)t, lit, key))
+      return false;
+
+    auto it = vi.map.find(key);
+    if (it == vi.map.end())
+      continue;
+
+    if (out.empty())
+      out = it->second;
+    else
+    {
+      std::vector<uint32_t> merged;
+      std::set_union(out.begin(), out.end(), it->second.begin(), it->second.end(), std::back_inserter(merged));
+      out = std::move(merged);
+    }
+  }
+  return true;
+}
+
+std::vector<size_t> CSystemQueryIndex::run(const CSystem& sys, const CSystemQuery& query, size_t thread_cnt)
+{
+  auto t0 = std::chrono::steady_clock::now();
+  m_last_stats = run_stats_t();
+
+  std::vector<size_t> matches;
+  if (query.empty())
+    return matches;
+
+  sync_snapshot(sys);
+
+  if (m_values_stale)
+  {
+    for (auto& it : m_by_value)
+    {
+      it.second.built = false;
+      it.second.map.clear();
+    }
+    m_values_stale = false;
+  }
+
+  // candidates from the indexes, intersected
+  std::vector<const CSystemQuery::expr_t*> eq_terms;
+  query.collect_eq_terms(query.m_root, eq_terms);
+
+  bool has_candidates = false;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> term_candidates;
+
+  for (auto term : eq_terms)
+  {
+    const std::vector<uint32_t>* term_objs = nullptr;
+
+    if (term->path.size() == 1 && term->path[0].kind == CSystemQuery::segment_t::kind_t::type)
+    {
+      if (!m_has_type_index)
+        build_type_index();
+      m_last_stats.used_type_index = true;
+
+      static const std::vector<uint32_t> empty;
+      auto it = m_by_type.find(term->lit.sysname);
+      term_objs = (it != m_by_type.end()) ? &it->second : &empty;
+    }
+    else
+    {
+      auto& vi = m_by_value[term->path_text];
+      if (!vi.built && ++vi.use_cnt >= hot_threshold)
+        build_value_index(vi, term->path, thread_cnt);
+      if (!vi.built || !lookup_value_index(vi, term->lit, term_candidates))
+        continue;
+      m_last_stats.used_value_indexes++;
+      term_objs = &term_candidates;
+    }
+
+    if (!has_candidates)
+    {
+      candidates = *term_objs;
+      has_candidates = true;
+    }
+    else
+    {
+      std::vector<uint32_t> inter;
+      std::set_intersection(candidates.begin(), candidates.end(), term_objs->begin(), term_objs->end(), std::back_inserter(inter));
+      candidates = std::move(inter);
+    }
+  }
+
+  const size_t cand_cnt = has_candidates ? candidates.size() : m_objects.size();
+  m_last_stats.candidates = cand_cnt;
+
+  // full evaluation
+  std::vector<std::vector<size_t>> chunk_matches(chunk_count(cand_cnt));
+  parallel_chunks(cand_cnt, thread_cnt, [&](size_t begin, size_t end, size_t chunk_idx) {
+    auto& out = chunk_matches[chunk_idx];
+    for (size_t i = begin; i < end; ++i)
+    {
+      const size_t obj_idx = has_candidates ? candidates[i] : i;
+      if (query.match(*m_objects[obj_idx]))
+        out.push_back(obj_idx);
+    }
+  });
+
+  for (auto& part : chunk_matches)
+    matches.insert(matches.end(), part.begin(), part.end());
+
+  auto t1 = std::chrono::steady_clock::now();
+  m_last_stats.matches = matches.size();
+  m_last_stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  return matches;
+}
+
+std::vector<CObjectSPtr> CSystemQueryIndex::select(const CSystem& sys, const CSystemQuery& query, size_t thread_cnt)
+{
+  std::vector<CObjectSPtr> objects;
+  for (auto idx : run(sys, query, thread_cnt))
+    objects.push_back(m_objects[idx]);
+  return objects;
+}
+
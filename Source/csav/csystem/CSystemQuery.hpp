@@ -0,0 +1,189 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <csav/csystem/CSystem.hpp>
+
+// Structural queries over the root objects of a CSystem.
+//
+//   query    := or
+//   or       := and ('||' and)*
+//   and      := unary ('&&' unary)*
+//   unary    := '!' unary | '(' or ')' | path [op literal]
+//   path     := segment ('.' segment | '[' index ']' | '[*]')*
+//   segment  := field name | '@type' | '@count'
+//   op       := '==' | '!=' | '<' | '<=' | '>' | '>=' | '~=' (contains, case insensitive)
+//   literal  := number | "string" | true | false | bare.word
+//
+// A path without comparison only tests that it can be reached (non-null
+// handles..). Paths go through object and handle properties, arrays are
+// expanded when they are not indexed and a comparison holds if any of the
+// reached values satisfies it (so "a != 1" and "!(a == 1)" differ for arrays).
+// '@type' is the ctypename of the current object, '@count' the element count
+// of an array.
+// TweakDBIDs, CNames and enums compare with names (or raw hashes), numbers
+// with numbers.
+//
+// examples:
+//   @type == vehicleGarageComponentPS
+//   @type == gameSavedStatsData && seed == 0x1234 && statModifiers.@count > 2
+
+enum class EQueryOp : uint8_t
+{
+  exists,
+  eq,
+  ne,
+  lt,
+  le,
+  gt,
+  ge,
+  contains,
+};
+
+class CSystemQuery
+{
+  friend class CSystemQueryIndex;
+
+public:
+  struct segment_t
+  {
+    enum class kind_t : uint8_t { field, index, any, type, count };
+
+    kind_t kind = kind_t::field;
+    uint32_t index = 0;
+    CSysName name; // fields only
+  };
+
+  using path_t = std::vector<segment_t>;
+
+  struct literal_t
+  {
+    std::string str;   // source text, or unquoted string
+    std::string lower; // for contains
+    bool is_bool = false;
+    bool is_number = false;
+    bool is_int = false;
+    bool is_negative = false;
+    bool b = false;
+    double num = 0;
+    uint64_t u64 = 0; // two's complement when negative
+
+    // precomputed for equality with names
+    CSysName sysname;
+    uint64_t tdbid = 0;
+    uint64_t cname = 0;
+  };
+
+protected:
+  struct expr_t
+  {
+    enum class kind_t : uint8_t { and_, or_, not_, cmp };
+
+    kind_t kind = kind_t::cmp;
+    uint32_t lhs = 0;
+    uint32_t rhs = 0;
+    EQueryOp op = EQueryOp::exists;
+    path_t path;
+    std::string path_text; // canonical form, key of the value indexes
+    literal_t lit;
+  };
+
+  std::string m_text;
+  std::vector<expr_t> m_exprs;
+  uint32_t m_root = 0;
+
+public:
+  CSystemQuery() = default;
+
+  [[nodiscard]] bool parse(std::string_view text, std::string& err);
+
+  bool empty() const { return m_exprs.empty(); }
+  const std::string& text() const { return m_text; }
+
+  // can be called concurrently
+  bool match(const CObject& obj) const;
+
+protected:
+  bool eval(uint32_t expr_idx, const CObject& obj) const;
+
+  // equality comparisons of the top-level conjunction
+  void collect_eq_terms(uint32_t expr_idx, std::vector<const expr_t*>& out) const;
+};
+
+// Lazily built indexes of a system's root objects:
+// - by ctypename, built on the first '@type ==' query,
+// - by value of a path, built once the path has been used hot_threshold
+//   times in equality comparisons of the top-level conjunction.
+// The indexes only select candidates that are then evaluated in parallel
+// with the full query.
+//
+// Value indexes are dropped when an indexed object posts an event, all the
+// indexes are rebuilt when the root objects have been added or removed.
+// Queries are run from one thread at a time.
+class CSystemQueryIndex
+  : public CObjectListener
+{
+public:
+  static constexpr uint32_t hot_threshold = 2;
+
+  struct run_stats_t
+  {
+    size_t candidates = 0;
+    size_t matches = 0;
+    bool used_type_index = false;
+    size_t used_value_indexes = 0;
+    double ms = 0;
+  };
+
+protected:
+  struct value_index_t
+  {
+    uint32_t use_cnt = 0;
+    bool built = false;
+    uint32_t tags = 0; // value tags present in map
+    std::unordered_map<uint64_t, std::vector<uint32_t>> map;
+  };
+
+  std::vector<CObjectSPtr> m_objects; // the indexes refer to this snapshot
+  bool m_has_type_index = false;
+  std::unordered_map<CSysName, std::vector<uint32_t>> m_by_type;
+  std::unordered_map<std::string, value_index_t> m_by_value;
+  bool m_values_stale = false;
+  uint64_t m_version = 0;
+  run_stats_t m_last_stats;
+
+public:
+  CSystemQueryIndex() = default;
+  ~CSystemQueryIndex() override;
+
+  CSystemQueryIndex(const CSystemQueryIndex&) = delete;
+  CSystemQueryIndex& operator=(const CSystemQueryIndex&) = delete;
+
+  // indices in sys.objects() of the matching objects, in order
+  std::vector<size_t> run(const CSystem& sys, const CSystemQuery& query, size_t thread_cnt = 0);
+
+  std::vector<CObjectSPtr> select(const CSystem& sys, const CSystemQuery& query, size_t thread_cnt = 0);
+
+  const run_stats_t& last_stats() const { return m_last_stats; }
+
+  // incremented when objects are edited, added or removed,
+  // results of previous runs are outdated if it changed
+  uint64_t version() const { return m_version; }
+
+  void clear();
+
+  void on_cobject_event(const CObject& obj, EObjectEvent evt) override;
+
+protected:
+  void sync_snapshot(const CSystem& sys);
+  void build_type_index();
+  void build_value_index(value_index_t& vi, const CSystemQuery::path_t& path, size_t thread_cnt);
+
+  // false if the index can't be used for this literal
+  bool lookup_value_index(const value_index_t& vi, const CSystemQuery::literal_t& lit, std::vector<uint32_t>& out) const;
+};
+
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <fstream>
 #include <fmt/format.h>
 #include <csav/csystem/fwd.hpp>
@@ -15,6 +16,10 @@ protected:
   std::vector<CObjectSPtr> m_objects;
   std::unordered_map<uintptr_t, uint32_t> m_ptrmap;
 
+  // highest handle resolved since last reset, tells CSystem which
+  // objects the serialized bytes of an object depend on
+  int64_t m_max_handle = -1;
+
   std::ofstream m_logfile;
 
 public:
@@ -53,10 +58,14 @@ public:
     const uintptr_t key = (uintptr_t)obj.get();
     auto it = m_ptrmap.find(key);
     if (it != m_ptrmap.end())
+    {
+      m_max_handle = std::max(m_max_handle, (int64_t)it->second);
       return it->second;
+    }
     uint32_t idx = (uint32_t)m_objects.size();
     m_ptrmap.emplace(key, idx);
     m_objects.push_back(obj);
+    m_max_handle = std::max(m_max_handle, (int64_t)idx);
     return idx;
   }
 
@@ -64,6 +73,7 @@ public:
   {
     if (handle >= m_objects.size())
       return nullptr;
+    m_max_handle = std::max(m_max_handle, (int64_t)handle);
     return m_objects[handle];
   }
 };
@@ -1,4 +1,5 @@
 #pragma once
+#include <atomic>
 #include <memory>
 #include <functional>
 #include <string>
@@ -25,6 +26,54 @@ struct node_listener_t
   virtual void on_node_event(const std::shared_ptr<const node_t>& node, node_event_e evt) = 0;
 };
 
+// Defers the node events posted on this thread while it is alive: at its end
+// each listener (other than parent nodes, which are updated immediately)
+// receives at most one event of each kind per node.
+// Nested batches are merged into the outermost one.
+class node_event_batch
+{
+  static inline thread_local node_event_batch* s_current = nullptr;
+
+  bool m_is_outermost = false;
+  std::vector<std::pair<std::shared_ptr<const node_t>, uint8_t>> m_events;
+  std::map<const node_t*, size_t> m_event_idx;
+
+public:
+  node_event_batch()
+  {
+    if (!s_current)
+    {
+      s_current = this;
+      m_is_outermost = true;
+    }
+  }
+
+  node_event_batch(const node_event_batch&) = delete;
+  node_event_batch& operator=(const node_event_batch&) = delete;
+
+  inline ~node_event_batch();
+
+  static node_event_batch* current() { return s_current; }
+
+  // returns false if the node already has an event of this kind pending
+  bool record(const std::shared_ptr<const node_t>& node, node_event_e evt)
+  {
+    const uint8_t bit = (uint8_t)(1 << (int)evt);
+    auto it = m_event_idx.find(node.get());
+    if (it == m_event_idx.end())
+    {
+      m_event_idx.emplace(node.get(), m_events.size());
+      m_events.emplace_back(node, bit);
+      return true;
+    }
+    auto& mask = m_events[it->second].second;
+    if (mask & bit)
+      return false;
+    mask |= bit;
+    return true;
+  }
+};
+
 class node_t
   : public std::enable_shared_from_this<const node_t>
   , public node_listener_t
@@ -42,6 +91,10 @@ private:
   std::vector<char> m_data;
   std::vector<std::shared_ptr<const node_t>> m_children;
 
+  // see content_hash()
+  mutable std::atomic<uint64_t> m_hash = 0;
+  mutable std::atomic<bool> m_hash_valid = false;
+
 public:
   explicit node_t(create_tag&&, int32_t idx, std::string name)
     : m_name(name)
@@ -131,14 +184,40 @@ public:
   std::shared_ptr<const node_t> deepcopy() const
   {
     // not cycle-safe, but shouldn't happen..
-    auto new_node = create_shared(0, name());
+    auto new_node = create_shared(m_idx, name());
     auto& nc = new_node->nonconst();
     for (auto& c : m_children)
+    {
       nc.m_children.push_back(c->deepcopy());
+      nc.m_children.back()->add_listener(&nc);
+    }
     nc.m_data = m_data;
     return new_node;
   }
 
+  // Hash of the subtree's content (kind, name, data and children hashes,
+  // not the index), computed lazily and cached until the node or one of its
+  // descendants posts an event.
+  // Must not be called concurrently with edits of the subtree.
+  uint64_t content_hash() const
+  {
+    if (m_hash_valid.load(std::memory_order_acquire))
+      return m_hash.load(std::memory_order_relaxed);
+
+    const uint64_t kind = is_cnode() ? 0 : (uint64_t)(-m_idx);
+    uint64_t h = hash64(m_name.data(), m_name.size(), kind);
+    h = hash64(m_data.data(), m_data.size(), h);
+    for (auto& c : m_children)
+    {
+      const uint64_t ch = c->content_hash();
+      h = hash64(&ch, sizeof(ch), h);
+    }
+
+    m_hash.store(h, std::memory_order_relaxed);
+    m_hash_valid.store(true, std::memory_order_release);
+    return h;
+  }
+
 public: 
   // non const setters
 
@@ -182,6 +261,23 @@ protected:
 
   void post_node_event(node_event_e evt) const
   {
+    // ancestors are invalidated by the subtree_update they post in turn
+    const bool had_hash = m_hash_valid.exchange(false, std::memory_order_acq_rel);
+
+    if (auto batch = node_event_batch::current())
+    {
+      // an invalid hash means the ancestors are already invalidated
+      if (!batch->record(shared_from_this(), evt) && !had_hash)
+        return;
+      std::set<node_listener_t*> listeners = m_listeners;
+      for (auto& l : listeners)
+      {
+        if (auto parent = dynamic_cast<node_t*>(l))
+          parent->on_node_event(shared_from_this(), evt);
+      }
+      return;
+    }
+
     std::set<node_listener_t*> listeners = m_listeners;
     for (auto& l : listeners) {
       l->on_node_event(shared_from_this(), evt);
@@ -207,8 +303,32 @@ public:
     auto& listeners = nonconst().m_listeners;
     listeners.erase(listener);
   }
+
+  std::set<node_listener_t*> listeners() const { return m_listeners; }
 };
 
+node_event_batch::~node_event_batch()
+{
+  if (!m_is_outermost)
+    return;
+  s_current = nullptr;
+
+  for (auto& [node, mask] : m_events)
+  {
+    const auto listeners = node->listeners();
+    for (auto& l : listeners)
+    {
+      if (dynamic_cast<node_t*>(l))
+        continue;
+      for (int evt = 0; evt <= (int)node_event_e::subtree_update; ++evt)
+      {
+        if (mask & (1 << evt))
+          l->on_node_event(node, (node_event_e)evt);
+      }
+    }
+  }
+}
+
 // only to read at node level
 // buffer and position in the istream is only relevant between child nodes
 class node_reader
@@ -388,6 +508,7 @@ struct node_serializable
   bool from_node(const std::shared_ptr<const node_t>& node, const csav_version& version)
   {
     has_valid_data = from_node_impl(node, version);
+    clear_dirty();
     return has_valid_data;
   }
 
@@ -398,8 +519,34 @@ struct node_serializable
     return nullptr;
   }
 
+  // dirty tracking: an unmodified structure doesn't need to be re-serialized,
+  // the node it was loaded from can be kept as is.
+
+  bool is_dirty() const { return m_is_dirty || is_dirty_impl(); }
+
+  // for edits that can't be detected by the structure itself (e.g. widgets)
+  void mark_dirty() { m_is_dirty = true; }
+
+  // to be called once to_node's result has been committed to the tree
+  void clear_dirty()
+  {
+    m_is_dirty = false;
+    clear_dirty_impl();
+  }
+
+  // structures that reuse their original bytes on to_node (CSystem) must
+  // re-encode everything after this, for reserialization checks
+  void drop_original_data() { drop_original_data_impl(); }
+
 private:
+  bool m_is_dirty = false;
+
   virtual bool from_node_impl(const std::shared_ptr<const node_t>& node, const csav_version& version) = 0;
   virtual std::shared_ptr<const node_t> to_node_impl(const csav_version& version) const = 0;
+
+  // structures able to track their own modifications (CSystem events) override these
+  virtual bool is_dirty_impl() const { return false; }
+  virtual void clear_dirty_impl() {}
+  virtual void drop_original_data_impl() {}
 };
 
@@ -0,0 +1,184 @@
+#include "node_diff.hpp"
+#include <csav/node_siblings.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+
+const char* node_diff_entry::kind_name(node_diff_kind kind)
+{
+  switch (kind)
+  {
+    case node_diff_kind::added: return "added";
+    case node_diff_kind::removed: return "removed";
+    case node_diff_kind::changed: return "changed";
+    default: break;
+  }
+  return "unknown";
+}
+
+bool node_diff::run(const std::shared_ptr<const node_t>& a, const std::shared_ptr<const node_t>& b)
+{
+  m_entries.clear();
+  m_stats = stats_t();
+  if (!a || !b)
+    return false;
+
+  auto t0 = std::chrono::steady_clock::now();
+  diff_pair(a, b, "");
+  auto t1 = std::chrono::steady_clock::now();
+  m_stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  return true;
+}
+
+void node_diff::diff_pair(const std::shared_ptr<const node_t>& a, const std::shared_ptr<const node_t>& b, const std::string& path)
+{
+  m_stats.compared_pairs++;
+  if (a->content_hash() == b->content_hash())
+  {
+    m_stats.pruned_subtrees++;
+    return;
+  }
+
+  if (a->data() != b->data())
+  {
+    node_diff_entry entry;
+    entry.kind = node_diff_kind::changed;
+    entry.path = path;
+    entry.a = a;
+    entry.b = b;
+    auto& da = a->data();
+    auto& db = b->data();
+    entry.ranges_truncated = !diff_bytes(da.data(), da.size(), db.data(), db.size(), entry.ranges);
+    m_entries.push_back(std::move(entry));
+  }
+
+  if (a->has_children() || b->has_children())
+    diff_children(*a, *b, path);
+}
+
+void node_diff::diff_children(const node_t& a, const node_t& b, const std::string& path)
+{
+  auto& ca = a.children();
+  auto& cb = b.children();
+  const size_t na = ca.size();
+  const size_t nb = cb.size();
+
+  // identical prefix and suffix, the usual case for saves of the same game
+  size_t prefix = 0;
+  while (prefix < na && prefix < nb && ca[prefix]->content_hash() == cb[prefix]->content_hash())
+    ++prefix;
+
+  size_t suffix = 0;
+  while (suffix < na - prefix && suffix < nb - prefix
+    && ca[na - 1 - suffix]->content_hash() == cb[nb - 1 - suffix]->content_hash())
+    ++suffix;
+
+  m_stats.pruned_subtrees += prefix + suffix;
+  if (prefix + suffix == na && prefix + suffix == nb)
+    return;
+
+  const auto keys_a = node_siblings(ca);
+  const auto keys_b = node_siblings(cb);
+
+  // middle children of b by name and occurrence
+  std::unordered_map<uint64_t, size_t> b_middle;
+  for (size_t j = prefix; j < nb - suffix; ++j)
+    b_middle.emplace(keys_b[j].key, j);
+
+  std::vector<bool> b_matched(nb, false);
+  for (size_t i = prefix; i < na - suffix; ++i)
+  {
+    auto& child = ca[i];
+    auto it = b_middle.find(keys_a[i].key);
+    if (it != b_middle.end())
+    {
+      const size_t j = it->second;
+      b_matched[j] = true;
+      const bool force_occ = !keys_a[i].name_is_unique || !keys_b[j].name_is_unique;
+      diff_pair(child, cb[j], node_child_path(path, keys_b[j], force_occ));
+      continue;
+    }
+
+    node_diff_entry entry;
+    entry.kind = node_diff_kind::removed;
+    entry.path = node_child_path(path, keys_a[i]);
+    entry.a = child;
+    m_entries.push_back(std::move(entry));
+  }
+
+  for (size_t j = prefix; j < nb - suffix; ++j)
+  {
+    if (b_matched[j])
+      continue;
+
+    node_diff_entry entry;
+    entry.kind = node_diff_kind::added;
+    entry.path = node_child_path(path, keys_b[j]);
+    entry.b = cb[j];
+    m_entries.push_back(std::move(entry));
+  }
+}
+
+bool node_diff::diff_bytes(
+  const char* a, size_t a_size, const char* b, size_t b_size,
+  std::vector<node_byte_range>& out, size_t max_ranges)
+{
+  const size_t n = std::min(a_size, b_size);
+
+  size_t prefix = 0;
+  while (prefix + 64 <= n && std::memcmp(a + prefix, b + prefix, 64) == 0)
+    prefix += 64;
+  while (prefix < n && a[prefix] == b[prefix])
+    ++prefix;
+
+  if (prefix == a_size && prefix == b_size)
+    return true;
+
+  size_t suffix = 0;
+  const size_t max_suffix = n - prefix;
+  while (suffix < max_suffix && a[a_size - 1 - suffix] == b[b_size - 1 - suffix])
+    ++suffix;
+
+  const size_t a_mid = a_size - prefix - suffix;
+  const size_t b_mid = b_size - prefix - suffix;
+
+  // insertion or removal: one range, no alignment of the middle
+  if (a_mid != b_mid)
+  {
+    out.push_back(node_byte_range{prefix, a_mid, prefix, b_mid});
+    return true;
+  }
+
+  const size_t end = prefix + a_mid;
+  size_t cnt = 0;
+  size_t i = prefix;
+  while (i < end)
+  {
+    while (i + 64 <= end && std::memcmp(a + i, b + i, 64) == 0)
+      i += 64;
+    while (i < end && a[i] == b[i])
+      ++i;
+    if (i >= end)
+      break;
+
+    if (cnt == max_ranges)
+      return false;
+
+    const size_t start = i;
+    size_t last_diff = i;
+    for (++i; i < end && i - last_diff <= range_merge_gap; ++i)
+    {
+      if (a[i] != b[i])
+        last_diff = i;
+    }
+
+    const size_t size = last_diff + 1 - start;
+    out.push_back(node_byte_range{start, size, start, size});
+    ++cnt;
+    i = last_diff + 1;
+  }
+
+  return true;
+}
+
@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <csav/node.hpp>
+
+// Structural diff of two node trees (typically the roots of two saves).
+//
+// Subtrees with equal content hashes are skipped without being visited, so
+// once the hashes are cached the cost is proportional to the changed
+// subtrees, the first diff of a tree only pays for hashing it.
+// Children are aligned on their common prefix and suffix, the remaining ones
+// are matched by name and occurrence among their siblings.
+
+enum class node_diff_kind : uint8_t
+{
+  added,
+  removed,
+  changed,
+};
+
+// [a_offset, a_offset + a_size) in a's data became
+// [b_offset, b_offset + b_size) in b's data
+struct node_byte_range
+{
+  size_t a_offset = 0;
+  size_t a_size = 0;
+  size_t b_offset = 0;
+  size_t b_size = 0;
+};
+
+struct node_diff_entry
+{
+  node_diff_kind kind = node_diff_kind::changed;
+  std::string path; // names from the root, "name[i]" for the i-th sibling of a name
+  std::shared_ptr<const node_t> a; // null if added
+  std::shared_ptr<const node_t> b; // null if removed
+  std::vector<node_byte_range> ranges; // changed entries only
+  bool ranges_truncated = false;
+
+  static const char* kind_name(node_diff_kind kind);
+};
+
+class node_diff
+{
+public:
+  static constexpr size_t max_ranges_per_node = 1024;
+  // differing runs separated by fewer equal bytes are reported as one range
+  static constexpr size_t range_merge_gap = 8;
+
+  struct stats_t
+  {
+    size_t compared_pairs = 0;
+    size_t pruned_subtrees = 0;
+    double ms = 0;
+  };
+
+protected:
+  std::vector<node_diff_entry> m_entries;
+  stats_t m_stats;
+
+public:
+  node_diff() = default;
+
+  // diffs b against a, false if one of them is null
+  [[nodiscard]] bool run(const std::shared_ptr<const node_t>& a, const std::shared_ptr<const node_t>& b);
+
+  const std::vector<node_diff_entry>& entries() const { return m_entries; }
+  const stats_t& stats() const { return m_stats; }
+
+  // changed ranges between two buffers, returns false if max_ranges was reached
+  static bool diff_bytes(
+    const char* a, size_t a_size, const char* b, size_t b_size,
+    std::vector<node_byte_range>& out, size_t max_ranges = max_ranges_per_node);
+
+protected:
+  void diff_pair(const std::shared_ptr<const node_t>& a, const std::shared_ptr<const node_t>& b, const std::string& path);
+  void diff_children(const node_t& a, const node_t& b, const std::string& path);
+};
+
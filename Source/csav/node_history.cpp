@@ -0,0 +1,233 @@
+#include "node_history.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+void node_history::reset(const std::shared_ptr<const node_t>& root, std::string label)
+{
+  m_root = root;
+  m_entries.clear();
+  m_cur = 0;
+  m_stats = stats_t();
+  if (!root)
+    return;
+
+  auto t0 = std::chrono::steady_clock::now();
+  m_entries.push_back({std::move(label), freeze(root, nullptr), std::chrono::system_clock::now()});
+  auto t1 = std::chrono::steady_clock::now();
+  m_stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+bool node_history::is_unchanged() const
+{
+  return m_entries[m_cur].root->hash == m_root->content_hash();
+}
+
+bool node_history::capture(std::string label)
+{
+  if (!m_root || m_entries.empty() || is_unchanged())
+    return false;
+
+  auto t0 = std::chrono::steady_clock::now();
+  m_stats = stats_t();
+  auto snap = freeze(m_root, m_entries[m_cur].root);
+
+  m_entries.resize(m_cur + 1);
+  m_entries.push_back({std::move(label), std::move(snap), std::chrono::system_clock::now()});
+  if (m_entries.size() > m_max_entries)
+    m_entries.erase(m_entries.begin());
+  m_cur = m_entries.size() - 1;
+
+  auto t1 = std::chrono::steady_clock::now();
+  m_stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  return true;
+}
+
+bool node_history::undo()
+{
+  if (!m_root || m_entries.empty())
+    return false;
+  capture("edit");
+  return can_undo() && jump(m_cur - 1);
+}
+
+bool node_history::redo()
+{
+  // pending changes drop the entries to redo
+  if (!m_root || m_entries.empty() || capture("edit"))
+    return false;
+  return can_redo() && jump(m_cur + 1);
+}
+
+bool node_history::jump(size_t entry_idx)
+{
+  if (!m_root || entry_idx >= m_entries.size())
+    return false;
+
+  // pending changes are captured first: the entries to redo are dropped and
+  // the oldest one may be evicted, entry_idx is re-based on the others
+  const size_t prev_cur = m_cur;
+  if (capture("edit"))
+  {
+    if (entry_idx > prev_cur)
+      return false;
+    const size_t evicted = prev_cur + 1 - m_cur;
+    if (entry_idx < evicted)
+      return false;
+    entry_idx -= evicted;
+  }
+
+  if (entry_idx == m_cur)
+    return true;
+
+  auto t0 = std::chrono::steady_clock::now();
+  m_stats = stats_t();
+  {
+    node_event_batch batch;
+    restore(m_root, m_entries[entry_idx].root, m_entries[m_cur].root);
+  }
+  m_cur = entry_idx;
+
+  auto t1 = std::chrono::steady_clock::now();
+  m_stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  return true;
+}
+
+node_history::snap_sptr node_history::freeze(const node_sptr& live, const snap_sptr& prev)
+{
+  // the index isn't part of the hash but is renumbered on save anyway
+  const uint64_t hash = live->content_hash();
+  if (prev && prev->hash == hash)
+  {
+    prev->source = live;
+    m_stats.shared_nodes++;
+    return prev;
+  }
+
+  auto snap = std::make_shared<node_snapshot>();
+  snap->idx = live->idx();
+  snap->name = live->name();
+  snap->hash = hash;
+  snap->source = live;
+  m_stats.new_nodes++;
+
+  if (prev && *prev->data == live->data())
+    snap->data = prev->data;
+  else
+    snap->data = std::make_shared<const std::vector<char>>(live->data());
+
+  // children are matched with the previous ones by live node, then content
+  std::unordered_map<const node_t*, snap_sptr> prev_by_source;
+  std::unordered_map<uint64_t, snap_sptr> prev_by_hash;
+  if (prev)
+  {
+    for (auto& pc : prev->children)
+    {
+      if (auto src = pc->source.lock())
+        prev_by_source.emplace(src.get(), pc);
+      prev_by_hash.emplace(pc->hash, pc);
+    }
+  }
+
+  snap->children.reserve(live->children().size());
+  for (auto& lc : live->children())
+  {
+    snap_sptr pc;
+    auto it = prev_by_source.find(lc.get());
+    if (it != prev_by_source.end())
+      pc = it->second;
+    else
+    {
+      auto hit = prev_by_hash.find(lc->content_hash());
+      if (hit != prev_by_hash.end())
+        pc = hit->second;
+    }
+    snap->children.push_back(freeze(lc, pc));
+  }
+
+  return snap;
+}
+
+node_history::node_sptr node_history::materialize(const snap_sptr& snap)
+{
+  auto node = node_t::create_shared(snap->idx, snap->name);
+  auto& nc = node->nonconst();
+  nc.assign_data(*snap->data);
+
+  std::vector<node_sptr> children;
+  children.reserve(snap->children.size());
+  for (auto& sc : snap->children)
+    children.push_back(materialize(sc));
+  if (children.size())
+    nc.assign_children(children);
+
+  m_stats.patched_nodes++;
+  snap->source = node;
+  return node;
+}
+
+void node_history::restore(const node_sptr& live, const snap_sptr& target, const snap_sptr& cur)
+{
+  // cur is the snapshot live is in sync with, if known
+  if (cur == target)
+    return;
+
+  if (live->content_hash() == target->hash)
+  {
+    target->source = live;
+    return;
+  }
+
+  m_stats.patched_nodes++;
+  auto& nc = live->nonconst();
+  if (live->data() != *target->data)
+    nc.assign_data(*target->data);
+
+  // live nodes are only reused among the current children, so that a node
+  // never ends up with two parents
+  const auto& live_children = live->children();
+  const bool in_sync = cur && cur->children.size() == live_children.size();
+
+  std::unordered_map<const node_snapshot*, size_t> idx_by_snap;
+  std::unordered_map<const node_t*, size_t> idx_by_node;
+  for (size_t i = 0; i < live_children.size(); ++i)
+  {
+    if (in_sync)
+      idx_by_snap.emplace(cur->children[i].get(), i);
+    idx_by_node.emplace(live_children[i].get(), i);
+  }
+
+  std::vector<bool> taken(live_children.size(), false);
+  std::vector<node_sptr> new_children;
+  new_children.reserve(target->children.size());
+
+  for (auto& tc : target->children)
+  {
+    size_t i = live_children.size();
+
+    auto it = idx_by_snap.find(tc.get());
+    if (it != idx_by_snap.end() && !taken[it->second])
+      i = it->second;
+    else if (auto src = tc->source.lock())
+    {
+      auto nit = idx_by_node.find(src.get());
+      if (nit != idx_by_node.end() && !taken[nit->second])
+        i = nit->second;
+    }
+
+    if (i == live_children.size())
+    {
+      new_children.push_back(materialize(tc));
+      continue;
+    }
+
+    taken[i] = true;
+    restore(live_children[i], tc, in_sync ? cur->children[i] : nullptr);
+    new_children.push_back(live_children[i]);
+  }
+
+  if (new_children != live_children)
+    nc.assign_children(new_children);
+
+  target->source = live;
+}
+
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <csav/node.hpp>
+
+// Undo/redo history of a node tree.
+//
+// Each entry is a frozen copy of the tree made of node_snapshot, a snapshot
+// shares every subtree whose content didn't change with the previous one
+// (path copying), so that an entry costs memory in proportion to its edit.
+// Unchanged subtrees are found with content_hash(), which stays cached
+// for the nodes no event went through, so capturing only visits the paths
+// from the root to the edits.
+//
+// Jumping to an entry does the reverse: the live tree is patched where its
+// snapshot differs from the target's, reusing the live nodes (their
+// editors stay attached) and within a node_event_batch, so that each
+// listener is notified once per jump.
+//
+// The first entry is a full copy of the tree's data, the next ones share it.
+
+struct node_snapshot
+{
+  int32_t idx = node_t::null_node_idx;
+  std::string name;
+  std::shared_ptr<const std::vector<char>> data;
+  std::vector<std::shared_ptr<const node_snapshot>> children;
+  uint64_t hash = 0; // content_hash() of the node it was taken from
+
+  // last live node known to have this content, reused on jumps
+  mutable std::weak_ptr<const node_t> source;
+};
+
+class node_history
+{
+public:
+  struct entry_t
+  {
+    std::string label;
+    std::shared_ptr<const node_snapshot> root;
+    std::chrono::system_clock::time_point time;
+  };
+
+  struct stats_t
+  {
+    size_t new_nodes = 0;    // snapshot nodes created by the last capture
+    size_t shared_nodes = 0; // subtrees reused by the last capture
+    size_t patched_nodes = 0; // live nodes modified by the last jump
+    double ms = 0;
+  };
+
+protected:
+  std::shared_ptr<const node_t> m_root;
+  std::vector<entry_t> m_entries;
+  size_t m_cur = 0;
+  size_t m_max_entries = 200;
+  stats_t m_stats;
+
+public:
+  node_history() = default;
+
+  explicit node_history(size_t max_entries)
+    : m_max_entries(std::max<size_t>(2, max_entries)) {}
+
+  // clears the history, its first entry is root's current state
+  void reset(const std::shared_ptr<const node_t>& root, std::string label = "opened");
+
+  // appends the current state of the tree if it changed since the current
+  // entry, entries after the current one (redo) are dropped.
+  // Must not be called concurrently with edits of the tree.
+  bool capture(std::string label);
+
+  bool can_undo() const { return m_cur > 0; }
+  bool can_redo() const { return m_cur + 1 < m_entries.size(); }
+
+  // pending changes are captured first, so that they can be redone.
+  // jump fails if that capture dropped the entry (redo or evicted one)
+  bool undo();
+  bool redo();
+  bool jump(size_t entry_idx);
+
+  const std::shared_ptr<const node_t>& root() const { return m_root; }
+  const std::vector<entry_t>& entries() const { return m_entries; }
+  size_t current() const { return m_cur; }
+  const stats_t& stats() const { return m_stats; }
+
+protected:
+  using snap_sptr = std::shared_ptr<const node_snapshot>;
+  using node_sptr = std::shared_ptr<const node_t>;
+
+  snap_sptr freeze(const node_sptr& live, const snap_sptr& prev);
+  node_sptr materialize(const snap_sptr& snap);
+  void restore(const node_sptr& live, const snap_sptr& target, const snap_sptr& cur);
+  bool is_unchanged() const;
+};
+
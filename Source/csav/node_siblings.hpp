@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <utils.hpp>
+#include <csav/node.hpp>
+
+// Identity of a node among its siblings, for the tree comparisons (diff,
+// merge): siblings are matched by name and occurrence of that name, since
+// indexes shift on insertions and names repeat (e.g. item lists).
+
+struct node_sibling_t
+{
+  std::string name;
+  uint32_t occurrence = 0; // among the siblings with the same name
+  bool name_is_unique = true;
+  uint64_t key = 0; // hash of name and occurrence
+};
+
+inline std::vector<node_sibling_t> node_siblings(const std::vector<std::shared_ptr<const node_t>>& children)
+{
+  std::vector<node_sibling_t> res(children.size());
+  std::unordered_map<std::string, uint32_t> counts;
+  for (size_t i = 0; i < children.size(); ++i)
+  {
+    auto& s = res[i];
+    s.name = children[i]->name();
+    s.occurrence = counts[s.name]++;
+    s.key = hash64(&s.occurrence, sizeof(s.occurrence), hash64(s.name.data(), s.name.size()));
+  }
+  for (auto& s : res)
+    s.name_is_unique = counts[s.name] == 1;
+  return res;
+}
+
+// "parent/name", "parent/name[occurrence]" when the name repeats among the
+// siblings or if force_occurrence is set
+inline std::string node_child_path(const std::string& parent_path, const node_sibling_t& s, bool force_occurrence = false)
+{
+  std::string path = parent_path;
+  if (path.size())
+    path += '/';
+  path += s.name;
+  if (!s.name_is_unique || force_occurrence)
+    path += "[" + std::to_string(s.occurrence) + "]";
+  return path;
+}
@@ -0,0 +1,245 @@
+#include "piece_table.hpp"
+#include <algorithm>
+#include <cstring>
+
+void piece_table::assign(std::vector<char> data)
+{
+  m_original = std::make_shared<const std::vector<char>>(std::move(data));
+  m_added.clear();
+  m_roots.clear();
+  m_cur = 0;
+  m_cache = nullptr;
+  m_original_root = m_original->empty() ? nullptr : make_leaf(false, 0, m_original->size());
+  m_roots.push_back(m_original_root);
+}
+
+char piece_table::at(size_t off) const
+{
+  if (m_cache && off >= m_cache_pos && off < m_cache_pos + m_cache->len)
+    return piece_data(*m_cache)[off - m_cache_pos];
+
+  const piece_node* t = root().get();
+  size_t base = 0;
+  while (t)
+  {
+    const size_t lsz = total(t->left);
+    if (off < base + lsz)
+    {
+      t = t->left.get();
+      continue;
+    }
+    base += lsz;
+    if (off < base + t->len)
+    {
+      m_cache = t;
+      m_cache_pos = base;
+      return piece_data(*t)[off - base];
+    }
+    base += t->len;
+    t = t->right.get();
+  }
+  return 0;
+}
+
+void piece_table::read_impl(const piece_node* t, size_t off, size_t len, char*& out) const
+{
+  // off is relative to t's subtree, [off, off + len) is within it
+  while (t && len)
+  {
+    const size_t lsz = total(t->left);
+    if (off < lsz)
+    {
+      const size_t n = std::min(len, lsz - off);
+      read_impl(t->left.get(), off, n, out);
+      off += n;
+      len -= n;
+    }
+    if (!len)
+      break;
+
+    off -= lsz;
+    if (off < t->len)
+    {
+      const size_t n = std::min(len, t->len - off);
+      std::memcpy(out, piece_data(*t) + off, n);
+      out += n;
+      off += n;
+      len -= n;
+    }
+    off -= t->len;
+    t = t->right.get();
+  }
+}
+
+void piece_table::read(size_t off, size_t len, char* out) const
+{
+  const size_t sz = size();
+  if (off >= sz)
+    return;
+  len = std::min(len, sz - off);
+  read_impl(root().get(), off, len, out);
+}
+
+std::vector<char> piece_table::read(size_t off, size_t len) const
+{
+  const size_t sz = size();
+  if (off >= sz)
+    return {};
+  std::vector<char> ret(std::min(len, sz - off));
+  read(off, ret.size(), ret.data());
+  return ret;
+}
+
+void piece_table::insert(size_t off, const char* data, size_t len)
+{
+  replace(off, 0, data, len);
+}
+
+void piece_table::erase(size_t off, size_t len)
+{
+  replace(off, len, nullptr, 0);
+}
+
+void piece_table::replace(size_t off, size_t len, const char* data, size_t data_len)
+{
+  const size_t sz = size();
+  off = std::min(off, sz);
+  len = std::min(len, sz - off);
+  if (!len && !data_len)
+    return;
+
+  node_sptr right;
+  node_sptr left = split_at(root(), off, right);
+  node_sptr tail;
+  split_at(right, len, tail);
+
+  if (data_len)
+  {
+    const size_t add_off = m_added.size();
+    m_added.insert(m_added.end(), data, data + data_len);
+    left = merge(left, make_leaf(true, add_off, data_len));
+  }
+
+  push_root(merge(left, tail));
+}
+
+bool piece_table::undo()
+{
+  if (!can_undo())
+    return false;
+  --m_cur;
+  m_cache = nullptr;
+  return true;
+}
+
+bool piece_table::redo()
+{
+  if (!can_redo())
+    return false;
+  ++m_cur;
+  m_cache = nullptr;
+  return true;
+}
+
+size_t piece_table::piece_count() const
+{
+  size_t cnt = 0;
+  std::vector<const piece_node*> stack;
+  if (root())
+    stack.push_back(root().get());
+  while (stack.size())
+  {
+    auto t = stack.back();
+    stack.pop_back();
+    ++cnt;
+    if (t->left)
+      stack.push_back(t->left.get());
+    if (t->right)
+      stack.push_back(t->right.get());
+  }
+  return cnt;
+}
+
+piece_table::node_sptr piece_table::make_leaf(bool added, size_t off, size_t len)
+{
+  // xorshift32
+  m_seed ^= m_seed << 13;
+  m_seed ^= m_seed >> 17;
+  m_seed ^= m_seed << 5;
+
+  auto n = std::make_shared<piece_node>();
+  n->added = added;
+  n->off = off;
+  n->len = len;
+  n->total = len;
+  n->prio = m_seed;
+  return n;
+}
+
+piece_table::node_sptr piece_table::with_children(const piece_node& p, node_sptr left, node_sptr right)
+{
+  auto n = std::make_shared<piece_node>();
+  n->added = p.added;
+  n->off = p.off;
+  n->len = p.len;
+  n->prio = p.prio;
+  n->total = total(left) + p.len + total(right);
+  n->left = std::move(left);
+  n->right = std::move(right);
+  return n;
+}
+
+piece_table::node_sptr piece_table::merge(const node_sptr& a, const node_sptr& b)
+{
+  if (!a)
+    return b;
+  if (!b)
+    return a;
+  if (a->prio > b->prio)
+    return with_children(*a, a->left, merge(a->right, b));
+  return with_children(*b, merge(a, b->left), b->right);
+}
+
+piece_table::node_sptr piece_table::split_at(const node_sptr& t, size_t pos, node_sptr& right)
+{
+  // returns the pieces before pos, right receives the others
+  if (!t)
+  {
+    right = nullptr;
+    return nullptr;
+  }
+
+  const size_t lsz = total(t->left);
+  if (pos <= lsz)
+  {
+    node_sptr lr;
+    node_sptr ll = split_at(t->left, pos, lr);
+    right = (lr == t->left) ? t : with_children(*t, lr, t->right);
+    return ll;
+  }
+
+  if (pos >= lsz + t->len)
+  {
+    node_sptr rl = split_at(t->right, pos - lsz - t->len, right);
+    return (rl == t->right) ? t : with_children(*t, t->left, rl);
+  }
+
+  // pos is inside this piece, it's cut in two
+  const size_t k = pos - lsz;
+  right = merge(make_leaf(t->added, t->off + k, t->len - k), t->right);
+  return merge(t->left, make_leaf(t->added, t->off, k));
+}
+
+void piece_table::push_root(node_sptr root)
+{
+  m_roots.resize(m_cur + 1);
+  m_roots.push_back(std::move(root));
+  if (m_roots.size() > m_max_undo + 1)
+  {
+    // the oldest state is dropped, the current one is still reachable
+    m_roots.erase(m_roots.begin());
+  }
+  m_cur = m_roots.size() - 1;
+  m_cache = nullptr;
+}
+
@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// Editable byte buffer over an immutable original (e.g. the data of a node).
+//
+// The content is a sequence of pieces, each a range of either the original
+// or an append-only buffer holding the inserted bytes. Pieces are kept in a
+// treap ordered by position, with their subtree's byte count, so that
+// locating an offset, inserting or erasing is O(log pieces) whatever the
+// size of the data.
+// The treap is persistent: an edit copies the O(log n) nodes on its path
+// and shares the others, each edit keeps its root for undo/redo.
+//
+// to_vector() materializes the content, e.g. to commit it to a node.
+
+class piece_table
+{
+  struct piece_node;
+  using node_sptr = std::shared_ptr<const piece_node>;
+
+  struct piece_node
+  {
+    bool added = false; // in m_added, else in m_original
+    size_t off = 0;
+    size_t len = 0;
+    size_t total = 0; // bytes in this subtree
+    uint32_t prio = 0;
+    node_sptr left, right;
+  };
+
+  std::shared_ptr<const std::vector<char>> m_original;
+  std::vector<char> m_added; // append-only, pieces of undone edits stay valid
+
+  node_sptr m_original_root;
+  std::vector<node_sptr> m_roots; // one per edit, oldest first
+  size_t m_cur = 0;
+  size_t m_max_undo = 1000;
+  uint32_t m_seed = 0x9E3779B9;
+
+  // last piece found by at(), consecutive reads mostly hit it
+  mutable const piece_node* m_cache = nullptr;
+  mutable size_t m_cache_pos = 0;
+
+public:
+  piece_table() { assign(std::vector<char>()); }
+
+  explicit piece_table(std::vector<char> data) { assign(std::move(data)); }
+
+  piece_table(const piece_table&) = delete;
+  piece_table& operator=(const piece_table&) = delete;
+
+  // resets the content and clears the history
+  void assign(std::vector<char> data);
+
+  size_t size() const { return total(root()); }
+  bool empty() const { return size() == 0; }
+
+  // off must be < size()
+  char at(size_t off) const;
+
+  // copies [off, off + len) clamped to size()
+  void read(size_t off, size_t len, char* out) const;
+  std::vector<char> read(size_t off, size_t len) const;
+
+  std::vector<char> to_vector() const { return read(0, size()); }
+
+  const std::vector<char>& original() const { return *m_original; }
+
+  // one undo step each
+  void insert(size_t off, const char* data, size_t len);
+  void erase(size_t off, size_t len);
+  void replace(size_t off, size_t len, const char* data, size_t data_len);
+  void write(size_t off, char value) { replace(off, 1, &value, 1); }
+
+  bool can_undo() const { return m_cur > 0; }
+  bool can_redo() const { return m_cur + 1 < m_roots.size(); }
+  bool undo();
+  bool redo();
+
+  // false once the edits have all been undone
+  bool is_modified() const { return root() != m_original_root; }
+
+  size_t piece_count() const;
+
+protected:
+  const node_sptr& root() const { return m_roots[m_cur]; }
+
+  static size_t total(const node_sptr& t) { return t ? t->total : 0; }
+
+  const char* piece_data(const piece_node& p) const
+  {
+    return (p.added ? m_added.data() : m_original->data()) + p.off;
+  }
+
+  node_sptr make_leaf(bool added, size_t off, size_t len);
+  static node_sptr with_children(const piece_node& p, node_sptr left, node_sptr right);
+  static node_sptr merge(const node_sptr& a, const node_sptr& b);
+  node_sptr split_at(const node_sptr& t, size_t pos, node_sptr& right);
+
+  void push_root(node_sptr root);
+  void read_impl(const piece_node* t, size_t off, size_t len, char*& out) const;
+};
+
@@ -0,0 +1,268 @@
+#pragma once
+#include <mutex>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <cstring>
+#include <fmt/format.h>
+#include <csav/node.hpp>
+#include <job_scheduler.hpp>
+
+
+// Streams a node subtree in serial_tree's flattened layout
+// (preorder, cnodes are prefixed with their u32 index) without copying it.
+// Indices are counted from 0 at the given node, like the reserialization
+// test used to do with a temporary root.
+class node_flat_stream
+{
+  struct frame_t
+  {
+    const node_t* node;
+    size_t next_child;
+  };
+
+  const node_t* m_start = nullptr;
+  const node_t* m_pending_data = nullptr;
+  const node_t* m_cur_node = nullptr;
+  std::vector<frame_t> m_stack;
+  uint32_t m_next_idx = 0;
+  uint32_t m_idx_buf = 0;
+
+public:
+  explicit node_flat_stream(const node_t& node)
+    : m_start(&node) {}
+
+  // returns false at the end of the stream, chunks are never empty
+  bool next(const char*& data, size_t& size)
+  {
+    for (;;)
+    {
+      if (m_pending_data)
+      {
+        const node_t* node = m_pending_data;
+        m_pending_data = nullptr;
+        m_stack.push_back({node, 0});
+        if (node->data().size())
+        {
+          data = node->data().data();
+          size = node->data().size();
+          return true;
+        }
+        continue;
+      }
+
+      const node_t* node = nullptr;
+      if (m_start)
+      {
+        node = m_start;
+        m_start = nullptr;
+      }
+      else
+      {
+        if (m_stack.empty())
+          return false;
+        auto& frame = m_stack.back();
+        if (frame.next_child >= frame.node->children().size())
+        {
+          m_stack.pop_back();
+          continue;
+        }
+        node = frame.node->children()[frame.next_child++].get();
+      }
+
+      m_cur_node = node;
+      m_pending_data = node;
+      if (node->is_cnode())
+      {
+        m_idx_buf = m_next_idx++;
+        data = (const char*)&m_idx_buf;
+        size = sizeof(m_idx_buf);
+        return true;
+      }
+    }
+  }
+
+  // path of the node that owns the last chunk
+  std::string current_path() const
+  {
+    std::string path;
+    for (auto& frame : m_stack)
+    {
+      if (path.size())
+        path += '/';
+      path += frame.node->name();
+    }
+    if (m_cur_node && (m_stack.empty() || m_stack.back().node != m_cur_node))
+    {
+      if (path.size())
+        path += '/';
+      path += m_cur_node->name();
+    }
+    return path;
+  }
+};
+
+
+struct reserialization_mismatch
+{
+  size_t offset = 0;      // in the flattened subtree
+  std::string node_path;  // of the node containing offset
+};
+
+// compares the flattened representations of two subtrees chunk by chunk
+inline bool compare_flattened_nodes(const node_t& a, const node_t& b, reserialization_mismatch& mismatch)
+{
+  node_flat_stream sa(a), sb(b);
+  const char* pa = nullptr;
+  const char* pb = nullptr;
+  size_t na = 0, nb = 0;
+  size_t offset = 0;
+
+  for (;;)
+  {
+    if (!na)
+      std::ignore = sa.next(pa, na);
+    if (!nb)
+      std::ignore = sb.next(pb, nb);
+
+    if (!na || !nb)
+    {
+      if (!na && !nb)
+        return true;
+      mismatch.offset = offset;
+      mismatch.node_path = na ? sa.current_path() : sb.current_path();
+      return false;
+    }
+
+    const size_t n = std::min(na, nb);
+    if (std::memcmp(pa, pb, n))
+    {
+      size_t i = 0;
+      while (pa[i] == pb[i])
+        ++i;
+      mismatch.offset = offset + i;
+      mismatch.node_path = sa.current_path();
+      return false;
+    }
+
+    pa += n; na -= n;
+    pb += n; nb -= n;
+    offset += n;
+  }
+}
+
+inline bool dump_flattened_node(const node_t& node, const std::string& filename)
+{
+  std::ofstream ofs;
+  ofs.open(filename, ofs.out | ofs.binary);
+  if (!ofs.is_open())
+    return false;
+
+  node_flat_stream stream(node);
+  const char* data = nullptr;
+  size_t size = 0;
+  while (stream.next(data, size))
+    ofs.write(data, size);
+  return ofs.good();
+}
+
+
+// Runs the reserialization checks of a loaded save in a job_scheduler job,
+// each check is a subtask that handles one structure and doesn't touch the
+// save's instances.
+class reserialization_checker
+{
+public:
+  struct result_t
+  {
+    std::string node_name;
+    bool ok = false;
+    std::string error;
+    reserialization_mismatch mismatch;
+  };
+
+  using check_fn_t = std::function<result_t()>;
+
+protected:
+  mutable std::mutex m_job_mtx;
+  job_scheduler::job_ptr m_job;
+  std::vector<check_fn_t> m_checks;
+
+  mutable std::mutex m_results_mtx;
+  std::vector<result_t> m_results;
+
+public:
+  reserialization_checker() = default;
+  reserialization_checker(const reserialization_checker&) = delete;
+  reserialization_checker& operator=(const reserialization_checker&) = delete;
+
+  ~reserialization_checker()
+  {
+    wait();
+  }
+
+  bool start(std::vector<check_fn_t> checks)
+  {
+    std::lock_guard<std::mutex> lk_job(m_job_mtx);
+    if (m_job && !m_job->is_done())
+      return false;
+
+    m_checks = std::move(checks);
+    {
+      std::lock_guard<std::mutex> lk(m_results_mtx);
+      m_results.clear();
+    }
+
+    m_job = job_scheduler::get().submit([this](progress_t&) {
+      job_scheduler::get().parallel_for(m_checks.size(), [this](size_t i) { run_check(i); });
+      return true;
+    });
+    return true;
+  }
+
+  bool is_running() const
+  {
+    std::lock_guard<std::mutex> lk(m_job_mtx);
+    return m_job && !m_job->is_done();
+  }
+
+  // save and ui threads may both call it, a job that didn't start yet runs
+  // on the calling thread
+  void wait()
+  {
+    job_scheduler::job_ptr job;
+    {
+      std::lock_guard<std::mutex> lk(m_job_mtx);
+      job = m_job;
+    }
+    job_scheduler::get().wait(job);
+  }
+
+  std::vector<result_t> results() const
+  {
+    std::lock_guard<std::mutex> lk(m_results_mtx);
+    return m_results;
+  }
+
+protected:
+  void run_check(size_t i)
+  {
+    result_t res;
+    try
+    {
+      res = m_checks[i]();
+    }
+    catch (std::exception& e)
+    {
+      res.ok = false;
+      res.error = e.what();
+    }
+
+    std::lock_guard<std::mutex> lk(m_results_mtx);
+    m_results.push_back(std::move(res));
+  }
+};
+
@@ -0,0 +1,715 @@
+#include "save_merge.hpp"
+#include <chrono>
+#include <iterator>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+#include <fmt/format.h>
+#include <utils.hpp>
+#include <job_scheduler.hpp>
+#include <csav/cnodes.hpp>
+#include <csav/node_siblings.hpp>
+#include <csav/csystem/CSystem.hpp>
+
+const char* save_merge_conflict::kind_name(save_merge_conflict_kind kind)
+{
+  switch (kind)
+  {
+    case save_merge_conflict_kind::both_modified: return "both modified";
+    case save_merge_conflict_kind::both_added: return "both added";
+    case save_merge_conflict_kind::modified_deleted: return "modified/deleted";
+    case save_merge_conflict_kind::deleted_modified: return "deleted/modified";
+    case save_merge_conflict_kind::load_failed: return "load failed";
+    default: break;
+  }
+  return "unknown";
+}
+
+bool save_merge::run(const save_merge_input& base, const save_merge_input& ours, const save_merge_input& theirs, std::string& err)
+{
+  m_result.reset();
+  m_conflicts.clear();
+  m_stats = stats_t();
+
+  if (!base.root || !ours.root || !theirs.root)
+  {
+    err = "the three saves must be loaded";
+    return false;
+  }
+
+  m_base_ver = base.ver;
+  m_ours_ver = ours.ver;
+  m_theirs_ver = theirs.ver;
+
+  auto t0 = std::chrono::steady_clock::now();
+  try
+  {
+    m_result = merge_node(base.root, ours.root, theirs.root, "");
+  }
+  catch (std::exception& e)
+  {
+    err = e.what();
+    m_result.reset();
+    return false;
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  m_stats.ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+  return true;
+}
+
+void save_merge::add_conflict(save_merge_conflict_kind kind, const std::string& path, std::string detail)
+{
+  save_merge_conflict c;
+  c.kind = kind;
+  c.path = path;
+  c.detail = std::move(detail);
+  m_conflicts.push_back(std::move(c));
+}
+
+namespace {
+
+inline uint64_t mix(uint64_t h, uint64_t v)
+{
+  return hash64(&v, sizeof(v), h);
+}
+
+// Position of an entry of the merged sequence in each of the three ones.
+// Entries follow theirs' order, ours' additions are placed after their
+// closest preceding sibling that theirs has too.
+struct aligned_t
+{
+  int64_t b = -1;
+  int64_t o = -1;
+  int64_t t = -1;
+};
+
+template <typename T>
+std::unordered_map<uint64_t, int64_t> index_keys(const std::vector<T>& v)
+{
+  std::unordered_map<uint64_t, int64_t> m;
+  m.reserve(v.size());
+  for (size_t i = 0; i < v.size(); ++i)
+    m.emplace(v[i].key, (int64_t)i);
+  return m;
+}
+
+inline int64_t find_key(const std::unordered_map<uint64_t, int64_t>& m, uint64_t key)
+{
+  auto it = m.find(key);
+  return it == m.end() ? -1 : it->second;
+}
+
+// T has a uint64_t key, unique in its sequence
+template <typename T>
+std::vector<aligned_t> align3(const std::vector<T>& b, const std::vector<T>& o, const std::vector<T>& t)
+{
+  const auto mb = index_keys(b);
+  const auto mo = index_keys(o);
+  const auto mt = index_keys(t);
+
+  std::vector<std::vector<aligned_t>> inserts(t.size() + 1);
+  int64_t anchor = -1;
+  for (size_t i = 0; i < o.size(); ++i)
+  {
+    const int64_t j = find_key(mt, o[i].key);
+    if (j >= 0)
+    {
+      anchor = j;
+      continue;
+    }
+    inserts[anchor + 1].push_back(aligned_t{find_key(mb, o[i].key), (int64_t)i, -1});
+  }
+
+  std::vector<aligned_t> res;
+  res.reserve(t.size() + o.size());
+  res.insert(res.end(), inserts[0].begin(), inserts[0].end());
+  for (size_t j = 0; j < t.size(); ++j)
+  {
+    res.push_back(aligned_t{find_key(mb, t[j].key), find_key(mo, t[j].key), (int64_t)j});
+    res.insert(res.end(), inserts[j + 1].begin(), inserts[j + 1].end());
+  }
+  return res;
+}
+
+//------------------------------------------------------------------------------
+// nodes
+//------------------------------------------------------------------------------
+
+// children are aligned by their node_sibling_t keys (name and occurrence)
+
+//------------------------------------------------------------------------------
+// system objects
+//------------------------------------------------------------------------------
+
+constexpr uint32_t max_hash_depth = 16;
+
+uint64_t hash_object(const CObject* obj, uint32_t depth);
+
+const std::vector<CPropertyUPtr>* array_elts(const CProperty* prop)
+{
+  // both array kinds report EPropertyKind::DynArray
+  if (auto arr = dynamic_cast<const CDynArrayProperty*>(prop))
+    return &arr->elts();
+  if (auto arr = dynamic_cast<const CArrayProperty*>(prop))
+    return &arr->elts();
+  return nullptr;
+}
+
+template <typename T>
+uint64_t bits_of(T v)
+{
+  uint64_t bits = 0;
+  std::memcpy(&bits, &v, sizeof(T));
+  return bits;
+}
+
+uint64_t hash_prop(const CProperty* prop, uint32_t depth)
+{
+  if (!prop)
+    return 0;
+
+  uint64_t h = mix(0, (uint64_t)prop->kind());
+  switch (prop->kind())
+  {
+    case EPropertyKind::Unknown:
+    {
+      auto& raw = static_cast<const CUnknownProperty*>(prop)->raw_data();
+      return hash64(raw.data(), raw.size(), h);
+    }
+    case EPropertyKind::Bool:
+      return mix(h, static_cast<const CBoolProperty*>(prop)->value() ? 1 : 0);
+    case EPropertyKind::Integer:
+      return mix(h, static_cast<const CIntProperty*>(prop)->u64());
+    case EPropertyKind::Float:
+      return mix(h, bits_of(static_cast<const CFloatPropertyT<float>*>(prop)->value()));
+    case EPropertyKind::Double:
+      return mix(h, bits_of(static_cast<const CFloatPropertyT<double>*>(prop)->value()));
+    case EPropertyKind::Combo:
+    {
+      const std::string name = static_cast<const CEnumProperty*>(prop)->value_name().str();
+      return hash64(name.data(), name.size(), h);
+    }
+    case EPropertyKind::TweakDBID:
+      return mix(h, static_cast<const CTweakDBIDProperty*>(prop)->id().as_u64);
+    case EPropertyKind::CName:
+      return mix(h, static_cast<const CNameProperty*>(prop)->id().as_u64);
+    case EPropertyKind::CRUID:
+      return mix(h, static_cast<const CCRUIDProperty*>(prop)->id());
+    case EPropertyKind::NodeRef:
+    {
+      auto& str = static_cast<const CNodeRefProperty*>(prop)->str();
+      return hash64(str.data(), str.size(), h);
+    }
+    case EPropertyKind::DynArray:
+    case EPropertyKind::Array:
+      if (auto elts = array_elts(prop))
+      {
+        h = mix(h, elts->size());
+        for (auto& elt : *elts)
+          h = mix(h, hash_prop(elt.get(), depth));
+      }
+      return h;
+    case EPropertyKind::Object:
+      return mix(h, hash_object(static_cast<const CObjectProperty*>(prop)->obj().get(), depth + 1));
+    case EPropertyKind::Handle:
+      return mix(h, hash_object(static_cast<const CHandleProperty*>(prop)->obj().get(), depth + 1));
+    default:
+      break;
+  }
+  return h;
+}
+
+// content hash, handles are followed up to max_hash_depth
+uint64_t hash_object(const CObject* obj, uint32_t depth)
+{
+  if (!obj)
+    return 0;
+
+  const std::string ctypename = obj->ctypename().str();
+  uint64_t h = hash64(ctypename.data(), ctypename.size());
+  if (depth >= max_hash_depth)
+    return h;
+
+  obj->for_each_field([&](CSysName name, const CProperty* prop) {
+    const std::string field_name = name.str();
+    h = hash64(field_name.data(), field_name.size(), h);
+    h = mix(h, hash_prop(prop, depth));
+  });
+  return h;
+}
+
+struct object_entry_t
+{
+  uint64_t key = 0; // ctypename, identity and occurrence
+  uint64_t hash = 0;
+};
+
+// identity is the object's subsystem name when the system has one per root
+// object (PSData, scriptables..), the identity fields otherwise
+std::vector<object_entry_t> object_entries(const CSystem& sys, const std::vector<CSysName>& identity_fields)
+{
+  auto& objects = sys.objects();
+  auto& names = sys.subsys_names();
+  const bool named = names.size() == objects.size();
+
+  std::vector<object_entry_t> res(objects.size());
+  std::unordered_map<uint64_t, uint32_t> counts;
+  for (size_t i = 0; i < objects.size(); ++i)
+  {
+    auto& obj = *objects[i];
+    const std::string ctypename = obj.ctypename().str();
+    uint64_t id = hash64(ctypename.data(), ctypename.size());
+    if (named)
+    {
+      id = mix(id, names[i].as_u64);
+    }
+    else
+    {
+      for (auto& field_name : identity_fields)
+      {
+        if (auto prop = obj.get_prop(field_name))
+          id = mix(mix(id, field_name.idx()), hash_prop(prop, 0));
+      }
+    }
+    res[i].key = mix(id, counts[id]++);
+    res[i].hash = hash_object(&obj, 0);
+  }
+  return res;
+}
+
+std::string object_path(const std::string& node_path, const CObject& obj, size_t idx)
+{
+  return fmt::format("{}#{}@{}", node_path, obj.ctypename().str(), idx);
+}
+
+// through serialization, so that any kind of property can be copied,
+// handles end up sharing the source's objects
+bool copy_prop(const CProperty& src, CProperty& dst, CSystemSerCtx& serctx)
+{
+  std::stringstream ss;
+  try
+  {
+    if (!src.serialize_out(ss, serctx))
+      return false;
+    ss.seekg(0);
+    return dst.serialize_in(ss, serctx);
+  }
+  catch (std::exception&)
+  {
+    return false;
+  }
+}
+
+struct system_struct_t
+{
+  std::unique_ptr<node_serializable> var;
+  CSystem* sys = nullptr;
+  std::string error;
+};
+
+template <typename T>
+system_struct_t make_system_struct()
+{
+  system_struct_t ss;
+  auto var = std::make_unique<T>();
+  ss.sys = &var->system();
+  ss.var = std::move(var);
+  return ss;
+}
+
+// same structures as the ones csav loads
+bool make_system_struct(std::string_view node_name, system_struct_t& out)
+{
+  if (node_name == "ScriptableSystemsContainer" || node_name == "godModeSystem")
+    out = make_system_struct<CGenericSystem>();
+  else if (node_name == "PSData")
+    out = make_system_struct<CPSData>();
+  else if (node_name == "StatsSystem")
+    out = make_system_struct<CStats>();
+  else if (node_name == "StatPoolsSystem")
+    out = make_system_struct<CStatsPool>();
+  else
+    return false;
+  return true;
+}
+
+void load_system_struct(system_struct_t& ss, const std::shared_ptr<const node_t>& node, const csav_version& ver)
+{
+  try
+  {
+    if (!ss.var->from_node(node, ver))
+      ss.error = "couldn't be loaded";
+  }
+  catch (std::exception& e)
+  {
+    ss.error = e.what();
+  }
+}
+
+} // namespace
+
+save_merge::node_sptr save_merge::merge_node(const node_sptr& b, const node_sptr& o, const node_sptr& t, const std::string& path)
+{
+  m_stats.compared_nodes++;
+
+  const uint64_t hb = b->content_hash();
+  const uint64_t ho = o->content_hash();
+  const uint64_t ht = t->content_hash();
+
+  if (ho == hb || ho == ht)
+  {
+    m_stats.pruned_subtrees++;
+    return t;
+  }
+  if (ht == hb)
+  {
+    m_stats.pruned_subtrees++;
+    return o->deepcopy();
+  }
+
+  // changed on both sides
+
+  if (m_opts.merge_systems)
+  {
+    if (auto merged = merge_system(b, o, t, path))
+      return merged;
+  }
+
+  if (o->is_blob() != t->is_blob())
+  {
+    add_conflict(save_merge_conflict_kind::both_modified, path, "node kind differs");
+    return prefer_ours() ? o->deepcopy() : t;
+  }
+
+  auto merged = node_t::create_shared(t->idx(), t->name());
+  auto& nc = merged->nonconst();
+  nc.assign_data(merge_data(b->data(), o->data(), t->data(), path));
+  if (b->has_children() || o->has_children() || t->has_children())
+    merge_children(*b, *o, *t, nc, path);
+  return merged;
+}
+
+void save_merge::merge_children(const node_t& b, const node_t& o, const node_t& t, node_t& out, const std::string& path)
+{
+  auto& cb = b.children();
+  auto& co = o.children();
+  auto& ct = t.children();
+
+  const auto sb = node_siblings(cb);
+  const auto so = node_siblings(co);
+  const auto st = node_siblings(ct);
+
+  std::vector<node_sptr> children;
+  children.reserve(ct.size() + co.size());
+
+  for (auto& a : align3(sb, so, st))
+  {
+    if (a.t >= 0)
+    {
+      auto& tchild = ct[a.t];
+      const std::string cpath = node_child_path(path, st[a.t]);
+
+      if (a.o >= 0 && a.b >= 0)
+      {
+        children.push_back(merge_node(cb[a.b], co[a.o], tchild, cpath));
+      }
+      else if (a.o >= 0)
+      {
+        if (co[a.o]->content_hash() == tchild->content_hash())
+          children.push_back(tchild);
+        else
+        {
+          add_conflict(save_merge_conflict_kind::both_added, cpath);
+          children.push_back(prefer_ours() ? co[a.o]->deepcopy() : tchild);
+        }
+      }
+      else if (a.b >= 0)
+      {
+        // deleted in ours
+        if (cb[a.b]->content_hash() == tchild->content_hash())
+          continue;
+        add_conflict(save_merge_conflict_kind::deleted_modified, cpath);
+        if (!prefer_ours())
+          children.push_back(tchild);
+      }
+      else
+      {
+        children.push_back(tchild);
+      }
+      continue;
+    }
+
+    auto& ochild = co[a.o];
+    if (a.b >= 0)
+    {
+      // deleted in theirs
+      if (cb[a.b]->content_hash() == ochild->content_hash())
+        continue;
+      add_conflict(save_merge_conflict_kind::modified_deleted, node_child_path(path, so[a.o]));
+      if (prefer_ours())
+        children.push_back(ochild->deepcopy());
+    }
+    else
+    {
+      children.push_back(ochild->deepcopy());
+    }
+  }
+
+  out.assign_children(children);
+}
+
+std::vector<char> save_merge::merge_data(const std::vector<char>& b, const std::vector<char>& o, const std::vector<char>& t, const std::string& path)
+{
+  if (o == b || o == t)
+    return t;
+  if (t == b)
+    return o;
+
+  if (o.size() != b.size() || t.size() != b.size())
+  {
+    add_conflict(save_merge_conflict_kind::both_modified, path,
+      fmt::format("data resized ({} bytes in ours, {} in theirs)", o.size(), t.size()));
+    return prefer_ours() ? o : t;
+  }
+
+  std::vector<char> res = t;
+  size_t conflicting = 0;
+  size_t first = 0;
+  for (size_t i = 0; i < b.size(); ++i)
+  {
+    if (o[i] == b[i] || o[i] == t[i])
+      continue;
+    if (t[i] == b[i])
+    {
+      res[i] = o[i];
+      continue;
+    }
+    if (conflicting++ == 0)
+      first = i;
+    if (prefer_ours())
+      res[i] = o[i];
+  }
+
+  if (conflicting)
+  {
+    add_conflict(save_merge_conflict_kind::both_modified, path,
+      fmt::format("{} conflicting bytes, first at {:#x}", conflicting, first));
+  }
+  return res;
+}
+
+save_merge::node_sptr save_merge::merge_system(const node_sptr& b, const node_sptr& o, const node_sptr& t, const std::string& path)
+{
+  const std::string name = t->name();
+  system_struct_t sb, so, st;
+  if (!make_system_struct(name, sb))
+    return nullptr;
+  std::ignore = make_system_struct(name, so);
+  std::ignore = make_system_struct(name, st);
+
+  // the big ones (PSData) take a while to load
+  const std::tuple<system_struct_t*, const node_sptr*, const csav_version*> loads[] = {
+    {&sb, &b, &m_base_ver}, {&so, &o, &m_ours_ver}, {&st, &t, &m_theirs_ver}};
+  job_scheduler::get().parallel_for(std::size(loads), [&](size_t i) {
+    auto [ss, node, ver] = loads[i];
+    load_system_struct(*ss, *node, *ver);
+  });
+
+  const std::string* error = nullptr;
+  for (auto ss : {&sb, &so, &st})
+  {
+    if (ss->error.size())
+      error = &ss->error;
+  }
+  if (error)
+  {
+    add_conflict(save_merge_conflict_kind::load_failed, path, *error);
+    return prefer_ours() ? o->deepcopy() : t;
+  }
+
+  m_stats.merged_systems++;
+
+  std::vector<CSysName> identity_fields;
+  for (auto& field_name : m_opts.identity_fields)
+    identity_fields.emplace_back(field_name);
+
+  auto& ob = sb.sys->objects();
+  auto& oo = so.sys->objects();
+  auto& ot = st.sys->objects();
+
+  const auto eb = object_entries(*sb.sys, identity_fields);
+  const auto eo = object_entries(*so.sys, identity_fields);
+  const auto et = object_entries(*st.sys, identity_fields);
+
+  // root objects and their subsystem names go in pairs
+  auto& nt = st.sys->subsys_names();
+  auto& no = so.sys->subsys_names();
+  const bool named = nt.size() == ot.size();
+  if (named && no.size() != oo.size())
+  {
+    add_conflict(save_merge_conflict_kind::load_failed, path, "systems have different layouts");
+    return prefer_ours() ? o->deepcopy() : t;
+  }
+
+  CSystemSerCtx copy_ctx;
+  bool fields_combined = false;
+
+  std::vector<CObjectSPtr> merged;
+  std::vector<CName> merged_names;
+  merged.reserve(ot.size() + oo.size());
+  auto keep = [&](const std::vector<CObjectSPtr>& objects, const std::vector<CName>& names, int64_t idx) {
+    merged.push_back(objects[idx]);
+    if (named)
+      merged_names.push_back(names[idx]);
+  };
+
+  for (auto& a : align3(eb, eo, et))
+  {
+    m_stats.compared_objects++;
+
+    if (a.t >= 0)
+    {
+      auto& tobj = ot[a.t];
+      const uint64_t ht = et[a.t].hash;
+
+      if (a.o < 0)
+      {
+        // deleted in ours
+        if (a.b >= 0 && eb[a.b].hash != ht)
+        {
+          add_conflict(save_merge_conflict_kind::deleted_modified, object_path(path, *tobj, a.t));
+          if (!prefer_ours())
+            keep(ot, nt, a.t);
+        }
+        else if (a.b < 0)
+        {
+          keep(ot, nt, a.t);
+        }
+        continue;
+      }
+
+      auto& oobj = oo[a.o];
+      const uint64_t ho = eo[a.o].hash;
+      if (ho == ht)
+      {
+        keep(ot, nt, a.t);
+        continue;
+      }
+
+      if (a.b < 0)
+      {
+        add_conflict(save_merge_conflict_kind::both_added, object_path(path, *tobj, a.t));
+        if (prefer_ours())
+          keep(oo, no, a.o);
+        else
+          keep(ot, nt, a.t);
+        continue;
+      }
+
+      const uint64_t hb = eb[a.b].hash;
+      if (ho == hb)
+      {
+        keep(ot, nt, a.t);
+        continue;
+      }
+      if (ht == hb)
+      {
+        keep(oo, no, a.o);
+        continue;
+      }
+
+      // changed on both sides, same ctypename (part of the key) so same fields
+
+      auto& bobj = ob[a.b];
+      std::vector<std::pair<CSysName, CProperty*>> fb, fo, ft;
+      auto collect = [](const CObject& obj, std::vector<std::pair<CSysName, CProperty*>>& out) {
+        obj.for_each_field([&](CSysName field_name, CProperty* prop) {
+          out.emplace_back(field_name, prop);
+        });
+      };
+      collect(*bobj, fb);
+      collect(*oobj, fo);
+      collect(*tobj, ft);
+
+      if (fb.size() != ft.size() || fo.size() != ft.size())
+      {
+        add_conflict(save_merge_conflict_kind::both_modified, object_path(path, *tobj, a.t), "fields differ");
+        if (prefer_ours())
+          keep(oo, no, a.o);
+        else
+          keep(ot, nt, a.t);
+        continue;
+      }
+
+      bool combined = false;
+      for (size_t i = 0; i < ft.size(); ++i)
+      {
+        const uint64_t fhb = hash_prop(fb[i].second, 0);
+        const uint64_t fho = hash_prop(fo[i].second, 0);
+        const uint64_t fht = hash_prop(ft[i].second, 0);
+        if (fho == fhb || fho == fht)
+          continue;
+
+        const std::string fpath = object_path(path, *tobj, a.t) + "." + ft[i].first.str();
+        if (fht != fhb)
+        {
+          add_conflict(save_merge_conflict_kind::both_modified, fpath);
+          if (!prefer_ours())
+            continue;
+        }
+
+        if (copy_prop(*fo[i].second, *ft[i].second, copy_ctx))
+          combined = true;
+        else
+          add_conflict(save_merge_conflict_kind::both_modified, fpath, "ours' value couldn't be copied");
+      }
+
+      if (combined)
+      {
+        m_stats.field_merges++;
+        fields_combined = true;
+      }
+      keep(ot, nt, a.t);
+      continue;
+    }
+
+    auto& oobj = oo[a.o];
+    if (a.b >= 0)
+    {
+      // deleted in theirs
+      if (eb[a.b].hash != eo[a.o].hash)
+      {
+        add_conflict(save_merge_conflict_kind::modified_deleted, object_path(path, *oobj, a.o));
+        if (prefer_ours())
+          keep(oo, no, a.o);
+      }
+    }
+    else
+    {
+      keep(oo, no, a.o);
+    }
+  }
+
+  st.sys->objects() = std::move(merged);
+  if (named)
+    st.sys->subsys_names() = std::move(merged_names);
+  // objects edited through serialization aren't dirty, their original bytes
+  // would be reused
+  if (fields_combined)
+    st.var->drop_original_data();
+
+  auto new_node = st.var->to_node(m_theirs_ver);
+  if (!new_node)
+  {
+    add_conflict(save_merge_conflict_kind::load_failed, path, "merged system couldn't be serialized");
+    return prefer_ours() ? o->deepcopy() : t;
+  }
+
+  auto res = node_t::create_shared(t->idx(), name);
+  auto& nc = res->nonconst();
+  nc.assign_children(new_node->children());
+  nc.assign_data(new_node->data());
+  return res;
+}
+
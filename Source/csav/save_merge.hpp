@@ -0,0 +1,112 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <csav/node.hpp>
+#include <csav/csav_version.hpp>
+
+// Three-way merge of save trees: carries the changes made to "ours" since
+// "base" into "theirs", typically the edits made to an older save into a newer
+// save the game produced since then.
+//
+// Nodes are matched by path (name and occurrence among their siblings) and
+// compared with their content hashes, so that subtrees unchanged on one side
+// are taken from the other without being visited.
+// Nodes changed on both sides are merged recursively, leaves byte per byte
+// when their sizes match.
+// The CSystem nodes (PSData, scriptables..) are loaded and merged at the
+// object level: root objects are matched by ctypename and subsystem name (or
+// a hash of their identity fields when the system has no names), then merged
+// field by field.
+//
+// Unchanged subtrees of theirs are shared with the result, the ones taken
+// from ours are copied.
+
+enum class save_merge_conflict_kind : uint8_t
+{
+  both_modified,    // changed differently on both sides
+  both_added,       // added on both sides with different contents
+  modified_deleted, // modified in ours, deleted in theirs
+  deleted_modified, // deleted in ours, modified in theirs
+  load_failed,      // system node that couldn't be loaded, merged as a whole
+};
+
+enum class save_merge_policy : uint8_t
+{
+  theirs, // conflicts keep the newer save's version
+  ours,
+};
+
+struct save_merge_conflict
+{
+  save_merge_conflict_kind kind = save_merge_conflict_kind::both_modified;
+  std::string path; // node path, then "#ctypename{key}.field" for system objects
+  std::string detail;
+
+  static const char* kind_name(save_merge_conflict_kind kind);
+};
+
+struct save_merge_input
+{
+  std::shared_ptr<const node_t> root;
+  csav_version ver;
+};
+
+class save_merge
+{
+public:
+  struct options_t
+  {
+    save_merge_policy policy = save_merge_policy::theirs;
+    // fields identifying a root object among the ones of the same ctypename
+    // in systems without subsystem names, objects without any of them are
+    // matched by occurrence
+    std::vector<std::string> identity_fields = {"id", "persistentID", "entityID", "recordID", "itemID", "seed"};
+    bool merge_systems = true;
+  };
+
+  struct stats_t
+  {
+    size_t compared_nodes = 0;
+    size_t pruned_subtrees = 0;
+    size_t merged_systems = 0;
+    size_t compared_objects = 0;
+    size_t field_merges = 0; // objects combining fields of both sides
+    double ms = 0;
+  };
+
+protected:
+  options_t m_opts;
+  csav_version m_base_ver, m_ours_ver, m_theirs_ver;
+  std::shared_ptr<const node_t> m_result;
+  std::vector<save_merge_conflict> m_conflicts;
+  stats_t m_stats;
+
+public:
+  save_merge() = default;
+
+  explicit save_merge(const options_t& opts)
+    : m_opts(opts) {}
+
+  // the result is to be saved with theirs' version
+  [[nodiscard]] bool run(const save_merge_input& base, const save_merge_input& ours, const save_merge_input& theirs, std::string& err);
+
+  const options_t& options() const { return m_opts; }
+  const std::shared_ptr<const node_t>& result() const { return m_result; }
+  const std::vector<save_merge_conflict>& conflicts() const { return m_conflicts; }
+  const stats_t& stats() const { return m_stats; }
+
+protected:
+  using node_sptr = std::shared_ptr<const node_t>;
+
+  node_sptr merge_node(const node_sptr& b, const node_sptr& o, const node_sptr& t, const std::string& path);
+  void merge_children(const node_t& b, const node_t& o, const node_t& t, node_t& out, const std::string& path);
+  std::vector<char> merge_data(const std::vector<char>& b, const std::vector<char>& o, const std::vector<char>& t, const std::string& path);
+  // null if the node isn't a known system or couldn't be loaded
+  node_sptr merge_system(const node_sptr& b, const node_sptr& o, const node_sptr& t, const std::string& path);
+
+  void add_conflict(save_merge_conflict_kind kind, const std::string& path, std::string detail = "");
+  bool prefer_ours() const { return m_opts.policy == save_merge_policy::ours; }
+};
+
@@ -0,0 +1,285 @@
+#include "byte_find.hpp"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BYTE_FIND_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// gcc and clang only emit avx2 instructions in functions that allow them,
+// msvc doesn't need it
+#if defined(BYTE_FIND_X86) && !defined(_MSC_VER)
+#define BYTE_FIND_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BYTE_FIND_TARGET_AVX2
+#endif
+
+namespace byte_find {
+
+//------------------------------------------------------------------------------
+// cpu features
+//------------------------------------------------------------------------------
+
+static bool cpu_has_avx2()
+{
+#if defined(BYTE_FIND_X86)
+#if defined(_MSC_VER)
+  int regs[4] = {};
+  __cpuid(regs, 0);
+  if (regs[0] < 7)
+    return false;
+  __cpuid(regs, 1);
+  const bool osxsave = (regs[2] & (1 << 27)) != 0;
+  const bool avx = (regs[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx)
+    return false;
+  // the os must save the ymm registers
+  if ((_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(regs, 7, 0);
+  return (regs[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+#else
+  return false;
+#endif
+}
+
+kernel_e best_kernel()
+{
+  static const kernel_e kernel = []() {
+#if defined(BYTE_FIND_X86)
+    if (cpu_has_avx2())
+      return kernel_e::avx2;
+    return kernel_e::sse2; // x64 baseline
+#else
+    return kernel_e::scalar;
+#endif
+  }();
+  return kernel;
+}
+
+const char* kernel_name(kernel_e kernel)
+{
+  switch (kernel)
+  {
+    case kernel_e::sse2: return "sse2";
+    case kernel_e::avx2: return "avx2";
+    default: break;
+  }
+  return "scalar";
+}
+
+//------------------------------------------------------------------------------
+// needle
+//------------------------------------------------------------------------------
+
+needle_t::needle_t(std::string_view bytes, std::string_view mask)
+  : m_bytes(bytes.begin(), bytes.end())
+{
+  if (mask.size())
+  {
+    m_mask.resize(m_bytes.size(), 0xFF);
+    for (size_t i = 0; i < m_mask.size() && i < mask.size(); ++i)
+      m_mask[i] = (mask[i] == '?') ? 0x00 : 0xFF;
+  }
+
+  m_head = m_bytes.size();
+  m_tail = 0;
+  for (size_t i = 0; i < m_bytes.size(); ++i)
+  {
+    if (m_mask.size() && !m_mask[i])
+      continue;
+    if (m_head == m_bytes.size())
+      m_head = i;
+    m_tail = i;
+  }
+}
+
+bool needle_t::verify(const uint8_t* p) const
+{
+  if (!is_masked())
+    return std::memcmp(p, m_bytes.data(), m_bytes.size()) == 0;
+
+  for (size_t i = 0; i < m_bytes.size(); ++i)
+  {
+    if ((p[i] ^ m_bytes[i]) & m_mask[i])
+      return false;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// kernels
+//------------------------------------------------------------------------------
+
+// they return the first unprocessed position, or last + 1 once stopped
+
+struct scan_ctx
+{
+  const uint8_t* hay;
+  anchor_t a0, a1;
+  candidate_fn on_candidate;
+  void* user;
+};
+
+static size_t scan_scalar(const scan_ctx& ctx, size_t pos, size_t last)
+{
+  const uint8_t* const hay = ctx.hay;
+  const size_t off0 = ctx.a0.offset;
+
+  while (pos < last)
+  {
+    auto p = (const uint8_t*)std::memchr(hay + pos + off0, ctx.a0.value, last - pos);
+    if (!p)
+      break;
+    pos = (size_t)(p - hay) - off0;
+    if (hay[pos + ctx.a1.offset] == ctx.a1.value && ctx.on_candidate(ctx.user, pos))
+      return last + 1;
+    ++pos;
+  }
+  return last;
+}
+
+#if defined(BYTE_FIND_X86)
+
+static size_t scan_sse2(const scan_ctx& ctx, size_t pos, size_t last)
+{
+  const size_t off0 = ctx.a0.offset;
+  const size_t off1 = ctx.a1.offset;
+  const __m128i v0 = _mm_set1_epi8((char)ctx.a0.value);
+  const __m128i v1 = _mm_set1_epi8((char)ctx.a1.value);
+
+  for (; pos + 16 <= last; pos += 16)
+  {
+    const uint8_t* p = ctx.hay + pos;
+    const __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + off0)), v0);
+    const __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + off1)), v1);
+    uint32_t bitmask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(eq0, eq1));
+    while (bitmask)
+    {
+      if (ctx.on_candidate(ctx.user, pos + ctz32(bitmask)))
+        return last + 1;
+      bitmask &= bitmask - 1;
+    }
+  }
+  return pos;
+}
+
+BYTE_FIND_TARGET_AVX2
+static size_t scan_avx2(const scan_ctx& ctx, size_t pos, size_t last)
+{
+  const size_t off0 = ctx.a0.offset;
+  const size_t off1 = ctx.a1.offset;
+  const __m256i v0 = _mm256_set1_epi8((char)ctx.a0.value);
+  const __m256i v1 = _mm256_set1_epi8((char)ctx.a1.value);
+
+  for (; pos + 32 <= last; pos += 32)
+  {
+    const uint8_t* p = ctx.hay + pos;
+    const __m256i eq0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + off0)), v0);
+    const __m256i eq1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + off1)), v1);
+    uint32_t bitmask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(eq0, eq1));
+    while (bitmask)
+    {
+      if (ctx.on_candidate(ctx.user, pos + ctz32(bitmask)))
+        return last + 1;
+      bitmask &= bitmask - 1;
+    }
+  }
+  return pos;
+}
+
+#endif
+
+bool scan_anchors(
+  const uint8_t* hay, size_t begin, size_t last,
+  anchor_t a0, anchor_t a1, candidate_fn on_candidate, void* user,
+  kernel_e kernel)
+{
+  const scan_ctx ctx{hay, a0, a1, on_candidate, user};
+
+  size_t pos = begin;
+  switch (kernel)
+  {
+#if defined(BYTE_FIND_X86)
+    case kernel_e::avx2: pos = scan_avx2(ctx, pos, last); break;
+    case kernel_e::sse2: pos = scan_sse2(ctx, pos, last); break;
+#endif
+    default: break;
+  }
+
+  // remainder (or everything for the scalar kernel)
+  if (pos < last)
+    pos = scan_scalar(ctx, pos, last);
+
+  return pos <= last;
+}
+
+//------------------------------------------------------------------------------
+// needle search
+//------------------------------------------------------------------------------
+
+struct find_ctx
+{
+  const uint8_t* hay;
+  const needle_t& needle;
+  std::vector<size_t>& out;
+  size_t maxcnt;
+  size_t cnt = 0;
+
+  static bool on_candidate(void* user, size_t pos)
+  {
+    auto& ctx = *static_cast<find_ctx*>(user);
+    if (!ctx.needle.verify(ctx.hay + pos))
+      return false;
+    ctx.out.push_back(pos);
+    ++ctx.cnt;
+    return ctx.maxcnt && ctx.cnt == ctx.maxcnt;
+  }
+};
+
+size_t find_all(
+  const uint8_t* hay, size_t size, size_t begin, size_t end,
+  const needle_t& needle, std::vector<size_t>& out, size_t maxcnt,
+  kernel_e kernel)
+{
+  const size_t n = needle.size();
+  if (!n || size < n)
+    return 0;
+
+  // last possible match start + 1
+  const size_t last = std::min(end, size - n + 1);
+  if (begin >= last)
+    return 0;
+
+  find_ctx ctx{hay, needle, out, maxcnt};
+
+  if (!needle.has_significant_bytes())
+  {
+    for (size_t pos = begin; pos < last; ++pos)
+    {
+      out.push_back(pos);
+      if (maxcnt && ++ctx.cnt == maxcnt)
+        break;
+    }
+    return ctx.cnt;
+  }
+
+  const anchor_t head{needle.head(), needle.bytes()[needle.head()]};
+  const anchor_t tail{needle.tail(), needle.bytes()[needle.tail()]};
+  scan_anchors(hay, begin, last, head, tail, &find_ctx::on_candidate, &ctx, kernel);
+
+  return ctx.cnt;
+}
+
+} // namespace byte_find
+
@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+#include <string_view>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Portable substring search kernels (scalar, SSE2, AVX2) selected at runtime.
+//
+// The needle can be masked: mask[i] == '?' makes needle[i] a wildcard, any
+// other character (conventionally 'x') makes it significant. An empty mask
+// means every byte is significant.
+// Candidates are found by comparing the first and last significant bytes of
+// the needle for a whole vector of positions at once, then verified.
+
+namespace byte_find {
+
+enum class kernel_e
+{
+  scalar,
+  sse2,
+  avx2,
+};
+
+// best kernel supported by the running cpu
+kernel_e best_kernel();
+const char* kernel_name(kernel_e kernel);
+
+class needle_t
+{
+public:
+  needle_t() = default;
+  needle_t(std::string_view bytes, std::string_view mask = {});
+
+  size_t size() const { return m_bytes.size(); }
+  bool empty() const { return m_bytes.empty(); }
+
+  const std::vector<uint8_t>& bytes() const { return m_bytes; }
+
+  // positions of the significant bytes used for the vectorized prefilter
+  size_t head() const { return m_head; }
+  size_t tail() const { return m_tail; }
+
+  bool is_masked() const { return m_mask.size() != 0; }
+  bool has_significant_bytes() const { return m_head < m_bytes.size(); }
+
+  bool verify(const uint8_t* p) const;
+
+protected:
+  std::vector<uint8_t> m_bytes;
+  std::vector<uint8_t> m_mask; // 0xFF for significant bytes, empty if unmasked
+  size_t m_head = 0;
+  size_t m_tail = 0;
+};
+
+// Lower level scan used by find_all and byte_pattern:
+// calls on_candidate(user, pos) for each pos in [begin, last) such that
+// hay[pos + a0.offset] == a0.value and hay[pos + a1.offset] == a1.value,
+// until it returns true (stop). The caller guarantees that
+// last - 1 + max(a0.offset, a1.offset) is in bounds.
+// Returns false if stopped.
+
+struct anchor_t
+{
+  size_t offset = 0;
+  uint8_t value = 0;
+};
+
+using candidate_fn = bool (*)(void* user, size_t pos);
+
+bool scan_anchors(
+  const uint8_t* hay, size_t begin, size_t last,
+  anchor_t a0, anchor_t a1, candidate_fn on_candidate, void* user,
+  kernel_e kernel = best_kernel());
+
+// Appends to out the offsets of the matches starting in [begin, end).
+// Bytes up to end + needle.size() - 1 (capped at size) are read so that a
+// buffer can be searched in partitions without missing straddling matches.
+// Stops after maxcnt matches if maxcnt != 0, returns the number of matches.
+size_t find_all(
+  const uint8_t* hay, size_t size, size_t begin, size_t end,
+  const needle_t& needle, std::vector<size_t>& out, size_t maxcnt = 0,
+  kernel_e kernel = best_kernel());
+
+inline size_t find_all(const uint8_t* hay, size_t size, const needle_t& needle, std::vector<size_t>& out, size_t maxcnt = 0)
+{
+  return find_all(hay, size, 0, size, needle, out, maxcnt);
+}
+
+// portable count-trailing-zeroes, v must not be 0
+inline unsigned ctz32(uint32_t v)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long idx = 0;
+  _BitScanForward(&idx, v);
+  return (unsigned)idx;
+#else
+  return (unsigned)__builtin_ctz(v);
+#endif
+}
+
+} // namespace byte_find
+
@@ -0,0 +1,581 @@
+#include "byte_pattern.hpp"
+#include <algorithm>
+#include <fmt/format.h>
+
+using elem_t = byte_pattern::elem_t;
+using seq_t = byte_pattern::seq_t;
+using kind_e = elem_t::kind_e;
+
+//------------------------------------------------------------------------------
+// parser
+//------------------------------------------------------------------------------
+
+namespace {
+
+// bounds backtracking, a gap tries every size in its range
+constexpr uint32_t max_gap_size = 0x10000;
+
+class pattern_parser
+{
+  std::string_view m_src;
+  size_t m_pos = 0;
+  std::string& m_err;
+
+public:
+  pattern_parser(std::string_view src, std::string& err)
+    : m_src(src), m_err(err) {}
+
+  bool parse(seq_t& seq)
+  {
+    if (!parse_seq(seq))
+      return false;
+    skip_spaces();
+    if (m_pos < m_src.size())
+      return fail("unexpected character");
+    return true;
+  }
+
+protected:
+  bool fail(std::string_view msg)
+  {
+    m_err = fmt::format("{} at position {}", msg, m_pos);
+    return false;
+  }
+
+  void skip_spaces()
+  {
+    while (m_pos < m_src.size() && (m_src[m_pos] == ' ' || m_src[m_pos] == '\t' || m_src[m_pos] == ','))
+      ++m_pos;
+  }
+
+  static int hex_value(char c)
+  {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  }
+
+  // consecutive gaps are merged into one: each gap tries every size of its
+  // range for each size of the previous one otherwise
+  bool push_elem(seq_t& seq, elem_t e)
+  {
+    if (e.kind == kind_e::gap && seq.size() && seq.back().kind == kind_e::gap)
+    {
+      auto& prev = seq.back();
+      if (prev.gap_max + e.gap_max > max_gap_size)
+        return fail("gap is too big");
+      prev.gap_min += e.gap_min;
+      prev.gap_max += e.gap_max;
+      return true;
+    }
+    seq.push_back(std::move(e));
+    return true;
+  }
+
+  bool is_nibble(size_t pos) const
+  {
+    return pos < m_src.size() && (m_src[pos] == '?' || hex_value(m_src[pos]) >= 0);
+  }
+
+  bool parse_seq(seq_t& seq)
+  {
+    for (;;)
+    {
+      skip_spaces();
+      if (m_pos >= m_src.size())
+        return true;
+
+      const char c = m_src[m_pos];
+      if (c == '|' || c == ')')
+        return true;
+
+      if (c == '(')
+      {
+        if (!parse_alt(seq))
+          return false;
+      }
+      else if (c == '[')
+      {
+        if (!parse_range(seq))
+          return false;
+      }
+      else if (c == '{')
+      {
+        if (!parse_gap(seq))
+          return false;
+      }
+      else if (c == '"')
+      {
+        if (!parse_string(seq))
+          return false;
+      }
+      else if (is_nibble(m_pos))
+      {
+        if (!parse_byte(seq))
+          return false;
+      }
+      else
+      {
+        return fail("unexpected character");
+      }
+    }
+  }
+
+  bool parse_byte(seq_t& seq)
+  {
+    elem_t e;
+    e.kind = kind_e::byte;
+
+    // lone '?' is a whole byte wildcard
+    if (m_src[m_pos] == '?' && !is_nibble(m_pos + 1))
+    {
+      ++m_pos;
+      e.value = 0;
+      e.mask = 0;
+      seq.push_back(e);
+      return true;
+    }
+
+    if (!is_nibble(m_pos + 1))
+      return fail("incomplete byte");
+
+    uint8_t value = 0, mask = 0;
+    for (int i = 0; i < 2; ++i, ++m_pos)
+    {
+      value <<= 4;
+      mask <<= 4;
+      const char c = m_src[m_pos];
+      if (c != '?')
+      {
+        value |= (uint8_t)hex_value(c);
+        mask |= 0xF;
+      }
+    }
+    e.value = value;
+    e.mask = mask;
+    seq.push_back(e);
+    return true;
+  }
+
+  bool parse_hex_byte(uint8_t& value)
+  {
+    skip_spaces();
+    if (m_pos + 1 >= m_src.size() || hex_value(m_src[m_pos]) < 0 || hex_value(m_src[m_pos + 1]) < 0)
+      return fail("expected hex byte");
+    value = (uint8_t)((hex_value(m_src[m_pos]) << 4) | hex_value(m_src[m_pos + 1]));
+    m_pos += 2;
+    return true;
+  }
+
+  bool parse_range(seq_t& seq)
+  {
+    ++m_pos; // [
+    elem_t e;
+    e.kind = kind_e::range;
+    if (!parse_hex_byte(e.lo))
+      return false;
+    skip_spaces();
+    if (m_pos >= m_src.size() || m_src[m_pos] != '-')
+      return fail("expected '-'");
+    ++m_pos;
+    if (!parse_hex_byte(e.hi))
+      return false;
+    skip_spaces();
+    if (m_pos >= m_src.size() || m_src[m_pos] != ']')
+      return fail("expected ']'");
+    ++m_pos;
+    if (e.lo > e.hi)
+      return fail("empty range");
+    seq.push_back(e);
+    return true;
+  }
+
+  bool parse_uint(uint32_t& value)
+  {
+    skip_spaces();
+    const size_t start = m_pos;
+    uint64_t v = 0;
+    while (m_pos < m_src.size() && m_src[m_pos] >= '0' && m_src[m_pos] <= '9')
+    {
+      v = v * 10 + (m_src[m_pos++] - '0');
+      if (v > max_gap_size)
+        return fail("gap is too big");
+    }
+    if (m_pos == start)
+      return fail("expected number");
+    value = (uint32_t)v;
+    return true;
+  }
+
+  bool parse_gap(seq_t& seq)
+  {
+    ++m_pos; // {
+    elem_t e;
+    e.kind = kind_e::gap;
+    if (!parse_uint(e.gap_min))
+      return false;
+    e.gap_max = e.gap_min;
+    skip_spaces();
+    if (m_pos < m_src.size() && m_src[m_pos] == '-')
+    {
+      ++m_pos;
+      if (!parse_uint(e.gap_max))
+        return false;
+      skip_spaces();
+    }
+    if (m_pos >= m_src.size() || m_src[m_pos] != '}')
+      return fail("expected '}'");
+    ++m_pos;
+    if (e.gap_min > e.gap_max)
+      return fail("empty gap range");
+    if (e.gap_max)
+      return push_elem(seq, e);
+    return true;
+  }
+
+  bool parse_alt(seq_t& seq)
+  {
+    ++m_pos; // (
+    elem_t e;
+    e.kind = kind_e::alt;
+    for (;;)
+    {
+      seq_t alt;
+      if (!parse_seq(alt))
+        return false;
+      if (alt.empty())
+        return fail("empty alternative");
+      e.alts.push_back(std::move(alt));
+
+      if (m_pos >= m_src.size())
+        return fail("expected ')'");
+      if (m_src[m_pos++] == ')')
+        break;
+      // '|'
+    }
+    if (e.alts.size() == 1)
+    {
+      // a gap that starts the group can follow one of seq
+      for (auto& ae : e.alts[0])
+      {
+        if (!push_elem(seq, std::move(ae)))
+          return false;
+      }
+      return true;
+    }
+    seq.push_back(std::move(e));
+    return true;
+  }
+
+  bool parse_string(seq_t& seq)
+  {
+    ++m_pos; // "
+    while (m_pos < m_src.size() && m_src[m_pos] != '"')
+    {
+      elem_t e;
+      e.kind = kind_e::byte;
+      e.value = (uint8_t)m_src[m_pos++];
+      e.mask = 0xFF;
+      seq.push_back(e);
+    }
+    if (m_pos >= m_src.size())
+      return fail("unterminated string");
+    ++m_pos;
+    return true;
+  }
+};
+
+//------------------------------------------------------------------------------
+// sizes and anchors
+//------------------------------------------------------------------------------
+
+void seq_sizes(const seq_t& seq, size_t& min_size, size_t& max_size)
+{
+  min_size = 0;
+  max_size = 0;
+  for (auto& e : seq)
+  {
+    switch (e.kind)
+    {
+      case kind_e::gap:
+        min_size += e.gap_min;
+        max_size += e.gap_max;
+        break;
+      case kind_e::alt:
+      {
+        size_t amin = SIZE_MAX, amax = 0;
+        for (auto& alt : e.alts)
+        {
+          size_t smin = 0, smax = 0;
+          seq_sizes(alt, smin, smax);
+          amin = std::min(amin, smin);
+          amax = std::max(amax, smax);
+        }
+        min_size += amin;
+        max_size += amax;
+        break;
+      }
+      default:
+        min_size += 1;
+        max_size += 1;
+        break;
+    }
+  }
+}
+
+// exact bytes at fixed offsets from the start of the pattern
+void collect_anchors(const seq_t& seq, std::vector<byte_find::anchor_t>& anchors)
+{
+  size_t offset = 0;
+  for (auto& e : seq)
+  {
+    size_t emin = 1, emax = 1;
+    switch (e.kind)
+    {
+      case kind_e::byte:
+        if (e.mask == 0xFF)
+          anchors.push_back({offset, e.value});
+        break;
+      case kind_e::range:
+        if (e.lo == e.hi)
+          anchors.push_back({offset, e.lo});
+        break;
+      case kind_e::gap:
+        emin = e.gap_min;
+        emax = e.gap_max;
+        break;
+      case kind_e::alt:
+        seq_sizes({e}, emin, emax);
+        break;
+    }
+    if (emin != emax)
+      return;
+    offset += emin;
+  }
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// byte_pattern
+//------------------------------------------------------------------------------
+
+byte_pattern byte_pattern::from_bytes(std::string_view bytes, std::string_view mask)
+{
+  byte_pattern pat;
+  pat.m_seq.reserve(bytes.size());
+  for (size_t i = 0; i < bytes.size(); ++i)
+  {
+    elem_t e;
+    e.kind = kind_e::byte;
+    e.value = (uint8_t)bytes[i];
+    e.mask = (i < mask.size() && mask[i] == '?') ? 0x00 : 0xFF;
+    e.value &= e.mask;
+    pat.m_seq.push_back(e);
+  }
+  pat.compile();
+  return pat;
+}
+
+bool byte_pattern::parse(std::string_view src, std::string& err)
+{
+  seq_t seq;
+  pattern_parser parser(src, err);
+  if (!parser.parse(seq))
+    return false;
+
+  if (seq.empty())
+  {
+    err = "empty pattern";
+    return false;
+  }
+
+  m_seq = std::move(seq);
+  compile();
+  return true;
+}
+
+void byte_pattern::compile()
+{
+  seq_sizes(m_seq, m_min_size, m_max_size);
+
+  std::vector<byte_find::anchor_t> anchors;
+  collect_anchors(m_seq, anchors);
+
+  // zeroes and 0xFF are everywhere in saves, they make poor anchors
+  auto is_rare = [](const byte_find::anchor_t& a) { return a.value != 0x00 && a.value != 0xFF; };
+  std::stable_partition(anchors.begin(), anchors.end(), is_rare);
+  const size_t rare_cnt = (size_t)std::count_if(anchors.begin(), anchors.end(), is_rare);
+
+  m_has_anchors = anchors.size() != 0;
+  if (m_has_anchors)
+  {
+    // two anchors far apart filter better than neighbours
+    m_a0 = anchors.front();
+    m_a1 = rare_cnt > 1 ? anchors[rare_cnt - 1] : (anchors.size() > 1 ? anchors.back() : m_a0);
+  }
+
+  m_is_needle = false;
+  m_needle = {};
+  const bool whole_bytes = std::all_of(m_seq.begin(), m_seq.end(),
+    [](const elem_t& e) { return e.kind == kind_e::byte && (e.mask == 0xFF || e.mask == 0x00); });
+  if (whole_bytes)
+  {
+    std::string bytes, mask;
+    for (auto& e : m_seq)
+    {
+      bytes.push_back((char)e.value);
+      mask.push_back(e.mask ? 'x' : '?');
+    }
+    byte_find::needle_t needle(bytes, mask);
+    if (needle.has_significant_bytes()
+      && is_rare({0, needle.bytes()[needle.head()]}) && is_rare({0, needle.bytes()[needle.tail()]}))
+    {
+      m_is_needle = true;
+      m_needle = std::move(needle);
+    }
+  }
+}
+
+namespace {
+
+struct match_ctx
+{
+  const uint8_t* hay;
+  size_t size;
+};
+
+// continuation of an enclosing sequence, for alternatives
+struct cont_t
+{
+  const seq_t* seq;
+  size_t idx;
+  const cont_t* next;
+};
+
+bool match_seq(const match_ctx& ctx, const seq_t& seq, size_t i, const cont_t* next, size_t pos, size_t& end)
+{
+  for (; i < seq.size(); ++i)
+  {
+    const elem_t& e = seq[i];
+    switch (e.kind)
+    {
+      case kind_e::byte:
+        if (pos >= ctx.size || (ctx.hay[pos] & e.mask) != e.value)
+          return false;
+        ++pos;
+        break;
+
+      case kind_e::range:
+        if (pos >= ctx.size || ctx.hay[pos] < e.lo || ctx.hay[pos] > e.hi)
+          return false;
+        ++pos;
+        break;
+
+      case kind_e::gap:
+      {
+        // shortest gap first
+        for (size_t g = e.gap_min; g <= e.gap_max && pos + g <= ctx.size; ++g)
+        {
+          if (match_seq(ctx, seq, i + 1, next, pos + g, end))
+            return true;
+        }
+        return false;
+      }
+
+      case kind_e::alt:
+      {
+        const cont_t k{&seq, i + 1, next};
+        for (auto& alt : e.alts)
+        {
+          if (match_seq(ctx, alt, 0, &k, pos, end))
+            return true;
+        }
+        return false;
+      }
+    }
+  }
+
+  if (next)
+    return match_seq(ctx, *next->seq, next->idx, next->next, pos, end);
+
+  end = pos;
+  return true;
+}
+
+struct find_ctx
+{
+  const byte_pattern& pattern;
+  match_ctx mctx;
+  std::vector<byte_match>& out;
+  size_t maxcnt;
+  size_t cnt = 0;
+
+  bool check(size_t pos)
+  {
+    size_t end = 0;
+    if (!match_seq(mctx, pattern.elements(), 0, nullptr, pos, end))
+      return false;
+    out.push_back({pos, end - pos});
+    ++cnt;
+    return maxcnt && cnt == maxcnt;
+  }
+
+  static bool on_candidate(void* user, size_t pos)
+  {
+    return static_cast<find_ctx*>(user)->check(pos);
+  }
+};
+
+} // namespace
+
+bool byte_pattern::match_at(const uint8_t* hay, size_t size, size_t pos, size_t& match_size) const
+{
+  size_t end = 0;
+  if (m_seq.empty() || !match_seq({hay, size}, m_seq, 0, nullptr, pos, end))
+    return false;
+  match_size = end - pos;
+  return true;
+}
+
+size_t byte_pattern::find_all(
+  const uint8_t* hay, size_t size, size_t begin, size_t end,
+  std::vector<byte_match>& out, size_t maxcnt) const
+{
+  if (m_seq.empty() || size < m_min_size || !m_max_size)
+    return 0;
+
+  // last possible match start + 1
+  const size_t last = std::min(end, size - m_min_size + 1);
+  if (begin >= last)
+    return 0;
+
+  if (m_is_needle)
+  {
+    std::vector<size_t> offsets;
+    const size_t cnt = byte_find::find_all(hay, size, begin, end, m_needle, offsets, maxcnt);
+    out.reserve(out.size() + offsets.size());
+    for (size_t offset : offsets)
+      out.push_back({offset, m_needle.size()});
+    return cnt;
+  }
+
+  find_ctx ctx{*this, {hay, size}, out, maxcnt};
+
+  if (m_has_anchors)
+  {
+    byte_find::scan_anchors(hay, begin, last, m_a0, m_a1, &find_ctx::on_candidate, &ctx);
+  }
+  else
+  {
+    for (size_t pos = begin; pos < last; ++pos)
+    {
+      if (ctx.check(pos))
+        break;
+    }
+  }
+
+  return ctx.cnt;
+}
+
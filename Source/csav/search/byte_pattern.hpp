@@ -0,0 +1,98 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <csav/search/byte_find.hpp>
+
+// Byte pattern language for structural searches.
+//
+//   4A          exact byte (hex, case insensitive, spaces are optional)
+//   ?? or ?     any byte
+//   4? ?A       nibble wildcards
+//   [10-1F]     byte range (inclusive)
+//   (01 | 02 03) alternation, alternatives can have different lengths
+//   {4} {2-8}   gap of a fixed or bounded number of any bytes
+//   "text"      ascii bytes
+//
+// e.g. "E1 71 83 4E {4} (1B | 1C) [00-0F] ?? 00"
+//
+// A compiled pattern picks up to two exact bytes at fixed offsets from the
+// start (anchors) that feed the simd prefilter, candidates are then verified
+// by a backtracking matcher. Patterns without usable anchors are verified at
+// every position.
+
+struct byte_match
+{
+  size_t offset = 0;
+  size_t size = 0;
+};
+
+class byte_pattern
+{
+public:
+  struct elem_t
+  {
+    enum class kind_e : uint8_t
+    {
+      byte,   // (b & mask) == value
+      range,  // lo <= b <= hi
+      gap,    // gap_min..gap_max any bytes
+      alt,    // one of alts
+    };
+
+    kind_e kind = kind_e::byte;
+    uint8_t value = 0, mask = 0xFF;
+    uint8_t lo = 0, hi = 0xFF;
+    uint32_t gap_min = 0, gap_max = 0;
+    std::vector<std::vector<elem_t>> alts;
+  };
+
+  using seq_t = std::vector<elem_t>;
+
+protected:
+  seq_t m_seq;
+  size_t m_min_size = 0;
+  size_t m_max_size = 0;
+
+  bool m_has_anchors = false;
+  byte_find::anchor_t m_a0, m_a1;
+
+  // patterns made of whole bytes and '??' only are searched as a masked
+  // needle, without the backtracking matcher, if its first and last bytes
+  // make good anchors
+  bool m_is_needle = false;
+  byte_find::needle_t m_needle;
+
+public:
+  byte_pattern() = default;
+
+  // every byte significant if mask is empty, '?' in mask for wildcards
+  static byte_pattern from_bytes(std::string_view bytes, std::string_view mask = {});
+
+  // on failure, err describes the problem and its position
+  [[nodiscard]] bool parse(std::string_view src, std::string& err);
+
+  bool empty() const { return m_seq.empty(); }
+  size_t min_size() const { return m_min_size; }
+  size_t max_size() const { return m_max_size; }
+
+  const seq_t& elements() const { return m_seq; }
+
+  // size of the first match found at pos (shortest gaps, first alternative)
+  bool match_at(const uint8_t* hay, size_t size, size_t pos, size_t& match_size) const;
+
+  // appends the matches starting in [begin, end), see byte_find::find_all
+  size_t find_all(
+    const uint8_t* hay, size_t size, size_t begin, size_t end,
+    std::vector<byte_match>& out, size_t maxcnt = 0) const;
+
+  size_t find_all(const uint8_t* hay, size_t size, std::vector<byte_match>& out, size_t maxcnt = 0) const
+  {
+    return find_all(hay, size, 0, size, out, maxcnt);
+  }
+
+protected:
+  void compile();
+};
+
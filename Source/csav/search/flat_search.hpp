@@ -0,0 +1,188 @@
+#pragma once
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <job_scheduler.hpp>
+#include <csav/search/byte_pattern.hpp>
+#include <csav/search/multi_find.hpp>
+#include <csav/search/flat_view.hpp>
+
+// Splits [0, size) in partitions searched concurrently by
+// search_part(begin, end, out), as subtasks on the job_scheduler (thread_cnt
+// 0 for the whole pool). A match belongs to the partition it starts in but
+// can extend past its end, search_part appends them in offset order.
+// The partitions are merged in offset order, keeping the matches for which
+// keep(match) returns true (caps that span partitions).
+// Returns at most maxcnt (if not 0) matches sorted by offset.
+template <typename Match, typename SearchPartFn, typename KeepFn>
+std::vector<Match> parallel_search(size_t size, SearchPartFn&& search_part, KeepFn&& keep, size_t maxcnt = 0, size_t thread_cnt = 0)
+{
+  static constexpr size_t min_partition_size = 0x100000;
+
+  if (!thread_cnt)
+    thread_cnt = job_scheduler::get().thread_count();
+  thread_cnt = std::max<size_t>(1, std::min(thread_cnt, size / min_partition_size));
+
+  std::vector<std::vector<Match>> part_results(thread_cnt);
+  const size_t part_size = (size + thread_cnt - 1) / thread_cnt;
+
+  auto run_part = [&](size_t i) {
+    const size_t begin = i * part_size;
+    const size_t end = std::min(size, begin + part_size);
+    search_part(begin, end, part_results[i]);
+  };
+
+  job_scheduler::get().parallel_for(thread_cnt, run_part, thread_cnt);
+
+  std::vector<Match> matches;
+  for (auto& part : part_results)
+  {
+    for (auto& m : part)
+    {
+      if (!keep(m))
+        continue;
+      matches.push_back(m);
+      if (maxcnt && matches.size() == maxcnt)
+        return matches;
+    }
+  }
+  return matches;
+}
+
+inline std::vector<byte_match> parallel_find_all(
+  const uint8_t* data, size_t size, const byte_pattern& pattern,
+  size_t maxcnt = 0, size_t thread_cnt = 0)
+{
+  return parallel_search<byte_match>(size,
+    [&](size_t begin, size_t end, std::vector<byte_match>& out) {
+      pattern.find_all(data, size, begin, end, out, maxcnt);
+    },
+    [](const byte_match&) { return true; },
+    maxcnt, thread_cnt);
+}
+
+inline std::vector<multi_match> parallel_find_all(
+  const uint8_t* data, size_t size, const multi_needle_set& needles,
+  size_t maxcnt = 0, size_t max_per_needle = 0, size_t thread_cnt = 0)
+{
+  // each partition keeps up to max_per_needle matches of a needle, the
+  // first ones of the whole buffer are kept while merging
+  std::vector<size_t> per_needle_cnt(max_per_needle ? needles.needle_count() : 0, 0);
+  return parallel_search<multi_match>(size,
+    [&](size_t begin, size_t end, std::vector<multi_match>& out) {
+      needles.find_all(data, size, begin, end, out, maxcnt, max_per_needle);
+    },
+    [&](const multi_match& m) { return !max_per_needle || per_needle_cnt[m.needle]++ < max_per_needle; },
+    maxcnt, thread_cnt);
+}
+
+
+struct flat_search_match
+{
+  size_t flat_offset = 0;
+  size_t size = 0;
+  uint32_t needle = 0; // multi needle searches only
+  flat_node_view::location_t loc;
+};
+
+// Searches a flat_node_view in a job_scheduler job, the view is given by
+// a source called from the job (see flat_view_cache).
+class flat_search_job
+{
+  job_scheduler::job_ptr m_job;
+
+  std::vector<flat_search_match> m_matches;
+  double m_elapsed_ms = 0;
+
+public:
+  static constexpr size_t default_max_matches = 100000;
+
+  flat_search_job() = default;
+  flat_search_job(const flat_search_job&) = delete;
+  flat_search_job& operator=(const flat_search_job&) = delete;
+
+  ~flat_search_job()
+  {
+    if (m_job)
+    {
+      m_job->cancel();
+      job_scheduler::get().wait(m_job);
+    }
+  }
+
+  // until the results are polled
+  bool is_running() const { return m_job != nullptr; }
+
+  bool start(flat_view_source source, byte_pattern pattern, size_t maxcnt = default_max_matches)
+  {
+    return start_impl(std::move(source), [pattern = std::move(pattern), maxcnt](const std::shared_ptr<const flat_node_view>& view) {
+      auto& data = view->data();
+      auto found = parallel_find_all(data.data(), data.size(), pattern, maxcnt);
+
+      std::vector<flat_search_match> matches;
+      matches.reserve(found.size());
+      for (auto& m : found)
+        matches.push_back({m.offset, m.size, 0, view->locate(m.offset)});
+      return matches;
+    });
+  }
+
+  // the needle set must be compiled
+  bool start(
+    flat_view_source source, std::shared_ptr<const multi_needle_set> needles,
+    size_t maxcnt = default_max_matches, size_t max_per_needle = 0)
+  {
+    if (!needles || !needles->is_compiled())
+      return false;
+
+    return start_impl(std::move(source), [needles, maxcnt, max_per_needle](const std::shared_ptr<const flat_node_view>& view) {
+      auto& data = view->data();
+      auto found = parallel_find_all(data.data(), data.size(), *needles, maxcnt, max_per_needle);
+
+      std::vector<flat_search_match> matches;
+      matches.reserve(found.size());
+      for (auto& m : found)
+        matches.push_back({m.offset, m.size, m.needle, view->locate(m.offset)});
+      return matches;
+    });
+  }
+
+  // to be called from the thread that started the job,
+  // returns true once when the results are available
+  bool poll(std::vector<flat_search_match>& matches, double& elapsed_ms)
+  {
+    if (!m_job || !m_job->is_done())
+      return false;
+    m_job.reset();
+    matches = std::move(m_matches);
+    elapsed_ms = m_elapsed_ms;
+    return true;
+  }
+
+protected:
+  template <typename SearchFn>
+  bool start_impl(flat_view_source source, SearchFn&& search)
+  {
+    if (is_running() || !source)
+      return false;
+
+    m_matches.clear();
+    m_job = job_scheduler::get().submit([this, source = std::move(source), search = std::forward<SearchFn>(search)](progress_t&) {
+      auto view = source();
+      if (!view)
+        return false;
+
+      // the search alone, the view may just have been built
+      auto t0 = std::chrono::steady_clock::now();
+      auto matches = search(view);
+      auto t1 = std::chrono::steady_clock::now();
+      m_elapsed_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+      m_matches = std::move(matches);
+      return true;
+    });
+    return true;
+  }
+};
+
@@ -0,0 +1,230 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <algorithm>
+#include <csav/node.hpp>
+#include <csav/node_history.hpp>
+
+// Contiguous copy of a node tree in serial_tree's flattened layout
+// (preorder, cnodes prefixed with their u32 index), with an interval index
+// mapping flat offsets back to nodes.
+// Building it is a single pass of copies, searches can then run on worker
+// threads without touching the live tree.
+class flat_node_view
+{
+public:
+  struct interval_t
+  {
+    size_t flat_offset = 0;   // start of the interval in data
+    std::shared_ptr<const node_t> node;
+    bool is_idx_header = false; // the u32 index prefix of a cnode, not in node->data()
+  };
+
+  struct location_t
+  {
+    std::shared_ptr<const node_t> node;
+    size_t offset = 0;        // in node->data()
+    bool in_idx_header = false;
+  };
+
+protected:
+  std::vector<uint8_t> m_data;
+  std::vector<interval_t> m_intervals; // sorted by flat_offset, non-empty
+  uint32_t m_next_idx = 0;
+
+public:
+  flat_node_view() = default;
+
+  // root nodes aren't serialized themselves, only their children
+  void build(const std::shared_ptr<const node_t>& root)
+  {
+    m_data.clear();
+    m_intervals.clear();
+    m_next_idx = 0;
+    if (!root)
+      return;
+
+    const size_t total = root->calcsize();
+    m_data.reserve(total);
+    m_intervals.reserve(root->treecount() * 2);
+
+    if (root->is_root())
+    {
+      for (auto& c : root->children())
+        append_node(c);
+    }
+    else
+    {
+      append_node(root);
+    }
+  }
+
+  // same layout from a node_history snapshot, which can't change while the
+  // view is built. live_nodes are the nodes of the tree the snapshot was
+  // taken from, see preorder_nodes(), the intervals refer to them.
+  void build(const node_snapshot& root, const std::vector<std::shared_ptr<const node_t>>& live_nodes)
+  {
+    m_data.clear();
+    m_intervals.clear();
+    m_next_idx = 0;
+    if (live_nodes.empty())
+      return;
+
+    m_intervals.reserve(live_nodes.size() * 2);
+
+    size_t pos = 0;
+    if (root.idx == node_t::root_node_idx)
+    {
+      ++pos;
+      for (auto& c : root.children)
+        append_snapshot(*c, live_nodes, pos);
+    }
+    else
+    {
+      append_snapshot(root, live_nodes, pos);
+    }
+  }
+
+  // root included
+  static std::vector<std::shared_ptr<const node_t>> preorder_nodes(const std::shared_ptr<const node_t>& root)
+  {
+    std::vector<std::shared_ptr<const node_t>> nodes;
+    if (root)
+    {
+      nodes.reserve(root->treecount());
+      append_preorder(nodes, root);
+    }
+    return nodes;
+  }
+
+  const std::vector<uint8_t>& data() const { return m_data; }
+  const std::vector<interval_t>& intervals() const { return m_intervals; }
+
+  size_t size() const { return m_data.size(); }
+
+  location_t locate(size_t flat_offset) const
+  {
+    location_t loc;
+    auto it = std::upper_bound(m_intervals.begin(), m_intervals.end(), flat_offset,
+      [](size_t off, const interval_t& itv) { return off < itv.flat_offset; });
+    if (it == m_intervals.begin())
+      return loc;
+    --it;
+
+    loc.node = it->node;
+    loc.in_idx_header = it->is_idx_header;
+    loc.offset = it->is_idx_header ? 0 : flat_offset - it->flat_offset;
+    return loc;
+  }
+
+protected:
+  void append_node(const std::shared_ptr<const node_t>& node)
+  {
+    if (node->is_cnode())
+    {
+      const uint32_t idx = m_next_idx++;
+      m_intervals.push_back({m_data.size(), node, true});
+      const uint8_t* pidx = (const uint8_t*)&idx;
+      m_data.insert(m_data.end(), pidx, pidx + sizeof(idx));
+    }
+
+    auto& buf = node->data();
+    if (buf.size())
+    {
+      m_intervals.push_back({m_data.size(), node, false});
+      m_data.insert(m_data.end(), buf.begin(), buf.end());
+    }
+
+    for (auto& c : node->children())
+      append_node(c);
+  }
+
+  void append_snapshot(const node_snapshot& snap, const std::vector<std::shared_ptr<const node_t>>& live_nodes, size_t& pos)
+  {
+    if (pos >= live_nodes.size())
+      return;
+    const auto& node = live_nodes[pos++];
+
+    if (snap.idx >= 0)
+    {
+      const uint32_t idx = m_next_idx++;
+      m_intervals.push_back({m_data.size(), node, true});
+      const uint8_t* pidx = (const uint8_t*)&idx;
+      m_data.insert(m_data.end(), pidx, pidx + sizeof(idx));
+    }
+
+    auto& buf = *snap.data;
+    if (buf.size())
+    {
+      m_intervals.push_back({m_data.size(), node, false});
+      m_data.insert(m_data.end(), buf.begin(), buf.end());
+    }
+
+    for (auto& c : snap.children)
+      append_snapshot(*c, live_nodes, pos);
+  }
+
+  static void append_preorder(std::vector<std::shared_ptr<const node_t>>& nodes, const std::shared_ptr<const node_t>& node)
+  {
+    nodes.push_back(node);
+    for (auto& c : node->children())
+      append_preorder(nodes, c);
+  }
+};
+
+
+// gives a flat view from any thread, see flat_view_cache
+using flat_view_source = std::function<std::shared_ptr<const flat_node_view>()>;
+
+// Flat view of a tree, shared by the searches of a save and rebuilt only
+// when the tree changed (the root's content_hash() differs).
+// The view is built from a node_history snapshot of the tree, so that a
+// job can build it while the tree is edited: the thread editing the tree
+// gets a source for its current state, and the first job calling the
+// source builds the view.
+class flat_view_cache
+{
+  struct version_t
+  {
+    uint64_t hash = 0;
+    std::once_flag built;
+    std::shared_ptr<const node_snapshot> snap; // released once built
+    std::vector<std::shared_ptr<const node_t>> live_nodes;
+    std::shared_ptr<const flat_node_view> view;
+  };
+
+  std::shared_ptr<version_t> m_cur;
+
+public:
+  // to be called from the thread editing the tree, snap must be root's
+  // current state (e.g. the current entry of its history after a capture)
+  flat_view_source source(const std::shared_ptr<const node_snapshot>& snap, const std::shared_ptr<const node_t>& root)
+  {
+    if (!snap || !root)
+      return nullptr;
+
+    if (!m_cur || m_cur->hash != snap->hash)
+    {
+      auto v = std::make_shared<version_t>();
+      v->hash = snap->hash;
+      v->snap = snap;
+      v->live_nodes = flat_node_view::preorder_nodes(root);
+      m_cur = std::move(v);
+    }
+
+    return [v = m_cur]() {
+      std::call_once(v->built, [&v]() {
+        auto view = std::make_shared<flat_node_view>();
+        view->build(*v->snap, v->live_nodes);
+        v->view = std::move(view);
+        v->snap.reset();
+        v->live_nodes = {};
+      });
+      return v->view;
+    };
+  }
+};
+
@@ -0,0 +1,284 @@
+#include "known_hash_scan.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <cpinternals/cpnames.hpp>
+#include <cpinternals/CFact.hpp>
+#include <csav/search/flat_search.hpp>
+
+//------------------------------------------------------------------------------
+// hash_annotation
+//------------------------------------------------------------------------------
+
+const char* hash_annotation::kind_name(known_hash_kind kind)
+{
+  switch (kind)
+  {
+    case known_hash_kind::tweakdbid: return "TweakDBID";
+    case known_hash_kind::cname: return "CName";
+    case known_hash_kind::cfact: return "CFact";
+    default: break;
+  }
+  return "unknown";
+}
+
+std::string hash_annotation::name() const
+{
+  switch (kind)
+  {
+    case known_hash_kind::tweakdbid: return TweakDBIDResolver::get().resolve(TweakDBID(hash));
+    case known_hash_kind::cname: return CNameResolver::get().resolve(hash);
+    case known_hash_kind::cfact: return CP::CFactResolver::get().resolve((uint32_t)hash).str();
+    default: break;
+  }
+  return {};
+}
+
+//------------------------------------------------------------------------------
+// known_hash_sets
+//------------------------------------------------------------------------------
+
+// blocked filter: the 3 bits of a value are in the same word, one cache
+// line is touched per lookup
+void known_hash_sets::bloom_t::build(size_t count)
+{
+  // ~16 bits per value
+  log2_size = 6;
+  while ((size_t(1) << log2_size) * 4 < count)
+    ++log2_size;
+  bits.assign(size_t(1) << log2_size, 0);
+}
+
+void known_hash_sets::bloom_t::insert(uint64_t v)
+{
+  const uint64_t h = v * 0x9E3779B97F4A7C15;
+  bits[h >> (64 - log2_size)] |= word_mask(h);
+}
+
+void known_hash_sets::load_from_resolvers()
+{
+  assign(
+    TweakDBIDResolver::get().registered_hashes(),
+    CNameResolver::get().registered_hashes(),
+    CP::CFactResolver::get().registered_hashes());
+}
+
+void known_hash_sets::assign(std::vector<uint64_t> tweakdbids, std::vector<uint64_t> cnames, std::vector<uint32_t> cfacts)
+{
+  m_tweakdbids = std::move(tweakdbids);
+  m_cnames = std::move(cnames);
+  m_cfacts = std::move(cfacts);
+  build_filters();
+}
+
+void known_hash_sets::build_filters()
+{
+  auto sort_unique = [](auto& v) {
+    std::sort(v.begin(), v.end());
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    // zeroes are everywhere in saves
+    if (v.size() && v.front() == 0)
+      v.erase(v.begin());
+  };
+
+  sort_unique(m_tweakdbids);
+  sort_unique(m_cnames);
+  sort_unique(m_cfacts);
+
+  m_tweakdbids_bloom.build(m_tweakdbids.size());
+  for (auto v : m_tweakdbids)
+    m_tweakdbids_bloom.insert(v);
+
+  m_cnames_bloom.build(m_cnames.size());
+  for (auto v : m_cnames)
+    m_cnames_bloom.insert(v);
+
+  m_cfacts_bloom.build(m_cfacts.size());
+  for (auto v : m_cfacts)
+    m_cfacts_bloom.insert(v);
+}
+
+size_t known_hash_sets::scan(const uint8_t* data, size_t size, size_t begin, size_t end, std::vector<hash_annotation>& out) const
+{
+  end = std::min(end, size);
+  const size_t start_cnt = out.size();
+
+  const bool has_tweakdbids = m_tweakdbids.size();
+  const bool has_cnames = m_cnames.size();
+  const bool has_cfacts = m_cfacts.size();
+
+  for (size_t pos = begin; pos < end; ++pos)
+  {
+    const size_t avail = size - pos;
+    if (avail < 4)
+      break;
+
+    if (has_cfacts)
+    {
+      uint32_t v32;
+      std::memcpy(&v32, data + pos, 4);
+      if (v32 && m_cfacts_bloom.maybe_contains(v32)
+        && std::binary_search(m_cfacts.begin(), m_cfacts.end(), v32))
+      {
+        out.push_back(hash_annotation{pos, v32, known_hash_kind::cfact});
+      }
+    }
+
+    if (avail < 8)
+      continue;
+
+    uint64_t v64;
+    std::memcpy(&v64, data + pos, 8);
+    if (!v64)
+      continue;
+
+    // tweakdbids have a non-zero length byte followed by 3 zeroes
+    const bool tdbid_shape = (v64 >> 40) == 0 && ((v64 >> 32) & 0xFF) != 0;
+    if (tdbid_shape && has_tweakdbids && m_tweakdbids_bloom.maybe_contains(v64)
+      && std::binary_search(m_tweakdbids.begin(), m_tweakdbids.end(), v64))
+    {
+      out.push_back(hash_annotation{pos, v64, known_hash_kind::tweakdbid});
+    }
+    else if (has_cnames && m_cnames_bloom.maybe_contains(v64)
+      && std::binary_search(m_cnames.begin(), m_cnames.end(), v64))
+    {
+      out.push_back(hash_annotation{pos, v64, known_hash_kind::cname});
+    }
+  }
+
+  return out.size() - start_cnt;
+}
+
+//------------------------------------------------------------------------------
+// hash_annotation_index
+//------------------------------------------------------------------------------
+
+void hash_annotation_index::build(const std::shared_ptr<const flat_node_view>& view, const known_hash_sets& sets, size_t thread_cnt)
+{
+  m_view = view;
+  m_entries.clear();
+  m_node_ranges.clear();
+  if (!view)
+    return;
+
+  auto& data = view->data();
+  m_entries = parallel_search<hash_annotation>(data.size(),
+    [&](size_t begin, size_t end, std::vector<hash_annotation>& out) {
+      sets.scan(data.data(), data.size(), begin, end, out);
+    },
+    [](const hash_annotation&) { return true; },
+    0, thread_cnt);
+
+  auto& intervals = view->intervals();
+  for (size_t i = 0; i < intervals.size(); ++i)
+  {
+    auto& itv = intervals[i];
+    if (itv.is_idx_header)
+      continue;
+
+    const size_t itv_end = (i + 1 < intervals.size()) ? intervals[i + 1].flat_offset : data.size();
+    auto first = std::lower_bound(m_entries.begin(), m_entries.end(), itv.flat_offset,
+      [](const hash_annotation& a, size_t off) { return a.offset < off; });
+    auto last = std::lower_bound(first, m_entries.end(), itv_end,
+      [](const hash_annotation& a, size_t off) { return a.offset < off; });
+    if (first == last)
+      continue;
+
+    node_range_t range;
+    range.data_flat_offset = itv.flat_offset;
+    range.first = (size_t)(first - m_entries.begin());
+    range.count = (size_t)(last - first);
+    m_node_ranges[itv.node.get()] = range;
+  }
+}
+
+bool hash_annotation_index::find_node_range(const node_t* node, node_range_t& range) const
+{
+  auto it = m_node_ranges.find(node);
+  if (it == m_node_ranges.end())
+    return false;
+  range = it->second;
+  return true;
+}
+
+void hash_annotation_index::write_tsv(std::ostream& os) const
+{
+  os << "flat_offset\tnode_idx\tnode_name\tnode_offset\tkind\thash\tname\n";
+  for (auto& a : m_entries)
+  {
+    auto loc = m_view->locate(a.offset);
+    if (!loc.node)
+      continue;
+    os << fmt::format("0x{:08X}\t{}\t{}\t0x{:X}\t{}\t0x{:X}\t{}\n",
+      a.offset, loc.node->idx(), loc.node->name(), loc.offset,
+      hash_annotation::kind_name(a.kind), a.hash, a.name());
+  }
+}
+
+//------------------------------------------------------------------------------
+// hash_annotation_registry
+//------------------------------------------------------------------------------
+
+void hash_annotation_registry::publish(const std::shared_ptr<const hash_annotation_index>& index)
+{
+  std::lock_guard<std::mutex> lk(m_mtx);
+  m_indexes.erase(
+    std::remove_if(m_indexes.begin(), m_indexes.end(), [](auto& w) { return w.expired(); }),
+    m_indexes.end());
+  m_indexes.push_back(index);
+}
+
+std::shared_ptr<const hash_annotation_index> hash_annotation_registry::find(const node_t* node, hash_annotation_index::node_range_t& range)
+{
+  std::lock_guard<std::mutex> lk(m_mtx);
+  // most recent first, a rescan replaces the previous index of a save
+  for (auto it = m_indexes.rbegin(); it != m_indexes.rend(); ++it)
+  {
+    auto index = it->lock();
+    if (index && index->find_node_range(node, range))
+      return index;
+  }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+// hash_annotation_job
+//------------------------------------------------------------------------------
+
+bool hash_annotation_job::start(flat_view_source source)
+{
+  if (is_running() || !source)
+    return false;
+
+  m_index.reset();
+  m_job = job_scheduler::get().submit([this, source = std::move(source)](progress_t&) {
+    auto view = source();
+    if (!view)
+      return false;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    known_hash_sets sets;
+    sets.load_from_resolvers();
+    auto index = std::make_shared<hash_annotation_index>();
+    index->build(view, sets);
+
+    auto t1 = std::chrono::steady_clock::now();
+    m_elapsed_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    m_index = std::move(index);
+    return true;
+  });
+  return true;
+}
+
+bool hash_annotation_job::poll(std::shared_ptr<const hash_annotation_index>& index, double& elapsed_ms)
+{
+  if (!m_job || !m_job->is_done())
+    return false;
+  m_job.reset();
+  index = std::move(m_index);
+  elapsed_ms = m_elapsed_ms;
+  return true;
+}
+
@@ -0,0 +1,182 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <job_scheduler.hpp>
+#include <csav/search/flat_view.hpp>
+
+// Annotates every offset of a save holding a known identifier:
+// - TweakDBID, 8 bytes: crc32 of the name, its length on 1 byte, 3 zeroes
+// - CName, 8 bytes: FNV1a64 of the name
+// - CFact, 4 bytes: FNV1a32 of the name
+//
+// The hashes registered in the resolvers are copied in sorted arrays with a
+// bloom filter in front of them, so that the exact lookup is only done for a
+// small fraction of the offsets.
+
+enum class known_hash_kind : uint8_t
+{
+  tweakdbid,
+  cname,
+  cfact,
+};
+
+struct hash_annotation
+{
+  size_t offset = 0; // flat offset
+  uint64_t hash = 0;
+  known_hash_kind kind = known_hash_kind::tweakdbid;
+
+  size_t size() const { return kind == known_hash_kind::cfact ? 4 : 8; }
+
+  static const char* kind_name(known_hash_kind kind);
+
+  // resolved name of the identifier
+  std::string name() const;
+};
+
+// snapshot of the hashes known by the resolvers
+class known_hash_sets
+{
+  struct bloom_t
+  {
+    std::vector<uint64_t> bits;
+    uint32_t log2_size = 0;
+
+    void build(size_t count);
+    void insert(uint64_t v);
+
+    static uint64_t word_mask(uint64_t h)
+    {
+      return (uint64_t(1) << (h & 63)) | (uint64_t(1) << ((h >> 6) & 63)) | (uint64_t(1) << ((h >> 12) & 63));
+    }
+
+    bool maybe_contains(uint64_t v) const
+    {
+      const uint64_t h = v * 0x9E3779B97F4A7C15;
+      const uint64_t mask = word_mask(h);
+      return (bits[h >> (64 - log2_size)] & mask) == mask;
+    }
+  };
+
+  // the tweakdbid filter is only probed when the bytes have its shape
+  bloom_t m_tweakdbids_bloom;
+  bloom_t m_cnames_bloom;
+  bloom_t m_cfacts_bloom;
+  std::vector<uint64_t> m_tweakdbids; // sorted
+  std::vector<uint64_t> m_cnames;     // sorted
+  std::vector<uint32_t> m_cfacts;     // sorted
+
+public:
+  known_hash_sets() = default;
+
+  // copies the hashes of TweakDBIDResolver, CNameResolver and CFactResolver
+  void load_from_resolvers();
+
+  // for tests and external lists
+  void assign(std::vector<uint64_t> tweakdbids, std::vector<uint64_t> cnames, std::vector<uint32_t> cfacts);
+
+  size_t count() const { return m_tweakdbids.size() + m_cnames.size() + m_cfacts.size(); }
+
+  // Appends the annotations starting in [begin, end), in offset order.
+  // Reads up to 7 bytes past end (capped at size).
+  size_t scan(const uint8_t* data, size_t size, size_t begin, size_t end, std::vector<hash_annotation>& out) const;
+
+protected:
+  void build_filters();
+};
+
+// Annotations of a flat_node_view, with per node ranges for the editors.
+// Offsets are only valid for the tree the view was built from, editors should
+// check that the bytes still hold the hash before using an annotation.
+class hash_annotation_index
+{
+public:
+  struct node_range_t
+  {
+    size_t data_flat_offset = 0; // flat offset of node->data()
+    size_t first = 0;            // index of the first annotation in the node
+    size_t count = 0;
+  };
+
+protected:
+  std::shared_ptr<const flat_node_view> m_view;
+  std::vector<hash_annotation> m_entries; // sorted by offset
+  std::unordered_map<const node_t*, node_range_t> m_node_ranges;
+
+public:
+  hash_annotation_index() = default;
+
+  void build(const std::shared_ptr<const flat_node_view>& view, const known_hash_sets& sets, size_t thread_cnt = 0);
+
+  const std::shared_ptr<const flat_node_view>& view() const { return m_view; }
+  const std::vector<hash_annotation>& entries() const { return m_entries; }
+
+  // annotations starting in node's data, false if there are none
+  bool find_node_range(const node_t* node, node_range_t& range) const;
+
+  // tab separated: flat offset, node index, node name, offset in node, kind, hash, name
+  void write_tsv(std::ostream& os) const;
+};
+
+// Indexes published by the opened saves, so that editors of a node can find
+// the annotations of its save.
+class hash_annotation_registry
+{
+  std::mutex m_mtx;
+  std::vector<std::weak_ptr<const hash_annotation_index>> m_indexes;
+
+  hash_annotation_registry() = default;
+
+public:
+  static hash_annotation_registry& get()
+  {
+    static hash_annotation_registry s;
+    return s;
+  }
+
+  hash_annotation_registry(const hash_annotation_registry&) = delete;
+  hash_annotation_registry& operator=(const hash_annotation_registry&) = delete;
+
+  void publish(const std::shared_ptr<const hash_annotation_index>& index);
+
+  std::shared_ptr<const hash_annotation_index> find(const node_t* node, hash_annotation_index::node_range_t& range);
+};
+
+// Builds an index in a job_scheduler job, the view is given by a source
+// called from the job (see flat_view_cache).
+class hash_annotation_job
+{
+  job_scheduler::job_ptr m_job;
+
+  std::shared_ptr<hash_annotation_index> m_index;
+  double m_elapsed_ms = 0;
+
+public:
+  hash_annotation_job() = default;
+  hash_annotation_job(const hash_annotation_job&) = delete;
+  hash_annotation_job& operator=(const hash_annotation_job&) = delete;
+
+  ~hash_annotation_job()
+  {
+    if (m_job)
+    {
+      m_job->cancel();
+      job_scheduler::get().wait(m_job);
+    }
+  }
+
+  // until the index is polled
+  bool is_running() const { return m_job != nullptr; }
+
+  bool start(flat_view_source source);
+
+  // to be called from the thread that started the job,
+  // returns true once when the index is available
+  bool poll(std::shared_ptr<const hash_annotation_index>& index, double& elapsed_ms);
+};
+
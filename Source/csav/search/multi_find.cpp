@@ -0,0 +1,210 @@
+#include "multi_find.hpp"
+#include <algorithm>
+#include <deque>
+
+uint32_t multi_needle_set::add(std::string_view bytes, std::string_view label)
+{
+  if (bytes.empty())
+    return npos;
+
+  m_compiled = false;
+  const uint32_t id = (uint32_t)m_needles.size();
+  auto& needle = m_needles.emplace_back();
+  needle.bytes = bytes;
+  needle.label = label.size() ? label : bytes;
+  return id;
+}
+
+void multi_needle_set::compile()
+{
+  m_states.clear();
+  m_edges.clear();
+  std::fill(std::begin(m_root_next), std::end(m_root_next), 0);
+  m_max_size = 0;
+
+  // trie, children are kept sorted by byte
+  std::vector<std::vector<edge_t>> children(1);
+  m_states.resize(1);
+
+  auto child = [&](uint32_t s, uint8_t c) -> uint32_t {
+    auto& edges = children[s];
+    auto it = std::lower_bound(edges.begin(), edges.end(), c,
+      [](const edge_t& e, uint8_t c) { return e.c < c; });
+    return (it != edges.end() && it->c == c) ? it->target : 0;
+  };
+
+  for (uint32_t id = 0; id < (uint32_t)m_needles.size(); ++id)
+  {
+    auto& needle = m_needles[id];
+    needle.dup_next = npos;
+    m_max_size = std::max(m_max_size, needle.bytes.size());
+
+    uint32_t s = 0;
+    for (char ch : needle.bytes)
+    {
+      const uint8_t c = (uint8_t)ch;
+      uint32_t t = child(s, c);
+      if (!t)
+      {
+        t = (uint32_t)m_states.size();
+        m_states.emplace_back();
+        children.emplace_back();
+        auto& edges = children[s];
+        auto it = std::lower_bound(edges.begin(), edges.end(), c,
+          [](const edge_t& e, uint8_t c) { return e.c < c; });
+        edges.insert(it, edge_t{c, t});
+      }
+      s = t;
+    }
+
+    // identical needles are chained, the last added one first
+    needle.dup_next = m_states[s].needle;
+    m_states[s].needle = id;
+  }
+
+  for (auto& e : children[0])
+    m_root_next[e.c] = e.target;
+
+  // failure and dictionary links, breadth first so that the links of
+  // shallower states are known
+  std::vector<uint32_t> order;
+  order.reserve(m_states.size());
+  std::deque<uint32_t> queue;
+  for (auto& e : children[0])
+    queue.push_back(e.target); // fail = 0
+  while (queue.size())
+  {
+    const uint32_t s = queue.front();
+    queue.pop_front();
+    order.push_back(s);
+
+    for (auto& e : children[s])
+    {
+      uint32_t f = m_states[s].fail;
+      uint32_t t = 0;
+      for (;;)
+      {
+        t = f ? child(f, e.c) : m_root_next[e.c];
+        if (t || !f)
+          break;
+        f = m_states[f].fail;
+      }
+
+      auto& st = m_states[e.target];
+      st.fail = t;
+      st.dict = (m_states[t].needle != npos) ? t : m_states[t].dict;
+      queue.push_back(e.target);
+    }
+  }
+
+  // edges are flattened in breadth first order, shallow states are the
+  // most visited ones
+  m_edges.reserve(m_states.size());
+  for (uint32_t s : order)
+  {
+    auto& st = m_states[s];
+    st.edges_begin = (uint32_t)m_edges.size();
+    st.edges_count = (uint32_t)children[s].size();
+    m_edges.insert(m_edges.end(), children[s].begin(), children[s].end());
+  }
+
+  m_compiled = true;
+}
+
+uint32_t multi_needle_set::find_edge(const state_t& s, uint8_t c) const
+{
+  const edge_t* first = m_edges.data() + s.edges_begin;
+  const edge_t* last = first + s.edges_count;
+
+  // most states past the first levels have a single child
+  if (s.edges_count <= 8)
+  {
+    for (; first != last; ++first)
+    {
+      if (first->c == c)
+        return first->target;
+    }
+    return 0;
+  }
+
+  auto it = std::lower_bound(first, last, c,
+    [](const edge_t& e, uint8_t c) { return e.c < c; });
+  return (it != last && it->c == c) ? it->target : 0;
+}
+
+size_t multi_needle_set::find_all(
+  const uint8_t* hay, size_t size, size_t begin, size_t end,
+  std::vector<multi_match>& out, size_t maxcnt, size_t max_per_needle) const
+{
+  if (!m_compiled || m_needles.empty())
+    return 0;
+
+  end = std::min(end, size);
+  if (begin >= end)
+    return 0;
+
+  // a match starting before end can't end past scan_end
+  const size_t scan_end = std::min(size, end + m_max_size - 1);
+
+  std::vector<uint32_t> per_needle_cnt;
+  if (max_per_needle)
+    per_needle_cnt.resize(m_needles.size(), 0);
+
+  // matches are found in end order: once maxcnt are found, a shorter one
+  // ending later can still start before some of them. The scan goes on
+  // until no match can start before the last kept start (cutoff), then
+  // the matches are sorted by start and the first maxcnt are kept.
+  const size_t first = out.size();
+  size_t cutoff = SIZE_MAX;
+
+  uint32_t s = 0;
+  for (size_t pos = begin; pos < scan_end; ++pos)
+  {
+    if (cutoff != SIZE_MAX && pos + 1 >= cutoff + m_max_size)
+      break;
+
+    const uint8_t c = hay[pos];
+    if (s == 0)
+    {
+      // fast path, most bytes don't start any needle
+      s = m_root_next[c];
+      if (!s)
+        continue;
+    }
+    else
+    {
+      s = next_state(s, c);
+    }
+
+    for (uint32_t t = (m_states[s].needle != npos) ? s : m_states[s].dict; t; t = m_states[t].dict)
+    {
+      for (uint32_t id = m_states[t].needle; id != npos; id = m_needles[id].dup_next)
+      {
+        const size_t needle_size = m_needles[id].bytes.size();
+        const size_t start = pos + 1 - needle_size;
+        if (start >= end || start >= cutoff)
+          continue;
+        if (max_per_needle && per_needle_cnt[id]++ >= max_per_needle)
+          continue;
+
+        out.push_back(multi_match{start, (uint32_t)needle_size, id});
+        if (cutoff == SIZE_MAX && out.size() - first == maxcnt)
+        {
+          cutoff = 0;
+          for (size_t i = first; i < out.size(); ++i)
+            cutoff = std::max(cutoff, out[i].offset);
+        }
+      }
+    }
+  }
+
+  // same needle, same size: its matches stay in start order, and so do the
+  // per needle caps
+  std::stable_sort(out.begin() + first, out.end(),
+    [](const multi_match& a, const multi_match& b) { return a.offset < b.offset; });
+  if (maxcnt && out.size() - first > maxcnt)
+    out.resize(first + maxcnt);
+
+  return out.size() - first;
+}
+
@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Aho-Corasick automaton matching a whole set of needles (item names,
+// encoded ids..) in a single pass over the haystack.
+//
+// The root state has a dense transition table so that the scan skips bytes
+// that can't start any needle quickly, other states keep their edges sorted
+// in a shared array and fall back on their failure links.
+// Memory is linear in the total size of the needles.
+
+struct multi_match
+{
+  size_t offset = 0;
+  uint32_t size = 0;
+  uint32_t needle = 0; // id returned by multi_needle_set::add
+};
+
+class multi_needle_set
+{
+public:
+  static constexpr uint32_t npos = (uint32_t)-1;
+
+protected:
+  struct needle_t
+  {
+    std::string bytes;
+    std::string label;
+    uint32_t dup_next = npos; // next needle with the same bytes
+  };
+
+  struct state_t
+  {
+    uint32_t edges_begin = 0;
+    uint32_t edges_count = 0;
+    uint32_t fail = 0;
+    uint32_t needle = npos; // first needle ending here
+    uint32_t dict = 0;      // nearest state on the failure chain with a needle, 0 if none
+  };
+
+  struct edge_t
+  {
+    uint8_t c;
+    uint32_t target;
+  };
+
+  std::vector<needle_t> m_needles;
+  std::vector<state_t> m_states;
+  std::vector<edge_t> m_edges;
+  uint32_t m_root_next[256] = {};
+  size_t m_max_size = 0;
+  bool m_compiled = false;
+
+public:
+  multi_needle_set() = default;
+
+  // empty needles are ignored (npos is returned), label defaults to bytes
+  uint32_t add(std::string_view bytes, std::string_view label = {});
+
+  // builds the automaton, must be called after the last add
+  void compile();
+
+  bool is_compiled() const { return m_compiled; }
+  bool empty() const { return m_needles.empty(); }
+  size_t needle_count() const { return m_needles.size(); }
+  size_t state_count() const { return m_states.size(); }
+  size_t max_size() const { return m_max_size; }
+
+  const std::string& needle_bytes(uint32_t id) const { return m_needles[id].bytes; }
+  const std::string& needle_label(uint32_t id) const { return m_needles[id].label; }
+
+  // Appends the matches starting in [begin, end), overlapping ones included.
+  // Bytes up to end + max_size() - 1 (capped at size) are read so that a
+  // buffer can be searched in partitions without missing straddling matches.
+  // Matches are appended in the order of their start offset (then end).
+  // Keeps the first maxcnt matches if maxcnt != 0, and ignores the matches
+  // of a needle past its first max_per_needle ones if max_per_needle != 0.
+  // Returns the number of appended matches.
+  size_t find_all(
+    const uint8_t* hay, size_t size, size_t begin, size_t end,
+    std::vector<multi_match>& out, size_t maxcnt = 0, size_t max_per_needle = 0) const;
+
+  size_t find_all(const uint8_t* hay, size_t size, std::vector<multi_match>& out, size_t maxcnt = 0) const
+  {
+    return find_all(hay, size, 0, size, out, maxcnt);
+  }
+
+protected:
+  uint32_t find_edge(const state_t& s, uint8_t c) const;
+
+  uint32_t next_state(uint32_t s, uint8_t c) const
+  {
+    for (;;)
+    {
+      if (s == 0)
+        return m_root_next[c];
+      const uint32_t t = find_edge(m_states[s], c);
+      if (t)
+        return t;
+      s = m_states[s].fail;
+    }
+  }
+};
+
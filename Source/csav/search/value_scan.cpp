@@ -0,0 +1,712 @@
+#include "value_scan.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <unordered_map>
+#include <fmt/format.h>
+#include <csav/search/byte_find.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VALUE_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+const char* scan_value_type_name(scan_value_type type)
+{
+  switch (type)
+  {
+    case scan_value_type::u8: return "u8";
+    case scan_value_type::u16: return "u16";
+    case scan_value_type::u32: return "u32";
+    case scan_value_type::i32: return "i32";
+    case scan_value_type::u64: return "u64";
+    case scan_value_type::f32: return "float";
+    case scan_value_type::f64: return "double";
+    default: break;
+  }
+  return "unknown";
+}
+
+size_t scan_value_type_size(scan_value_type type)
+{
+  switch (type)
+  {
+    case scan_value_type::u8: return 1;
+    case scan_value_type::u16: return 2;
+    case scan_value_type::u32: return 4;
+    case scan_value_type::i32: return 4;
+    case scan_value_type::u64: return 8;
+    case scan_value_type::f32: return 4;
+    case scan_value_type::f64: return 8;
+    default: break;
+  }
+  return 0;
+}
+
+const char* scan_predicate_name(scan_predicate pred)
+{
+  switch (pred)
+  {
+    case scan_predicate::equal: return "equal";
+    case scan_predicate::range: return "in range";
+    case scan_predicate::unknown: return "unknown value";
+    case scan_predicate::changed: return "changed";
+    case scan_predicate::unchanged: return "unchanged";
+    case scan_predicate::increased: return "increased";
+    case scan_predicate::decreased: return "decreased";
+    default: break;
+  }
+  return "unknown";
+}
+
+bool scan_predicate_needs_previous(scan_predicate pred)
+{
+  switch (pred)
+  {
+    case scan_predicate::changed:
+    case scan_predicate::unchanged:
+    case scan_predicate::increased:
+    case scan_predicate::decreased:
+      return true;
+    default: break;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// kernels
+//------------------------------------------------------------------------------
+
+namespace {
+
+template <typename T>
+T load(const uint8_t* p)
+{
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return v;
+}
+
+template <typename T>
+T to_value(double d)
+{
+  if constexpr (std::is_floating_point_v<T>)
+  {
+    return (T)d;
+  }
+  else
+  {
+    constexpr double lo = (double)std::numeric_limits<T>::min();
+    constexpr double hi = (double)std::numeric_limits<T>::max();
+    if (d <= lo)
+      return std::numeric_limits<T>::min();
+    if (d >= hi)
+      return std::numeric_limits<T>::max();
+    return (T)d;
+  }
+}
+
+template <typename T>
+bool eval(scan_predicate pred, T cur, T prev, T v1, T v2)
+{
+  switch (pred)
+  {
+    case scan_predicate::equal: return cur == v1;
+    case scan_predicate::range: return cur >= v1 && cur <= v2;
+    case scan_predicate::unknown: return true;
+    case scan_predicate::changed: return cur != prev;
+    case scan_predicate::unchanged: return cur == prev;
+    case scan_predicate::increased: return cur > prev;
+    case scan_predicate::decreased: return cur < prev;
+    default: break;
+  }
+  return false;
+}
+
+// Bit rel of the result is set if the predicate holds for the value at
+// cur + rel (and prev + rel). 16 + sizeof(T) - 1 bytes must be readable.
+template <typename T>
+uint32_t eval_block16(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, T v1, T v2)
+{
+  uint32_t mask = 0;
+  for (uint32_t rel = 0; rel < 16; ++rel)
+  {
+    const T p = prev ? load<T>(prev + rel) : T{};
+    if (eval(pred, load<T>(cur + rel), p, v1, v2))
+      mask |= 1u << rel;
+  }
+  return mask;
+}
+
+#if defined(VALUE_SCAN_SSE2)
+
+// A 16-byte load at cur + k holds the values at cur + k + i * sizeof(T):
+// sizeof(T) loads cover 16 offsets. Compares give all-ones lanes, bits()
+// packs them to one bit per value.
+
+struct sse_f32
+{
+  using vec = __m128;
+  static vec load(const uint8_t* p) { return _mm_loadu_ps((const float*)p); }
+  static vec set1(float v) { return _mm_set1_ps(v); }
+  static __m128i eq(vec a, vec b) { return _mm_castps_si128(_mm_cmpeq_ps(a, b)); }
+  static __m128i neq(vec a, vec b) { return _mm_castps_si128(_mm_cmpneq_ps(a, b)); }
+  static __m128i lt(vec a, vec b) { return _mm_castps_si128(_mm_cmplt_ps(a, b)); }
+  static __m128i gt(vec a, vec b) { return _mm_castps_si128(_mm_cmpgt_ps(a, b)); }
+  static __m128i ge(vec a, vec b) { return _mm_castps_si128(_mm_cmpge_ps(a, b)); }
+  static __m128i le(vec a, vec b) { return _mm_castps_si128(_mm_cmple_ps(a, b)); }
+  static uint32_t bits(__m128i m) { return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(m)); }
+};
+
+struct sse_f64
+{
+  using vec = __m128d;
+  static vec load(const uint8_t* p) { return _mm_loadu_pd((const double*)p); }
+  static vec set1(double v) { return _mm_set1_pd(v); }
+  static __m128i eq(vec a, vec b) { return _mm_castpd_si128(_mm_cmpeq_pd(a, b)); }
+  static __m128i neq(vec a, vec b) { return _mm_castpd_si128(_mm_cmpneq_pd(a, b)); }
+  static __m128i lt(vec a, vec b) { return _mm_castpd_si128(_mm_cmplt_pd(a, b)); }
+  static __m128i gt(vec a, vec b) { return _mm_castpd_si128(_mm_cmpgt_pd(a, b)); }
+  static __m128i ge(vec a, vec b) { return _mm_castpd_si128(_mm_cmpge_pd(a, b)); }
+  static __m128i le(vec a, vec b) { return _mm_castpd_si128(_mm_cmple_pd(a, b)); }
+  static uint32_t bits(__m128i m) { return (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(m)); }
+};
+
+// sse2 compares of 8, 16 and 32-bit lanes are signed
+template <size_t Size> struct sse_lanes;
+
+template <> struct sse_lanes<1>
+{
+  static __m128i set1(uint32_t v) { return _mm_set1_epi8((char)v); }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+  static __m128i lt(__m128i a, __m128i b) { return _mm_cmplt_epi8(a, b); }
+  static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi8(a, b); }
+  static uint32_t bits(__m128i m) { return (uint32_t)_mm_movemask_epi8(m); }
+};
+
+template <> struct sse_lanes<2>
+{
+  static __m128i set1(uint32_t v) { return _mm_set1_epi16((short)v); }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+  static __m128i lt(__m128i a, __m128i b) { return _mm_cmplt_epi16(a, b); }
+  static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi16(a, b); }
+  static uint32_t bits(__m128i m) { return (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128())); }
+};
+
+template <> struct sse_lanes<4>
+{
+  static __m128i set1(uint32_t v) { return _mm_set1_epi32((int)v); }
+  static __m128i eq(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+  static __m128i lt(__m128i a, __m128i b) { return _mm_cmplt_epi32(a, b); }
+  static __m128i gt(__m128i a, __m128i b) { return _mm_cmpgt_epi32(a, b); }
+  static uint32_t bits(__m128i m) { return (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(m)); }
+};
+
+// unsigned compares are signed compares of values biased by their sign bit
+template <size_t Size, uint32_t Bias>
+struct sse_int
+{
+  using lanes = sse_lanes<Size>;
+  using vec = __m128i;
+  static vec load(const uint8_t* p) { return _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), lanes::set1(Bias)); }
+  static vec set1(uint32_t v) { return lanes::set1(v ^ Bias); }
+  static __m128i ones() { return _mm_set1_epi32(-1); }
+  static __m128i eq(vec a, vec b) { return lanes::eq(a, b); }
+  static __m128i neq(vec a, vec b) { return _mm_xor_si128(eq(a, b), ones()); }
+  static __m128i lt(vec a, vec b) { return lanes::lt(a, b); }
+  static __m128i gt(vec a, vec b) { return lanes::gt(a, b); }
+  static __m128i ge(vec a, vec b) { return _mm_xor_si128(lt(a, b), ones()); }
+  static __m128i le(vec a, vec b) { return _mm_xor_si128(gt(a, b), ones()); }
+  static uint32_t bits(__m128i m) { return lanes::bits(m); }
+};
+
+using sse_u8 = sse_int<1, 0x80u>;
+using sse_u16 = sse_int<2, 0x8000u>;
+using sse_u32 = sse_int<4, 0x80000000u>;
+using sse_i32 = sse_int<4, 0>;
+
+// sse2 has no 64-bit compares: they are made of the compares of the biased
+// 32-bit halves, a > b if hi(a) > hi(b) or (hi(a) == hi(b) and lo(a) > lo(b)),
+// with the result broadcast to both halves
+struct sse_u64
+{
+  using vec = __m128i;
+  static __m128i bias() { return _mm_set1_epi32((int)0x80000000u); }
+  static vec load(const uint8_t* p) { return _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), bias()); }
+  static vec set1(uint64_t v) { return _mm_xor_si128(_mm_set_epi32((int)(v >> 32), (int)v, (int)(v >> 32), (int)v), bias()); }
+  static __m128i ones() { return _mm_set1_epi32(-1); }
+  static __m128i hi(__m128i m) { return _mm_shuffle_epi32(m, _MM_SHUFFLE(3, 3, 1, 1)); }
+  static __m128i lo(__m128i m) { return _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 2, 0, 0)); }
+  static __m128i eq(vec a, vec b) { const __m128i e = _mm_cmpeq_epi32(a, b); return _mm_and_si128(hi(e), lo(e)); }
+  static __m128i neq(vec a, vec b) { return _mm_xor_si128(eq(a, b), ones()); }
+  static __m128i gt(vec a, vec b)
+  {
+    const __m128i g = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(hi(g), _mm_and_si128(hi(_mm_cmpeq_epi32(a, b)), lo(g)));
+  }
+  static __m128i lt(vec a, vec b) { return gt(b, a); }
+  static __m128i ge(vec a, vec b) { return _mm_xor_si128(lt(a, b), ones()); }
+  static __m128i le(vec a, vec b) { return _mm_xor_si128(gt(a, b), ones()); }
+  static uint32_t bits(__m128i m) { return (uint32_t)_mm_movemask_pd(_mm_castsi128_pd(m)); }
+};
+
+// moves bit i of the bits() of a load to bit i * Size
+template <size_t Size>
+uint32_t spread_bits(uint32_t b)
+{
+  if constexpr (Size == 1)
+  {
+    return b;
+  }
+  else if constexpr (Size == 2)
+  {
+    b = (b | (b << 4)) & 0x0F0F;
+    b = (b | (b << 2)) & 0x3333;
+    return (b | (b << 1)) & 0x5555;
+  }
+  else if constexpr (Size == 4)
+  {
+    b = (b | (b << 6)) & 0x0303;
+    return (b | (b << 3)) & 0x1111;
+  }
+  else
+  {
+    return (b & 1) | ((b & 2) << 7);
+  }
+}
+
+template <typename Ops, typename T>
+uint32_t eval_block16_sse(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, T v1, T v2)
+{
+  if (pred == scan_predicate::unknown)
+    return 0xFFFF;
+
+  const auto s1 = Ops::set1(v1);
+  const auto s2 = Ops::set1(v2);
+
+  uint32_t mask = 0;
+  for (size_t k = 0; k < sizeof(T); ++k)
+  {
+    const auto a = Ops::load(cur + k);
+    __m128i m;
+    switch (pred)
+    {
+      case scan_predicate::equal: m = Ops::eq(a, s1); break;
+      case scan_predicate::range: m = _mm_and_si128(Ops::ge(a, s1), Ops::le(a, s2)); break;
+      case scan_predicate::changed: m = Ops::neq(a, Ops::load(prev + k)); break;
+      case scan_predicate::unchanged: m = Ops::eq(a, Ops::load(prev + k)); break;
+      case scan_predicate::increased: m = Ops::gt(a, Ops::load(prev + k)); break;
+      case scan_predicate::decreased: m = Ops::lt(a, Ops::load(prev + k)); break;
+      default: m = _mm_setzero_si128(); break;
+    }
+    mask |= spread_bits<sizeof(T)>(Ops::bits(m)) << k;
+  }
+  return mask;
+}
+
+template <>
+uint32_t eval_block16<uint8_t>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, uint8_t v1, uint8_t v2)
+{
+  return eval_block16_sse<sse_u8>(pred, cur, prev, v1, v2);
+}
+
+template <>
+uint32_t eval_block16<uint16_t>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, uint16_t v1, uint16_t v2)
+{
+  return eval_block16_sse<sse_u16>(pred, cur, prev, v1, v2);
+}
+
+template <>
+uint32_t eval_block16<float>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, float v1, float v2)
+{
+  return eval_block16_sse<sse_f32>(pred, cur, prev, v1, v2);
+}
+
+template <>
+uint32_t eval_block16<uint32_t>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, uint32_t v1, uint32_t v2)
+{
+  return eval_block16_sse<sse_u32>(pred, cur, prev, v1, v2);
+}
+
+template <>
+uint32_t eval_block16<int32_t>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, int32_t v1, int32_t v2)
+{
+  return eval_block16_sse<sse_i32>(pred, cur, prev, (uint32_t)v1, (uint32_t)v2);
+}
+
+template <>
+uint32_t eval_block16<uint64_t>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, uint64_t v1, uint64_t v2)
+{
+  return eval_block16_sse<sse_u64>(pred, cur, prev, v1, v2);
+}
+
+template <>
+uint32_t eval_block16<double>(scan_predicate pred, const uint8_t* cur, const uint8_t* prev, double v1, double v2)
+{
+  return eval_block16_sse<sse_f64>(pred, cur, prev, v1, v2);
+}
+
+#endif
+
+inline uint32_t popcount32(uint32_t v)
+{
+  v = v - ((v >> 1) & 0x55555555);
+  v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+  return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+uint32_t get_bits16(const std::vector<uint64_t>& bits, size_t pos)
+{
+  const size_t w = pos >> 6, s = pos & 63;
+  uint64_t v = bits[w] >> s;
+  if (s > 48 && w + 1 < bits.size())
+    v |= bits[w + 1] << (64 - s);
+  return (uint32_t)(v & 0xFFFF);
+}
+
+void or_bits16(std::vector<uint64_t>& bits, size_t pos, uint32_t mask)
+{
+  const size_t w = pos >> 6, s = pos & 63;
+  bits[w] |= (uint64_t)mask << s;
+  if (s > 48 && w + 1 < bits.size())
+    bits[w + 1] |= (uint64_t)mask >> (64 - s);
+}
+
+struct data_interval_t
+{
+  size_t interval_idx = 0; // in flat_node_view::intervals()
+  size_t flat_offset = 0;
+  size_t size = 0;
+};
+
+std::vector<data_interval_t> data_intervals(const flat_node_view& view)
+{
+  std::vector<data_interval_t> res;
+  auto& intervals = view.intervals();
+  for (size_t i = 0; i < intervals.size(); ++i)
+  {
+    auto& itv = intervals[i];
+    if (itv.is_idx_header)
+      continue;
+    const size_t end = (i + 1 < intervals.size()) ? intervals[i + 1].flat_offset : view.size();
+    res.push_back({i, itv.flat_offset, end - itv.flat_offset});
+  }
+  return res;
+}
+
+// Candidates of [0, cnt) relative offsets, cur at cur_offset in the new view,
+// prev at prev_offset in the previous one (prev_bits is null for a first scan).
+template <typename T>
+size_t scan_interval(
+  scan_predicate pred, T v1, T v2,
+  const uint8_t* cur, size_t cur_offset, std::vector<uint64_t>& bits,
+  const uint8_t* prev, size_t prev_offset, const std::vector<uint64_t>* prev_bits,
+  size_t cnt)
+{
+  size_t found = 0;
+  size_t rel = 0;
+  for (; rel + 16 <= cnt; rel += 16)
+  {
+    const uint32_t candidates = prev_bits ? get_bits16(*prev_bits, prev_offset + rel) : 0xFFFF;
+    if (!candidates)
+      continue;
+
+    const uint8_t* p = prev ? prev + prev_offset + rel : nullptr;
+    const uint32_t mask = eval_block16<T>(pred, cur + cur_offset + rel, p, v1, v2) & candidates;
+    if (mask)
+    {
+      or_bits16(bits, cur_offset + rel, mask);
+      found += popcount32(mask);
+    }
+  }
+
+  for (; rel < cnt; ++rel)
+  {
+    if (prev_bits && !(((*prev_bits)[(prev_offset + rel) >> 6] >> ((prev_offset + rel) & 63)) & 1))
+      continue;
+
+    const T p = prev ? load<T>(prev + prev_offset + rel) : T{};
+    if (eval(pred, load<T>(cur + cur_offset + rel), p, v1, v2))
+    {
+      bits[(cur_offset + rel) >> 6] |= uint64_t(1) << ((cur_offset + rel) & 63);
+      ++found;
+    }
+  }
+
+  return found;
+}
+
+struct scan_job_t
+{
+  scan_predicate pred;
+  double v1, v2;
+  const flat_node_view* cur_view;
+  std::vector<uint64_t>* bits;
+  const flat_node_view* prev_view;          // null for a first scan
+  const std::vector<uint64_t>* prev_bits;
+  std::vector<size_t>* prev_intervals;      // filled for next scans
+
+  template <typename T>
+  size_t run() const
+  {
+    const T tv1 = to_value<T>(v1);
+    const T tv2 = to_value<T>(v2);
+    const uint8_t* cur = cur_view->data().data();
+
+    auto cur_itvs = data_intervals(*cur_view);
+    size_t found = 0;
+
+    if (!prev_view)
+    {
+      for (auto& itv : cur_itvs)
+      {
+        if (itv.size >= sizeof(T))
+          found += scan_interval<T>(pred, tv1, tv2, cur, itv.flat_offset, *bits, nullptr, 0, nullptr, itv.size - sizeof(T) + 1);
+      }
+      return found;
+    }
+
+    // nodes are matched by name and occurrence order
+    auto prev_itvs = data_intervals(*prev_view);
+    std::unordered_map<std::string, std::vector<size_t>> prev_by_name;
+    for (size_t i = 0; i < prev_itvs.size(); ++i)
+      prev_by_name[prev_view->intervals()[prev_itvs[i].interval_idx].node->name()].push_back(i);
+
+    std::unordered_map<std::string, size_t> occurrences;
+    const uint8_t* prev = prev_view->data().data();
+    for (auto& itv : cur_itvs)
+    {
+      const std::string name = cur_view->intervals()[itv.interval_idx].node->name();
+      const size_t occurrence = occurrences[name]++;
+      auto it = prev_by_name.find(name);
+      if (it == prev_by_name.end() || occurrence >= it->second.size())
+        continue;
+
+      auto& prev_itv = prev_itvs[it->second[occurrence]];
+      (*prev_intervals)[itv.interval_idx] = prev_itv.interval_idx;
+
+      const size_t common_size = std::min(itv.size, prev_itv.size);
+      if (common_size >= sizeof(T))
+        found += scan_interval<T>(pred, tv1, tv2, cur, itv.flat_offset, *bits, prev, prev_itv.flat_offset, prev_bits, common_size - sizeof(T) + 1);
+    }
+    return found;
+  }
+};
+
+size_t run_scan(scan_value_type type, const scan_job_t& job)
+{
+  switch (type)
+  {
+    case scan_value_type::u8: return job.run<uint8_t>();
+    case scan_value_type::u16: return job.run<uint16_t>();
+    case scan_value_type::u32: return job.run<uint32_t>();
+    case scan_value_type::i32: return job.run<int32_t>();
+    case scan_value_type::u64: return job.run<uint64_t>();
+    case scan_value_type::f32: return job.run<float>();
+    case scan_value_type::f64: return job.run<double>();
+    default: break;
+  }
+  return 0;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+// value_scan
+//------------------------------------------------------------------------------
+
+void value_scan::reset()
+{
+  m_view.reset();
+  m_prev_view.reset();
+  m_bits.clear();
+  m_prev_intervals.clear();
+  m_count = 0;
+  m_scan_cnt = 0;
+}
+
+bool value_scan::first_scan(
+  const std::shared_ptr<const flat_node_view>& view, scan_value_type type,
+  scan_predicate pred, double v1, double v2, std::string& err)
+{
+  if (!view)
+  {
+    err = "no save to scan";
+    return false;
+  }
+  if (type >= scan_value_type::count || pred >= scan_predicate::count)
+  {
+    err = "invalid scan parameters";
+    return false;
+  }
+  if (scan_predicate_needs_previous(pred))
+  {
+    err = fmt::format("\"{}\" needs a previous scan", scan_predicate_name(pred));
+    return false;
+  }
+  if (pred == scan_predicate::range && v1 > v2)
+  {
+    err = "empty range";
+    return false;
+  }
+
+  reset();
+  m_type = type;
+  m_view = view;
+  m_bits.assign((view->size() + 63) / 64, 0);
+  m_prev_intervals.assign(view->intervals().size(), npos);
+
+  scan_job_t job{pred, v1, v2, view.get(), &m_bits, nullptr, nullptr, nullptr};
+  m_count = run_scan(type, job);
+  m_scan_cnt = 1;
+  return true;
+}
+
+bool value_scan::next_scan(
+  const std::shared_ptr<const flat_node_view>& view,
+  scan_predicate pred, double v1, double v2, std::string& err)
+{
+  if (!m_view)
+  {
+    err = "no first scan";
+    return false;
+  }
+  if (!view)
+  {
+    err = "no save to scan";
+    return false;
+  }
+  if (pred == scan_predicate::unknown || pred >= scan_predicate::count)
+  {
+    err = fmt::format("\"{}\" is for first scans", scan_predicate_name(pred));
+    return false;
+  }
+  if (pred == scan_predicate::range && v1 > v2)
+  {
+    err = "empty range";
+    return false;
+  }
+
+  std::vector<uint64_t> bits((view->size() + 63) / 64, 0);
+  std::vector<size_t> prev_intervals(view->intervals().size(), npos);
+
+  scan_job_t job{pred, v1, v2, view.get(), &bits, m_view.get(), &m_bits, &prev_intervals};
+  m_count = run_scan(m_type, job);
+
+  m_prev_view = std::move(m_view);
+  m_view = view;
+  m_bits = std::move(bits);
+  m_prev_intervals = std::move(prev_intervals);
+  ++m_scan_cnt;
+  return true;
+}
+
+std::vector<value_scan::candidate_t> value_scan::candidates(size_t maxcnt) const
+{
+  std::vector<candidate_t> res;
+  if (!m_view)
+    return res;
+
+  auto& data = m_view->data();
+  auto& intervals = m_view->intervals();
+
+  for (size_t w = 0; w < m_bits.size() && res.size() < maxcnt; ++w)
+  {
+    uint64_t word = m_bits[w];
+    while (word && res.size() < maxcnt)
+    {
+      const uint32_t lo = (uint32_t)word;
+      const unsigned bit = lo ? byte_find::ctz32(lo) : 32 + byte_find::ctz32((uint32_t)(word >> 32));
+      word &= word - 1;
+
+      candidate_t c;
+      c.flat_offset = w * 64 + bit;
+      c.loc = m_view->locate(c.flat_offset);
+      c.value = format_value(data.data() + c.flat_offset);
+
+      if (m_prev_view)
+      {
+        auto it = std::upper_bound(intervals.begin(), intervals.end(), c.flat_offset,
+          [](size_t off, const flat_node_view::interval_t& itv) { return off < itv.flat_offset; });
+        const size_t itv_idx = (size_t)(it - intervals.begin()) - 1;
+        const size_t prev_itv_idx = m_prev_intervals[itv_idx];
+        if (prev_itv_idx != npos)
+        {
+          const size_t prev_offset = m_prev_view->intervals()[prev_itv_idx].flat_offset + (c.flat_offset - intervals[itv_idx].flat_offset);
+          c.prev_value = format_value(m_prev_view->data().data() + prev_offset);
+        }
+      }
+
+      res.push_back(std::move(c));
+    }
+  }
+
+  return res;
+}
+
+std::string value_scan::format_value(const uint8_t* p) const
+{
+  switch (m_type)
+  {
+    case scan_value_type::u8: return fmt::format("{}", (uint32_t)load<uint8_t>(p));
+    case scan_value_type::u16: return fmt::format("{}", load<uint16_t>(p));
+    case scan_value_type::u32: return fmt::format("{}", load<uint32_t>(p));
+    case scan_value_type::i32: return fmt::format("{}", load<int32_t>(p));
+    case scan_value_type::u64: return fmt::format("{}", load<uint64_t>(p));
+    case scan_value_type::f32: return fmt::format("{}", load<float>(p));
+    case scan_value_type::f64: return fmt::format("{}", load<double>(p));
+    default: break;
+  }
+  return {};
+}
+
+//------------------------------------------------------------------------------
+// value_scan_job
+//------------------------------------------------------------------------------
+
+bool value_scan_job::start(
+  value_scan& scan, flat_view_source source, bool first,
+  scan_value_type type, scan_predicate pred, double v1, double v2)
+{
+  if (is_running() || !source)
+    return false;
+
+  auto state = std::make_shared<state_t>();
+  state->scan = std::move(scan);
+  scan.reset();
+  m_state = state;
+
+  m_job = job_scheduler::get().submit([state, source = std::move(source), first, type, pred, v1, v2](progress_t&) {
+    auto view = source();
+
+    // the scan alone, the view may just have been built
+    auto t0 = std::chrono::steady_clock::now();
+    const bool ok = first
+      ? state->scan.first_scan(view, type, pred, v1, v2, state->error)
+      : state->scan.next_scan(view, pred, v1, v2, state->error);
+    auto t1 = std::chrono::steady_clock::now();
+
+    state->elapsed_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    return ok;
+  });
+  return true;
+}
+
+bool value_scan_job::poll(value_scan& scan, std::string& error, double& elapsed_ms)
+{
+  if (!m_job || !m_job->is_done())
+    return false;
+
+  const bool ok = m_job->state() == job_state::succeeded;
+  m_job.reset();
+
+  scan = std::move(m_state->scan);
+  error = std::move(m_state->error);
+  if (!ok && error.empty())
+    error = "scan failed";
+  elapsed_ms = m_state->elapsed_ms;
+  m_state.reset();
+  return true;
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include <job_scheduler.hpp>
+#include <csav/search/flat_view.hpp>
+
+// Typed value scan over the node data of a save, cheat engine style.
+//
+// The first scan keeps the offsets whose value satisfies a predicate as a
+// bitmap over a flat_node_view. Next scans narrow the candidates against
+// another view (next save, or a re-read of the same save): nodes are matched
+// by name and occurrence order, candidates keep their offset in their node.
+// Values never straddle two nodes.
+//
+// Values are evaluated 16 offsets at a time with sse2 (one load per byte
+// of the type), with a scalar loop elsewhere.
+
+enum class scan_value_type : uint8_t
+{
+  u8,
+  u16,
+  u32,
+  i32,
+  u64,
+  f32,
+  f64,
+  count
+};
+
+enum class scan_predicate : uint8_t
+{
+  equal,
+  range,      // v1 <= value <= v2
+  unknown,    // any value, first scan only
+  changed,    // next scans only..
+  unchanged,
+  increased,
+  decreased,
+  count
+};
+
+const char* scan_value_type_name(scan_value_type type);
+size_t scan_value_type_size(scan_value_type type);
+
+const char* scan_predicate_name(scan_predicate pred);
+// changed, unchanged, increased and decreased compare with the previous scan
+bool scan_predicate_needs_previous(scan_predicate pred);
+
+class value_scan
+{
+protected:
+  scan_value_type m_type = scan_value_type::u32;
+  std::shared_ptr<const flat_node_view> m_view;      // view the candidates refer to
+  std::shared_ptr<const flat_node_view> m_prev_view; // view of the previous scan, if any
+  std::vector<uint64_t> m_bits;                      // candidate bitmap over m_view
+  std::vector<size_t> m_prev_intervals;              // per m_view interval, matched m_prev_view interval or npos
+  size_t m_count = 0;
+  size_t m_scan_cnt = 0;
+
+public:
+  static constexpr size_t npos = (size_t)-1;
+
+  value_scan() = default;
+
+  void reset();
+
+  [[nodiscard]] bool first_scan(
+    const std::shared_ptr<const flat_node_view>& view, scan_value_type type,
+    scan_predicate pred, double v1, double v2, std::string& err);
+
+  [[nodiscard]] bool next_scan(
+    const std::shared_ptr<const flat_node_view>& view,
+    scan_predicate pred, double v1, double v2, std::string& err);
+
+  bool has_candidates() const { return m_view != nullptr; }
+  size_t candidate_count() const { return m_count; }
+  size_t scan_count() const { return m_scan_cnt; }
+  scan_value_type type() const { return m_type; }
+
+  const std::shared_ptr<const flat_node_view>& view() const { return m_view; }
+
+  struct candidate_t
+  {
+    size_t flat_offset = 0;
+    flat_node_view::location_t loc;
+    std::string value;
+    std::string prev_value; // empty after a first scan
+  };
+
+  // the maxcnt first candidates in offset order
+  std::vector<candidate_t> candidates(size_t maxcnt) const;
+
+  std::string format_value(const uint8_t* p) const;
+};
+
+// Runs a first or next scan in a job_scheduler job, the view is given by a
+// source called from the job (see flat_view_cache). The scan is moved into
+// the job and given back by poll(), unchanged if the scan failed.
+class value_scan_job
+{
+  struct state_t
+  {
+    value_scan scan;
+    std::string error;
+    double elapsed_ms = 0;
+  };
+
+  // shared with the job, which doesn't need its owner
+  std::shared_ptr<state_t> m_state;
+  job_scheduler::job_ptr m_job;
+
+public:
+  value_scan_job() = default;
+  value_scan_job(const value_scan_job&) = delete;
+  value_scan_job& operator=(const value_scan_job&) = delete;
+
+  ~value_scan_job()
+  {
+    if (m_job)
+      m_job->cancel();
+  }
+
+  // until the scan is polled
+  bool is_running() const { return m_job != nullptr; }
+
+  // scan is moved from if the job starts, type is ignored by next scans
+  bool start(
+    value_scan& scan, flat_view_source source, bool first,
+    scan_value_type type, scan_predicate pred, double v1, double v2);
+
+  // to be called from the thread that started the job, returns true once
+  // when the scan is back, error is empty if it succeeded
+  bool poll(value_scan& scan, std::string& error, double& elapsed_ms);
+};
@@ -0,0 +1,142 @@
+#include "structure_tasks.hpp"
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <fmt/format.h>
+#include <job_scheduler.hpp>
+
+namespace {
+
+struct task_state
+{
+  bool started = false;
+  bool done = false;
+  bool ok = false;
+  std::string error;
+};
+
+bool run_task(structure_task& task, std::string& error, const progress_t& progress)
+{
+  if (progress.is_cancelled())
+  {
+    error = "cancelled";
+    return false;
+  }
+
+  try
+  {
+    if (task.fn(error))
+      return true;
+    if (error.empty())
+      error = "failed";
+  }
+  catch (std::exception& e)
+  {
+    error = e.what();
+  }
+  return false;
+}
+
+} // namespace
+
+std::vector<structure_task_failure> run_structure_tasks(
+  std::vector<structure_task> tasks, size_t thread_cnt,
+  progress_t& progress, float progress_from, float progress_to, std::string_view verb)
+{
+  const size_t cnt = tasks.size();
+  std::vector<task_state> states(cnt);
+
+  uint64_t total_weight = 0;
+  for (auto& task : tasks)
+  {
+    task.weight = std::max<uint64_t>(task.weight, 1);
+    total_weight += task.weight;
+  }
+
+  if (thread_cnt == 0)
+    thread_cnt = job_scheduler::get().thread_count();
+  thread_cnt = std::min(thread_cnt, cnt);
+
+  if (thread_cnt <= 1)
+  {
+    uint64_t done_weight = 0;
+    for (size_t i = 0; i < cnt; ++i)
+    {
+      progress.set_comment(fmt::format("{} {}", verb, tasks[i].name));
+      auto& st = states[i];
+      st.ok = run_task(tasks[i], st.error, progress);
+      st.done = true;
+      done_weight += tasks[i].weight;
+      progress.value = progress_from + (progress_to - progress_from) * (float)((double)done_weight / total_weight);
+    }
+  }
+  else
+  {
+    // heaviest first
+    std::vector<size_t> order(cnt);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+      return tasks[a].weight > tasks[b].weight;
+    });
+
+    std::mutex mtx;
+    size_t done_cnt = 0; // guarded by mtx
+    uint64_t done_weight = 0; // guarded by mtx
+
+    // guarded by mtx
+    auto update_progress = [&]() {
+      std::string comment(verb);
+      for (size_t i : order)
+      {
+        if (!states[i].started || states[i].done)
+          continue;
+        comment += comment.size() > verb.size() ? ", " : " ";
+        comment += tasks[i].name;
+      }
+      progress.set_comment(fmt::format("{} ({}/{})", comment, done_cnt, cnt));
+      progress.value = progress_from + (progress_to - progress_from) * (float)((double)done_weight / total_weight);
+    };
+
+    job_scheduler::get().parallel_for(cnt, [&](size_t k) {
+      const size_t i = order[k];
+      {
+        std::lock_guard<std::mutex> lk(mtx);
+        states[i].started = true;
+        update_progress();
+      }
+
+      std::string error;
+      const bool ok = run_task(tasks[i], error, progress);
+
+      std::lock_guard<std::mutex> lk(mtx);
+      auto& st = states[i];
+      st.done = true;
+      st.ok = ok;
+      st.error = std::move(error);
+      ++done_cnt;
+      done_weight += tasks[i].weight;
+      update_progress();
+    }, thread_cnt);
+  }
+
+  std::vector<structure_task_failure> failures;
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    if (!states[i].ok)
+      failures.push_back({tasks[i].name, std::move(states[i].error)});
+  }
+  return failures;
+}
+
+std::string format_structure_failures(const std::vector<structure_task_failure>& failures)
+{
+  std::string msg;
+  for (auto& f : failures)
+  {
+    if (msg.size())
+      msg += '\n';
+    msg += fmt::format("{}: {}", f.name, f.error);
+  }
+  return msg;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utils.hpp>
+
+// Runs the per-structure work of a save (loading, re-serialization) as
+// subtasks on the job_scheduler, the calling thread included. The tasks must
+// be independent: each one reads or builds its own node subtree, the shared
+// registries they use (blueprints, names) are thread-safe.
+// The heaviest tasks start first so that the total time approaches the one
+// of the heaviest task rather than the sum. The progress is written under a
+// lock as tasks start and complete.
+// A failing task doesn't stop the others, every failure is returned.
+// Once the progress is cancelled the tasks that didn't start fail with
+// "cancelled".
+
+struct structure_task
+{
+  std::string name;
+  uint64_t weight = 1; // e.g. size of the node subtree, for scheduling and progress
+  // false and error set on failure, exceptions are caught as failures
+  std::function<bool(std::string& error)> fn;
+};
+
+struct structure_task_failure
+{
+  std::string name;
+  std::string error;
+};
+
+// thread_cnt: 0 for the whole scheduler pool, 1 runs the tasks on the calling thread.
+// progress goes from progress_from to progress_to, verb prefixes its comment.
+// failures are in the order of the tasks.
+std::vector<structure_task_failure> run_structure_tasks(
+  std::vector<structure_task> tasks, size_t thread_cnt,
+  progress_t& progress, float progress_from, float progress_to, std::string_view verb);
+
+// one line per failure, "name: error"
+std::string format_structure_failures(const std::vector<structure_task_failure>& failures);
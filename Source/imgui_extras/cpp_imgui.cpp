@@ -1,5 +1,6 @@
 #include "cpp_imgui.hpp"
 #include "imgui.h"
+#include "imgui_internal.h"
 
 
 
@@ -15,6 +16,74 @@ bool ImGui::ListBox(std::string_view label, int* current_item, const std::vector
   return ImGui::ListBox(label.data(), current_item, ListBoxVectorGetter, (void*)&items, (int)items.size(), height_items);
 }
 
+ImGui::TableRowsClipper::TableRowsClipper(std::vector<float>& row_heights, int items_count)
+  : m_heights(row_heights)
+{
+  ImGuiTable* table = GImGui->CurrentTable;
+  IM_ASSERT(table && "TableRowsClipper must be used within a table");
+
+  // unmeasured rows are assumed to hold a single frame (e.g. a collapsed tree node)
+  const float pad_y2 = table->CellPaddingY * 2.f;
+  m_heights.resize(items_count, GetFrameHeight() + pad_y2);
+  if (items_count == 0)
+    return;
+
+  TableNextRow();
+  m_row_begun = true;
 
+  const float y0 = table->RowPosY1;
+  const ImRect& clip = table->InnerClipRect;
 
+  float y = y0;
+  int i = 0;
+  while (i < items_count && y + m_heights[i] < clip.Min.y)
+    y += m_heights[i++];
+  DisplayStart = i;
+  const float before_h = y - y0;
+  while (i < items_count && y < clip.Max.y)
+    y += m_heights[i++];
+  DisplayEnd = i;
+  while (i < items_count)
+    m_after_h += m_heights[i++];
 
+  if (DisplayStart > 0 || DisplayEnd == 0)
+  {
+    // the row that just began is the leading spacer
+    TableNextColumn();
+    Dummy(ImVec2(0.f, ImMax(0.f, before_h - pad_y2)));
+    m_row_begun = false;
+  }
+  m_row = DisplayStart - 1;
+}
+
+void ImGui::TableRowsClipper::NextRow()
+{
+  ImGuiTable* table = GImGui->CurrentTable;
+  if (!m_row_begun)
+  {
+    TableNextRow();
+    if (m_row >= DisplayStart)
+      m_heights[m_row] = table->RowPosY1 - m_row_y1;
+  }
+  m_row_begun = false;
+  m_row_y1 = table->RowPosY1;
+  ++m_row;
+}
+
+void ImGui::TableRowsClipper::End()
+{
+  if (m_ended)
+    return;
+  m_ended = true;
+
+  // the last visible row is measured when the trailing spacer begins
+  if (DisplayEnd < (int)m_heights.size())
+  {
+    ImGuiTable* table = GImGui->CurrentTable;
+    TableNextRow();
+    if (m_row >= DisplayStart)
+      m_heights[m_row] = table->RowPosY1 - m_row_y1;
+    TableNextColumn();
+    Dummy(ImVec2(0.f, ImMax(0.f, m_after_h - table->CellPaddingY * 2.f)));
+  }
+}
@@ -10,6 +10,37 @@ namespace ImGui
 {
   bool ListBox(std::string_view label, int* current_item, const std::vector<std::string>& items, int height_items = -1);
 
+  // ImGuiListClipper for table rows of different heights (e.g. elements
+  // whose tree node can be expanded). Rows out of view are replaced by two
+  // spacer rows sized with the heights measured the last time they were
+  // visible, row_heights keeps them between frames and is owned by the caller.
+  // Usage, after TableHeadersRow():
+  //   TableRowsClipper clipper(row_heights, (int)items.size());
+  //   for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+  //   {
+  //     clipper.NextRow();
+  //     TableNextColumn(); ...
+  //   }
+  //   clipper.End();
+  struct TableRowsClipper
+  {
+    int DisplayStart = 0;
+    int DisplayEnd = 0;
+
+    TableRowsClipper(std::vector<float>& row_heights, int items_count);
+
+    void NextRow();
+    void End(); // must be called before EndTable()
+
+  protected:
+    std::vector<float>& m_heights;
+    int m_row = -1;         // current row
+    float m_row_y1 = 0;     // top of the current row
+    float m_after_h = 0;    // height of the rows after DisplayEnd
+    bool m_row_begun = false; // NextRow() mustn't start a new table row
+    bool m_ended = false;
+  };
+
   // returns true if data has been modified
   template <typename T, typename ItemNameGetFnT,
     std::enable_if_t<
@@ -1,6 +1,7 @@
 #include "AppLib/imgui/imgui.h"
 #include "AppLib/imgui/imgui_internal.h"
 #include <cctype>
+#include <cstdint>
 	
 // https://github.com/HasKha/GWToolboxpp
 
@@ -0,0 +1,228 @@
+#include "job_scheduler.hpp"
+#include <algorithm>
+#include <exception>
+
+// indices of a parallel_for, claimed by the calling thread and the workers
+// that dequeue one of its helper entries
+struct job_scheduler::batch
+{
+  const std::function<void(size_t)>* fn = nullptr;
+  size_t cnt = 0;
+  std::atomic<size_t> next = 0;
+  std::atomic<size_t> done = 0;
+
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::exception_ptr error; // guarded by mtx
+
+  // fn isn't touched once every index is claimed, the caller may be gone
+  void run()
+  {
+    for (;;)
+    {
+      const size_t i = next++;
+      if (i >= cnt)
+        return;
+
+      try
+      {
+        (*fn)(i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lk(mtx);
+        if (!error)
+          error = std::current_exception();
+      }
+
+      if (++done == cnt)
+      {
+        std::lock_guard<std::mutex> lk(mtx);
+        cv.notify_all();
+      }
+    }
+  }
+};
+
+void job_scheduler::job::cancel()
+{
+  m_progress.cancel();
+  auto expected = job_state::queued;
+  m_state.compare_exchange_strong(expected, job_state::cancelled, std::memory_order_acq_rel);
+}
+
+job_scheduler& job_scheduler::get()
+{
+  static job_scheduler s(std::max(1u, std::thread::hardware_concurrency()));
+  return s;
+}
+
+job_scheduler::job_scheduler(size_t thread_cnt)
+{
+  thread_cnt = std::max<size_t>(thread_cnt, 1);
+  m_threads.reserve(thread_cnt);
+  for (size_t i = 0; i < thread_cnt; ++i)
+    m_threads.emplace_back([this]() { worker_loop(); });
+}
+
+job_scheduler::~job_scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    m_stopping = true;
+    for (auto& j : m_queue)
+    {
+      j->cancel();
+      --m_pending_cnt;
+    }
+    m_queue.clear();
+  }
+  m_cv.notify_all();
+  m_done_cv.notify_all();
+
+  for (auto& t : m_threads)
+    t.join();
+}
+
+job_scheduler::job_ptr job_scheduler::submit(job_fn_t fn)
+{
+  auto j = std::make_shared<job>();
+  j->m_fn = std::move(fn);
+
+  {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if (m_stopping)
+    {
+      j->cancel();
+      return j;
+    }
+    m_queue.push_back(j);
+    ++m_pending_cnt;
+  }
+  m_cv.notify_one();
+  return j;
+}
+
+void job_scheduler::wait(const job_ptr& j)
+{
+  if (!j)
+    return;
+
+  {
+    std::unique_lock<std::mutex> lk(m_mtx);
+    auto it = std::find(m_queue.begin(), m_queue.end(), j);
+    if (it == m_queue.end())
+    {
+      m_done_cv.wait(lk, [&j]() { return j->is_done(); });
+      return;
+    }
+    m_queue.erase(it);
+  }
+
+  run_job(j);
+}
+
+void job_scheduler::parallel_for(size_t cnt, const std::function<void(size_t)>& fn, size_t max_threads)
+{
+  if (!max_threads || max_threads > thread_count())
+    max_threads = thread_count();
+  const size_t helper_cnt = std::min(max_threads, cnt) - (cnt ? 1 : 0);
+
+  if (!helper_cnt)
+  {
+    for (size_t i = 0; i < cnt; ++i)
+      fn(i);
+    return;
+  }
+
+  auto b = std::make_shared<batch>();
+  b->fn = &fn;
+  b->cnt = cnt;
+
+  {
+    std::lock_guard<std::mutex> lk(m_mtx);
+    if (!m_stopping)
+    {
+      for (size_t i = 0; i < helper_cnt; ++i)
+        m_batches.push_back(b);
+    }
+  }
+  m_cv.notify_all();
+
+  b->run();
+
+  std::unique_lock<std::mutex> lk(b->mtx);
+  b->cv.wait(lk, [&b]() { return b->done.load() == b->cnt; });
+  if (b->error)
+    std::rethrow_exception(b->error);
+}
+
+void job_scheduler::run_job(const job_ptr& j)
+{
+  // cancelled while queued
+  auto expected = job_state::queued;
+  if (j->m_state.compare_exchange_strong(expected, job_state::running, std::memory_order_acq_rel))
+  {
+    bool ok = false;
+    try
+    {
+      ok = j->m_fn(j->m_progress);
+    }
+    catch (std::exception& e)
+    {
+      report_error("error", e.what());
+    }
+
+    // released before the owner can see the job done, the function may
+    // hold resources of its owner
+    j->m_fn = nullptr;
+
+    job_state result = ok ? job_state::succeeded : job_state::failed;
+    if (!ok && j->m_progress.is_cancelled())
+      result = job_state::cancelled;
+    j->m_state.store(result, std::memory_order_release);
+  }
+  else
+  {
+    j->m_fn = nullptr;
+  }
+
+  --m_pending_cnt;
+
+  // waiters check the state under the lock
+  {
+    std::lock_guard<std::mutex> lk(m_mtx);
+  }
+  m_done_cv.notify_all();
+}
+
+void job_scheduler::worker_loop()
+{
+  for (;;)
+  {
+    job_ptr j;
+    std::shared_ptr<batch> b;
+    {
+      std::unique_lock<std::mutex> lk(m_mtx);
+      m_cv.wait(lk, [this]() { return m_stopping || m_queue.size() || m_batches.size(); });
+      // subtasks first, they belong to jobs that are already running
+      if (m_batches.size())
+      {
+        b = std::move(m_batches.front());
+        m_batches.pop_front();
+      }
+      else if (m_queue.size())
+      {
+        j = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+      else
+        return;
+    }
+
+    if (b)
+      b->run();
+    else
+      run_job(j);
+  }
+}
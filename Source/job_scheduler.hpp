@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "utils.hpp"
+
+// Bounded pool of worker threads shared by the background jobs of the app
+// (opening and saving savefiles, searches). Jobs beyond the pool size wait
+// in a queue and start in submission order.
+// A job reports through its own progress_t, which the ui reads without
+// locking, and can be cancelled at any time: a queued job never runs, a
+// running one sees progress.is_cancelled() at its next check.
+// Jobs split their work with parallel_for, whose subtasks go to the idle
+// workers before the queued jobs: the thread count stays the pool size
+// however many jobs run at once.
+
+enum class job_state
+{
+  queued,
+  running,
+  succeeded,
+  failed,
+  cancelled,
+};
+
+class job_scheduler
+{
+public:
+  using job_fn_t = std::function<bool(progress_t&)>;
+
+  // handle shared by the scheduler and the owner of the job
+  class job
+  {
+    friend class job_scheduler;
+
+  public:
+    job_state state() const { return m_state.load(std::memory_order_acquire); }
+
+    // succeeded, failed or cancelled, what the job wrote is then visible
+    bool is_done() const { return state() > job_state::running; }
+
+    void cancel();
+
+    const progress_t& progress() const { return m_progress; }
+
+  private:
+    job_fn_t m_fn;
+    progress_t m_progress;
+    std::atomic<job_state> m_state = job_state::queued;
+  };
+
+  using job_ptr = std::shared_ptr<job>;
+
+  // the app-wide scheduler, one worker per hardware thread
+  static job_scheduler& get();
+
+  explicit job_scheduler(size_t thread_cnt);
+  // cancels the remaining jobs and waits for the running ones
+  ~job_scheduler();
+
+  job_scheduler(const job_scheduler&) = delete;
+  job_scheduler& operator=(const job_scheduler&) = delete;
+
+  job_ptr submit(job_fn_t fn);
+
+  // waits for a job to be done, running it on the calling thread if it is
+  // still queued (a job can wait for another one without a free worker)
+  void wait(const job_ptr& j);
+
+  // Runs fn(i) for every i of [0, cnt) on the calling thread and on up to
+  // max_threads - 1 idle workers (0: the whole pool), indices are taken in
+  // increasing order. Returns once every call is done and rethrows the first
+  // exception. The calling thread runs the indices no worker picked up, so
+  // it never waits for a worker busy with another job.
+  void parallel_for(size_t cnt, const std::function<void(size_t)>& fn, size_t max_threads = 0);
+
+  size_t thread_count() const { return m_threads.size(); }
+
+  // queued and running jobs
+  size_t pending_count() const { return m_pending_cnt.load(std::memory_order_relaxed); }
+
+protected:
+  struct batch;
+
+  void worker_loop();
+  void run_job(const job_ptr& j);
+
+private:
+  std::mutex m_mtx;
+  std::condition_variable m_cv;
+  std::condition_variable m_done_cv;
+  std::deque<job_ptr> m_queue;
+  std::deque<std::shared_ptr<batch>> m_batches; // parallel_for helpers
+  bool m_stopping = false;
+  std::atomic<size_t> m_pending_cnt = 0;
+  std::vector<std::thread> m_threads;
+};
+
@@ -11,7 +11,7 @@
 #include <fmt/format.h>
 #include <imgui_extras/imgui_filebrowser.hpp>
 
-#include "widgets/csav_widget.hpp"
+#include "widgets/csav_list_widget.hpp"
 #include "widgets/node_editors/hexedit.hpp"
 #include "archive/archive_test.hpp"
 
@@ -53,6 +53,10 @@ public:
 		m_wndname = L"Cyberpunk 2077\u2122 Save Editor v0.5.4-alpha.3 (CP_v1.06)";
 		m_display_width = 1600;
 		m_display_height = 900;
+
+		set_error_report_fn([](const std::string& title, const std::string& msg) {
+			MessageBoxA(0, msg.c_str(), title.c_str(), 0);
+		});
 	}
 
 protected:
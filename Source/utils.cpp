@@ -1,10 +1,13 @@
 #include "utils.hpp"
 
+#ifdef _WIN32
 #include <windows.h>
 #include <ShlObj.h>
-#include <intrin.h>
+#endif
 #include <cassert>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <sstream>
 #include <iomanip>
 #include <vector>
@@ -38,142 +41,83 @@ std::string bytes_to_hex(const void* buf, size_t len)
 }
 
 
-template <typename T, std::enable_if_t<sizeof(T) <= 4, int> = 0>
-inline unsigned ctz(const T value)
-{
-  assert(value != 0);
-  DWORD trailing_zero = 0;
-  return _BitScanForward(&trailing_zero, value) ? trailing_zero : sizeof(T) * 8;
+std::optional<std::filesystem::path> find_user_saved_games() {
+#ifdef _WIN32
+  PWSTR out_ptr{};
+  HRESULT hr = SHGetKnownFolderPath(FOLDERID_SavedGames, KF_FLAG_DEFAULT, nullptr, &out_ptr);
+  if (SUCCEEDED(hr)) {
+    std::shared_ptr<void> free_guard(out_ptr, CoTaskMemFree);
+    auto subdir = std::filesystem::path(out_ptr) / "CD Projekt Red" / "Cyberpunk 2077";
+    std::error_code ec;
+    if (exists(subdir, ec) && !ec && is_directory(subdir, ec) && !ec) {
+      return subdir;
+    }
+  }
+#endif
+  return {};
 }
 
-inline uint16_t candidates_lookup(__m128i headblk, __m128i tailblk, const unsigned char* headseq, const unsigned char* tailseq)
+namespace {
+
+std::mutex s_error_report_mtx;
+error_report_fn_t s_error_report_fn;
+
+} // namespace
+
+void set_error_report_fn(error_report_fn_t fn)
 {
-  const __m128i head_seq = _mm_loadu_si128(reinterpret_cast<const __m128i*>(headseq));
-  const __m128i tail_seq = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tailseq));
-  const __m128i eq_head = _mm_cmpeq_epi8(headblk, head_seq);
-  const __m128i eq_tail = _mm_cmpeq_epi8(tailblk, tail_seq);
-  return _mm_movemask_epi8(_mm_and_si128(eq_head, eq_tail)); // LSB -> first char match result
+  std::lock_guard<std::mutex> lk(s_error_report_mtx);
+  s_error_report_fn = std::move(fn);
 }
 
-struct needle_chunk {
-  uint32_t mask = { 0 };
-  __m128i value;
-};
-
-std::vector<uintptr_t> sse2_strstr_masked(const unsigned char* s, size_t m, const unsigned char* needle, size_t n, const char* mask, size_t maxcnt)
+void report_error(const std::string& title, const std::string& msg)
 {
-  assert(n > 2);
-  assert(m >= n);
-  assert(strlen(mask) == n);
-  assert(mask[0] == 'x');
-  assert(mask[n - 1] == 'x');
-
-  std::vector<uintptr_t> ret;
-
-  needle_chunk needle_chunks[4] = {};
-  // we pre-check first and last character so the final cmp is on range [1:n-2]
-  int nchunks = ((int)n - 2 + 15) / 16;
-  assert(nchunks <= 4);
-  char needle_copy[16 * 4] = { 0 }; // to avoid access violation by _mm_loadu_si128
-  memcpy(needle_copy, needle, n);
-  for (int i = 0, rem = (int)n - 2; i < nchunks; ++i, rem -= 16)
+  error_report_fn_t fn;
   {
-    const int ej = min(rem, 16);
-    for (size_t j = 0; j < ej; ++j) {
-      if (mask[16 * i + j + 1] == 'x')
-        needle_chunks[i].mask |= 1 << j;
-    }
-    needle_chunks[i].value = _mm_loadu_si128((const __m128i*)(needle_copy + 1 + i * 16));
+    std::lock_guard<std::mutex> lk(s_error_report_mtx);
+    fn = s_error_report_fn;
   }
 
-  const __m128i headblk = _mm_set1_epi8((char)needle[0]);
-  const __m128i tailblk = _mm_set1_epi8((char)needle[n - 1]);
-
-  for (size_t pos = 0; pos + n <= m; pos += 16)
-  {
-    if (pos + n + 15 > m) // avoid access violation case
-      pos = m - n - 15;
-
-    const BYTE* pc = s + pos;
-
-    uint16_t bitmask = candidates_lookup(headblk, tailblk, pc, pc + n - 1);
-    while (bitmask != 0)
-    {
-      const auto match_offset = ctz(bitmask);
-      bool match = true;
-      for (int j = 0; j < nchunks && match; ++j)
-      {
-        auto hay = _mm_loadu_si128((const __m128i*)(pc + match_offset + 1 + j * 16));
-        auto cmpmask = _mm_movemask_epi8(_mm_cmpeq_epi8(hay, needle_chunks[j].value));
-        match = ((cmpmask & needle_chunks[j].mask) == needle_chunks[j].mask);
-      }
-      if (match) {
-        ret.push_back(pos + match_offset);
-        if (maxcnt && ret.size() == maxcnt)
-          return ret;
-      }
-      bitmask ^= (1 << match_offset);
-    }
-  }
-
-  return ret;
+  if (fn)
+    fn(title, msg);
+  else
+    std::cerr << title << ": " << msg << std::endl;
 }
 
-std::vector<uintptr_t> sse2_strstr(const unsigned char* s, size_t m, const unsigned char* needle, size_t n, size_t maxcnt)
+void progress_t::set_comment(std::string_view comment)
 {
-  if (n == 0 || m < n)
-    return {};
-
-  std::vector<uintptr_t> ret;
-
-  if (n < 2) {
-    // fallback to default impl
-    const unsigned char* c = s;
-    const unsigned char* e = s + m;
-    while (c < e)
-      if (*c == *needle)
-        ret.push_back(s - c);
-    return ret;
-  }
-
-  const __m128i headblk = _mm_set1_epi8((char)needle[0]);
-  const __m128i tailblk = _mm_set1_epi8((char)needle[n - 1]);
+  const size_t len = std::min(comment.size(), comment_capacity - 1);
 
-  for (size_t pos = 0; pos + n <= m; pos += 16)
+  uint32_t seq = m_comment_seq.load(std::memory_order_relaxed);
+  for (;;)
   {
-    if (pos + n + 15 > m) // avoid access violation case
-      pos = m - n - 15;
-
-    const BYTE* pc = s + pos;
-
-    uint16_t bitmask = candidates_lookup(headblk, tailblk, pc, pc + n - 1);
-    while (bitmask != 0)
-    {
-      const auto match_offset = ctz(bitmask);
-      if (!memcmp(pc + match_offset + 1, needle + 1, n - 2)) {
-        ret.push_back(pos + match_offset);
-        if (maxcnt && ret.size() == maxcnt)
-          return ret;
-      }
-      bitmask ^= (1 << match_offset);
-    }
+    if (!(seq & 1) && m_comment_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_relaxed))
+      break;
+    std::this_thread::yield();
+    seq = m_comment_seq.load(std::memory_order_relaxed);
   }
+  std::atomic_thread_fence(std::memory_order_release);
 
-  return ret;
-}
+  for (size_t i = 0; i < len; ++i)
+    m_comment[i].store(comment[i], std::memory_order_relaxed);
+  m_comment[len].store(0, std::memory_order_relaxed);
 
+  m_comment_seq.store(seq + 2, std::memory_order_release);
+}
 
-std::optional<std::filesystem::path> find_user_saved_games() {
-  PWSTR out_ptr{};
-  HRESULT hr = SHGetKnownFolderPath(FOLDERID_SavedGames, KF_FLAG_DEFAULT, nullptr, &out_ptr);
-  if (SUCCEEDED(hr)) {
-    std::shared_ptr<void> free_guard(out_ptr, CoTaskMemFree);
-    auto subdir = std::filesystem::path(out_ptr) / "CD Projekt Red" / "Cyberpunk 2077";
-    std::error_code ec;
-    if (exists(subdir, ec) && !ec && is_directory(subdir, ec) && !ec) {
-      return subdir;
-    }
+std::string progress_t::comment() const
+{
+  char buf[comment_capacity];
+  for (;;)
+  {
+    const uint32_t seq = m_comment_seq.load(std::memory_order_acquire);
+    for (size_t i = 0; i < comment_capacity; ++i)
+      buf[i] = m_comment[i].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!(seq & 1) && seq == m_comment_seq.load(std::memory_order_relaxed))
+      break;
+    std::this_thread::yield();
   }
-  return {};
+  buf[comment_capacity - 1] = 0;
+  return buf;
 }
-
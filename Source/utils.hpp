@@ -1,13 +1,18 @@
 #pragma once
+#include <atomic>
 #include <filesystem>
+#include <functional>
 #include <optional>
 #include <stdint.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
-#if __has_include(<span>) && (!defined(_HAS_CXX20) or _HAS_CXX20)
+// <span> exists in C++17 mode too on some standard libraries, without std::span
+#if __has_include(<span>) && (defined(_HAS_CXX20) ? _HAS_CXX20 : __cplusplus > 201703L)
 #include <span>
 #else
 #include "span.hpp"
@@ -15,10 +20,27 @@ namespace std { using tcb::span; }
 #endif
 
 // really bad place
+// progress of a background job, written by the job while the ui thread
+// reads it. Nothing is locked: the comment is a small seqlock-protected
+// buffer (writers wait for each other, readers retry), a reader sees
+// either the old or the new comment, never a mix.
+// cancel() is cooperative, the load and save stages check is_cancelled().
 struct progress_t
 {
-	float value = 0.f;
-	std::string comment;
+	std::atomic<float> value = 0.f;
+
+	void set_comment(std::string_view comment);
+	std::string comment() const;
+
+	void cancel() { m_cancelled.store(true, std::memory_order_relaxed); }
+	bool is_cancelled() const { return m_cancelled.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr size_t comment_capacity = 256; // longer comments are truncated
+
+	std::atomic<uint32_t> m_comment_seq = 0; // odd while a comment is written
+	std::atomic<char> m_comment[comment_capacity] = {};
+	std::atomic<bool> m_cancelled = false;
 };
 
 
@@ -114,6 +136,65 @@ constexpr uint32_t FNV1a32(std::string_view str)
 }
 
 
+// xxhash64, for content hashes of large buffers
+inline uint64_t hash64(const void* data, size_t len, uint64_t seed = 0)
+{
+	constexpr uint64_t p1 = 0x9E3779B185EBCA87;
+	constexpr uint64_t p2 = 0xC2B2AE3D27D4EB4F;
+	constexpr uint64_t p3 = 0x165667B19E3779F9;
+	constexpr uint64_t p4 = 0x85EBCA77C2B2AE63;
+	constexpr uint64_t p5 = 0x27D4EB2F165667C5;
+
+	auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+	auto read64 = [](const uint8_t* p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+	auto round = [&](uint64_t acc, uint64_t in) { return rotl(acc + in * p2, 31) * p1; };
+	auto merge = [&](uint64_t acc, uint64_t v) { return (acc ^ round(0, v)) * p1 + p4; };
+
+	auto p = static_cast<const uint8_t*>(data);
+	const uint8_t* const end = p + len;
+	uint64_t h;
+
+	if (len >= 32)
+	{
+		uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+		for (; p + 32 <= end; p += 32)
+		{
+			v1 = round(v1, read64(p));
+			v2 = round(v2, read64(p + 8));
+			v3 = round(v3, read64(p + 16));
+			v4 = round(v4, read64(p + 24));
+		}
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = merge(h, v1);
+		h = merge(h, v2);
+		h = merge(h, v3);
+		h = merge(h, v4);
+	}
+	else
+		h = seed + p5;
+
+	h += len;
+
+	for (; p + 8 <= end; p += 8)
+		h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+	if (p + 4 <= end)
+	{
+		uint32_t v; std::memcpy(&v, p, 4);
+		h = rotl(h ^ (v * p1), 23) * p2 + p3;
+		p += 4;
+	}
+	for (; p < end; ++p)
+		h = rotl(h ^ (*p * p5), 11) * p1;
+
+	h ^= h >> 33;
+	h *= p2;
+	h ^= h >> 29;
+	h *= p3;
+	h ^= h >> 32;
+	return h;
+}
+
+
 class span_istreambuf
 	: public std::streambuf
 {
@@ -122,7 +203,7 @@ class span_istreambuf
 public:
 	span_istreambuf() = default;
 	span_istreambuf(const std::span<char>& span)
-		: span_istreambuf(span.begin(), span.end()) {}
+		: span_istreambuf(span.data(), span.data() + span.size()) {}
 
 	span_istreambuf(const char* begin, const char* end)
 	{
@@ -309,8 +390,13 @@ std::string u64_to_cpp(uint64_t val);
 
 std::string bytes_to_hex(const void* buf, size_t len);
 
-std::vector<uintptr_t> sse2_strstr_masked(const unsigned char* s, size_t m, const unsigned char* needle, size_t n, const char* mask, size_t maxcnt = 0);
-std::vector<uintptr_t> sse2_strstr(const unsigned char* s, size_t m, const unsigned char* needle, size_t n, size_t maxcnt = 0);
-
 std::optional<std::filesystem::path> find_user_saved_games();
 
+// errors of the core (resource files, structures that can't be loaded..),
+// the app shows them in message boxes, by default they are printed on stderr
+using error_report_fn_t = std::function<void(const std::string& title, const std::string& msg)>;
+
+void set_error_report_fn(error_report_fn_t fn);
+
+void report_error(const std::string& title, const std::string& msg);
+
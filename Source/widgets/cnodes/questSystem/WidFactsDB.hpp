@@ -1,6 +1,6 @@
 #pragma once
 #include <inttypes.h>
-#include <AppLib/IApp.hpp>
+#include <AppLib/imgui_helpers.hpp>
 #include <imgui_extras/imgui_better_combo.hpp>
 #include <csav/cnodes/questSystem/FactsDB.hpp>
 #include <widgets/cpinternals.hpp>
@@ -33,6 +33,7 @@ struct WidFactsTable
     if (ImGui::Button("Prepend new fact"))
     {
       facts.emplace(facts.begin());
+      modified = true;
     }
     ImGui::SameLine();
     if (ImGui::Button("Sort facts lexicographically ascending"))
@@ -40,6 +41,7 @@ struct WidFactsTable
       std::sort(facts.begin(), facts.end(), [](const CP::CFact& a, const CP::CFact& b) -> bool {
         return a.name().str() < b.name().str();
       });
+      modified = true;
     }
 
 
@@ -69,6 +71,7 @@ struct WidFactsTable
       if (ImGui::Button("append new fact"))
       {
         facts.emplace_back();
+        modified = true;
       }
 
       if (torem_idx != -1)
@@ -1,9 +1,11 @@
 #pragma once
 #include <inttypes.h>
-#include <AppLib/IApp.hpp>
+#include <AppLib/imgui_helpers.hpp>
 #include <imgui_extras/imgui_better_combo.hpp>
+#include <imgui_extras/imgui_stdlib.h>
 #include <cpinternals/cpnames.hpp>
 #include <cpinternals/CFact.hpp>
+#include <cpinternals/name_filter.hpp>
 
 namespace UI {
 
@@ -58,13 +60,98 @@ struct WidCFact
 } // namespace UI
 
 
-struct TweakDBID_widget
+// Combo over a resolver's name list with a filter field, typing filters the
+// list in background (see name_filter) and enter picks the best match.
+struct name_picker_widget
 {
-  struct ItemGetterData
+  // TweakDBIDs are displayed without their category prefix
+  static inline const char* short_tdbid_name(const std::string& s)
+  {
+    auto cs = s.c_str();
+    if (s.rfind("Items.", 0) == 0)
+      return cs + 6;
+    if (s.rfind("AttachmentSlots.", 0) == 0)
+      return cs + 16;
+    if (s.rfind("Vehicle.", 0) == 0)
+      return cs + 8;
+    return cs;
+  }
+
+  // returns true if a name has been picked.
+  // get_names returns the names or a snapshot of them (see name_filter::sync),
+  // it is only called while the combo is opened
+  template <typename GetNamesFn>
+  [[nodiscard]] static inline bool draw(const char* label, const char* preview, name_filter& filter,
+    GetNamesFn&& get_names, std::string& picked, bool tdbid_names = false)
   {
-    std::string cur_name;
-    const std::vector<std::string>& namelist;
-  };
+    if (!ImGui::BeginCombo(label, preview, ImGuiComboFlags_HeightLarge))
+      return false;
+
+    filter.sync(get_names());
+
+    // shared, only one combo can be opened at a time
+    static std::string s_query;
+    if (ImGui::IsWindowAppearing())
+    {
+      s_query.clear();
+      ImGui::SetKeyboardFocusHere();
+    }
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    const bool enter = ImGui::InputTextWithHint("##filter", "filter (typos are tolerated)", &s_query, ImGuiInputTextFlags_EnterReturnsTrue);
+    filter.submit(s_query);
+
+    // the last results are shown until the ones of the current query are published
+    const bool filtered = !s_query.empty();
+    auto res = filtered ? filter.results() : nullptr;
+    const auto& list = res ? *res->names : *filter.names();
+    const size_t cnt = filtered ? (res ? res->matches.size() : 0) : list.size();
+
+    if (filtered)
+    {
+      const bool done = res && res->complete && res->query == name_filter_index::lower(s_query);
+      ImGui::TextDisabled("%zu matches%s%s", cnt, done ? "" : ", filtering..", filter.is_indexed() ? "" : " (indexing)");
+    }
+    else
+      ImGui::TextDisabled("%zu names", cnt);
+
+    bool picked_one = false;
+    ImGui::BeginChild("##names", ImVec2(0, ImGui::GetTextLineHeightWithSpacing() * 16));
+    ImGuiListClipper clipper;
+    clipper.Begin((int)cnt);
+    while (clipper.Step())
+    {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+        const auto& name = list[filtered ? res->matches[i] : (size_t)i];
+        ImGui::PushID(i);
+        if (ImGui::Selectable(tdbid_names ? short_tdbid_name(name) : name.c_str()))
+        {
+          picked = name;
+          picked_one = true;
+        }
+        ImGui::PopID();
+      }
+    }
+    ImGui::EndChild();
+
+    if (enter && cnt)
+    {
+      picked = list[filtered ? res->matches[0] : 0];
+      picked_one = true;
+    }
+
+    if (picked_one)
+      ImGui::CloseCurrentPopup();
+    ImGui::EndCombo();
+    return picked_one;
+  }
+};
+
+
+struct TweakDBID_widget
+{
+  // one per category
+  static inline name_filter s_filters[(size_t)TweakDBIDCategory::Unknown + 1];
 
   // returns true if content has been edited
   [[nodiscard]] static inline bool draw(TweakDBID& x, const char* label, TweakDBIDCategory cat = TweakDBIDCategory::All, bool advanced_edit=true)
@@ -72,17 +159,14 @@ struct TweakDBID_widget
     scoped_imgui_id _sii(&x);
     bool modified = false;
 
-    auto& namelist = TweakDBIDResolver::get().sorted_names(cat);
-
-    // tricky ;)
-    int item_current = 0;
-
-    ItemGetterData data {x.name(), namelist};
-    ImGui::BetterCombo(label, &item_current, &ItemGetter, (void*)&data, (int)namelist.size()+1);
+    auto get_names = [cat]() -> const std::vector<std::string>& {
+      return TweakDBIDResolver::get().sorted_names(cat);
+    };
 
-    if (item_current != 0)
+    std::string picked;
+    if (name_picker_widget::draw(label, x.name().c_str(), s_filters[(size_t)cat], get_names, picked, true))
     {
-      x = TweakDBID(namelist[item_current-1]);
+      x = TweakDBID(picked);
       modified = true;
     }
 
@@ -108,50 +192,25 @@ struct TweakDBID_widget
 
     return modified;
   }
-
-  static inline bool ItemGetter(void* data, int n, const char** out_str)
-  { 
-    auto& dataref = *(ItemGetterData*)data;
-    if (n == 0)
-      *out_str = dataref.cur_name.c_str();
-    else
-    {
-      auto& s = dataref.namelist[n-1];
-      auto cs = s.c_str();
-
-      if (s.rfind("Items.", 0) == 0)
-        *out_str = cs + 6;
-      else if (s.rfind("AttachmentSlots.", 0) == 0)
-        *out_str = cs + 16;
-      else if (s.rfind("Vehicle.", 0) == 0)
-        *out_str = cs + 8;
-      else
-        *out_str = cs;
-    }
-    return true;
-  }
 };
 
 
 struct CName_widget
 {
+  static inline name_filter s_filter;
+
   // returns true if content has been edited
   [[nodiscard]] static inline bool draw(CName& x, const char* label)
   {
     scoped_imgui_id _sii(&x);
     bool modified = false;
 
-    auto& namelist = CNameResolver::get().sorted_names();
-
-    // tricky ;)
-    int item_current = 0;
+    auto get_names = []() { return CNameResolver::get().sorted_names(); };
 
-    const auto& curname = x.name();
-    ImGui::BetterCombo(label, &item_current, &ItemGetter, (void*)curname.c_str(), (int)namelist.size()+1);
-
-    if (item_current != 0)
+    std::string picked;
+    if (name_picker_widget::draw(label, x.name().c_str(), s_filter, get_names, picked))
     {
-      x = CName(namelist[item_current-1]);
+      x = CName(picked);
       modified = true;
     }
 
@@ -172,15 +231,5 @@ struct CName_widget
 
     return modified;
   }
-
-  static inline bool ItemGetter(void* data, int n, const char** out_str)
-  { 
-    auto& namelist = CNameResolver::get().sorted_names();
-    if (n == 0)
-      *out_str = (const char*)data;
-    else
-      *out_str = namelist[n-1].c_str();
-    return true;
-  }
 };
 
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <list>
+
+#include "AppLib/IApp.hpp"
+#include "csav_widget.hpp"
+
+class csav_list_widget
+{
+protected:
+  ImGui::FileBrowser open_dialog;
+
+  // savefiles being opened, in parallel on the job_scheduler
+  // failed ones are kept until their error is acknowledged
+  struct open_request
+  {
+    std::filesystem::path path;
+    std::shared_ptr<csav> save;
+    std::shared_ptr<AppImage> img;
+    loading_bar_job_widget job;
+  };
+
+  std::list<open_request> m_open_requests;
+
+  std::list<csav_collapsable_header> m_list;
+
+public:
+  csav_list_widget()
+  {
+    open_dialog.SetTitle("Opening savefile");
+    open_dialog.SetTypeFilters({ ".dat" });
+
+    try
+    {
+      auto& jroot = ps_json_storage::get().jroot();
+      if (jroot.find("open_path") != jroot.end())
+        open_dialog.SetPwd(jroot.at("open_path").get<std::string>());
+    }
+    catch (std::exception&) {}
+  }
+  
+  void update()
+  {
+    for (auto it = m_open_requests.begin(); it != m_open_requests.end();)
+    {
+      if (it->job.is_running() || it->job.failed())
+      {
+        ++it;
+        continue;
+      }
+
+      if (!it->job.cancelled())
+        m_list.emplace_back(it->save, it->img);
+      it = m_open_requests.erase(it);
+    }
+
+    m_list.erase(
+      std::remove_if(m_list.begin(), m_list.end(), [](auto& a){ return a.is_closed(); }),
+      m_list.end()
+    );
+
+    for (auto& cs : m_list)
+      cs.update();
+  }
+
+  void draw_list()
+  {
+    // todo: remove that when error popup is app-wide
+    node_editor_widget::draw_popups();
+
+    // Expose a couple of the available flags. In most cases you may just call BeginTabBar() with no flags (0).
+    static ImGuiTabBarFlags tab_bar_flags =
+      ImGuiTabBarFlags_Reorderable |
+      ImGuiTabBarFlags_AutoSelectNewTabs |
+      ImGuiTabBarFlags_FittingPolicyResizeDown;
+
+    // Passing a bool* to BeginTabItem() is similar to passing one to Begin():
+    // the underlying bool will be set to false when the tab is closed.
+    if (ImGui::BeginTabBar("MyTabBar", tab_bar_flags))
+    {
+      if (ImGui::TabItemButton("  +  ", ImGuiTabItemFlags_Leading | ImGuiTabItemFlags_NoTooltip))
+        open_dialog.Open();
+
+      size_t i = 0;
+      for (auto it = m_list.begin(); it != m_list.end(); ++it)
+      {
+        scoped_imgui_id _sii(&*it);
+        bool opened = true;
+        if (ImGui::BeginTabItem(it->pretty_name().c_str(), &opened, ImGuiTabItemFlags_None))
+        {
+          it->draw();
+          ImGui::EndTabItem();
+        }
+        if (!opened)
+          it->close();
+      }
+      ImGui::EndTabBar();
+    }
+  }
+
+  void open_file(IApp* owning_app, std::wstring fpath)
+  {
+    auto& req = m_open_requests.emplace_back();
+    req.path = std::filesystem::absolute(fpath);
+
+    try
+    {
+      std::filesystem::path dirpath = req.path;
+      auto& jroot = ps_json_storage::get().jroot();
+      jroot["open_path"] = dirpath.remove_filename().string();
+    }
+    catch (std::exception&) {}
+
+    auto screenshot_path = req.path;
+    screenshot_path.replace_filename(L"screenshot.png");
+    if (std::filesystem::exists(screenshot_path))
+      req.img = owning_app->load_texture_from_file(screenshot_path.string());
+
+    req.save = std::make_shared<csav>();
+    req.job.start([cs = req.save, path = req.path, dump = s_dump_decompressed_data](progress_t& progress) -> bool {
+      // the structures are subtasks of this job, files opened at once share the pool
+      return cs->open_with_progress(path, progress, dump);
+    });
+  }
+
+  void draw_menu_item(IApp* owning_app)
+  {
+    if (ImGui::MenuItem("Open savefile"))
+      open_dialog.Open();
+
+    open_dialog.Display();
+
+    if (open_dialog.HasSelected())
+    {
+      open_file(owning_app, open_dialog.GetSelected().wstring());
+      open_dialog.ClearSelected();
+    }
+
+    // be sure that this modal is opened
+    if (m_open_requests.size())
+      ImGui::OpenPopup("Loading..##LOAD");
+
+    if (ImGui::BeginMenu("Options"))
+    {
+      ImGui::Checkbox("use ps4wizard format", &s_use_ps4_weird_format);
+      ImGui::Checkbox("dump decompressed data", &s_dump_decompressed_data);
+      ImGui::Checkbox("show CObject field types", &CObject::show_field_types);
+      ImGui::Checkbox("show CProperty skipped flag", &CProperty::imgui_show_skipped);
+      ImGui::EndMenu();
+    }
+
+    if (0 && ImGui::Button("open error"))
+      ImGui::OpenPopup("Loading..##LOAD");
+
+    // Always center this window when appearing
+    ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
+    ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
+
+    bool any_running = false, any_failed = false;
+    for (auto& req : m_open_requests)
+    {
+      any_running |= req.job.is_running();
+      any_failed |= req.job.failed();
+    }
+
+    bool pushed_stylecol = false;
+    if (any_failed) {
+      ImGui::PushStyleColor(ImGuiCol_ModalWindowDimBg, (ImVec4)ImColor::HSV(0.f, 1.f, 0.6f, 0.35f));
+      pushed_stylecol = true;
+    }
+
+    if (ImGui::BeginPopupModal("Loading..##LOAD", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove))
+    {
+      for (auto& req : m_open_requests)
+      {
+        scoped_imgui_id _sii(&req);
+        ImGui::Text("path: %s", req.path.string().c_str());
+
+        if (req.job.is_running())
+          req.job.draw();
+        else if (req.job.failed())
+          ImGui::Text("error, couldn't load savefile");
+
+        ImGui::Separator();
+      }
+
+      if (m_open_requests.empty())
+      {
+        ImGui::CloseCurrentPopup();
+      }
+      else if (any_running)
+      {
+        if (m_open_requests.size() > 1 && ImGui::Button("cancel all", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+        {
+          for (auto& req : m_open_requests)
+            req.job.cancel();
+        }
+      }
+      else if (ImGui::Button("OK", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+      {
+        m_open_requests.remove_if([](auto& req) { return req.job.failed(); });
+        ImGui::CloseCurrentPopup();
+      }
+
+      ImGui::EndPopup();
+    }
+
+    if (pushed_stylecol)
+      ImGui::PopStyleColor();
+  }
+};
+
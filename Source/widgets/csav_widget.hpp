@@ -1,6 +1,9 @@
 #pragma once
 
 #include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <utility>
 #include <iostream>
@@ -11,11 +14,20 @@
 #include <vector>
 #include <memory>
 
-#include "AppLib/IApp.hpp"
+#include "AppLib/imgui_helpers.hpp"
+#include <imgui_extras/imgui_filebrowser.hpp>
 
 #include "utils.hpp"
+#include "job_scheduler.hpp"
+#include <fmt/chrono.h>
 #include <ps_json_storage.hpp>
 #include "csav/csav.hpp"
+#include <csav/node_diff.hpp>
+#include <csav/node_history.hpp>
+#include <csav/save_merge.hpp>
+#include <csav/search/flat_search.hpp>
+#include <csav/search/known_hash_scan.hpp>
+#include <csav/search/value_scan.hpp>
 #include "cpinternals/cpnames.hpp"
 #include "hexeditor_windows_mgr.hpp"
 #include "node_editors.hpp"
@@ -26,52 +38,67 @@
 
 void ImGui::ShowDemoWindow(bool* p_open);
 
-using loading_bar_job_fntype = bool (*)(float& progress);
-
+// ui of a job run by the job_scheduler: progress bar, comment, cancel button
+// the state of the last job stays available until the next one is started
 class loading_bar_job_widget
 {
-  std::thread thread;
-  bool finished = false;
-  progress_t progress = {};
+  job_scheduler::job_ptr m_job;
 
 public:
-  bool failed = false;
-
-  bool is_running() const { return thread.joinable(); }
+  bool is_running() const { return m_job && !m_job->is_done(); }
+  bool failed() const { return m_job && m_job->state() == job_state::failed; }
+  bool cancelled() const { return m_job && m_job->state() == job_state::cancelled; }
 
   template <class Fn, std::enable_if_t<std::is_same_v<std::invoke_result_t<Fn, progress_t&>, bool>, int> = 0> 
   bool start(Fn&& fn)
   {
     if (is_running())
       return false;
-    failed = false;
-    progress = {};
-    thread = std::thread([this, fn]() {
-      failed = !fn(progress);
-      finished = true;
-    });
+    m_job = job_scheduler::get().submit(std::forward<Fn>(fn));
     return true;
   }
 
-  void update()
+  void cancel()
   {
-    if (finished) {
-      finished = false;
-      thread.join();
-    }
+    if (m_job)
+      m_job->cancel();
   }
 
-  void draw()
+  // runs the job inline if no worker picked it yet
+  void wait()
   {
-    if (is_running()) {
+    if (m_job)
+      job_scheduler::get().wait(m_job);
+  }
+
+  void draw(bool cancellable = true)
+  {
+    if (!is_running())
+      return;
+
+    auto& progress = m_job->progress();
+    const float width = ImGui::GetContentRegionAvailWidth();
+
+    if (m_job->state() == job_state::queued)
+    {
+      ImGui::ProgressBar(0.f, ImVec2(width, 0.f), "queued");
+      ImGui::TextUnformatted("waiting for a worker...");
+    }
+    else
+    {
+      const float value = progress.value.load(std::memory_order_relaxed);
       std::stringstream ss;
-      ss << std::fixed << std::setprecision(1) << (progress.value * 100) << "%";
-      ImGui::ProgressBar(progress.value, ImVec2(ImGui::GetContentRegionAvailWidth(), 0.f), ss.str().c_str());
-      if (progress.comment.size())
-        ImGui::Text(progress.comment.c_str());
-      else
-        ImGui::Text("processing...");
+      ss << std::fixed << std::setprecision(1) << (value * 100) << "%";
+      ImGui::ProgressBar(value, ImVec2(width, 0.f), ss.str().c_str());
+
+      const auto comment = progress.comment();
+      ImGui::TextUnformatted(comment.size() ? comment.c_str() : "processing...");
     }
+
+    if (progress.is_cancelled())
+      ImGui::TextUnformatted("cancelling...");
+    else if (cancellable && ImGui::Button("cancel"))
+      m_job->cancel();
   }
 };
 
@@ -95,10 +122,99 @@ protected:
   bool m_closed = false; // can be destroyed
   bool m_closing = false; // close button clicked
 
+  bool m_reserialization_checked = false;
+  std::vector<std::string> m_reserialization_errors;
+
+  // known identifiers, scanned in background after opening
+  // shared_ptr: headers are copied around by csav_list_widget
+  std::shared_ptr<hash_annotation_job> m_hash_scan_job = std::make_shared<hash_annotation_job>();
+  std::shared_ptr<const hash_annotation_index> m_hash_index;
+  bool m_hash_scan_started = false;
+  double m_hash_scan_ms = 0;
+
   //std::vector<ScanEntryWidget> scan_entries;
   //using scan_entry_it = decltype(scan_entries)::iterator;
-  std::array<char, 24 * 3 + 1> search_needle = {};
-  std::array<char, 24     + 1> search_mask = {};
+  std::string search_pattern_src;
+  std::string search_pattern_error;
+
+  // multi needle search, one needle per line
+  std::string search_list_src;
+  int search_list_kind = 0; // see search_list_kinds
+  bool search_list_utf8 = true;
+  bool search_list_utf16 = true;
+  bool search_list_item_names = false;
+  size_t search_list_max_per_needle = 0;
+
+  // typed value scan, shared by the opened saves so that the candidates of
+  // a save can be narrowed with the next one
+  static inline value_scan s_value_scan;
+  static inline int s_value_scan_type = (int)scan_value_type::u32;
+  static inline int s_value_scan_pred = (int)scan_predicate::equal;
+  static inline double s_value_scan_v1 = 0, s_value_scan_v2 = 0;
+  static inline std::string s_value_scan_last_save;
+  static inline double s_value_scan_ms = 0;
+  // one scan at a time, polled by the header of its save (any header once
+  // that one is closed)
+  static inline value_scan_job s_value_scan_job;
+  static inline std::weak_ptr<const csav> s_value_scan_owner;
+  static inline std::string s_value_scan_owner_name;
+  std::string value_scan_error;
+
+  // diff with another opened save, the base is shared by the headers
+  static inline std::weak_ptr<const node_t> s_diff_base;
+  static inline std::string s_diff_base_name;
+  // shared_ptr: headers are copied around by csav_list_widget
+  std::shared_ptr<node_diff> m_diff;
+  std::string m_diff_base_name;
+  size_t m_diff_selected = (size_t)-1;
+
+  // three-way merge of the changes made to "ours" since "base" into this save
+  static inline std::weak_ptr<csav> s_merge_base, s_merge_ours;
+  static inline std::string s_merge_base_name, s_merge_ours_name;
+  static inline int s_merge_policy = (int)save_merge_policy::theirs;
+  // shared_ptr: headers are copied around by csav_list_widget
+  std::shared_ptr<save_merge> m_merge;
+  std::string m_merge_error;
+  bool m_merge_applied = false;
+
+  // undo/redo of the node tree, edits are captured once they reach it
+  // (node editors' commits, saves, merges)
+  // shared_ptr: headers are copied around by csav_list_widget
+  std::shared_ptr<node_history> m_history;
+
+  // flags the changes of the tree so that each of them is captured once,
+  // the save job posts its events from its thread
+  struct tree_change_listener : node_listener_t
+  {
+    std::atomic<bool> changed = false;
+    std::weak_ptr<const node_t> root;
+
+    ~tree_change_listener() override
+    {
+      if (auto r = root.lock())
+        r->remove_listener(this);
+    }
+
+    void on_node_event(const std::shared_ptr<const node_t>& node, node_event_e evt) override
+    {
+      changed = true;
+    }
+  };
+  std::shared_ptr<tree_change_listener> m_tree_listener;
+  // label of the next capture, set by the actions that edit the tree
+  std::string m_next_history_label;
+
+  // the structures are reloaded from the tree after a jump, their unsaved
+  // edits are either saved first or discarded (confirmation popup)
+  loading_bar_job_widget m_reload_job;
+  std::shared_ptr<const node_snapshot> m_jump_target;
+  bool m_open_jump_confirm = false;
+  bool m_jump_after_save = false;
+
+  // flat view of the tree for the hash scan, searches and value scans,
+  // built by their jobs from the current history entry
+  // shared_ptr: headers are copied around by csav_list_widget
+  std::shared_ptr<flat_view_cache> m_flat_views = std::make_shared<flat_view_cache>();
 
 public:
   csav_collapsable_header(const std::shared_ptr<csav>& csav, const std::shared_ptr<AppImage>& img, std::string_view name = "")
@@ -133,9 +249,11 @@ public:
 
   ~csav_collapsable_header()
   {
-    // fail-safe, not the best
-    while (save_job.is_running())
-      Sleep(1);
+    // closing waits for the save (see m_closing), this is a fail-safe.
+    // the reloaded structures are about to be dropped
+    m_reload_job.cancel();
+    m_reload_job.wait();
+    save_job.wait();
   }
 
   //template <typename EditorType>
@@ -154,6 +272,7 @@ public:
 protected:
   void do_save()
   {
+    m_next_history_label = "save";
     std::weak_ptr<csav> weak_csav = m_csav;
     save_job.start([weak_csav](progress_t& progress) -> bool {
       auto csav = weak_csav.lock();
@@ -175,7 +294,160 @@ public:
 
   void update()
   {
-    save_job.update();
+    if (m_csav && !m_reserialization_checked && !m_csav->reserialization_check.is_running())
+    {
+      m_reserialization_checked = true;
+      m_csav->reserialization_check.wait();
+      for (auto& res : m_csav->reserialization_check.results())
+      {
+        if (!res.ok)
+          m_reserialization_errors.push_back(fmt::format("\"{}\" node: {}", res.node_name, res.error));
+      }
+    }
+
+    if (m_csav && !m_hash_scan_started)
+      start_hash_scan();
+
+    update_history();
+    update_pending_jump();
+    update_value_scan();
+
+    if (m_hash_scan_job->poll(m_hash_index, m_hash_scan_ms) && m_hash_index)
+      hash_annotation_registry::get().publish(m_hash_index);
+  }
+
+  void update_history()
+  {
+    // the save job edits the tree from its thread
+    if (!m_csav || !m_csav->root_node || save_job.is_running())
+      return;
+
+    if (!m_history)
+    {
+      m_history = std::make_shared<node_history>();
+      m_history->reset(m_csav->root_node);
+      m_tree_listener = std::make_shared<tree_change_listener>();
+      m_tree_listener->root = m_csav->root_node;
+      m_csav->root_node->add_listener(m_tree_listener.get());
+      return;
+    }
+
+    // one entry per action that reached the tree
+    if (m_tree_listener->changed.exchange(false))
+    {
+      std::string label = m_next_history_label.size() ? m_next_history_label : history_edit_label();
+      m_history->capture(std::move(label));
+    }
+    m_next_history_label.clear();
+  }
+
+  // names the root children whose content differs from the current entry
+  std::string history_edit_label() const
+  {
+    const auto& snap = *m_history->entries()[m_history->current()].root;
+    const auto& children = m_csav->root_node->children();
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+      if (i >= snap.children.size() || snap.children[i]->hash != children[i]->content_hash())
+        names.push_back(children[i]->name());
+    }
+
+    std::string label = "edit";
+    const size_t max_names = 3;
+    for (size_t i = 0; i < names.size() && i < max_names; ++i)
+      label += (i ? ", " : " ") + names[i];
+    if (names.size() > max_names)
+      label += fmt::format(" (+{})", names.size() - max_names);
+    return label;
+  }
+
+  // jumps edit the tree in place, background readers must be done
+  bool can_jump_in_history() const
+  {
+    return m_history && !save_job.is_running() && !m_reload_job.is_running()
+      && !is_checking_reserialization() && !m_hash_scan_job->is_running();
+  }
+
+  // the target is kept as a snapshot, captures may shift the entries
+  // before the jump is confirmed
+  void request_history_jump(size_t entry_idx)
+  {
+    update_history();
+    if (!can_jump_in_history() || m_jump_target || entry_idx >= m_history->entries().size()
+      || entry_idx == m_history->current())
+      return;
+
+    m_jump_target = m_history->entries()[entry_idx].root;
+    if (m_csav->dirty_structures().size())
+      m_open_jump_confirm = true;
+    else
+      history_jump();
+  }
+
+  void history_jump()
+  {
+    auto target = std::move(m_jump_target);
+    m_jump_target.reset();
+    m_jump_after_save = false;
+    if (!target || !can_jump_in_history())
+      return;
+
+    auto& entries = m_history->entries();
+    auto it = std::find_if(entries.begin(), entries.end(),
+      [&target](const node_history::entry_t& e) { return e.root == target; });
+    if (it == entries.end() || !m_history->jump((size_t)(it - entries.begin())))
+      return;
+
+    std::weak_ptr<csav> weak_csav = m_csav;
+    m_reload_job.start([weak_csav](progress_t& progress) -> bool {
+      auto csav = weak_csav.lock();
+      if (!csav)
+        return false;
+      csav->reload_structures(progress);
+      return true;
+    });
+  }
+
+  // a jump confirmed with "save" waits for the save job, and is dropped if
+  // the save didn't go through
+  void update_pending_jump()
+  {
+    if (!m_jump_after_save || save_job.is_running())
+      return;
+
+    if (save_job.failed() || save_job.cancelled() || m_csav->dirty_structures().size())
+    {
+      m_jump_target.reset();
+      m_jump_after_save = false;
+      return;
+    }
+    history_jump();
+  }
+
+  // source of the flat view of the current tree, null while the save job
+  // edits the tree
+  flat_view_source current_flat_view()
+  {
+    update_history();
+    if (!m_history || save_job.is_running())
+      return nullptr;
+    auto& entry = m_history->entries()[m_history->current()];
+    return m_flat_views->source(entry.root, m_csav->root_node);
+  }
+
+  void start_hash_scan()
+  {
+    if (m_hash_scan_job->is_running() || !m_csav->root_node)
+      return;
+    m_hash_scan_started = true;
+    m_hash_scan_job->start(current_flat_view());
+  }
+
+  bool is_checking_reserialization() const
+  {
+    return m_csav && m_csav->reserialization_check.is_running();
   }
 
   const std::string& pretty_name() 
@@ -191,8 +463,9 @@ public:
     scoped_imgui_id sii {this};
     ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
 
-    std::string label = fmt::format("{} (csav {})",
-      m_csav->filepath.u8string(), m_csav->ver.string());
+    std::string label = fmt::format("{} (csav {}){}",
+      m_csav->filepath.u8string(), m_csav->ver.string(),
+      is_checking_reserialization() ? " - checking reserialization.." : "");
 
     ImGuiStyle& style = ImGui::GetStyle();
     ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, style.ItemSpacing.y));
@@ -228,7 +501,7 @@ public:
       scoped_imgui_button_hue _sibh(0.2f);
       ImGui::SameLine();
       bool save_clicked = ImGui::ButtonEx("SAVE##SAVE", ImVec2(120, 60));
-      if (!save_job.is_running() && !m_closed && save_clicked)
+      if (!save_job.is_running() && !m_reload_job.is_running() && !m_closed && save_clicked)
       {
         bool has_unsaved_changes = false;
         for (auto& ce : m_collapsible_editors)
@@ -299,6 +572,46 @@ public:
       ImGui::EndPopup();
     }
 
+    if (m_open_jump_confirm)
+    {
+      m_open_jump_confirm = false;
+      ImGui::OpenPopup("Unsaved structures##HISTORY");
+    }
+
+    // Always center this window when appearing
+    ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
+    if (ImGui::BeginPopupModal("Unsaved structures##HISTORY", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove))
+    {
+      ImGui::Text("The history jump reloads the structures from the node tree.");
+      ImGui::Text("These ones have unsaved changes:");
+      for (auto& name : m_csav->dirty_structures())
+        ImGui::BulletText("%s", name.c_str());
+      ImGui::Text("Would you like to save them first ?");
+
+      float button_width = ImGui::GetContentRegionAvail().x * 0.25f;
+      ImGui::Separator();
+      if (ImGui::Button("SAVE", ImVec2(button_width, 0)))
+      {
+        m_jump_after_save = true;
+        should_do_save = true;
+        ImGui::CloseCurrentPopup();
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("DISCARD", ImVec2(button_width, 0)))
+      {
+        history_jump();
+        ImGui::CloseCurrentPopup();
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("CANCEL", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+      {
+        m_jump_target.reset();
+        ImGui::CloseCurrentPopup();
+      }
+
+      ImGui::EndPopup();
+    }
+
     if (should_do_save)
       do_save();
 
@@ -309,7 +622,7 @@ public:
     }
 
     bool pushed_stylecol = false;
-    if (save_job.failed) {
+    if (save_job.failed()) {
       ImGui::PushStyleColor(ImGuiCol_ModalWindowDimBg, (ImVec4)ImColor::HSV(0.f, 1.f, 0.6f, 0.35f));
       pushed_stylecol = true;
     }
@@ -326,8 +639,10 @@ public:
       }
       else 
       {
-        if (save_job.failed)
+        if (save_job.failed())
           ImGui::Text("error, couldn't save savefile");
+        else if (save_job.cancelled())
+          ImGui::Text("cancelled, the file wasn't written");
         else
           ImGui::Text("success!");
         ImGui::Separator();
@@ -357,8 +672,10 @@ public:
     //-------------------------------------------------------------------------------
 
     ImGui::SameLine();
-    if (ImGui::ButtonEx("PASTE SKIN##SAVE", ImVec2(100, 60)))
+    if (ImGui::ButtonEx("PASTE SKIN##SAVE", ImVec2(100, 60)) && !save_job.is_running() && !m_reload_job.is_running())
     {
+      // the node is edited in place, the check may still be reading it
+      m_csav->reserialization_check.wait();
       auto appearance_node = m_csav->search_node("CharacetrCustomization_Appearances");
       if (appearance_src && appearance_src != appearance_node)
       {
@@ -369,6 +686,7 @@ public:
         else
         {
           auto& src_buf = appearance_src->data();
+          m_next_history_label = "paste skin";
           appearance_node->nonconst().assign_data(src_buf.begin(), src_buf.end());
         }
       }
@@ -389,6 +707,29 @@ public:
       ImGui::EndPopup();
     }
 
+    if (m_reserialization_errors.size())
+      ImGui::OpenPopup("Reserialization test failed.##RESERIALIZATION");
+
+    // Always center this window when appearing
+    ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
+    if (ImGui::BeginPopupModal("Reserialization test failed.##RESERIALIZATION", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove))
+    {
+      for (auto& err : m_reserialization_errors)
+        ImGui::Text("%s", err.c_str());
+      ImGui::Separator();
+      ImGui::Text("If your save has been edited with an older version of CPSE,");
+      ImGui::Text("please make the game save it again.");
+      ImGui::Text("Otherwise, please open an issue.");
+      ImGui::Separator();
+      if (ImGui::Button("OK", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
+      {
+        m_reserialization_errors.clear();
+        ImGui::CloseCurrentPopup();
+      }
+
+      ImGui::EndPopup();
+    }
+
     //-------------------------------------------------------------------------------
 
     ImGui::SameLine();
@@ -403,7 +744,14 @@ public:
     //const ImGuiID id = ImGui::GetCurrentWindow()->GetID((void*)this);
     //ImGui::BeginChild(id);
     ImGui::BeginChild(ImGui::GetID("csav_frame"), ImVec2(0, 0), false);
-    draw_content();
+    if (m_reload_job.is_running())
+    {
+      // the structures drawn by the editors are being replaced
+      ImGui::Text("reloading the structures from the history entry..");
+      m_reload_job.draw(false);
+    }
+    else
+      draw_content();
     ImGui::EndChild();
     //ImGui::EndChild();
   }
@@ -413,6 +761,7 @@ public:
   int selected_item3 = -1;
   int selected_item4 = -1;
   int selected_item5 = -1;
+  CObjectListLabels labels1, labels2, labels3, labels4, labels5;
   bool advanced_tabs = false;
 
   bool modified = false; // unused atm, this pending save feature needs refactoring
@@ -476,7 +825,12 @@ public:
       if (ImGui::BeginTabItem("Facts", 0, ImGuiTabItemFlags_None))
       {
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings);
-        modified |= UI::WidFactsDB::draw(m_csav->factsdb, "Facts");
+        // csystem-based structures track their own edits, others are marked by their widget
+        if (UI::WidFactsDB::draw(m_csav->factsdb, "Facts"))
+        {
+          m_csav->factsdb.mark_dirty();
+          modified = true;
+        }
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -484,7 +838,11 @@ public:
       if (ImGui::BeginTabItem("Inventories", 0, ImGuiTabItemFlags_None))
       {
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-        modified |= CInventory_widget::draw(m_csav->inventory, &m_csav->stats);
+        if (CInventory_widget::draw(m_csav->inventory, &m_csav->stats))
+        {
+          m_csav->inventory.mark_dirty();
+          modified = true;
+        }
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -493,7 +851,11 @@ public:
       {
         //scoped_imgui_id _sii("Appearance Customization");
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-        modified |= CCharacterCustomization_widget::draw(m_csav->chtrcustom);
+        if (CCharacterCustomization_widget::draw(m_csav->chtrcustom))
+        {
+          m_csav->chtrcustom.mark_dirty();
+          modified = true;
+        }
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -501,7 +863,7 @@ public:
       if (ImGui::BeginTabItem("Scriptable Systems", 0, ImGuiTabItemFlags_None))
       {
         ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-        modified |= CSystem_widget::draw(m_csav->scriptables.system(), &selected_item1);
+        modified |= CSystem_widget::draw(m_csav->scriptables.system(), &selected_item1, labels1);
         ImGui::EndChild();
         ImGui::EndTabItem();
       }
@@ -514,7 +876,7 @@ public:
         if (ImGui::BeginTabItem("Stats Map", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CSystem_widget::draw(m_csav->stats.system(), &selected_item2);
+          modified |= CSystem_widget::draw(m_csav->stats.system(), &selected_item2, labels2);
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -522,7 +884,7 @@ public:
         if (ImGui::BeginTabItem("Stats Pool", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CSystem_widget::draw(m_csav->statspool.system(), &selected_item3);
+          modified |= CSystem_widget::draw(m_csav->statspool.system(), &selected_item3, labels3);
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -530,7 +892,7 @@ public:
         if (ImGui::BeginTabItem("Persistent Data", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CPSData_widget::draw(m_csav->psdata, &selected_item4);
+          modified |= CPSData_widget::draw(m_csav->psdata, &selected_item4, labels4);
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -538,7 +900,7 @@ public:
         if (ImGui::BeginTabItem("God Mode", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          modified |= CSystem_widget::draw(m_csav->godmode.system(), &selected_item5);
+          modified |= CSystem_widget::draw(m_csav->godmode.system(), &selected_item5, labels5);
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -554,7 +916,11 @@ public:
         if (ImGui::BeginTabItem("Node Tree", 0, ImGuiTabItemFlags_None))
         {
           ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
-          draw_node_tree();
+          // node editors edit nodes in place, the check may still be reading them
+          if (is_checking_reserialization())
+            ImGui::Text("checking reserialization..");
+          else
+            draw_node_tree();
           ImGui::EndChild();
           ImGui::EndTabItem();
         }
@@ -567,6 +933,36 @@ public:
           ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("Diff", 0, ImGuiTabItemFlags_None))
+        {
+          ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
+          if (is_checking_reserialization())
+            ImGui::Text("checking reserialization..");
+          else
+            draw_diff_tools();
+          ImGui::EndChild();
+          ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("Merge", 0, ImGuiTabItemFlags_None))
+        {
+          ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
+          if (is_checking_reserialization())
+            ImGui::Text("checking reserialization..");
+          else
+            draw_merge_tools();
+          ImGui::EndChild();
+          ImGui::EndTabItem();
+        }
+
+        if (ImGui::BeginTabItem("History", 0, ImGuiTabItemFlags_None))
+        {
+          ImGui::BeginChild("current editor", ImVec2(0, 0), false, ImGuiWindowFlags_NoSavedSettings | ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoScrollWithMouse);
+          draw_history();
+          ImGui::EndChild();
+          ImGui::EndTabItem();
+        }
+
       }
 
       ImGui::EndTabBar();
@@ -651,6 +1047,239 @@ public:
     ImGui::EndChild();
   }
 
+  void draw_diff_tools()
+  {
+    if (ImGui::Button("use as diff base"))
+    {
+      s_diff_base = m_csav->root_node;
+      s_diff_base_name = m_pretty_name;
+    }
+
+    auto base = s_diff_base.lock();
+    ImGui::SameLine();
+    if (!base)
+    {
+      ImGui::Text("set another opened save as diff base first");
+    }
+    else if (base == m_csav->root_node)
+    {
+      ImGui::Text("this save is the diff base");
+    }
+    else
+    {
+      if (ImGui::Button(fmt::format("diff with {}", s_diff_base_name).c_str()))
+      {
+        m_diff = std::make_shared<node_diff>();
+        m_diff_base_name = s_diff_base_name;
+        m_diff_selected = (size_t)-1;
+        if (!m_diff->run(base, m_csav->root_node))
+          m_diff.reset();
+      }
+    }
+
+    if (!m_diff)
+      return;
+
+    auto& stats = m_diff->stats();
+    auto& entries = m_diff->entries();
+    ImGui::Text("%zu differences with %s (%zu node pairs compared, %zu identical subtrees skipped, %.2fms)",
+      entries.size(), m_diff_base_name.c_str(), stats.compared_pairs, stats.pruned_subtrees, stats.ms);
+
+    static std::shared_ptr<node_hexeditor> nh;
+
+    static ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter
+      | ImGuiTableFlags_BordersV | ImGuiTableFlags_Resizable;
+    ImVec2 size = ImVec2(600, ImGui::GetTextLineHeightWithSpacing() * 28);
+    if (ImGui::BeginTable("##diff_table", 3, flags, size))
+    {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("kind", ImGuiTableColumnFlags_WidthFixed, 60.f);
+      ImGui::TableSetupColumn("node", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("changed bytes", ImGuiTableColumnFlags_WidthFixed, 200.f);
+      ImGui::TableHeadersRow();
+
+      ImGuiListClipper clipper;
+      clipper.Begin((int)entries.size());
+      while (clipper.Step())
+      {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+        {
+          auto& entry = entries[row];
+          scoped_imgui_id sii{row};
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+
+          if (ImGui::Selectable(node_diff_entry::kind_name(entry.kind), m_diff_selected == row, ImGuiSelectableFlags_SpanAllColumns))
+          {
+            m_diff_selected = row;
+            // the node of this save, or the removed one of the base
+            auto& n = entry.b ? entry.b : entry.a;
+            if (!nh || nh->node() != n)
+              nh = std::make_shared<node_hexeditor>(n);
+            if (entry.ranges.size())
+            {
+              auto& r = entry.ranges.front();
+              const size_t data_size = n->data().size();
+              const size_t offset = std::min(r.b_offset, data_size);
+              nh->select(offset, std::min(r.b_size, data_size - offset));
+            }
+          }
+
+          ImGui::TableNextColumn();
+          ImGui::Text("%s", entry.path.c_str());
+
+          ImGui::TableNextColumn();
+          if (entry.kind == node_diff_kind::changed)
+          {
+            size_t changed = 0;
+            for (auto& r : entry.ranges)
+              changed += r.b_size;
+            ImGui::Text("%zu ranges, %zu bytes%s", entry.ranges.size(), changed, entry.ranges_truncated ? "+" : "");
+          }
+        }
+      }
+      ImGui::EndTable();
+    }
+
+    if (nh)
+    {
+      ImGui::SameLine();
+      nh->draw_widget();
+    }
+  }
+
+  void draw_merge_tools()
+  {
+    if (ImGui::Button("use as merge base"))
+    {
+      s_merge_base = m_csav;
+      s_merge_base_name = m_pretty_name;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("use as edited save (ours)"))
+    {
+      s_merge_ours = m_csav;
+      s_merge_ours_name = m_pretty_name;
+    }
+
+    auto base = s_merge_base.lock();
+    auto ours = s_merge_ours.lock();
+    ImGui::Text("base: %s", base ? s_merge_base_name.c_str() : "none");
+    ImGui::Text("ours: %s", ours ? s_merge_ours_name.c_str() : "none");
+
+    ImGui::Text("on conflict keep:"); ImGui::SameLine();
+    ImGui::RadioButton("this save", &s_merge_policy, (int)save_merge_policy::theirs); ImGui::SameLine();
+    ImGui::RadioButton("ours", &s_merge_policy, (int)save_merge_policy::ours);
+
+    if (!base || !ours)
+    {
+      ImGui::Text("set the base and edited saves among the opened ones first");
+    }
+    else if (base == m_csav || ours == m_csav)
+    {
+      ImGui::Text("this save is one of the merge's inputs");
+    }
+    else if (ImGui::Button(fmt::format("merge changes of {} since {} into this save", s_merge_ours_name, s_merge_base_name).c_str()))
+    {
+      save_merge::options_t opts;
+      opts.policy = (save_merge_policy)s_merge_policy;
+      m_merge = std::make_shared<save_merge>(opts);
+      m_merge_error.clear();
+      m_merge_applied = false;
+      if (!m_merge->run({base->root_node, base->ver}, {ours->root_node, ours->ver}, {m_csav->root_node, m_csav->ver}, m_merge_error))
+        m_merge.reset();
+    }
+
+    if (m_merge_error.size())
+      ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "merge failed: %s", m_merge_error.c_str());
+
+    if (!m_merge)
+      return;
+
+    auto& stats = m_merge->stats();
+    auto& conflicts = m_merge->conflicts();
+    ImGui::Text("%zu conflicts (%zu nodes compared, %zu subtrees taken as is, %zu systems and %zu objects merged, %.2fms)",
+      conflicts.size(), stats.compared_nodes, stats.pruned_subtrees, stats.merged_systems, stats.compared_objects, stats.ms);
+
+    if (m_merge_applied)
+    {
+      ImGui::Text("merged, save this save to write the result");
+    }
+    else if (ImGui::Button("apply merge to this save"))
+    {
+      progress_t progress;
+      m_next_history_label = "merge";
+      m_merge_applied = m_csav->assign_root_and_reload(m_merge->result(), progress);
+    }
+
+    static ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersOuter
+      | ImGuiTableFlags_BordersV | ImGuiTableFlags_Resizable;
+    ImVec2 size = ImVec2(-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * 28);
+    if (ImGui::BeginTable("##merge_conflicts_table", 3, flags, size))
+    {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("conflict", ImGuiTableColumnFlags_WidthFixed, 120.f);
+      ImGui::TableSetupColumn("path", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableSetupColumn("detail", ImGuiTableColumnFlags_WidthStretch);
+      ImGui::TableHeadersRow();
+
+      ImGuiListClipper clipper;
+      clipper.Begin((int)conflicts.size());
+      while (clipper.Step())
+      {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+        {
+          auto& c = conflicts[row];
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn(); ImGui::Text("%s", save_merge_conflict::kind_name(c.kind));
+          ImGui::TableNextColumn(); ImGui::Text("%s", c.path.c_str());
+          ImGui::TableNextColumn(); ImGui::Text("%s", c.detail.c_str());
+        }
+      }
+      ImGui::EndTable();
+    }
+  }
+
+  void draw_history()
+  {
+    if (!m_history)
+      return;
+
+    const bool can_jump = can_jump_in_history();
+    if (ImGui::Button("undo") && m_history->can_undo())
+      request_history_jump(m_history->current() - 1);
+    ImGui::SameLine();
+    if (ImGui::Button("redo") && m_history->can_redo())
+      request_history_jump(m_history->current() + 1);
+    if (!can_jump)
+    {
+      ImGui::SameLine();
+      ImGui::Text("(waiting for the background jobs)");
+    }
+
+    auto& stats = m_history->stats();
+    ImGui::Text("last operation: %zu new snapshot nodes, %zu shared subtrees, %zu patched nodes (%.2fms)",
+      stats.new_nodes, stats.shared_nodes, stats.patched_nodes, stats.ms);
+    ImGui::Text("jumps reload the structures from the tree, their unsaved edits are saved or discarded first.");
+
+    auto& entries = m_history->entries();
+    ImGui::BeginChild("##history_entries", ImVec2(0, 0), true);
+    ImGuiListClipper clipper;
+    clipper.Begin((int)entries.size());
+    while (clipper.Step())
+    {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+        auto& e = entries[i];
+        const std::string label = fmt::format("{:%H:%M:%S} {}##{}",
+          fmt::localtime(std::chrono::system_clock::to_time_t(e.time)), e.label, i);
+        if (ImGui::Selectable(label.c_str(), (size_t)i == m_history->current()) && (size_t)i != m_history->current())
+          request_history_jump((size_t)i);
+      }
+    }
+    ImGui::EndChild();
+  }
+
   void draw_search_tools()
   {
     int line_width = (int)ImGui::GetContentRegionAvail().x;
@@ -713,17 +1342,86 @@ public:
 
     ImGui::Separator();
 
-    // bool pat_search = ImGui::Button("search pattern", ImVec2(150, 0)); ImGui::SameLine();
-    // ImGui::PushItemWidth(slider_width);
-    // ImGui::InputText("pattern bytes", search_needle.data(), (int)search_needle.size(), ImGuiInputTextFlags_CharsUppercase | ImGuiInputTextFlags_AlwaysInsertMode);
-    // ImGui::InvisibleButton("search pattern##inv", ImVec2(150, 1)); ImGui::SameLine();
-    // ImGui::PushItemWidth(slider_width);
-    // ImGui::InputTextEx("pattern mask", "x?xxx??x", search_mask.data(), (int)search_mask.size(), ImVec2(0, 0), ImGuiInputTextFlags_AlwaysInsertMode);
+    bool pat_search = ImGui::Button("search pattern", ImVec2(150, 0)); ImGui::SameLine();
+    ImGui::PushItemWidth(slider_width);
+    pat_search |= ImGui::InputTextWithHint("pattern", "E1 71 ?? 4E {4} (1B | 1C) [00-0F] 1?", &search_pattern_src, ImGuiInputTextFlags_EnterReturnsTrue);
+    if (ImGui::IsItemHovered())
+      ImGui::SetTooltip(
+        "4A: byte, ?? or ?: any byte, 4? ?A: nibble wildcards\n"
+        "[10-1F]: byte range, (01 | 02 03): alternatives\n"
+        "{4} {2-8}: gap of any bytes, \"text\": ascii bytes");
+    if (pat_search)
+    {
+      byte_pattern pattern;
+      if (pattern.parse(search_pattern_src, search_pattern_error))
+      {
+        search_pattern_error.clear();
+        search_compiled_pattern(std::move(pattern));
+      }
+    }
+    if (search_pattern_error.size())
+      ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "pattern error: %s", search_pattern_error.c_str());
 
-    // todo, parse hex string
+    ImGui::Separator();
+
+    const bool list_search = ImGui::Button("search list", ImVec2(150, 0)); ImGui::SameLine();
+    ImGui::PushItemWidth(slider_width);
+    ImGui::InputTextMultiline("one needle per line", &search_list_src, ImVec2(slider_width, ImGui::GetTextLineHeight() * 6));
+    ImGui::InvisibleButton("search list##next", ImVec2(150, 1)); ImGui::SameLine();
+    ImGui::PushItemWidth(150);
+    ImGui::Combo("##search_list_kind", &search_list_kind, search_list_kinds, (int)std::size(search_list_kinds));
+    if (search_list_kind == 0)
+    {
+      ImGui::SameLine(); ImGui::Checkbox("utf8", &search_list_utf8);
+      ImGui::SameLine(); ImGui::Checkbox("utf16", &search_list_utf16);
+    }
+    if (search_list_kind != 1)
+    {
+      ImGui::SameLine(); ImGui::Checkbox("+ TweakDB item names", &search_list_item_names);
+    }
+    ImGui::SameLine();
+    ImGui::PushItemWidth(100);
+    ImGui::InputScalar("max matches per needle (0: no limit)", ImGuiDataType_U64, &search_list_max_per_needle);
+    if (list_search)
+      search_needle_list();
 
     ImGui::Separator();
 
+    draw_value_scan();
+
+    ImGui::Separator();
+
+    if (m_hash_scan_job->is_running())
+      ImGui::Text("scanning known identifiers..");
+    else if (m_hash_index)
+    {
+      size_t cnts[3] = {};
+      for (auto& a : m_hash_index->entries())
+        ++cnts[(size_t)a.kind];
+      ImGui::Text("known identifiers: %zu TweakDBIDs, %zu CNames, %zu CFacts (%.2f ms)",
+        cnts[0], cnts[1], cnts[2], m_hash_scan_ms);
+      ImGui::SameLine();
+      if (ImGui::Button("rescan"))
+        start_hash_scan();
+      ImGui::SameLine();
+      if (ImGui::Button("export (tsv)"))
+      {
+        std::ofstream ofs(fmt::format("identifiers_{}.tsv", m_csav->filepath.parent_path().filename().string()));
+        if (ofs.is_open())
+          m_hash_index->write_tsv(ofs);
+      }
+    }
+
+    ImGui::Separator();
+
+    update_search();
+    if (search_job->is_running())
+      ImGui::Text("searching..");
+    else if (search_done)
+      ImGui::Text("%zu matches in %.2f ms (%s)%s", search_result.size(), search_elapsed_ms,
+        byte_find::kernel_name(byte_find::best_kernel()),
+        search_result.size() >= flat_search_job::default_max_matches ? ", truncated" : "");
+
     // results
 
     static std::shared_ptr<node_hexeditor> nh;
@@ -751,14 +1449,24 @@ public:
           ImGui::TableNextColumn();
 
           static char matchname[512];
-          ImFormatString(matchname, 512, "offset 0x%08X in node %4d - %s", match.offset, match.n->idx(), match.n->name().c_str());
+          if (search_needles)
+            ImFormatString(matchname, 512, "offset 0x%08X in node %4d - %s : %s", match.offset, match.n->idx(), match.n->name().c_str(),
+              search_needles->needle_label(match.needle).c_str());
+          else if (match.info.size())
+            ImFormatString(matchname, 512, "offset 0x%08X in node %4d - %s : %s", match.offset, match.n->idx(), match.n->name().c_str(),
+              match.info.c_str());
+          else
+            ImFormatString(matchname, 512, "offset 0x%08X in node %4d - %s", match.offset, match.n->idx(), match.n->name().c_str());
 
           if (ImGui::Selectable(matchname, selected_result == row))
           {
             selected_result = row;
             if (!nh || nh->node() != match.n)
               nh = std::make_shared<node_hexeditor>(match.n);
-            nh->select(match.offset, match.size);
+            // matches can continue in the next nodes
+            const size_t data_size = match.n->data().size();
+            const size_t offset = std::min(match.offset, data_size);
+            nh->select(offset, std::min(match.size, data_size - offset));
           }
         }
       }
@@ -836,13 +1544,25 @@ protected:
     std::shared_ptr<const node_t> n;
     size_t offset;
     size_t size;
+    uint32_t needle;
+    std::string info;
   };
   std::vector<search_match> search_result;
   size_t selected_result = (size_t)-1;
 
-  std::vector<search_match>& search_pattern_in_nodes(const std::string& needle, const std::string& mask)
+  // shared_ptr: headers are copied around by csav_list_widget
+  std::shared_ptr<flat_search_job> search_job = std::make_shared<flat_search_job>();
+  bool search_done = false;
+  double search_elapsed_ms = 0;
+  // needles of the last list search, for the match labels
+  std::shared_ptr<const multi_needle_set> search_needles;
+
+  static constexpr const char* search_list_kinds[] = {"text", "u32 (dec or 0x hex)", "TweakDBID"};
+
+  // the search runs on a flat copy of the tree, so matches can span
+  // several nodes and the ui isn't blocked meanwhile
+  void search_pattern_in_nodes(const std::string& needle, const std::string& mask)
   {
-    selected_result = (size_t)-1;
     // history draft
     /*
     std::stringstream ss;
@@ -854,204 +1574,213 @@ protected:
       ss << "mask:" << mask;
     auto it = searches.emplace(ss.str(), std::vector<search_match>());
     */
-    search_result.clear();
-    if (m_csav and !std::all_of(needle.begin(), needle.end(), [](char i) { return i==0; })) // searching for zeroes is just.. the way to die
-      search_pattern_in_nodes_rec(search_result, m_csav->root_node, needle, mask);
-    return search_result;
+    if (!std::all_of(needle.begin(), needle.end(), [](char i) { return i==0; })) // searching for zeroes is just.. the way to die
+      search_compiled_pattern(byte_pattern::from_bytes(needle, mask));
   }
 
-  void search_pattern_in_nodes_rec(std::vector<search_match>& matches, const std::shared_ptr<const node_t> node, const std::string& needle, const std::string& mask)
+  void search_compiled_pattern(byte_pattern pattern)
   {
-    auto& haystack = node->data();
-    std::vector<uintptr_t> match_offsets;
-    if (mask.size())
-      match_offsets = sse2_strstr_masked((uint8_t*)haystack.data(), haystack.size(), (uint8_t*)needle.data(), needle.size(), mask.data(), mask.size());
-    else
-      match_offsets = sse2_strstr((uint8_t*)haystack.data(), haystack.size(), (uint8_t*)needle.data(), needle.size());
-    for (auto off : match_offsets)
-      matches.emplace_back(search_match{node, off, needle.size()});
-    for (auto& c : node->children())
-      search_pattern_in_nodes_rec(matches, c, needle, mask);
+    if (search_job->is_running())
+      return;
+
+    selected_result = (size_t)-1;
+    search_result.clear();
+    search_needles.reset();
+    search_done = false;
+    if (m_csav)
+      search_job->start(current_flat_view(), std::move(pattern));
   }
-};
 
-class csav_list_widget
-{
-protected:
-  ImGui::FileBrowser open_dialog;
-  loading_bar_job_widget open_job;
-  std::filesystem::path open_filepath;
-  std::shared_ptr<csav> opened_save;
-  std::shared_ptr<AppImage> opened_save_img;
+  void draw_value_scan()
+  {
+    ImGui::PushItemWidth(100);
+    ImGui::Combo("##value_scan_type", &s_value_scan_type,
+      [](void*, int idx, const char** out) { *out = scan_value_type_name((scan_value_type)idx); return true; },
+      nullptr, (int)scan_value_type::count);
+    ImGui::SameLine();
+    ImGui::PushItemWidth(130);
+    ImGui::Combo("##value_scan_pred", &s_value_scan_pred,
+      [](void*, int idx, const char** out) { *out = scan_predicate_name((scan_predicate)idx); return true; },
+      nullptr, (int)scan_predicate::count);
 
-  std::list<csav_collapsable_header> m_list;
+    const auto pred = (scan_predicate)s_value_scan_pred;
+    if (pred == scan_predicate::equal || pred == scan_predicate::range)
+    {
+      ImGui::SameLine();
+      ImGui::PushItemWidth(130);
+      ImGui::InputDouble(pred == scan_predicate::range ? "min##value_scan" : "value##value_scan", &s_value_scan_v1);
+    }
+    if (pred == scan_predicate::range)
+    {
+      ImGui::SameLine();
+      ImGui::PushItemWidth(130);
+      ImGui::InputDouble("max##value_scan", &s_value_scan_v2);
+    }
 
-public:
-  csav_list_widget()
-  {
-    open_dialog.SetTitle("Opening savefile");
-    open_dialog.SetTypeFilters({ ".dat" });
+    if (s_value_scan_job.is_running())
+    {
+      ImGui::Text("scanning %s..", s_value_scan_owner_name.c_str());
+      return;
+    }
 
-    try
+    const bool first_scan = ImGui::Button("first scan", ImVec2(150, 0));
+    ImGui::SameLine();
+    const bool next_scan = s_value_scan.has_candidates() && ImGui::Button("next scan", ImVec2(150, 0));
+    if (s_value_scan.has_candidates())
     {
-      auto& jroot = ps_json_storage::get().jroot();
-      if (jroot.find("open_path") != jroot.end())
-        open_dialog.SetPwd(jroot.at("open_path").get<std::string>());
+      ImGui::SameLine();
+      if (ImGui::Button("reset##value_scan"))
+        s_value_scan.reset();
     }
-    catch (std::exception&) {}
-  }
-  
-  void update()
-  {
-    open_job.update();
-    if (opened_save)
+
+    if ((first_scan || next_scan) && s_value_scan_job.start(s_value_scan, current_flat_view(), first_scan,
+      (scan_value_type)s_value_scan_type, pred, s_value_scan_v1, s_value_scan_v2))
     {
-      m_list.emplace_back(opened_save, opened_save_img);
-      opened_save.reset();
-      opened_save_img.reset();
+      s_value_scan_owner = m_csav;
+      s_value_scan_owner_name = m_pretty_name;
+      return;
     }
 
-    m_list.erase(
-      std::remove_if(m_list.begin(), m_list.end(), [](auto& a){ return a.is_closed(); }),
-      m_list.end()
-    );
+    if (value_scan_error.size())
+      ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "scan error: %s", value_scan_error.c_str());
+    else if (s_value_scan.has_candidates())
+      ImGui::Text("%zu %s candidates after %zu scan(s), last one on %s in %.2f ms%s",
+        s_value_scan.candidate_count(), scan_value_type_name(s_value_scan.type()), s_value_scan.scan_count(),
+        s_value_scan_last_save.c_str(), s_value_scan_ms,
+        s_value_scan.candidate_count() > flat_search_job::default_max_matches ? " (too many to list)" : "");
+  }
 
-    for (auto& cs : m_list)
-      cs.update();
+  void update_value_scan()
+  {
+    auto owner = s_value_scan_owner.lock();
+    if (owner && owner != m_csav)
+      return;
+    if (!s_value_scan_job.poll(s_value_scan, value_scan_error, s_value_scan_ms) || value_scan_error.size())
+      return;
+
+    s_value_scan_last_save = s_value_scan_owner_name;
+    if (owner)
+      list_value_scan_candidates();
   }
 
-  void draw_list()
+  // candidates are listed in the search results when there are few enough
+  void list_value_scan_candidates()
   {
-    // todo: remove that when error popup is app-wide
-    node_editor_widget::draw_popups();
+    if (search_job->is_running())
+      return;
 
-    // Expose a couple of the available flags. In most cases you may just call BeginTabBar() with no flags (0).
-    static ImGuiTabBarFlags tab_bar_flags =
-      ImGuiTabBarFlags_Reorderable |
-      ImGuiTabBarFlags_AutoSelectNewTabs |
-      ImGuiTabBarFlags_FittingPolicyResizeDown;
+    selected_result = (size_t)-1;
+    search_result.clear();
+    search_needles.reset();
+    search_done = false;
 
-    // Passing a bool* to BeginTabItem() is similar to passing one to Begin():
-    // the underlying bool will be set to false when the tab is closed.
-    if (ImGui::BeginTabBar("MyTabBar", tab_bar_flags))
+    if (s_value_scan.candidate_count() > flat_search_job::default_max_matches)
+      return;
+
+    const size_t value_size = scan_value_type_size(s_value_scan.type());
+    for (auto& c : s_value_scan.candidates(flat_search_job::default_max_matches))
     {
-      if (ImGui::TabItemButton("  +  ", ImGuiTabItemFlags_Leading | ImGuiTabItemFlags_NoTooltip) && !open_job.is_running())
-        open_dialog.Open();
+      if (!c.loc.node)
+        continue;
+      std::string info = c.prev_value.size() ? fmt::format("{} -> {}", c.prev_value, c.value) : c.value;
+      search_result.push_back(search_match{c.loc.node, c.loc.offset, value_size, 0, std::move(info)});
+    }
+  }
 
-      size_t i = 0;
-      for (auto it = m_list.begin(); it != m_list.end(); ++it)
+  void add_list_needle(multi_needle_set& needles, const std::string& line)
+  {
+    switch (search_list_kind)
+    {
+      case 0:
       {
-        scoped_imgui_id _sii(&*it);
-        bool opened = true;
-        if (ImGui::BeginTabItem(it->pretty_name().c_str(), &opened, ImGuiTabItemFlags_None))
+        if (search_list_utf8)
+          needles.add(line, line);
+        if (search_list_utf16)
         {
-          it->draw();
-          ImGui::EndTabItem();
+          std::u16string str16;
+          try
+          {
+            std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
+            str16 = convert.from_bytes(line);
+          }
+          catch (std::range_error&)
+          {
+            break; // not valid utf8
+          }
+          needles.add(std::string_view((const char*)str16.data(), str16.size() * 2), line + " (utf16)");
         }
-        if (!opened)
-          it->close();
+        break;
       }
-      ImGui::EndTabBar();
+      case 1:
+      {
+        char* end = nullptr;
+        const unsigned long long v = std::strtoull(line.c_str(), &end, 0);
+        if (end == line.c_str() || *end || v > UINT32_MAX)
+          break;
+        const uint32_t u32_v = (uint32_t)v;
+        needles.add(std::string_view((const char*)&u32_v, 4), line);
+        break;
+      }
+      case 2:
+      {
+        TweakDBID id(line);
+        needles.add(std::string_view((const char*)&id.as_u64, 8), line);
+        break;
+      }
+      default:
+        break;
     }
   }
 
-  void open_file(IApp* owning_app, std::wstring fpath)
+  // all the needles are searched in a single pass
+  void search_needle_list()
   {
-    if (open_job.is_running())
-    {
-      // todo: add centralized error modal popup to IApp
-      // and open an error here
+    if (search_job->is_running() || !m_csav)
       return;
-    }
 
-    open_filepath = std::filesystem::absolute(fpath);
+    auto needles = std::make_shared<multi_needle_set>();
 
-    try
+    std::istringstream iss(search_list_src);
+    std::string line;
+    while (std::getline(iss, line))
     {
-      std::filesystem::path dirpath = open_filepath;
-      auto& jroot = ps_json_storage::get().jroot();
-      jroot["open_path"] = dirpath.remove_filename().string();
+      if (line.size() && line.back() == '\r')
+        line.pop_back();
+      if (line.size())
+        add_list_needle(*needles, line);
     }
-    catch (std::exception&) {}
-
-    auto screenshot_path = open_filepath;
-    screenshot_path.replace_filename(L"screenshot.png");
-    if (std::filesystem::exists(screenshot_path))
-      opened_save_img = owning_app->load_texture_from_file(screenshot_path.string());
 
-    open_job.start([this](progress_t& progress) -> bool {
-      auto cs = std::make_shared<csav>();
-      if (!cs->open_with_progress(open_filepath, progress, s_dump_decompressed_data))
-        return false;
-      opened_save = cs;
-      return true;
-    });
-  }
-
-  void draw_menu_item(IApp* owning_app)
-  {
-    if (ImGui::MenuItem("Open savefile", 0, false, !open_job.is_running()))
-      open_dialog.Open();
-
-    open_dialog.Display();
-
-    if (open_dialog.HasSelected())
+    if (search_list_item_names && search_list_kind != 1)
     {
-      open_file(owning_app, open_dialog.GetSelected().wstring());
-      open_dialog.ClearSelected();
+      for (auto& name : TweakDBIDResolver::get().sorted_names(TweakDBIDCategory::Item))
+        add_list_needle(*needles, name);
     }
 
-    // be sure that this modal is opened
-    if (open_job.is_running())
-      ImGui::OpenPopup("Loading..##LOAD");
-
-    if (ImGui::BeginMenu("Options"))
-    {
-      ImGui::Checkbox("use ps4wizard format", &s_use_ps4_weird_format);
-      ImGui::Checkbox("dump decompressed data", &s_dump_decompressed_data);
-      ImGui::Checkbox("show CObject field types", &CObject::show_field_types);
-      ImGui::Checkbox("show CProperty skipped flag", &CProperty::imgui_show_skipped);
-      ImGui::EndMenu();
-    }
+    if (needles->empty())
+      return;
+    needles->compile();
 
-    if (0 && ImGui::Button("open error"))
-      ImGui::OpenPopup("Loading..##LOAD");
+    selected_result = (size_t)-1;
+    search_result.clear();
+    search_done = false;
+    search_needles = needles;
 
-    // Always center this window when appearing
-    ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
-    ImGui::SetNextWindowPos(center, ImGuiCond_Appearing, ImVec2(0.5f, 0.5f));
+    search_job->start(current_flat_view(), needles, flat_search_job::default_max_matches, search_list_max_per_needle);
+  }
 
-    bool pushed_stylecol = false;
-    if (open_job.failed) {
-      ImGui::PushStyleColor(ImGuiCol_ModalWindowDimBg, (ImVec4)ImColor::HSV(0.f, 1.f, 0.6f, 0.35f));
-      pushed_stylecol = true;
-    }
+  void update_search()
+  {
+    std::vector<flat_search_match> matches;
+    if (!search_job->poll(matches, search_elapsed_ms))
+      return;
 
-    if (ImGui::BeginPopupModal("Loading..##LOAD", NULL, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoMove))
+    search_done = true;
+    search_result.clear();
+    search_result.reserve(matches.size());
+    for (auto& m : matches)
     {
-      ImGui::Text("path: %s", open_filepath.string().c_str());
-
-      if (open_job.is_running())
-      {
-        open_job.draw();
-      }
-      else if (open_job.failed)
-      {
-        ImGui::Text("error, couldn't load savefile");
-        ImGui::Separator();
-        if (ImGui::Button("OK", ImVec2(ImGui::GetContentRegionAvail().x, 0)))
-          ImGui::CloseCurrentPopup();
-      }
-      else
-      {
-        ImGui::CloseCurrentPopup();
-      }
-
-      ImGui::EndPopup();
+      if (m.loc.node)
+        search_result.push_back(search_match{m.loc.node, m.loc.offset, m.size, m.needle});
     }
-
-    if (pushed_stylecol)
-      ImGui::PopStyleColor();
   }
 };
-
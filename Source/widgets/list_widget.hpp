@@ -1,5 +1,5 @@
 #pragma once
-#include <AppLib/IApp.hpp>
+#include <AppLib/imgui_helpers.hpp>
 #include <list>
 
 
@@ -12,6 +12,8 @@
 #include "hexedit.hpp"
 
 #include <csav/cnodes.hpp>
+#include <csav/csystem/CSystemQuery.hpp>
+#include <csav/csystem/CObjectListLabels.hpp>
 
 // to be used with CScriptObjProperty struct
 struct CProperty_widget
@@ -42,15 +44,111 @@ struct CObject_widget
 // to be used with CSystem struct
 struct CSystem_widget
 {
-  static std::string object_name_getter(const CObjectSPtr& item)
+
+  // filter of the object list, owned by the editor
+  struct query_state_t
   {
-    static std::string tmp;
-    tmp = item->ctypename().str();
-    return tmp;
+    std::string text;
+    CSystemQuery query;
+    std::string status;
+    std::vector<size_t> matches;
+    uint64_t index_version = 0;
+    size_t objects_cnt = 0;
+    bool active = false;
   };
 
+  static void run_query(CSystem& sys, query_state_t& qs)
+  {
+    auto& index = sys.query_index();
+    qs.matches = index.run(sys, qs.query);
+    qs.index_version = index.version();
+    qs.objects_cnt = sys.objects().size();
+
+    auto& stats = index.last_stats();
+    qs.status = fmt::format("{} matches in {:.2f}ms ({} candidates{}{})",
+      stats.matches, stats.ms, stats.candidates,
+      stats.used_type_index ? ", type index" : "",
+      stats.used_value_indexes ? fmt::format(", {} value indexes", stats.used_value_indexes) : "");
+  }
+
+  static void draw_query_bar(CSystem& sys, query_state_t& qs)
+  {
+    ImGui::PushItemWidth(500.f);
+    const bool enter = ImGui::InputTextWithHint("##query", "query, e.g. @type == vehicleGarageComponentPS && spawnedVehiclesData.@count > 0",
+      &qs.text, ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    if (enter || ImGui::Button("filter"))
+    {
+      std::string err;
+      qs.active = qs.query.parse(qs.text, err);
+      if (qs.active)
+        run_query(sys, qs);
+      else
+        qs.status = err;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("clear"))
+    {
+      qs.active = false;
+      qs.status.clear();
+      qs.matches.clear();
+    }
+
+    // edits, additions and removals invalidate the results
+    if (qs.active && (qs.index_version != sys.query_index().version() || qs.objects_cnt != sys.objects().size()))
+      run_query(sys, qs);
+
+    if (qs.status.size())
+    {
+      ImGui::SameLine();
+      ImGui::TextUnformatted(qs.status.c_str());
+    }
+  }
+
+  static void draw_query_matches(CSystem& sys, const query_state_t& qs, CObjectListLabels& labels, int* selected_object)
+  {
+    auto& objects = sys.objects();
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)qs.matches.size());
+    while (clipper.Step())
+    {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+        const size_t obj_idx = qs.matches[i];
+        if (obj_idx >= objects.size())
+          continue;
+        scoped_imgui_id _sii((int)obj_idx);
+        if (ImGui::Selectable(labels.label(obj_idx).c_str(), *selected_object == (int)obj_idx))
+          *selected_object = (int)obj_idx;
+      }
+    }
+  }
+
+  static void draw_objects(CSystem& sys, CObjectListLabels& labels, int* selected_object)
+  {
+    auto& objects = sys.objects();
+
+    ImGuiListClipper clipper;
+    clipper.Begin((int)objects.size(), ImGui::GetTextLineHeightWithSpacing());
+    while (clipper.Step())
+    {
+      for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i)
+      {
+        const bool selected = (i == *selected_object);
+        scoped_imgui_id _sii(i);
+        if (ImGui::Selectable(labels.label(i).c_str(), selected))
+          *selected_object = i;
+        if (selected)
+          ImGui::SetItemDefaultFocus();
+      }
+    }
+  }
+
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(CSystem& sys, int* selected_object)
+  // labels must be kept by the caller between frames
+  [[nodiscard]] static inline bool draw(CSystem& sys, int* selected_object, CObjectListLabels& labels, query_state_t* query_state = nullptr)
   {
     ImGuiWindow* window = ImGui::GetCurrentWindow();
     if (window->SkipItems)
@@ -73,6 +171,9 @@ struct CSystem_widget
     }
     else
     {
+      if (query_state)
+        draw_query_bar(sys, *query_state);
+
       static ImGuiTableFlags tbl_flags = ImGuiTableFlags_BordersOuter | ImGuiTableFlags_BordersV
         | ImGuiTableFlags_Resizable;
 
@@ -89,7 +190,11 @@ struct CSystem_widget
 
         //ImGui::PushItemWidth(150.f);
         ImGui::BeginChild("Objects", ImVec2(-FLT_MIN, 0));
-        modified |= ImGui::ErasableListBox("##CSystem::objects", selected_object, &object_name_getter, objects, true, true);
+        labels.sync(objects);
+        if (query_state && query_state->active)
+          draw_query_matches(sys, *query_state, labels, selected_object);
+        else
+          draw_objects(sys, labels, selected_object);
         ImGui::EndChild();
         //ImGui::PopItemWidth();
 
@@ -136,7 +241,7 @@ struct CPSData_widget
   }
 
   // returns true if content has been edited
-  [[nodiscard]] static inline bool draw(CPSData& psdata, int* selected_object)
+  [[nodiscard]] static inline bool draw(CPSData& psdata, int* selected_object, CObjectListLabels& labels, CSystem_widget::query_state_t* query_state = nullptr)
   {
     bool modified = false;
 
@@ -147,7 +252,7 @@ struct CPSData_widget
     ImGui::EndChild();
 
     //ImGui::Text("PSData");
-    modified |= CSystem_widget::draw(psdata.system(), selected_object);
+    modified |= CSystem_widget::draw(psdata.system(), selected_object, labels, query_state);
 
     static int selected_dummy = -1;
     ImGui::ListBox("trailing names", &selected_dummy, &trailing_name_string_getter, (void*)&psdata.trailing_names, (int)psdata.trailing_names.size());
@@ -210,6 +315,8 @@ public:
 
 protected:
   int selected_obj = -1;
+  CObjectListLabels m_labels;
+  CSystem_widget::query_state_t m_query;
 
   bool draw_impl(const ImVec2& size) override
   {
@@ -217,7 +324,7 @@ protected:
 
     //ImGui::Text("System");
 
-    return CSystem_widget::draw(m_data.system(), &selected_obj);
+    return CSystem_widget::draw(m_data.system(), &selected_obj, m_labels, &m_query);
   }
 };
 
@@ -277,10 +384,12 @@ protected:
   int selected_obj = -1;
   int selected_prop = -1;
   int selected_dummy = -1;
+  CObjectListLabels m_labels;
+  CSystem_widget::query_state_t m_query;
 
   bool draw_impl(const ImVec2& size) override
   {
-    return CPSData_widget::draw(m_data, &selected_obj);;
+    return CPSData_widget::draw(m_data, &selected_obj, m_labels, &m_query);
   }
 };
 
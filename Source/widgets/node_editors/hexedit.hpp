@@ -3,15 +3,28 @@
 #include "node_editor.hpp"
 #include "utils.hpp"
 #include "imgui_extras/imgui_memory_editor.hpp"
+#include "imgui_extras/imgui_stdlib.h"
+#include <csav/piece_table.hpp>
+#include <csav/search/byte_pattern.hpp>
+#include <csav/search/known_hash_scan.hpp>
 
 class node_hexeditor
   : public node_editor_widget
 {
   static inline std::vector<char> m_clipboard;
-  std::vector<char> editbuf;
+  // edits stay in the piece table until commit, which materializes it
+  piece_table editbuf;
   MemoryEditor me;
   bool m_write_event = false;
 
+  // pattern search in editbuf
+  static constexpr size_t max_find_matches = 10000;
+  std::string m_find_src;
+  std::string m_find_error;
+  std::vector<byte_match> m_find_matches;
+  size_t m_find_idx = 0;
+  bool m_find_done = false;
+
 public:
   node_hexeditor(const std::shared_ptr<const node_t>& node)
     : node_editor_widget(node, csav_version{})
@@ -41,7 +54,7 @@ protected:
   {
     auto& buf = ((node_hexeditor*)data)->editbuf;
     if (off < buf.size())
-      return buf.at(off);
+      return (ImU8)buf.at(off);
     return 0;
   }
 
@@ -49,9 +62,9 @@ protected:
   {
     node_hexeditor* e = (node_hexeditor*)data;
     auto& buf = e->editbuf;
-    if (off < buf.size() && buf[off] != d)
+    if (off < buf.size() && (ImU8)buf.at(off) != d)
     {
-      buf[off] = d;
+      buf.write(off, (char)d);
       e->m_write_event = true;
     }
   }
@@ -62,7 +75,7 @@ protected:
     auto& buf = e->editbuf;
     auto& original = e->node()->data();
     if (off < buf.size() && off < original.size())
-      return buf[off] != original[off];
+      return buf.at(off) != original[off];
     return false;
   }
 
@@ -93,9 +106,20 @@ protected:
     ImVec2 c2 = ImGui::GetCursorScreenPos();
     c2.x += ImGui::GetContentRegionAvailWidth();
 
+    draw_find_bar();
+    draw_known_identifiers();
+
     if (ImGui::IsMouseHoveringRect(c1, c2) && ImGui::IsMouseReleased(ImGuiMouseButton_Right))
       ImGui::OpenPopup("context##hexedit");
 
+    if (ImGui::IsMouseHoveringRect(c1, c2) && ImGui::GetIO().KeyCtrl && me.DataEditingAddr == (size_t)-1)
+    {
+      if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Z)))
+        modified |= editbuf.undo();
+      else if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Y)))
+        modified |= editbuf.redo();
+    }
+
     if (ImGui::BeginPopup("context##hexedit"))
     {
       if (me.DataSelectionStart != (size_t)-1 || editbuf.empty())
@@ -111,22 +135,21 @@ protected:
         if (!editbuf.empty())
         {
           if (ImGui::Selectable("copy"))
-            m_clipboard.assign(editbuf.begin() + seladdr_beg, editbuf.begin() + seladdr_end);
+            m_clipboard = editbuf.read(seladdr_beg, seladdr_end - seladdr_beg);
 
           if (ImGui::Selectable("paste"))
           {
-            editbuf.erase(editbuf.begin() + seladdr_beg, editbuf.begin() + seladdr_end);
-            editbuf.insert(editbuf.begin() + seladdr_beg, m_clipboard.begin(), m_clipboard.end());
+            editbuf.replace(seladdr_beg, seladdr_end - seladdr_beg, m_clipboard.data(), m_clipboard.size());
             modified = true;
           }
           if (ImGui::Selectable("paste insert"))
           {
-            editbuf.insert(editbuf.begin() + seladdr_beg, m_clipboard.begin(), m_clipboard.end());
+            editbuf.insert(seladdr_beg, m_clipboard.data(), m_clipboard.size());
             modified = true;
           }
           if (ImGui::Selectable("erase"))
           {
-            editbuf.erase(editbuf.begin() + seladdr_beg, editbuf.begin() + seladdr_end);
+            editbuf.erase(seladdr_beg, seladdr_end - seladdr_beg);
             modified = true;
           }
           ImGui::Separator();
@@ -143,11 +166,17 @@ protected:
         if (ImGui::Selectable("insert"))
         {
           std::vector<char> values((size_t)cnt, value);
-          editbuf.insert(editbuf.begin() + seladdr_beg, values.begin(), values.end());
+          editbuf.insert(seladdr_beg, values.data(), values.size());
           modified = true;
         }
       }
 
+      ImGui::Separator();
+      if (ImGui::Selectable("undo (ctrl+z)", false, editbuf.can_undo() ? 0 : ImGuiSelectableFlags_Disabled))
+        modified |= editbuf.undo();
+      if (ImGui::Selectable("redo (ctrl+y)", false, editbuf.can_redo() ? 0 : ImGuiSelectableFlags_Disabled))
+        modified |= editbuf.redo();
+
       ImGui::EndPopup();
     }
 
@@ -160,16 +189,126 @@ protected:
     return modified;
   }
 
+  void draw_find_bar()
+  {
+    ImGui::PushItemWidth(300.f);
+    bool find = ImGui::InputTextWithHint("##find_pattern", "find: 4A ?? [00-0F] {2} (01 | 02)", &m_find_src, ImGuiInputTextFlags_EnterReturnsTrue);
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    find |= ImGui::Button("find##hexedit");
+
+    if (find)
+    {
+      m_find_matches.clear();
+      m_find_idx = 0;
+      m_find_done = false;
+
+      byte_pattern pattern;
+      if (pattern.parse(m_find_src, m_find_error))
+      {
+        m_find_error.clear();
+        const auto flat = editbuf.to_vector();
+        pattern.find_all((const uint8_t*)flat.data(), flat.size(), m_find_matches, max_find_matches);
+        m_find_done = true;
+        if (m_find_matches.size())
+          select_find_match();
+      }
+    }
+
+    const size_t cnt = m_find_matches.size();
+    if (cnt)
+    {
+      ImGui::SameLine();
+      if (ImGui::ArrowButton("##find_prev", ImGuiDir_Left))
+      {
+        m_find_idx = (m_find_idx + cnt - 1) % cnt;
+        select_find_match();
+      }
+      ImGui::SameLine();
+      if (ImGui::ArrowButton("##find_next", ImGuiDir_Right))
+      {
+        m_find_idx = (m_find_idx + 1) % cnt;
+        select_find_match();
+      }
+      ImGui::SameLine();
+      ImGui::Text("%zu/%zu%s", m_find_idx + 1, cnt, cnt >= max_find_matches ? "+" : "");
+    }
+    else if (m_find_error.size())
+    {
+      ImGui::SameLine();
+      ImGui::TextColored(ImVec4(1.f, 0.3f, 0.3f, 1.f), "%s", m_find_error.c_str());
+    }
+    else if (m_find_done)
+    {
+      ImGui::SameLine();
+      ImGui::Text("no match");
+    }
+  }
+
+  // annotations of the last identifier scan of the save, the ones whose
+  // bytes have been edited since are greyed out
+  void draw_known_identifiers()
+  {
+    hash_annotation_index::node_range_t range;
+    auto index = hash_annotation_registry::get().find(node().get(), range);
+    if (!index)
+      return;
+
+    if (!ImGui::TreeNode("known_identifiers", "known identifiers (%zu)", range.count))
+      return;
+
+    const float height = ImGui::GetTextLineHeightWithSpacing() * std::min<size_t>(range.count, 8) + 4.f;
+    ImGui::BeginChild("known_identifiers##list", ImVec2(0, height), false);
+
+    auto& entries = index->entries();
+    ImGuiListClipper clipper;
+    clipper.Begin((int)range.count);
+    while (clipper.Step())
+    {
+      for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++)
+      {
+        auto& a = entries[range.first + row];
+        const size_t off = a.offset - range.data_flat_offset;
+        bool valid = off + a.size() <= editbuf.size();
+        if (valid)
+        {
+          char bytes[8] = {};
+          editbuf.read(off, a.size(), bytes);
+          valid = std::memcmp(bytes, &a.hash, a.size()) == 0;
+        }
+
+        scoped_imgui_id sii{row};
+        if (!valid)
+          ImGui::PushStyleColor(ImGuiCol_Text, ImGui::GetStyleColorVec4(ImGuiCol_TextDisabled));
+        const std::string label = fmt::format("0x{:04X} {:9} {}", off, hash_annotation::kind_name(a.kind), a.name());
+        if (ImGui::Selectable(label.c_str()) && valid)
+          select(off, a.size());
+        if (!valid)
+          ImGui::PopStyleColor();
+      }
+    }
+
+    ImGui::EndChild();
+    ImGui::TreePop();
+  }
+
+  void select_find_match()
+  {
+    auto& m = m_find_matches[m_find_idx];
+    if (m.offset < editbuf.size())
+      select(m.offset, std::max<size_t>(m.size, 1));
+  }
+
   bool commit_impl() override
   {
-    ncnode()->assign_data(editbuf.begin(), editbuf.end());
+    // the history is kept, an undone commit can be committed again
+    ncnode()->assign_data(editbuf.to_vector());
     return true;
   }
 
   bool reload_impl() override 
   {
-    const auto& buf = node()->data();
-    editbuf.assign(buf.begin(), buf.end());
+    editbuf.assign(node()->data());
     return true;
   }
 };
@@ -48,6 +48,7 @@ struct CInventory_widget
           subinv.items.sort([](const CItemData& a, const CItemData& b){
             return a.name() < b.name();
           });
+          modified = true;
         }
         ImGui::SameLine();
         if (ImGui::Button("Add dummy item (alcohol6)", ImVec2(0, 30)))
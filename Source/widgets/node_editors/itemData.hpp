@@ -1,6 +1,6 @@
 #pragma once
 #include <inttypes.h>
-#include <AppLib/IApp.hpp>
+#include <AppLib/imgui_helpers.hpp>
 #include <csav/cnodes/CItemData.hpp>
 #include <widgets/list_widget.hpp>
 #include <widgets/cpinternals.hpp>
@@ -107,7 +107,7 @@ struct CItemMod_widget
       //  default: break;
       //}
 
-      ImGui::InputText("unknown string", item.cn0, sizeof(item.cn0));
+      modified |= ImGui::InputText("unknown string", item.cn0, sizeof(item.cn0));
 
       modified |= ImGui::InputScalar("field u32 (hex)##uk2",   ImGuiDataType_U32, &item.uk2, NULL, NULL, "%08X", ImGuiInputTextFlags_CharsHexadecimal);
 
@@ -214,12 +214,13 @@ struct CItemData_widget
           }
           catch (std::exception& e)
           {
-            MessageBoxA(0, e.what(), "error", 0);
+            report_error("error", e.what());
           }
         }
         else
         {
           item.uk3.nameid.as_u64 = 0x14951C01A5;
+          modified = true;
         }
       }
 
@@ -7,7 +7,7 @@
 #include <sstream>
 #include <iostream>
 
-#include "AppLib/IApp.hpp"
+#include "AppLib/imgui_helpers.hpp"
 #include "csav/node.hpp"
 #include "csav/csav_version.hpp"
 #include "fmt/format.h"